@@ -15,31 +15,311 @@
 
 #include <tchar.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <time.h>
 #include <stdarg.h>
 
 #include "hwapi.h"
 #include "base64.h"
-
-#define IsHexChar(a) ((a >= '0' && a <= '9') || (a >= 'A' && a <= 'F') || (a >= 'a' && a <= 'f'))
-#define IsSkipChar(a) ((a == ' ') || (a == 0xd) || (a == 0xa) || (a == '\t'))
-#define IsNumber(a) ((a >= '0' && a <= '9'))
-#define IsUpper(a) ((a >= 'a' && a <= 'f'))
-#define IsLower(a) ((a >= 'A' && a <= 'F'))
+#include "bufpool.h"
+#include "decode.h"
+#include "hex.h"
+#include "scanner.h"
+#include "docedit.h"
+#include "config.h"
+#include "filedecode.h"
+#include "clipcache.h"
+#include "hexdump.h"
+#include "ascii85.h"
+#include "bitstr.h"
+#include "sniff.h"
+#include "chain.h"
+#include "fileindex.h"
+#include "prompt.h"
+#include "patch.h"
+#include "compare.h"
+#include "docfind.h"
+#include "docwrite.h"
 
 // Plug-in Command constants
 #define PARSE_HEX_STRING  _T("parse to Binary by\\Hex")
 #define PARSE_BASE64_STRING  _T("parse to Binary by\\Base64")
+#define FIND_ENCODED_BOOKMARK  _T("find Encoded Data\\Bookmark hex/base64 runs")
+#define FIND_ENCODED_DECODE  _T("find Encoded Data\\Decode hex/base64 runs to new document")
+#define DECODE_SELECTION_HEX  _T("decode Selection in place\\Hex")
+#define DECODE_SELECTION_BASE64  _T("decode Selection in place\\Base64")
+#define PASTE_DECODED  _T("paste Decoded (detect format)")
+#define AUTODECODE_HEX  _T("auto Decode on Open\\Hex files")
+#define AUTODECODE_BASE64  _T("auto Decode on Open\\Base64 files")
+// Followed by the name of a chain from the [Chains] section
+#define PASTE_CHAIN_PREFIX  _T("paste Transformed\\")
+#define INDEX_BUILD_HEX  _T("index Encoded File\\Build index (hex)")
+#define INDEX_BUILD_BASE64  _T("index Encoded File\\Build index (base64)")
+#define INDEX_EXTRACT  _T("index Encoded File\\Extract decoded range")
+#define APPLY_PATCH  _T("apply Patch Script from clipboard")
+#define COMPARE_HEX  _T("compare Clipboard at caret\\Hex")
+#define COMPARE_BASE64  _T("compare Clipboard at caret\\Base64")
+#define FIND_PATTERN_HEX  _T("find Decoded Pattern\\Hex (?? wildcards)")
+#define FIND_PATTERN_BASE64  _T("find Decoded Pattern\\Base64")
+
+// Shortest hex / base64 run reported by the scanner, line breaks excluded
+#define FIND_ENCODED_MIN_RUN 64
+// Bookmarks added per scan; further hits are only counted in the log
+#define FIND_ENCODED_MAX_BOOKMARKS 4096
+// Longest clipboard text read as a base64 pattern
+#define FIND_PATTERN_MAX_TEXT (4 * BYTEFIND_MAX_PATTERN)
+
+// [Autoexec] settings of the plugin .ini (see config.h); a file named
+// x.txt.b64 is matched by its last extension
+#define AUTODECODE_SECTION  _T("Autoexec")
+#define AUTODECODE_HEX_EXTENSIONS  _T("hex")
+#define AUTODECODE_BASE64_EXTENSIONS  _T("b64;pem")
+
+// [Index] settings: IntervalKB, the text between two checkpoints
+#define INDEX_SECTION  _T("Index")
+
+// [Pool] settings: LargePages=1 backs pooled buffers of 2 MB and up with
+// large pages, for users holding SeLockMemoryPrivilege (see bufpool.h)
+#define POOL_SECTION  _T("Pool")
+
+// Hex commands that read the text as words of a fixed size
+typedef struct _HEX_WORD_COMMAND
+{
+	LPCTSTR         lpszCommand;
+	unsigned int    uWordSize;
+	HWAPI_BYTEORDER eByteOrder;
+} HEX_WORD_COMMAND;
+
+static const HEX_WORD_COMMAND g_HexWordCommands[] =
+{
+	{ _T("parse to Binary by\\Hex WORDs (little-endian)"),  2, HWAPI_BYTEORDER_LITTLE_ENDIAN },
+	{ _T("parse to Binary by\\Hex DWORDs (little-endian)"), 4, HWAPI_BYTEORDER_LITTLE_ENDIAN },
+	{ _T("parse to Binary by\\Hex QWORDs (little-endian)"), 8, HWAPI_BYTEORDER_LITTLE_ENDIAN },
+	{ _T("parse to Binary by\\Hex WORDs (big-endian)"),     2, HWAPI_BYTEORDER_BIG_ENDIAN },
+	{ _T("parse to Binary by\\Hex DWORDs (big-endian)"),    4, HWAPI_BYTEORDER_BIG_ENDIAN },
+	{ _T("parse to Binary by\\Hex QWORDs (big-endian)"),    8, HWAPI_BYTEORDER_BIG_ENDIAN },
+};
+
+// Commands that read the text as a list of numbers of one data type
+typedef struct _NUMBER_COMMAND
+{
+	LPCTSTR         lpszCommand;
+	HWAPI_DATATYPE  eType;
+	HWAPI_SIGN      eSign;
+	HWAPI_BYTEORDER eByteOrder;
+} NUMBER_COMMAND;
+
+static const NUMBER_COMMAND g_NumberCommands[] =
+{
+	{ _T("parse Numbers to Binary as\\BYTEs (signed)"),                     HWAPI_DATATYPE_BYTE,      HWAPI_SIGN_SIGNED,   HWAPI_BYTEORDER_LITTLE_ENDIAN },
+	{ _T("parse Numbers to Binary as\\BYTEs (unsigned)"),                   HWAPI_DATATYPE_BYTE,      HWAPI_SIGN_UNSIGNED, HWAPI_BYTEORDER_LITTLE_ENDIAN },
+	{ _T("parse Numbers to Binary as\\WORDs (signed, little-endian)"),      HWAPI_DATATYPE_WORD,      HWAPI_SIGN_SIGNED,   HWAPI_BYTEORDER_LITTLE_ENDIAN },
+	{ _T("parse Numbers to Binary as\\WORDs (unsigned, little-endian)"),    HWAPI_DATATYPE_WORD,      HWAPI_SIGN_UNSIGNED, HWAPI_BYTEORDER_LITTLE_ENDIAN },
+	{ _T("parse Numbers to Binary as\\DWORDs (signed, little-endian)"),     HWAPI_DATATYPE_DWORD,     HWAPI_SIGN_SIGNED,   HWAPI_BYTEORDER_LITTLE_ENDIAN },
+	{ _T("parse Numbers to Binary as\\DWORDs (unsigned, little-endian)"),   HWAPI_DATATYPE_DWORD,     HWAPI_SIGN_UNSIGNED, HWAPI_BYTEORDER_LITTLE_ENDIAN },
+	{ _T("parse Numbers to Binary as\\QWORDs (signed, little-endian)"),     HWAPI_DATATYPE_QWORD,     HWAPI_SIGN_SIGNED,   HWAPI_BYTEORDER_LITTLE_ENDIAN },
+	{ _T("parse Numbers to Binary as\\QWORDs (unsigned, little-endian)"),   HWAPI_DATATYPE_QWORD,     HWAPI_SIGN_UNSIGNED, HWAPI_BYTEORDER_LITTLE_ENDIAN },
+	{ _T("parse Numbers to Binary as\\Half Floats (little-endian)"),        HWAPI_DATATYPE_HALFFLOAT, HWAPI_SIGN_SIGNED,   HWAPI_BYTEORDER_LITTLE_ENDIAN },
+	{ _T("parse Numbers to Binary as\\Floats (little-endian)"),             HWAPI_DATATYPE_FLOAT,     HWAPI_SIGN_SIGNED,   HWAPI_BYTEORDER_LITTLE_ENDIAN },
+	{ _T("parse Numbers to Binary as\\Doubles (little-endian)"),            HWAPI_DATATYPE_DOUBLE,    HWAPI_SIGN_SIGNED,   HWAPI_BYTEORDER_LITTLE_ENDIAN },
+	{ _T("parse Numbers to Binary as\\WORDs (signed, big-endian)"),         HWAPI_DATATYPE_WORD,      HWAPI_SIGN_SIGNED,   HWAPI_BYTEORDER_BIG_ENDIAN },
+	{ _T("parse Numbers to Binary as\\WORDs (unsigned, big-endian)"),       HWAPI_DATATYPE_WORD,      HWAPI_SIGN_UNSIGNED, HWAPI_BYTEORDER_BIG_ENDIAN },
+	{ _T("parse Numbers to Binary as\\DWORDs (signed, big-endian)"),        HWAPI_DATATYPE_DWORD,     HWAPI_SIGN_SIGNED,   HWAPI_BYTEORDER_BIG_ENDIAN },
+	{ _T("parse Numbers to Binary as\\DWORDs (unsigned, big-endian)"),      HWAPI_DATATYPE_DWORD,     HWAPI_SIGN_UNSIGNED, HWAPI_BYTEORDER_BIG_ENDIAN },
+	{ _T("parse Numbers to Binary as\\QWORDs (signed, big-endian)"),        HWAPI_DATATYPE_QWORD,     HWAPI_SIGN_SIGNED,   HWAPI_BYTEORDER_BIG_ENDIAN },
+	{ _T("parse Numbers to Binary as\\QWORDs (unsigned, big-endian)"),      HWAPI_DATATYPE_QWORD,     HWAPI_SIGN_UNSIGNED, HWAPI_BYTEORDER_BIG_ENDIAN },
+	{ _T("parse Numbers to Binary as\\Half Floats (big-endian)"),           HWAPI_DATATYPE_HALFFLOAT, HWAPI_SIGN_SIGNED,   HWAPI_BYTEORDER_BIG_ENDIAN },
+	{ _T("parse Numbers to Binary as\\Floats (big-endian)"),                HWAPI_DATATYPE_FLOAT,     HWAPI_SIGN_SIGNED,   HWAPI_BYTEORDER_BIG_ENDIAN },
+	{ _T("parse Numbers to Binary as\\Doubles (big-endian)"),               HWAPI_DATATYPE_DOUBLE,    HWAPI_SIGN_SIGNED,   HWAPI_BYTEORDER_BIG_ENDIAN },
+};
+
+// Commands that decode the clipboard with a kernel specialised for one
+// text convention (see the policies in hex.h and base64.h, and bitstr.h)
+typedef struct _POLICY_COMMAND
+{
+	LPCTSTR       lpszCommand;
+	DECODE_MODE   eMode;
+	DECODE_KERNEL pfnKernel;
+} POLICY_COMMAND;
+
+static const POLICY_COMMAND g_PolicyCommands[] =
+{
+	{ _T("parse to Binary by\\Hex (digits only)"),                       DECODE_MODE_HEX,    hex_decode_t<hex_policy_strict> },
+	{ _T("parse to Binary by\\Hex (upper-case digits only)"),            DECODE_MODE_HEX,    hex_decode_t<hex_policy_strict_upper> },
+	{ _T("parse to Binary by\\Hex (colon, dash or comma separated)"),    DECODE_MODE_HEX,    hex_decode_t<hex_policy_separated> },
+	{ _T("parse to Binary by\\Hex (skip non-hex characters)"),           DECODE_MODE_HEX,    hex_decode_t<hex_policy_filter> },
+	{ _T("parse to Binary by\\Base64 (single line, padded)"),            DECODE_MODE_BASE64, base64_decode_t<base64_policy_strict> },
+	{ _T("parse to Binary by\\Base64 (wrapped lines)"),                  DECODE_MODE_BASE64, base64_decode_t<base64_policy_lines> },
+	{ _T("parse to Binary by\\Base64 (URL-safe)"),                       DECODE_MODE_BASE64, base64_decode_t<base64_policy_url> },
+	{ _T("parse to Binary by\\Base64 (skip invalid characters)"),        DECODE_MODE_BASE64, base64_decode_t<base64_policy_filter> },
+	{ _T("parse to Binary by\\Bits (01001000, first bit most significant)"),  DECODE_MODE_BITS, bitstr_decode_msb },
+	{ _T("parse to Binary by\\Bits (00010010, first bit least significant)"), DECODE_MODE_BITS, bitstr_decode_lsb },
+};
+
+// Commands that turn the selected bytes into text where they sit
+typedef struct _ENCODE_COMMAND
+{
+	LPCTSTR       lpszCommand;
+	ENCODE_FORMAT format;
+} ENCODE_COMMAND;
+
+static const ENCODE_COMMAND g_EncodeCommands[] =
+{
+	{ _T("encode Selection in place\\Hex"),                           { DECODE_MODE_HEX,    0,  0 } },
+	{ _T("encode Selection in place\\Hex (spaced, 16 bytes per line)"), { DECODE_MODE_HEX,    47, ' ' } },
+	{ _T("encode Selection in place\\Base64"),                        { DECODE_MODE_BASE64, 0,  0 } },
+	{ _T("encode Selection in place\\Base64 (76 columns)"),           { DECODE_MODE_BASE64, 76, 0 } },
+};
+
+// Commands that copy the selection to the clipboard as hexdump text
+typedef struct _HEXDUMP_COMMAND
+{
+	LPCTSTR lpszCommand;
+	int     nStyle;
+} HEXDUMP_COMMAND;
+
+static const HEXDUMP_COMMAND g_HexdumpCommands[] =
+{
+	{ _T("copy Selection as\\Hex dump (xxd)"),        HEXDUMP_XXD },
+	{ _T("copy Selection as\\Hex dump (hexdump -C)"), HEXDUMP_CANONICAL },
+};
+
+#define COUNTOF(a) (sizeof(a) / sizeof((a)[0]))
 
 // Forward declarations (helper functions that perform tasks)
-BOOL doParseHexString(HWSESSION hSession, HWDOCUMENT hDoc);
+BOOL doParseHexString(HWSESSION hSession, HWDOCUMENT hDoc,
+	unsigned int uWordSize, HWAPI_BYTEORDER eByteOrder);
 BOOL doParseBase64String(HWSESSION hSession, HWDOCUMENT hDoc);
+BOOL doParseNumberList(HWSESSION hSession, HWDOCUMENT hDoc,
+	const NUMBER_COMMAND* pCommand);
+BOOL doParseWithPolicy(HWSESSION hSession, HWDOCUMENT hDoc,
+	const POLICY_COMMAND* pCommand);
+BOOL doFindEncodedData(HWSESSION hSession, HWDOCUMENT hDoc, BOOL bDecode);
+BOOL doDecodeSelection(HWSESSION hSession, HWDOCUMENT hDoc, DECODE_MODE eMode);
+BOOL doEncodeSelection(HWSESSION hSession, HWDOCUMENT hDoc, const ENCODE_FORMAT* pFormat);
+BOOL doAutoDecodeFile(HWSESSION hSession, HWDOCUMENT hDoc, DECODE_MODE eMode);
+BOOL doCopyHexdump(HWSESSION hSession, HWDOCUMENT hDoc, const HEXDUMP_COMMAND* pCommand);
+BOOL doPasteDecoded(HWSESSION hSession, HWDOCUMENT hDoc);
+BOOL doPasteChain(HWSESSION hSession, HWDOCUMENT hDoc, LPCTSTR lpszName);
+BOOL doBuildFileIndex(HWSESSION hSession, HWDOCUMENT hDoc, DECODE_MODE eMode);
+BOOL doExtractIndexedRange(HWSESSION hSession, HWDOCUMENT hDoc);
+BOOL doApplyPatch(HWSESSION hSession, HWDOCUMENT hDoc);
+BOOL doCompareClipboard(HWSESSION hSession, HWDOCUMENT hDoc, DECODE_MODE eMode);
+BOOL doFindDecodedPattern(HWSESSION hSession, HWDOCUMENT hDoc, DECODE_MODE eMode);
 
 // DllMain
 BOOL APIENTRY DllMain(HANDLE hModule,
 	DWORD  ul_reason_for_call,
 	LPVOID lpReserved)
 {
+	if (ul_reason_for_call == DLL_PROCESS_ATTACH)
+	{
+		// Settings are read from an .ini beside the DLL
+		ConfigInit((HMODULE)hModule);
+		bufpool_set_large_pages(ConfigGetInt(POOL_SECTION, _T("LargePages"), 0) != 0);
+	}
+	else if (ul_reason_for_call == DLL_PROCESS_DETACH)
+	{
+		// Hand cached decodes and pooled scratch buffers back to the OS,
+		// and stop the pool's idle timer before its code goes away
+		ClipCacheClear();
+		bufpool_close();
+	}
+	return TRUE;
+}
+
+// Appends one command to the ;-separated list built by HWPLUGIN_Identify
+static void AppendCommand(LPTSTR lpstrPluginCommand,
+	size_t nMaxPluginCommand,
+	LPCTSTR lpszCommand)
+{
+	size_t nLen = _tcslen(lpstrPluginCommand);
+	if (nLen + 1 >= nMaxPluginCommand)
+		return;
+
+	_sntprintf(lpstrPluginCommand + nLen, nMaxPluginCommand - nLen,
+		nLen ? _T(";%s") : _T("%s"), lpszCommand);
+	lpstrPluginCommand[nMaxPluginCommand - 1] = 0;
+}
+
+static const HEX_WORD_COMMAND* FindHexWordCommand(LPCTSTR lpstrPluginCommand)
+{
+	for (size_t i = 0; i < COUNTOF(g_HexWordCommands); i++)
+	{
+		if (_tcsicmp(lpstrPluginCommand, g_HexWordCommands[i].lpszCommand) == 0)
+			return &g_HexWordCommands[i];
+	}
+	return NULL;
+}
+
+static const NUMBER_COMMAND* FindNumberCommand(LPCTSTR lpstrPluginCommand)
+{
+	for (size_t i = 0; i < COUNTOF(g_NumberCommands); i++)
+	{
+		if (_tcsicmp(lpstrPluginCommand, g_NumberCommands[i].lpszCommand) == 0)
+			return &g_NumberCommands[i];
+	}
+	return NULL;
+}
+
+static const POLICY_COMMAND* FindPolicyCommand(LPCTSTR lpstrPluginCommand)
+{
+	for (size_t i = 0; i < COUNTOF(g_PolicyCommands); i++)
+	{
+		if (_tcsicmp(lpstrPluginCommand, g_PolicyCommands[i].lpszCommand) == 0)
+			return &g_PolicyCommands[i];
+	}
+	return NULL;
+}
+
+static const ENCODE_COMMAND* FindEncodeCommand(LPCTSTR lpstrPluginCommand)
+{
+	for (size_t i = 0; i < COUNTOF(g_EncodeCommands); i++)
+	{
+		if (_tcsicmp(lpstrPluginCommand, g_EncodeCommands[i].lpszCommand) == 0)
+			return &g_EncodeCommands[i];
+	}
+	return NULL;
+}
+
+static const HEXDUMP_COMMAND* FindHexdumpCommand(LPCTSTR lpstrPluginCommand)
+{
+	for (size_t i = 0; i < COUNTOF(g_HexdumpCommands); i++)
+	{
+		if (_tcsicmp(lpstrPluginCommand, g_HexdumpCommands[i].lpszCommand) == 0)
+			return &g_HexdumpCommands[i];
+	}
+	return NULL;
+}
+
+// Name of the chain a "paste Transformed" command runs, or NULL
+static LPCTSTR FindChainName(LPCTSTR lpstrPluginCommand)
+{
+	size_t nPrefix = _tcslen(PASTE_CHAIN_PREFIX);
+	if (_tcsnicmp(lpstrPluginCommand, PASTE_CHAIN_PREFIX, nPrefix) != 0 ||
+		!lpstrPluginCommand[nPrefix])
+		return NULL;
+	return lpstrPluginCommand + nPrefix;
+}
+
+// Maps a Hex Workshop data type onto the element format of numlist_parse
+static BOOL GetNumberFormat(const NUMBER_COMMAND* pCommand, numlist_format* pFormat)
+{
+	pFormat->is_float = 0;
+	switch (pCommand->eType)
+	{
+	case HWAPI_DATATYPE_BYTE:      pFormat->size = 1; break;
+	case HWAPI_DATATYPE_WORD:      pFormat->size = 2; break;
+	case HWAPI_DATATYPE_DWORD:     pFormat->size = 4; break;
+	case HWAPI_DATATYPE_QWORD:     pFormat->size = 8; break;
+	case HWAPI_DATATYPE_HALFFLOAT: pFormat->size = 2; pFormat->is_float = 1; break;
+	case HWAPI_DATATYPE_FLOAT:     pFormat->size = 4; pFormat->is_float = 1; break;
+	case HWAPI_DATATYPE_DOUBLE:    pFormat->size = 8; pFormat->is_float = 1; break;
+	default:
+		return FALSE;
+	}
+	pFormat->is_signed = (pCommand->eSign == HWAPI_SIGN_SIGNED);
+	pFormat->bigendian = (pCommand->eByteOrder == HWAPI_BYTEORDER_BIG_ENDIAN);
 	return TRUE;
 }
 
@@ -48,8 +328,35 @@ HWAPIEP BOOL HWPLUGIN_Identify(LPTSTR lpstrPluginCommand,
 	size_t nMaxPluginCommand)
 {
 	_sntprintf(lpstrPluginCommand, nMaxPluginCommand,
-		_T("%s;%s"),
-		PARSE_HEX_STRING, PARSE_BASE64_STRING);
+		_T("%s;%s;%s;%s;%s;%s;%s;%s;%s;%s;%s;%s;%s;%s;%s;%s;%s"),
+		PASTE_DECODED, PARSE_HEX_STRING, PARSE_BASE64_STRING,
+		FIND_ENCODED_BOOKMARK, FIND_ENCODED_DECODE,
+		DECODE_SELECTION_HEX, DECODE_SELECTION_BASE64,
+		AUTODECODE_HEX, AUTODECODE_BASE64,
+		INDEX_BUILD_HEX, INDEX_BUILD_BASE64, INDEX_EXTRACT,
+		APPLY_PATCH, COMPARE_HEX, COMPARE_BASE64, FIND_PATTERN_HEX, FIND_PATTERN_BASE64);
+
+	for (size_t i = 0; i < COUNTOF(g_HexWordCommands); i++)
+		AppendCommand(lpstrPluginCommand, nMaxPluginCommand, g_HexWordCommands[i].lpszCommand);
+	for (size_t i = 0; i < COUNTOF(g_PolicyCommands); i++)
+		AppendCommand(lpstrPluginCommand, nMaxPluginCommand, g_PolicyCommands[i].lpszCommand);
+	for (size_t i = 0; i < COUNTOF(g_NumberCommands); i++)
+		AppendCommand(lpstrPluginCommand, nMaxPluginCommand, g_NumberCommands[i].lpszCommand);
+	for (size_t i = 0; i < COUNTOF(g_EncodeCommands); i++)
+		AppendCommand(lpstrPluginCommand, nMaxPluginCommand, g_EncodeCommands[i].lpszCommand);
+	for (size_t i = 0; i < COUNTOF(g_HexdumpCommands); i++)
+		AppendCommand(lpstrPluginCommand, nMaxPluginCommand, g_HexdumpCommands[i].lpszCommand);
+
+	// One command per chain configured in the .ini file
+	TCHAR szNames[CHAIN_MAX_SPEC];
+	TCHAR szCommand[MAX_PATH];
+	ConfigGetKeys(CHAIN_SECTION, szNames, COUNTOF(szNames));
+	for (LPCTSTR lpszName = szNames; *lpszName; lpszName += _tcslen(lpszName) + 1)
+	{
+		_sntprintf(szCommand, COUNTOF(szCommand), _T("%s%s"), PASTE_CHAIN_PREFIX, lpszName);
+		szCommand[COUNTOF(szCommand) - 1] = 0;
+		AppendCommand(lpstrPluginCommand, nMaxPluginCommand, szCommand);
+	}
 
 	return TRUE;
 }
@@ -60,7 +367,11 @@ HWAPIEP DWORD HWPLUGIN_RequestCapabilities(LPCTSTR lpstrPluginCommand)
 {
 	// Return unique capabilities for each Plug-in command
 
-	if (_tcsicmp(lpstrPluginCommand, PARSE_HEX_STRING) == 0)
+	if (_tcsicmp(lpstrPluginCommand, PASTE_DECODED) == 0)
+	{
+		return HWPLUGIN_CAP_FILE_REQUIRE;
+	}
+	else if (_tcsicmp(lpstrPluginCommand, PARSE_HEX_STRING) == 0)
 	{
 		// Copy to new file require a file, but selection is optional
 		return HWPLUGIN_CAP_FILE_REQUIRE;
@@ -69,26 +380,228 @@ HWAPIEP DWORD HWPLUGIN_RequestCapabilities(LPCTSTR lpstrPluginCommand)
 	{
 		return HWPLUGIN_CAP_FILE_REQUIRE;
 	}
+	else if (FindHexWordCommand(lpstrPluginCommand))
+	{
+		return HWPLUGIN_CAP_FILE_REQUIRE;
+	}
+	else if (FindPolicyCommand(lpstrPluginCommand))
+	{
+		return HWPLUGIN_CAP_FILE_REQUIRE;
+	}
+	else if (FindNumberCommand(lpstrPluginCommand))
+	{
+		return HWPLUGIN_CAP_FILE_REQUIRE;
+	}
+	else if (FindChainName(lpstrPluginCommand))
+	{
+		return HWPLUGIN_CAP_FILE_REQUIRE;
+	}
+	else if (_tcsicmp(lpstrPluginCommand, FIND_ENCODED_BOOKMARK) == 0 ||
+		_tcsicmp(lpstrPluginCommand, FIND_ENCODED_DECODE) == 0)
+	{
+		// Scans the whole document; the selection is ignored
+		return HWPLUGIN_CAP_FILE_REQUIRE;
+	}
+	else if (_tcsicmp(lpstrPluginCommand, DECODE_SELECTION_HEX) == 0 ||
+		_tcsicmp(lpstrPluginCommand, DECODE_SELECTION_BASE64) == 0)
+	{
+		return HWPLUGIN_CAP_FILE_REQUIRE | HWPLUGIN_CAP_SELECTION_REQUIRE;
+	}
+	else if (FindEncodeCommand(lpstrPluginCommand))
+	{
+		return HWPLUGIN_CAP_FILE_REQUIRE | HWPLUGIN_CAP_SELECTION_REQUIRE;
+	}
+	else if (FindHexdumpCommand(lpstrPluginCommand))
+	{
+		// Only reads the document, so read-only files are fine
+		return HWPLUGIN_CAP_FILE_REQUIRE | HWPLUGIN_CAP_SELECTION_REQUIRE;
+	}
+	else if (_tcsicmp(lpstrPluginCommand, AUTODECODE_HEX) == 0 ||
+		_tcsicmp(lpstrPluginCommand, AUTODECODE_BASE64) == 0)
+	{
+		// Run when a file with one of the configured extensions is opened
+		return HWPLUGIN_CAP_FILE_REQUIRE | HWPLUGIN_CAP_FILE_AUTOEXEC;
+	}
+	else if (_tcsicmp(lpstrPluginCommand, INDEX_BUILD_HEX) == 0 ||
+		_tcsicmp(lpstrPluginCommand, INDEX_BUILD_BASE64) == 0 ||
+		_tcsicmp(lpstrPluginCommand, INDEX_EXTRACT) == 0)
+	{
+		// Reads the document's file from disk; the document is left alone
+		return HWPLUGIN_CAP_FILE_REQUIRE;
+	}
+	else if (_tcsicmp(lpstrPluginCommand, APPLY_PATCH) == 0)
+	{
+		// Offsets come from the script; the selection is ignored
+		return HWPLUGIN_CAP_FILE_REQUIRE;
+	}
+	else if (_tcsicmp(lpstrPluginCommand, COMPARE_HEX) == 0 ||
+		_tcsicmp(lpstrPluginCommand, COMPARE_BASE64) == 0)
+	{
+		// Only adds bookmarks, so read-only files are fine
+		return HWPLUGIN_CAP_FILE_REQUIRE;
+	}
+	else if (_tcsicmp(lpstrPluginCommand, FIND_PATTERN_HEX) == 0 ||
+		_tcsicmp(lpstrPluginCommand, FIND_PATTERN_BASE64) == 0)
+	{
+		// Searches the whole document and only bookmarks and selects
+		return HWPLUGIN_CAP_FILE_REQUIRE;
+	}
 
 	return 0;
 }
 
+// Plugin Entrypoint: File extensions that trigger an autoexec command
+HWAPIEP BOOL HWPLUGIN_RequestFileAutoexecExtensions(LPCTSTR lpstrPluginCommand,
+	LPTSTR lpstrExtensions,
+	size_t nExtensions)
+{
+	if (nExtensions == 0)
+		return FALSE;
+
+	if (_tcsicmp(lpstrPluginCommand, AUTODECODE_HEX) == 0)
+	{
+		ConfigGetString(AUTODECODE_SECTION, _T("HexExtensions"),
+			AUTODECODE_HEX_EXTENSIONS, lpstrExtensions, (DWORD)nExtensions);
+		return TRUE;
+	}
+	else if (_tcsicmp(lpstrPluginCommand, AUTODECODE_BASE64) == 0)
+	{
+		ConfigGetString(AUTODECODE_SECTION, _T("Base64Extensions"),
+			AUTODECODE_BASE64_EXTENSIONS, lpstrExtensions, (DWORD)nExtensions);
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
 // Plugin Entrypoint: Execute a plugin command
 HWAPIEP BOOL HWPLUGIN_Execute(LPCTSTR        lpstrPluginCommand,
 	HWSESSION    hSession,
 	HWDOCUMENT    hDocument)
 {
+	const HEX_WORD_COMMAND* pHexWords = NULL;
+	const NUMBER_COMMAND* pNumbers = NULL;
+	const POLICY_COMMAND* pPolicy = NULL;
+	const ENCODE_COMMAND* pEncode = NULL;
+	const HEXDUMP_COMMAND* pHexdump = NULL;
+	LPCTSTR lpszChain = NULL;
+
 	// Delegate plug-in command to helper functioms
-	if (_tcsicmp(lpstrPluginCommand, PARSE_HEX_STRING) == 0)
+	if (_tcsicmp(lpstrPluginCommand, PASTE_DECODED) == 0)
+	{
+		// parse with the decoder the clipboard text looks like it needs
+		return doPasteDecoded(hSession, hDocument);
+	}
+	else if (_tcsicmp(lpstrPluginCommand, PARSE_HEX_STRING) == 0)
 	{
 		// parse hex string
-		return doParseHexString(hSession, hDocument);
+		return doParseHexString(hSession, hDocument, 1, HWAPI_BYTEORDER_BIG_ENDIAN);
+	}
+	else if ((pHexWords = FindHexWordCommand(lpstrPluginCommand)) != NULL)
+	{
+		// parse hex string as words
+		return doParseHexString(hSession, hDocument, pHexWords->uWordSize, pHexWords->eByteOrder);
 	}
 	else if (_tcsicmp(lpstrPluginCommand, PARSE_BASE64_STRING) == 0)
 	{
 		// parse hex string
 		return doParseBase64String(hSession, hDocument);
 	}
+	else if ((pPolicy = FindPolicyCommand(lpstrPluginCommand)) != NULL)
+	{
+		// parse with the kernel for one text convention
+		return doParseWithPolicy(hSession, hDocument, pPolicy);
+	}
+	else if ((pNumbers = FindNumberCommand(lpstrPluginCommand)) != NULL)
+	{
+		// parse a list of numbers
+		return doParseNumberList(hSession, hDocument, pNumbers);
+	}
+	else if ((lpszChain = FindChainName(lpstrPluginCommand)) != NULL)
+	{
+		// decode, then transform the bytes as the named chain says
+		return doPasteChain(hSession, hDocument, lpszChain);
+	}
+	else if (_tcsicmp(lpstrPluginCommand, FIND_ENCODED_BOOKMARK) == 0)
+	{
+		// bookmark embedded hex / base64 text
+		return doFindEncodedData(hSession, hDocument, FALSE);
+	}
+	else if (_tcsicmp(lpstrPluginCommand, FIND_ENCODED_DECODE) == 0)
+	{
+		// bookmark and decode embedded hex / base64 text
+		return doFindEncodedData(hSession, hDocument, TRUE);
+	}
+	else if (_tcsicmp(lpstrPluginCommand, DECODE_SELECTION_HEX) == 0)
+	{
+		// replace the selected hex text with its bytes
+		return doDecodeSelection(hSession, hDocument, DECODE_MODE_HEX);
+	}
+	else if (_tcsicmp(lpstrPluginCommand, DECODE_SELECTION_BASE64) == 0)
+	{
+		// replace the selected base64 text with its bytes
+		return doDecodeSelection(hSession, hDocument, DECODE_MODE_BASE64);
+	}
+	else if ((pEncode = FindEncodeCommand(lpstrPluginCommand)) != NULL)
+	{
+		// replace the selected bytes with their text
+		return doEncodeSelection(hSession, hDocument, &pEncode->format);
+	}
+	else if ((pHexdump = FindHexdumpCommand(lpstrPluginCommand)) != NULL)
+	{
+		// put the selection on the clipboard as hexdump text
+		return doCopyHexdump(hSession, hDocument, pHexdump);
+	}
+	else if (_tcsicmp(lpstrPluginCommand, AUTODECODE_HEX) == 0)
+	{
+		// open the bytes of a hex text file
+		return doAutoDecodeFile(hSession, hDocument, DECODE_MODE_HEX);
+	}
+	else if (_tcsicmp(lpstrPluginCommand, AUTODECODE_BASE64) == 0)
+	{
+		// open the bytes of a base64 / PEM text file
+		return doAutoDecodeFile(hSession, hDocument, DECODE_MODE_BASE64);
+	}
+	else if (_tcsicmp(lpstrPluginCommand, INDEX_BUILD_HEX) == 0)
+	{
+		// checkpoint a hex text file for random access
+		return doBuildFileIndex(hSession, hDocument, DECODE_MODE_HEX);
+	}
+	else if (_tcsicmp(lpstrPluginCommand, INDEX_BUILD_BASE64) == 0)
+	{
+		// checkpoint a base64 text file for random access
+		return doBuildFileIndex(hSession, hDocument, DECODE_MODE_BASE64);
+	}
+	else if (_tcsicmp(lpstrPluginCommand, INDEX_EXTRACT) == 0)
+	{
+		// decode a window of an indexed text file
+		return doExtractIndexedRange(hSession, hDocument);
+	}
+	else if (_tcsicmp(lpstrPluginCommand, APPLY_PATCH) == 0)
+	{
+		// write the "offset: bytes" edits on the clipboard
+		return doApplyPatch(hSession, hDocument);
+	}
+	else if (_tcsicmp(lpstrPluginCommand, COMPARE_HEX) == 0)
+	{
+		// bookmark where the document differs from the clipboard's hex
+		return doCompareClipboard(hSession, hDocument, DECODE_MODE_HEX);
+	}
+	else if (_tcsicmp(lpstrPluginCommand, COMPARE_BASE64) == 0)
+	{
+		// bookmark where the document differs from the clipboard's base64
+		return doCompareClipboard(hSession, hDocument, DECODE_MODE_BASE64);
+	}
+	else if (_tcsicmp(lpstrPluginCommand, FIND_PATTERN_HEX) == 0)
+	{
+		// bookmark every match of the clipboard's hex, wildcards allowed
+		return doFindDecodedPattern(hSession, hDocument, DECODE_MODE_HEX);
+	}
+	else if (_tcsicmp(lpstrPluginCommand, FIND_PATTERN_BASE64) == 0)
+	{
+		// bookmark every match of the clipboard's base64
+		return doFindDecodedPattern(hSession, hDocument, DECODE_MODE_BASE64);
+	}
 	else
 	{
 		// Unknown Command
@@ -96,7 +609,226 @@ HWAPIEP BOOL HWPLUGIN_Execute(LPCTSTR        lpstrPluginCommand,
 	}
 }
 
-BOOL doParseHexString(HWSESSION hSession, HWDOCUMENT hDoc)
+// Decodes the clipboard text as pJob is set up (pIn / nIn are filled in
+// here) on a worker, unless the same text was already decoded the same
+// way.  pResult receives the outcome; *ppFree is set to a buffer the
+// caller frees once done with pResult, or NULL if the cache keeps it.
+// Returns FALSE if there was no text, or on failure or user abort.
+static BOOL DecodeClipboard(HWSESSION hSession, LPCTSTR lpszStatus,
+	DECODE_JOB* pJob, CLIPCACHE_RESULT* pResult, void** ppFree)
+{
+	BOOL bReturn = FALSE;
+	HWND hMain = hwGetWindowHandle(hSession);
+	HANDLE hClip = NULL;
+	LPSTR pData = NULL;
+	BOOL bOpen = FALSE;
+	void* pOut = NULL;
+	CLIPCACHE_KEY key;
+
+	*ppFree = NULL;
+
+	// Same clipboard contents, same settings: not even the text is read
+	ClipCacheKeyFromJob(&key, pJob);
+	if (ClipCacheLookup(&key, pResult))
+		return TRUE;
+
+	__try
+	{
+		if (!IsClipboardFormatAvailable(CF_TEXT))
+			__leave;
+		if (!OpenClipboard(hMain))
+		{
+			MessageBox(hMain, _T("打开剪切板失败!"), _T("错误"), MB_OK);
+			__leave;
+		}
+		bOpen = TRUE;
+
+		hClip = GetClipboardData(CF_TEXT);
+		if (!hClip)
+			__leave;
+		pData = (LPSTR)GlobalLock(hClip);
+		if (!pData)
+			__leave;
+
+		size_t nText = strlen(pData);
+		if (nText == 0)
+			__leave;
+
+		// Without sequence numbers the text is recognised by its hash
+		if (key.dwSequence == 0)
+		{
+			key.qwTextHash = ClipCacheHash(pData, nText);
+			if (ClipCacheLookup(&key, pResult))
+			{
+				bReturn = TRUE;
+				__leave;
+			}
+		}
+
+		// Decode on a worker so the status dialog stays responsive
+		pJob->pIn = pData;
+		pJob->nIn = nText;
+		WorkerProgressInit(&pJob->progress, nText);
+
+		size_t nOut = DecodeJobOutSize(pJob);
+		pOut = bufpool_alloc(nOut);
+		if (!pOut)
+			__leave;
+		pJob->pOut = (unsigned char*)pOut;
+		if (!RunWorker(hSession, lpszStatus, DecodeJobProc, pJob, &pJob->progress) ||
+			pJob->eStatus == DECODE_CANCELLED)
+			__leave;
+
+		pResult->pOut = pJob->pOut;
+		pResult->nOut = pJob->nOut;
+		pResult->nIn = nText;
+		pResult->nInUsed = pJob->nInUsed;
+		pResult->eStatus = pJob->eStatus;
+		if (!ClipCacheStore(&key, pResult, pOut, nOut))
+			*ppFree = pOut;
+		pOut = NULL;
+		bReturn = TRUE;
+	}
+	__finally
+	{
+		if (pOut)
+			bufpool_free(pOut);
+		if (pData)
+			GlobalUnlock(hClip);
+		if (bOpen)
+			CloseClipboard();
+	}
+
+	return bReturn;
+}
+
+static DWORD ClampToDword(QWORD qwValue)
+{
+	return qwValue > MAXDWORD ? MAXDWORD : (DWORD)qwValue;
+}
+
+// Decodes every PEM block / base64 data: URI in the clipboard text into
+// pJob->pOut; the caller frees pJob->pOut and pJob->pBlocks
+static BOOL DecodeClipboardEnvelopes(HWSESSION hSession, ENVELOPE_JOB* pJob)
+{
+	BOOL bReturn = FALSE;
+	HWND hMain = hwGetWindowHandle(hSession);
+	HANDLE hClip = NULL;
+	LPSTR pData = NULL;
+	BOOL bOpen = FALSE;
+
+	ZeroMemory(pJob, sizeof(*pJob));
+
+	__try
+	{
+		if (!IsClipboardFormatAvailable(CF_TEXT))
+			__leave;
+		if (!OpenClipboard(hMain))
+		{
+			MessageBox(hMain, _T("打开剪切板失败!"), _T("错误"), MB_OK);
+			__leave;
+		}
+		bOpen = TRUE;
+
+		hClip = GetClipboardData(CF_TEXT);
+		if (!hClip)
+			__leave;
+		pData = (LPSTR)GlobalLock(hClip);
+		if (!pData)
+			__leave;
+
+		size_t nText = strlen(pData);
+		if (nText == 0)
+			__leave;
+
+		// All blocks share one output buffer sized for the whole text
+		pJob->pIn = pData;
+		pJob->nIn = nText;
+		pJob->pOut = (unsigned char*)bufpool_alloc(BASE64_DECODE_OUT_SIZE64(nText));
+		pJob->pBlocks = (ENVELOPE_BLOCK_INFO*)bufpool_alloc(ENVELOPE_MAX_BLOCKS * sizeof(ENVELOPE_BLOCK_INFO));
+		if (!pJob->pOut || !pJob->pBlocks)
+			__leave;
+		WorkerProgressInit(&pJob->progress, nText);
+
+		if (!RunWorker(hSession, _T("Parsing base64 envelopes"), EnvelopeJobProc, pJob, &pJob->progress) ||
+			pJob->eStatus == DECODE_CANCELLED)
+			__leave;
+		bReturn = TRUE;
+	}
+	__finally
+	{
+		if (pData)
+			GlobalUnlock(hClip);
+		if (bOpen)
+			CloseClipboard();
+	}
+
+	return bReturn;
+}
+
+// Inserts the blocks of an envelope job at qwPosition, one bookmark each
+static void InsertEnvelopes(HWSESSION hSession, HWDOCUMENT hDoc, QWORD qwPosition,
+	const ENVELOPE_JOB* pJob)
+{
+	size_t nIncomplete = 0;
+
+	hwInsertAt(hDoc, qwPosition, (void*)pJob->pOut, pJob->nOut);
+
+	for (size_t i = 0; i < pJob->nBlocks; i++)
+	{
+		const ENVELOPE_BLOCK_INFO* pBlock = &pJob->pBlocks[i];
+
+		HWAPI_BOOKMARK bookmark;
+		ZeroMemory(&bookmark, sizeof(bookmark));
+		bookmark.cbSize = sizeof(bookmark);
+		bookmark.qwAddress = qwPosition + pBlock->nOutStart;
+		bookmark.dwArrayCount = ClampToDword(pBlock->nOut);
+		bookmark.eType = HWAPI_DATATYPE_BLOB;
+		bookmark.eSign = HWAPI_SIGN_UNSIGNED;
+		bookmark.eByteOrder = HWAPI_BYTEORDER_LITTLE_ENDIAN;
+		_sntprintf(bookmark.cDescription, COUNTOF(bookmark.cDescription),
+			pBlock->nKind == ENVELOPE_PEM ? _T("%hs%s") : _T("data:%hs%s"),
+			pBlock->szLabel, pBlock->bComplete ? _T("") : _T(" (no END line)"));
+		bookmark.cDescription[COUNTOF(bookmark.cDescription) - 1] = 0;
+		hwBookmarksAdd(hDoc, &bookmark);
+
+		if (!pBlock->bComplete)
+			nIncomplete++;
+	}
+
+	hwOutputLog(hSession, HWLOG_INFO,
+		_T("Decoded %Iu envelopes, %Iu bytes"), pJob->nBlocks, pJob->nOut);
+	if (nIncomplete)
+		hwOutputLog(hSession, HWLOG_WARN,
+			_T("%Iu PEM blocks have no matching END line"), nIncomplete);
+	if (pJob->eStatus == DECODE_TRUNCATED)
+		hwOutputLog(hSession, HWLOG_WARN,
+			_T("Only the first %u envelopes were decoded"), ENVELOPE_MAX_BLOCKS);
+}
+
+// Decodes the envelopes in the clipboard text and inserts them at
+// qwPosition; call inside an undo group
+static BOOL PasteEnvelopes(HWSESSION hSession, HWDOCUMENT hDoc, QWORD qwPosition)
+{
+	BOOL bReturn = FALSE;
+	ENVELOPE_JOB envelopes;
+
+	if (DecodeClipboardEnvelopes(hSession, &envelopes) &&
+		envelopes.eStatus != DECODE_INVALID)
+	{
+		InsertEnvelopes(hSession, hDoc, qwPosition, &envelopes);
+		bReturn = TRUE;
+	}
+	if (envelopes.pOut)
+		bufpool_free(envelopes.pOut);
+	if (envelopes.pBlocks)
+		bufpool_free(envelopes.pBlocks);
+
+	return bReturn;
+}
+
+BOOL doParseHexString(HWSESSION hSession, HWDOCUMENT hDoc,
+	unsigned int uWordSize, HWAPI_BYTEORDER eByteOrder)
 {
 	BOOL bReturn = FALSE;
 	QWORD qwStartPosition;
@@ -119,78 +851,35 @@ BOOL doParseHexString(HWSESSION hSession, HWDOCUMENT hDoc)
 	if ((hwGetCaretPosition(hDoc, &qwStartPosition) == HWAPI_RESULT_SUCCESS) &&
 		(hwGetSelection(hDoc, &qwLength) == HWAPI_RESULT_SUCCESS))
 	{
-		HANDLE hClip = NULL;
-		LPSTR pData = NULL;
-		LPSTR pStr = NULL;
+		DECODE_JOB job;
+		CLIPCACHE_RESULT result;
+		void* pFree = NULL;
 
-		__try
-		{
-			// Group all changes into a single undo operation
-			hwUndoBeginGroup(hDoc);
+		// Words are byte-swapped by the kernel, not in a second pass
+		DecodeJobInit(&job, DECODE_MODE_HEX, NULL, 0);
+		job.uWordSize = uWordSize;
+		job.bBigEndian = (eByteOrder == HWAPI_BYTEORDER_BIG_ENDIAN);
 
-			if (!IsClipboardFormatAvailable(CF_TEXT))
-				__leave;
-			if (!OpenClipboard(hMain))
-			{
-				MessageBox(hMain, _T("打开剪切板失败!"), _T("错误"), MB_OK);
-				__leave;
-			}
+		// Group all changes into a single undo operation
+		hwUndoBeginGroup(hDoc);
 
-			hClip = GetClipboardData(CF_TEXT);
-			if (!hClip)
-				__leave;
-			pData = (LPSTR)GlobalLock(hClip);
+		if (DecodeClipboard(hSession, _T("Parsing hex string"), &job, &result, &pFree))
+		{
+			if (result.nOut)
+				hwInsertAt(hDoc, qwStartPosition, (void*)result.pOut, result.nOut);
+			bReturn = (result.eStatus == DECODE_OK);
 
-			size_t uDataLen = strlen(pData);
-			size_t u1 = 0, u2 = 0, l1 = uDataLen, l2 = 0;
-			if (uDataLen)
+			if (result.nInUsed != result.nIn)
 			{
-				l2 = ((uDataLen / 2) | 15) + 1;
-				pStr = new char[l2];
-				LPSTR p1 = pData, p2 = pStr;
-				char szBuff[4] = { 0 };
-
-				while ((p1 + 1) < (pData + uDataLen))
-				{
-					if (IsHexChar(*p1) && IsHexChar(*(p1 + 1)))
-					{
-						szBuff[0] = *p1;
-						szBuff[1] = *(p1 + 1);
-						szBuff[2] = 0;
-						*(p2 + u2) = (char)strtol(szBuff, 0, 16);
-						u2 += 1;
-						p1 += 2;
-					}
-					else if (IsSkipChar(*p1))
-					{
-						p1 += 1;
-					}
-					else
-					{
-						// error
-						u2 = 0;
-						break;
-					}
-				}
-
-				hwInsertAt(hDoc, qwStartPosition, pStr, u2);
-
-				if (p1 != (pData + uDataLen))
-				{
-					MessageBox(hMain, _T("解析缺失部分末尾数据!"), _T("警告"), MB_OK);
-				}
+				MessageBox(hMain, _T("解析缺失部分末尾数据!"), _T("警告"), MB_OK);
 			}
 		}
-		__finally
-		{
-			if (pStr)
-				delete[] pStr;
-			if (pData)
-				GlobalUnlock(pData);
-			CloseClipboard();
-			// Commit the undo group
-			hwUndoEndGroup(hDoc);
-		}
+
+		// Commit the undo group
+		hwUndoEndGroup(hDoc);
+
+		if (pFree)
+			bufpool_free(pFree);
 	}
 
 	return bReturn;
@@ -219,49 +908,1275 @@ BOOL doParseBase64String(HWSESSION hSession, HWDOCUMENT hDoc)
 	if ((hwGetCaretPosition(hDoc, &qwStartPosition) == HWAPI_RESULT_SUCCESS) &&
 		(hwGetSelection(hDoc, &qwLength) == HWAPI_RESULT_SUCCESS))
 	{
-		HANDLE hClip = NULL;
-		LPSTR pData = NULL;
-		LPSTR pStr = NULL;
+		DECODE_JOB job;
+		CLIPCACHE_RESULT result;
+		void* pFree = NULL;
 
-		__try
-		{
-			// Group all changes into a single undo operation
-			hwUndoBeginGroup(hDoc);
+		DecodeJobInit(&job, DECODE_MODE_BASE64, NULL, 0);
 
-			if (!IsClipboardFormatAvailable(CF_TEXT))
-				__leave;
-			if (!OpenClipboard(hMain))
-			{
-				MessageBox(hMain, _T("打开剪切板失败!"), _T("错误"), MB_OK);
-				__leave;
+		// Group all changes into a single undo operation
+		hwUndoBeginGroup(hDoc);
+
+		if (!DecodeClipboard(hSession, _T("Parsing base64 string"), &job, &result, &pFree))
+		{
+			// No text, or cancelled
+		}
+		else if ((result.eStatus == DECODE_OK || result.eStatus == DECODE_TRUNCATED) &&
+			result.nOut != 0 && result.nOut <= BASE64_DECODE_OUT_SIZE64(result.nIn))
+		{
+			hwInsertAt(hDoc, qwStartPosition, (void*)result.pOut, result.nOut);
+			bReturn = (result.eStatus == DECODE_OK);
+
+			// Text after the padding, or a quantum cut short
+			if (result.nInUsed != result.nIn)
+			{
+				MessageBox(hMain, _T("解析缺失部分末尾数据!"), _T("警告"), MB_OK);
 			}
+		}
+		else
+		{
+			// Not one plain string: look for PEM blocks and data: URIs
+			bReturn = PasteEnvelopes(hSession, hDoc, qwStartPosition);
+		}
+
+		// Commit the undo group
+		hwUndoEndGroup(hDoc);
+
+		if (pFree)
+			bufpool_free(pFree);
+	}
+
+	return bReturn;
+}
+
+static LPCTSTR DecodeStatusText(DECODE_MODE eMode)
+{
+	switch (eMode)
+	{
+	case DECODE_MODE_HEX:       return _T("Parsing hex string");
+	case DECODE_MODE_BASE64:    return _T("Parsing base64 string");
+	case DECODE_MODE_ASCII85:   return _T("Parsing Ascii85 string");
+	case DECODE_MODE_INTEL_HEX: return _T("Parsing Intel HEX records");
+	case DECODE_MODE_BITS:      return _T("Parsing bit string");
+	default:                    return _T("Parsing number list");
+	}
+}
+
+BOOL doParseWithPolicy(HWSESSION hSession, HWDOCUMENT hDoc,
+	const POLICY_COMMAND* pCommand)
+{
+	BOOL bReturn = FALSE;
+	QWORD qwStartPosition;
+	QWORD qwLength;
+	HWND hMain = hwGetWindowHandle(hSession);
+
+	// Check readonly document status
+	BOOL bReadOnly = TRUE;
+	hwGetReadOnly(hDoc, &bReadOnly);
+	if (bReadOnly)
+	{
+		MessageBox(hMain,
+			_T("Document is read-only; cannot perform operation."),
+			_T("Error"),
+			MB_ICONSTOP | MB_APPLMODAL);
+		return bReturn;
+	}
+
+	// Obtain starting position and length
+	if ((hwGetCaretPosition(hDoc, &qwStartPosition) == HWAPI_RESULT_SUCCESS) &&
+		(hwGetSelection(hDoc, &qwLength) == HWAPI_RESULT_SUCCESS))
+	{
+		DECODE_JOB job;
+		CLIPCACHE_RESULT result;
+		void* pFree = NULL;
+
+		DecodeJobInit(&job, pCommand->eMode, NULL, 0);
+		job.pfnKernel = pCommand->pfnKernel;
+
+		// Group all changes into a single undo operation
+		hwUndoBeginGroup(hDoc);
+
+		if (DecodeClipboard(hSession, DecodeStatusText(pCommand->eMode),
+			&job, &result, &pFree))
+		{
+			if (result.nOut)
+				hwInsertAt(hDoc, qwStartPosition, (void*)result.pOut, result.nOut);
+			bReturn = (result.eStatus == DECODE_OK);
+
+			if (result.nInUsed != result.nIn)
+			{
+				MessageBox(hMain, _T("解析缺失部分末尾数据!"), _T("警告"), MB_OK);
+			}
+		}
+
+		// Commit the undo group
+		hwUndoEndGroup(hDoc);
+
+		if (pFree)
+			bufpool_free(pFree);
+	}
+
+	return bReturn;
+}
+
+// Decoders picked by doPasteDecoded, by SNIFF_* format
+static const POLICY_COMMAND g_SniffedFormats[] =
+{
+	{ NULL,              DECODE_MODE_HEX,       NULL },	// SNIFF_UNKNOWN
+	{ _T("hex"),         DECODE_MODE_HEX,       hex_decode_t<hex_policy_separated> },
+	{ _T("prefixed hex"), DECODE_MODE_HEX,      hex_decode_t<hex_policy_prefixed> },
+	{ _T("hex dump"),    DECODE_MODE_HEX,       hexdump_parse },
+	{ _T("base64"),      DECODE_MODE_BASE64,    base64_decode_t<base64_policy_lines> },
+	{ _T("base64url"),   DECODE_MODE_BASE64,    base64_decode_t<base64_policy_url> },
+	{ _T("PEM / data: URI"), DECODE_MODE_BASE64, NULL },	// SNIFF_ENVELOPE
+	{ _T("Ascii85"),     DECODE_MODE_ASCII85,   ascii85_decode },
+	{ _T("Intel HEX"),   DECODE_MODE_INTEL_HEX, NULL },
+};
+
+// Looks at the start of the clipboard text; the clipboard is closed again
+// before anything is decoded
+static int SniffClipboard(HWSESSION hSession)
+{
+	int nFormat = SNIFF_UNKNOWN;
+	HWND hMain = hwGetWindowHandle(hSession);
+	HANDLE hClip = NULL;
+	LPSTR pData = NULL;
+
+	if (!IsClipboardFormatAvailable(CF_TEXT))
+		return nFormat;
+	if (!OpenClipboard(hMain))
+	{
+		MessageBox(hMain, _T("打开剪切板失败!"), _T("错误"), MB_OK);
+		return nFormat;
+	}
+
+	hClip = GetClipboardData(CF_TEXT);
+	if (hClip && (pData = (LPSTR)GlobalLock(hClip)) != NULL)
+	{
+		// Only the sample is needed, however long the text is
+		nFormat = sniff_format(pData, strnlen(pData, SNIFF_SAMPLE_SIZE));
+		GlobalUnlock(hClip);
+	}
+	CloseClipboard();
+
+	return nFormat;
+}
+
+BOOL doPasteDecoded(HWSESSION hSession, HWDOCUMENT hDoc)
+{
+	HWND hMain = hwGetWindowHandle(hSession);
+	int nFormat = SniffClipboard(hSession);
+
+	if (nFormat == SNIFF_UNKNOWN || nFormat >= (int)COUNTOF(g_SniffedFormats))
+	{
+		MessageBox(hMain, _T("无法识别剪切板中的数据格式!"), _T("错误"), MB_OK);
+		return FALSE;
+	}
+	hwOutputLog(hSession, HWLOG_INFO, _T("Clipboard text looks like %s"),
+		g_SniffedFormats[nFormat].lpszCommand);
+
+	if (nFormat == SNIFF_ENVELOPE)
+	{
+		BOOL bReturn = FALSE;
+		BOOL bReadOnly = TRUE;
+		QWORD qwStartPosition;
+
+		hwGetReadOnly(hDoc, &bReadOnly);
+		if (bReadOnly)
+		{
+			MessageBox(hMain,
+				_T("Document is read-only; cannot perform operation."),
+				_T("Error"),
+				MB_ICONSTOP | MB_APPLMODAL);
+			return FALSE;
+		}
+		if (hwGetCaretPosition(hDoc, &qwStartPosition) != HWAPI_RESULT_SUCCESS)
+			return FALSE;
+
+		hwUndoBeginGroup(hDoc);
+		bReturn = PasteEnvelopes(hSession, hDoc, qwStartPosition);
+		hwUndoEndGroup(hDoc);
+		return bReturn;
+	}
+
+	return doParseWithPolicy(hSession, hDoc, &g_SniffedFormats[nFormat]);
+}
+
+BOOL doPasteChain(HWSESSION hSession, HWDOCUMENT hDoc, LPCTSTR lpszName)
+{
+	BOOL bReturn = FALSE;
+	QWORD qwStartPosition;
+	HWND hMain = hwGetWindowHandle(hSession);
+	HANDLE hClip = NULL;
+	LPSTR pData = NULL;
+	BOOL bOpen = FALSE;
+	TCHAR szSpec[CHAIN_MAX_SPEC];
+	CHAIN chain;
+	size_t nError;
+
+	// Check readonly document status
+	BOOL bReadOnly = TRUE;
+	hwGetReadOnly(hDoc, &bReadOnly);
+	if (bReadOnly)
+	{
+		MessageBox(hMain,
+			_T("Document is read-only; cannot perform operation."),
+			_T("Error"),
+			MB_ICONSTOP | MB_APPLMODAL);
+		return bReturn;
+	}
+
+	ConfigGetString(CHAIN_SECTION, lpszName, _T(""), szSpec, COUNTOF(szSpec));
+	if (!ChainParse(szSpec, &chain, &nError))
+	{
+		TCHAR szMessage[CHAIN_MAX_SPEC + 128];
+		_sntprintf(szMessage, COUNTOF(szMessage),
+			_T("Transform chain \"%s\" cannot be read at \"%s\"."), lpszName, szSpec + nError);
+		szMessage[COUNTOF(szMessage) - 1] = 0;
+		MessageBox(hMain, szMessage, _T("Error"), MB_ICONSTOP | MB_APPLMODAL);
+		return bReturn;
+	}
+
+	if (hwGetCaretPosition(hDoc, &qwStartPosition) != HWAPI_RESULT_SUCCESS)
+		return bReturn;
+
+	__try
+	{
+		if (!IsClipboardFormatAvailable(CF_TEXT))
+			__leave;
+		if (!OpenClipboard(hMain))
+		{
+			MessageBox(hMain, _T("打开剪切板失败!"), _T("错误"), MB_OK);
+			__leave;
+		}
+		bOpen = TRUE;
+
+		hClip = GetClipboardData(CF_TEXT);
+		if (!hClip)
+			__leave;
+		pData = (LPSTR)GlobalLock(hClip);
+		if (!pData)
+			__leave;
+
+		// Group all changes into a single undo operation
+		QWORD qwOut = 0;
+		hwUndoBeginGroup(hDoc);
+		DECODE_STATUS eStatus = ChainRun(hSession, hDoc, qwStartPosition, &chain,
+			pData, strlen(pData), &qwOut);
+		hwUndoEndGroup(hDoc);
+
+		if (eStatus == DECODE_CANCELLED)
+			__leave;
+		hwOutputLog(hSession, HWLOG_INFO, _T("Chain \"%s\" inserted %I64u bytes"), lpszName, qwOut);
+		if (eStatus == DECODE_INVALID)
+			MessageBox(hMain, _T("剪切板中不是有效的编码数据!"), _T("错误"), MB_OK);
+		else if (eStatus == DECODE_TRUNCATED)
+			MessageBox(hMain, _T("解析缺失部分末尾数据!"), _T("警告"), MB_OK);
+		bReturn = (eStatus == DECODE_OK);
+	}
+	__finally
+	{
+		if (pData)
+			GlobalUnlock(hClip);
+		if (bOpen)
+			CloseClipboard();
+	}
+
+	return bReturn;
+}
 
-			hClip = GetClipboardData(CF_TEXT);
-			if (!hClip)
+BOOL doParseNumberList(HWSESSION hSession, HWDOCUMENT hDoc,
+	const NUMBER_COMMAND* pCommand)
+{
+	BOOL bReturn = FALSE;
+	QWORD qwStartPosition;
+	QWORD qwLength;
+	HWND hMain = hwGetWindowHandle(hSession);
+
+	// Check readonly document status
+	BOOL bReadOnly = TRUE;
+	hwGetReadOnly(hDoc, &bReadOnly);
+	if (bReadOnly)
+	{
+		MessageBox(hMain,
+			_T("Document is read-only; cannot perform operation."),
+			_T("Error"),
+			MB_ICONSTOP | MB_APPLMODAL);
+		return bReturn;
+	}
+
+	// Obtain starting position and length
+	if ((hwGetCaretPosition(hDoc, &qwStartPosition) == HWAPI_RESULT_SUCCESS) &&
+		(hwGetSelection(hDoc, &qwLength) == HWAPI_RESULT_SUCCESS))
+	{
+		DECODE_JOB job;
+		CLIPCACHE_RESULT result;
+		void* pFree = NULL;
+
+		DecodeJobInit(&job, DECODE_MODE_NUMBERS, NULL, 0);
+		if (!GetNumberFormat(pCommand, &job.number))
+			return bReturn;
+
+		// Group all changes into a single undo operation
+		hwUndoBeginGroup(hDoc);
+
+		if (DecodeClipboard(hSession, _T("Parsing number list"), &job, &result, &pFree))
+		{
+			if (result.eStatus != DECODE_OK)
+			{
+				// Nothing is inserted; point at the value that failed
+				TCHAR szMessage[128];
+				_sntprintf(szMessage, COUNTOF(szMessage),
+					_T("第 %Iu 个字符处的数值无效或超出范围!"), result.nInUsed + 1);
+				szMessage[COUNTOF(szMessage) - 1] = 0;
+				MessageBox(hMain, szMessage, _T("错误"), MB_OK);
+			}
+			else
+			{
+				if (result.nOut)
+					hwInsertAt(hDoc, qwStartPosition, (void*)result.pOut, result.nOut);
+				bReturn = TRUE;
+			}
+		}
+
+		// Commit the undo group
+		hwUndoEndGroup(hDoc);
+
+		if (pFree)
+			bufpool_free(pFree);
+	}
+
+	return bReturn;
+}
+
+// Decodes the text of one scanner hit over pText itself; line breaks are
+// dropped first, base64 is cut to whole quanta
+static size_t DecodeScanHit(const SCAN_HIT* pHit, char* pText, size_t nText)
+{
+	unsigned char* pOut = (unsigned char*)pText;
+	size_t nUsed = 0;
+	size_t n = 0;
+
+	if (pHit->bHex)
+		return hex_decode(pText, nText, pOut, &nUsed);
+
+	for (size_t i = 0; i < nText; i++)
+	{
+		if (pText[i] != '\r' && pText[i] != '\n')
+			pText[n++] = pText[i];
+	}
+	return base64_decode64(pText, n & ~(size_t)3, pOut);
+}
+
+// Where a decoded run landed in the new document
+typedef struct _FIND_ENCODED_MARK
+{
+	QWORD  qwOut;
+	size_t nOut;		// 0: the run did not decode
+} FIND_ENCODED_MARK;
+
+BOOL doFindEncodedData(HWSESSION hSession, HWDOCUMENT hDoc, BOOL bDecode)
+{
+	BOOL bReturn = FALSE;
+	SCAN_RESULT result;
+	HWDOCUMENT hNewDoc = NULL;
+	DWORD dwStart = GetTickCount();
+
+	if (!ScanDocument(hSession, hDoc, FIND_ENCODED_MIN_RUN, &result))
+	{
+		ScanResultFree(&result);
+		return bReturn;
+	}
+
+	DWORD dwElapsed = GetTickCount() - dwStart;
+	size_t nHex = 0;
+	for (size_t i = 0; i < result.nHits; i++)
+	{
+		if (result.pHits[i].bHex)
+			nHex++;
+
+		if (i < FIND_ENCODED_MAX_BOOKMARKS)
+		{
+			HWAPI_BOOKMARK bookmark;
+			ZeroMemory(&bookmark, sizeof(bookmark));
+			bookmark.cbSize = sizeof(bookmark);
+			bookmark.qwAddress = result.pHits[i].qwStart;
+			bookmark.dwArrayCount = ClampToDword(result.pHits[i].qwEnd - result.pHits[i].qwStart);
+			bookmark.eType = HWAPI_DATATYPE_CHAR;
+			bookmark.eSign = HWAPI_SIGN_UNSIGNED;
+			bookmark.eByteOrder = HWAPI_BYTEORDER_LITTLE_ENDIAN;
+			_sntprintf(bookmark.cDescription, COUNTOF(bookmark.cDescription),
+				result.pHits[i].bHex ? _T("hex text") : _T("base64 text"));
+			hwBookmarksAdd(hDoc, &bookmark);
+		}
+	}
+	hwOutputLog(hSession, HWLOG_INFO,
+		_T("Found %Iu hex and %Iu base64 runs in %I64u bytes (%u ms)"),
+		nHex, result.nHits - nHex, result.qwScanned, dwElapsed);
+	if (result.nHits > FIND_ENCODED_MAX_BOOKMARKS)
+		hwOutputLog(hSession, HWLOG_WARN,
+			_T("Only the first %u runs were bookmarked"), FIND_ENCODED_MAX_BOOKMARKS);
+
+	if (!bDecode || result.nHits == 0)
+	{
+		ScanResultFree(&result);
+		return TRUE;
+	}
+
+	char* pText = NULL;
+	size_t nFailed = 0;
+	DOC_WRITER* pWriter = NULL;
+	size_t nMarks = (result.nHits < FIND_ENCODED_MAX_BOOKMARKS) ? result.nHits : FIND_ENCODED_MAX_BOOKMARKS;
+	FIND_ENCODED_MARK* pMarks = NULL;
+
+	__try
+	{
+		pMarks = (FIND_ENCODED_MARK*)calloc(nMarks, sizeof(FIND_ENCODED_MARK));
+		if (!pMarks)
+			__leave;
+		hNewDoc = hwNewDocument(hSession);
+		if (!hNewDoc)
+			__leave;
+		// Runs are often short; the writer puts them in the new document
+		// with a few large inserts
+		pWriter = DocWriterOpen(hSession, hNewDoc);
+		if (!pWriter)
+			__leave;
+
+		QWORD qwOut = 0;
+		for (size_t i = 0; i < result.nHits; i++)
+		{
+			const SCAN_HIT* pHit = &result.pHits[i];
+			size_t nText = (size_t)(pHit->qwEnd - pHit->qwStart);
+
+			if (hwUpdateProgress(hSession, (int)(i * 100 / result.nHits),
+				_T("Decoding encoded data")) == HWAPI_RESULT_USER_ABORT)
 				__leave;
-			pData = (LPSTR)GlobalLock(hClip);
 
-			SIZE_T len = strlen(pData);
-			if (len == 0)
+			pText = (char*)bufpool_alloc(nText);
+			if (!pText)
 				__leave;
-			pStr = (LPSTR)malloc(BASE64_DECODE_OUT_SIZE(len));
-			RtlZeroMemory(pStr, BASE64_DECODE_OUT_SIZE(len));
-			SIZE_T ret = base64_decode(pData, len, (unsigned char*)pStr);
-			if (ret == 0 || ret > BASE64_DECODE_OUT_SIZE(len))
+			if (hwReadAt(hDoc, pHit->qwStart, pText, nText) != HWAPI_RESULT_SUCCESS)
 				__leave;
 
-			hwInsertAt(hDoc, qwStartPosition, pStr, ret);
+			size_t nOut = DecodeScanHit(pHit, pText, nText);
+			if (nOut)
+			{
+				if (!DocWriterInsert(pWriter, qwOut, pText, nOut))
+					__leave;
+				if (i < nMarks)
+				{
+					pMarks[i].qwOut = qwOut;
+					pMarks[i].nOut = nOut;
+				}
+				qwOut += nOut;
+			}
+			else
+			{
+				nFailed++;
+			}
+
+			bufpool_free(pText);
+			pText = NULL;
+		}
+
+		// Bookmarks go in once the bytes they point at are in the document
+		BOOL bWritten = DocWriterClose(pWriter, NULL);
+		pWriter = NULL;
+		if (!bWritten)
+			__leave;
+		for (size_t i = 0; i < nMarks; i++)
+		{
+			if (pMarks[i].nOut == 0)
+				continue;
+
+			// Point back at the source text
+			HWAPI_BOOKMARK bookmark;
+			ZeroMemory(&bookmark, sizeof(bookmark));
+			bookmark.cbSize = sizeof(bookmark);
+			bookmark.qwAddress = pMarks[i].qwOut;
+			bookmark.dwArrayCount = ClampToDword(pMarks[i].nOut);
+			bookmark.eType = HWAPI_DATATYPE_BLOB;
+			bookmark.eSign = HWAPI_SIGN_UNSIGNED;
+			bookmark.eByteOrder = HWAPI_BYTEORDER_LITTLE_ENDIAN;
+			_sntprintf(bookmark.cDescription, COUNTOF(bookmark.cDescription),
+				_T("%s at 0x%I64X"), result.pHits[i].bHex ? _T("hex") : _T("base64"), result.pHits[i].qwStart);
+			hwBookmarksAdd(hNewDoc, &bookmark);
+		}
+
+		if (nFailed)
+			hwOutputLog(hSession, HWLOG_WARN,
+				_T("%Iu runs could not be decoded"), nFailed);
+		bReturn = TRUE;
+	}
+	__finally
+	{
+		DocWriterClose(pWriter, NULL);
+		free(pMarks);
+		if (pText)
+			bufpool_free(pText);
+		ScanResultFree(&result);
+	}
+
+	return bReturn;
+}
+
+BOOL doDecodeSelection(HWSESSION hSession, HWDOCUMENT hDoc, DECODE_MODE eMode)
+{
+	BOOL bReturn = FALSE;
+	QWORD qwStartPosition;
+	QWORD qwLength;
+	HWND hMain = hwGetWindowHandle(hSession);
+
+	// Check readonly document status
+	BOOL bReadOnly = TRUE;
+	hwGetReadOnly(hDoc, &bReadOnly);
+	if (bReadOnly)
+	{
+		MessageBox(hMain,
+			_T("Document is read-only; cannot perform operation."),
+			_T("Error"),
+			MB_ICONSTOP | MB_APPLMODAL);
+		return bReturn;
+	}
+
+	// Obtain starting position and length
+	if ((hwGetCaretPosition(hDoc, &qwStartPosition) == HWAPI_RESULT_SUCCESS) &&
+		(hwGetSelection(hDoc, &qwLength) == HWAPI_RESULT_SUCCESS) &&
+		qwLength)
+	{
+		QWORD qwOut = 0;
+		DECODE_STATUS eStatus;
+
+		// Group all changes into a single undo operation
+		hwUndoBeginGroup(hDoc);
+		eStatus = DecodeRangeInPlace(hSession, hDoc, qwStartPosition, qwLength, eMode, &qwOut);
+		hwUndoEndGroup(hDoc);
+
+		if (eStatus == DECODE_INVALID)
+		{
+			MessageBox(hMain, _T("选中内容不是有效的编码数据!"), _T("错误"), MB_OK);
 		}
-		__finally
+		else if (eStatus != DECODE_CANCELLED)
 		{
-			if (pStr)
-				free(pStr);
-			if (pData)
-				GlobalUnlock(pData);
+			// Select the decoded bytes
+			hwSetCaretPosition(hDoc, qwStartPosition);
+			hwSetSelection(hDoc, qwOut);
+			bReturn = (eStatus == DECODE_OK);
+
+			if (eStatus == DECODE_TRUNCATED)
+			{
+				MessageBox(hMain, _T("解析缺失部分末尾数据!"), _T("警告"), MB_OK);
+			}
+		}
+	}
+
+	return bReturn;
+}
+
+BOOL doEncodeSelection(HWSESSION hSession, HWDOCUMENT hDoc, const ENCODE_FORMAT* pFormat)
+{
+	BOOL bReturn = FALSE;
+	QWORD qwStartPosition;
+	QWORD qwLength;
+	HWND hMain = hwGetWindowHandle(hSession);
+
+	// Check readonly document status
+	BOOL bReadOnly = TRUE;
+	hwGetReadOnly(hDoc, &bReadOnly);
+	if (bReadOnly)
+	{
+		MessageBox(hMain,
+			_T("Document is read-only; cannot perform operation."),
+			_T("Error"),
+			MB_ICONSTOP | MB_APPLMODAL);
+		return bReturn;
+	}
+
+	// Obtain starting position and length
+	if ((hwGetCaretPosition(hDoc, &qwStartPosition) == HWAPI_RESULT_SUCCESS) &&
+		(hwGetSelection(hDoc, &qwLength) == HWAPI_RESULT_SUCCESS) &&
+		qwLength)
+	{
+		QWORD qwOut = 0;
+
+		// Group all changes into a single undo operation
+		hwUndoBeginGroup(hDoc);
+		bReturn = EncodeRangeInPlace(hSession, hDoc, qwStartPosition, qwLength, pFormat, &qwOut);
+		hwUndoEndGroup(hDoc);
+
+		if (bReturn)
+		{
+			// Select the text
+			hwSetCaretPosition(hDoc, qwStartPosition);
+			hwSetSelection(hDoc, qwOut);
+		}
+	}
+
+	return bReturn;
+}
+
+BOOL doCopyHexdump(HWSESSION hSession, HWDOCUMENT hDoc, const HEXDUMP_COMMAND* pCommand)
+{
+	BOOL bReturn = FALSE;
+	QWORD qwStartPosition;
+	QWORD qwLength;
+	HWND hMain = hwGetWindowHandle(hSession);
+	HGLOBAL hText = NULL;
+	char* pText = NULL;
+	BOOL bOpen = FALSE;
+
+	if ((hwGetCaretPosition(hDoc, &qwStartPosition) != HWAPI_RESULT_SUCCESS) ||
+		(hwGetSelection(hDoc, &qwLength) != HWAPI_RESULT_SUCCESS) ||
+		qwLength == 0)
+		return bReturn;
+
+	// The text is formatted straight into the clipboard block, sized up front
+	QWORD qwText = hexdump_size(pCommand->nStyle,
+		hexdump_offset_digits(qwStartPosition, qwLength), qwLength);
+	if (qwText >= (SIZE_T)-1)
+	{
+		MessageBox(hMain, _T("Selection is too large to copy as text."), _T("Error"), MB_ICONSTOP | MB_APPLMODAL);
+		return bReturn;
+	}
+
+	DWORD dwStart = GetTickCount();
+	__try
+	{
+		hText = GlobalAlloc(GMEM_MOVEABLE, (SIZE_T)qwText + 1);
+		if (!hText)
+		{
+			MessageBox(hMain, _T("Not enough memory for the hex dump."), _T("Error"), MB_ICONSTOP | MB_APPLMODAL);
+			__leave;
+		}
+		pText = (char*)GlobalLock(hText);
+		if (!pText)
+			__leave;
+
+		if (!HexdumpRange(hSession, hDoc, qwStartPosition, qwLength, pCommand->nStyle, pText))
+			__leave;
+		GlobalUnlock(hText);
+		pText = NULL;
+
+		if (!OpenClipboard(hMain))
+		{
+			MessageBox(hMain, _T("打开剪切板失败!"), _T("错误"), MB_OK);
+			__leave;
+		}
+		bOpen = TRUE;
+		EmptyClipboard();
+
+		// The clipboard owns the block from here on
+		if (!SetClipboardData(CF_TEXT, hText))
+			__leave;
+		hText = NULL;
+
+		hwOutputLog(hSession, HWLOG_INFO,
+			_T("Copied %I64u bytes as %I64u characters of hex dump (%u ms)"),
+			qwLength, qwText, GetTickCount() - dwStart);
+		bReturn = TRUE;
+	}
+	__finally
+	{
+		if (pText)
+			GlobalUnlock(hText);
+		if (hText)
+			GlobalFree(hText);
+		if (bOpen)
+			CloseClipboard();
+	}
+
+	return bReturn;
+}
+
+BOOL doAutoDecodeFile(HWSESSION hSession, HWDOCUMENT hDoc, DECODE_MODE eMode)
+{
+	TCHAR szFileName[MAX_PATH];
+	FILE_DECODE_RESULT result;
+
+	// The text is read straight from disk rather than through the document
+	if (hwGetFileName(hDoc, szFileName, COUNTOF(szFileName)) != HWAPI_RESULT_SUCCESS)
+		return FALSE;
+
+	DECODE_STATUS eStatus = DecodeFileToDocument(hSession, szFileName, eMode, &result);
+	if (eStatus == DECODE_CANCELLED)
+		return FALSE;
+	if (eStatus == DECODE_INVALID)
+	{
+		// Leave the text open as it is
+		hwOutputLog(hSession, HWLOG_WARN,
+			_T("%s is not valid %s text (stopped at offset %I64u)"),
+			szFileName, eMode == DECODE_MODE_HEX ? _T("hex") : _T("base64"), result.qwIn);
+		return FALSE;
+	}
+
+	DWORD dwElapsed = result.dwElapsed ? result.dwElapsed : 1;
+	hwOutputLog(hSession, HWLOG_INFO,
+		_T("Decoded %s: %I64u -> %I64u bytes in %u ms (%I64u MB/s)"),
+		szFileName, result.qwIn, result.qwOut, result.dwElapsed,
+		result.qwIn * 1000 / dwElapsed / (1024 * 1024));
+	if (eStatus == DECODE_TRUNCATED)
+		hwOutputLog(hSession, HWLOG_WARN,
+			_T("Decoding stopped at offset %I64u of %I64u"), result.qwIn, result.qwSize);
+
+	// Only the bytes are of interest; the untouched text closes quietly
+	if (ConfigGetInt(AUTODECODE_SECTION, _T("CloseSource"), 1))
+		hwCloseDocument(hDoc);
+
+	return TRUE;
+}
+
+BOOL doBuildFileIndex(HWSESSION hSession, HWDOCUMENT hDoc, DECODE_MODE eMode)
+{
+	TCHAR szFileName[MAX_PATH];
+	FILE_INDEX index;
+	HWND hMain = hwGetWindowHandle(hSession);
+	DWORD dwStart = GetTickCount();
+
+	// The file is indexed as it is on disk
+	if (hwGetFileName(hDoc, szFileName, COUNTOF(szFileName)) != HWAPI_RESULT_SUCCESS)
+		return FALSE;
+
+	DECODE_STATUS eStatus = FileIndexBuild(hSession, szFileName, eMode,
+		ConfigGetInt(INDEX_SECTION, _T("IntervalKB"), FILE_INDEX_INTERVAL_KB), &index);
+	if (eStatus == DECODE_CANCELLED)
+		return FALSE;
+	if (eStatus == DECODE_INVALID)
+	{
+		MessageBox(hMain, eMode == DECODE_MODE_HEX ?
+			_T("The file does not start with hex text.") : _T("The file does not start with base64 text."),
+			_T("Error"), MB_ICONSTOP | MB_APPLMODAL);
+		return FALSE;
+	}
+
+	BOOL bSaved = FileIndexSave(szFileName, &index);
+	hwOutputLog(hSession, HWLOG_INFO,
+		_T("Indexed %s: %I64u characters -> %I64u bytes, %Iu checkpoints (%u ms)"),
+		szFileName, index.qwTextUsed, index.qwOut, index.nPoints, GetTickCount() - dwStart);
+	if (eStatus == DECODE_TRUNCATED)
+		hwOutputLog(hSession, HWLOG_WARN,
+			_T("The data ends at offset %I64u of %I64u"), index.qwTextUsed, index.qwTextSize);
+	if (!bSaved)
+		hwOutputLog(hSession, HWLOG_ERR,
+			_T("Could not write the index to %s%s"), szFileName, FILE_INDEX_EXTENSION);
+
+	FileIndexFree(&index);
+	return bSaved;
+}
+
+// A size or offset: decimal, optionally with a fraction and a K / M / G /
+// T suffix (powers of 1024, "KB" and "KiB" alike), or hex after "0x".
+// QWORD is signed, so values stop short of 2^63.
+static BOOL ParseSize(LPCTSTR* pp, QWORD* pqwValue)
+{
+	LPCTSTR p = *pp;
+	QWORD qwValue = 0;
+	QWORD qwFraction = 0;
+	QWORD qwScale = 1;
+	int nShift = 0;
+
+	while (*p == _T(' ') || *p == _T('\t'))
+		p++;
+	LPCTSTR pStart = p;
+
+	if (p[0] == _T('0') && (p[1] == _T('x') || p[1] == _T('X')))
+	{
+		for (p += 2, pStart = p; _istxdigit(*p); p++)
+		{
+			if (qwValue >> 59)
+				return FALSE;
+			qwValue = (qwValue << 4) |
+				(QWORD)(_istdigit(*p) ? *p - _T('0') : (_totupper(*p) - _T('A') + 10));
+		}
+		if (p == pStart)
+			return FALSE;
+		*pp = p;
+		*pqwValue = qwValue;
+		return TRUE;
+	}
+
+	for (; *p >= _T('0') && *p <= _T('9'); p++)
+	{
+		if (qwValue > (_I64_MAX - 9) / 10)
+			return FALSE;
+		qwValue = qwValue * 10 + (*p - _T('0'));
+	}
+	if (*p == _T('.'))
+	{
+		// Six digits are plenty for a fraction of a terabyte
+		for (p++; *p >= _T('0') && *p <= _T('9'); p++)
+		{
+			if (qwScale < 1000000)
+			{
+				qwFraction = qwFraction * 10 + (*p - _T('0'));
+				qwScale *= 10;
+			}
+		}
+	}
+	if (p == pStart)
+		return FALSE;
+
+	switch (_totupper(*p))
+	{
+	case _T('K'): nShift = 10; break;
+	case _T('M'): nShift = 20; break;
+	case _T('G'): nShift = 30; break;
+	case _T('T'): nShift = 40; break;
+	}
+	if (nShift)
+	{
+		p++;
+		if (_totupper(*p) == _T('I'))
+			p++;
+	}
+	if (_totupper(*p) == _T('B'))
+		p++;
+
+	// Fractions of a byte are not
+	if ((qwScale > 1 && nShift == 0) || (nShift && (qwValue >> (63 - nShift))))
+		return FALSE;
+	*pp = p;
+	*pqwValue = (qwValue << nShift) + (qwFraction << nShift) / qwScale;
+	return TRUE;
+}
+
+// "start-end" (end excluded), "start+length" or "start length"
+static BOOL ParseByteRange(LPCTSTR lpszText, QWORD* pqwOffset, QWORD* pqwLength)
+{
+	LPCTSTR p = lpszText;
+	QWORD qwSecond;
+
+	if (!ParseSize(&p, pqwOffset))
+		return FALSE;
+	while (*p == _T(' ') || *p == _T('\t'))
+		p++;
+	TCHAR cSeparator = *p;
+	if (cSeparator == _T('-') || cSeparator == _T('+'))
+		p++;
+	if (!ParseSize(&p, &qwSecond))
+		return FALSE;
+	while (*p == _T(' ') || *p == _T('\t'))
+		p++;
+	if (*p)
+		return FALSE;
+
+	if (cSeparator == _T('-'))
+	{
+		if (qwSecond <= *pqwOffset)
+			return FALSE;
+		*pqwLength = qwSecond - *pqwOffset;
+	}
+	else
+	{
+		*pqwLength = qwSecond;
+	}
+	return *pqwLength != 0;
+}
+
+BOOL doExtractIndexedRange(HWSESSION hSession, HWDOCUMENT hDoc)
+{
+	BOOL bReturn = FALSE;
+	TCHAR szFileName[MAX_PATH];
+	TCHAR szLabel[PROMPT_MAX_TEXT];
+	// The last range asked for is offered again
+	static TCHAR s_szRange[PROMPT_MAX_TEXT];
+	FILE_INDEX index;
+	HWND hMain = hwGetWindowHandle(hSession);
+
+	if (hwGetFileName(hDoc, szFileName, COUNTOF(szFileName)) != HWAPI_RESULT_SUCCESS)
+		return bReturn;
+	if (!FileIndexLoad(szFileName, &index))
+	{
+		MessageBox(hMain,
+			_T("The file has no index, or has changed since it was indexed; build the index first."),
+			_T("Error"), MB_ICONSTOP | MB_APPLMODAL);
+		return bReturn;
+	}
+
+	__try
+	{
+		_sntprintf(szLabel, COUNTOF(szLabel),
+			_T("Bytes to decode, of %I64u (0x%I64X): start-end, start+length or start length, ")
+			_T("e.g. 3.2G-3.21G or 0x1000 64K"), index.qwOut, index.qwOut);
+		szLabel[COUNTOF(szLabel) - 1] = 0;
+		if (!PromptText(hMain, _T("Extract decoded range"), szLabel, s_szRange, COUNTOF(s_szRange)))
+			__leave;
+
+		QWORD qwOffset;
+		QWORD qwLength;
+		if (!ParseByteRange(s_szRange, &qwOffset, &qwLength) || qwOffset >= index.qwOut)
+		{
+			MessageBox(hMain, _T("Not a range of the decoded bytes."), _T("Error"), MB_ICONSTOP | MB_APPLMODAL);
+			__leave;
+		}
+		if (qwLength > index.qwOut - qwOffset)
+			qwLength = index.qwOut - qwOffset;
+
+		HWDOCUMENT hNewDoc = hwNewDocument(hSession);
+		if (!hNewDoc)
+			__leave;
+
+		DWORD dwStart = GetTickCount();
+		QWORD qwOut = 0;
+		DECODE_STATUS eStatus = FileIndexExtract(hSession, szFileName, &index,
+			qwOffset, qwLength, hNewDoc, 0, &qwOut);
+		if (eStatus == DECODE_INVALID || eStatus == DECODE_CANCELLED)
+		{
+			hwCloseDocument(hNewDoc);
+			__leave;
+		}
+
+		hwOutputLog(hSession, HWLOG_INFO,
+			_T("Extracted bytes 0x%I64X-0x%I64X of %s (%I64u bytes, %u ms)"),
+			qwOffset, qwOffset + qwOut, szFileName, qwOut, GetTickCount() - dwStart);
+		if (eStatus == DECODE_TRUNCATED)
+			hwOutputLog(hSession, HWLOG_WARN,
+				_T("Only %I64u of %I64u bytes could be decoded; the file may have changed"),
+				qwOut, qwLength);
+		bReturn = TRUE;
+	}
+	__finally
+	{
+		FileIndexFree(&index);
+	}
+
+	return bReturn;
+}
+
+BOOL doApplyPatch(HWSESSION hSession, HWDOCUMENT hDoc)
+{
+	BOOL bReturn = FALSE;
+	HWND hMain = hwGetWindowHandle(hSession);
+	HANDLE hClip = NULL;
+	LPSTR pData = NULL;
+	BOOL bOpen = FALSE;
+	PATCH_SET patch;
+	size_t nErrorLine = 0;
+	BOOL bParsed = FALSE;
+	DWORD dwStart = GetTickCount();
+
+	// Check readonly document status
+	BOOL bReadOnly = TRUE;
+	hwGetReadOnly(hDoc, &bReadOnly);
+	if (bReadOnly)
+	{
+		MessageBox(hMain,
+			_T("Document is read-only; cannot perform operation."),
+			_T("Error"),
+			MB_ICONSTOP | MB_APPLMODAL);
+		return bReturn;
+	}
+
+	ZeroMemory(&patch, sizeof(patch));
+	__try
+	{
+		if (!IsClipboardFormatAvailable(CF_TEXT))
+			__leave;
+		if (!OpenClipboard(hMain))
+		{
+			MessageBox(hMain, _T("打开剪切板失败!"), _T("错误"), MB_OK);
+			__leave;
+		}
+		bOpen = TRUE;
+
+		hClip = GetClipboardData(CF_TEXT);
+		if (!hClip)
+			__leave;
+		pData = (LPSTR)GlobalLock(hClip);
+		if (!pData)
+			__leave;
+
+		// The edits keep their own copy of the bytes, so the clipboard can
+		// go back straight away
+		bParsed = PatchParse(pData, strlen(pData), &patch, &nErrorLine);
+		GlobalUnlock(hClip);
+		pData = NULL;
+		CloseClipboard();
+		bOpen = FALSE;
+
+		if (!bParsed)
+		{
+			if (nErrorLine)
+			{
+				TCHAR szMessage[128];
+				_sntprintf(szMessage, COUNTOF(szMessage), _T("剪切板中的补丁脚本第 %Iu 行有误!"), nErrorLine);
+				szMessage[COUNTOF(szMessage) - 1] = 0;
+				MessageBox(hMain, szMessage, _T("错误"), MB_OK);
+			}
+			__leave;
+		}
+		size_t nEdits = patch.nEdits;
+		if (nEdits == 0)
+		{
+			MessageBox(hMain, _T("剪切板中没有补丁数据!"), _T("错误"), MB_OK);
+			__leave;
+		}
+		if (!PatchMerge(&patch))
+			__leave;
+
+		// Nothing is written unless every run fits
+		QWORD qwSize = 0;
+		if (hwGetDocumentSize(hDoc, &qwSize) != HWAPI_RESULT_SUCCESS)
+			__leave;
+		if (PatchExtent(&patch) > qwSize)
+		{
+			TCHAR szMessage[160];
+			_sntprintf(szMessage, COUNTOF(szMessage),
+				_T("The patch reaches offset 0x%I64X, past the end of the document (0x%I64X)."),
+				PatchExtent(&patch), qwSize);
+			szMessage[COUNTOF(szMessage) - 1] = 0;
+			MessageBox(hMain, szMessage, _T("Error"), MB_ICONSTOP | MB_APPLMODAL);
+			__leave;
+		}
+
+		// Group all changes into a single undo operation
+		size_t nApplied = 0;
+		hwUndoBeginGroup(hDoc);
+		bReturn = PatchApply(hSession, hDoc, &patch, &nApplied);
+		hwUndoEndGroup(hDoc);
+
+		hwOutputLog(hSession, HWLOG_INFO,
+			_T("Patch script: %Iu edits applied as %Iu writes (%Iu bytes, %u ms)"),
+			nEdits, nApplied, patch.nData, GetTickCount() - dwStart);
+		if (!bReturn)
+			hwOutputLog(hSession, HWLOG_ERR,
+				_T("The document refused the write at 0x%I64X; %Iu of %Iu were made"),
+				patch.pEdits[nApplied].qwOffset, nApplied, patch.nEdits);
+	}
+	__finally
+	{
+		PatchFree(&patch);
+		if (pData)
+			GlobalUnlock(hClip);
+		if (bOpen)
+			CloseClipboard();
+	}
+
+	return bReturn;
+}
+
+BOOL doCompareClipboard(HWSESSION hSession, HWDOCUMENT hDoc, DECODE_MODE eMode)
+{
+	BOOL bReturn = FALSE;
+	QWORD qwStartPosition;
+	HWND hMain = hwGetWindowHandle(hSession);
+	HANDLE hClip = NULL;
+	LPSTR pData = NULL;
+	BOOL bOpen = FALSE;
+	COMPARE_RESULT result;
+	DWORD dwStart = GetTickCount();
+
+	if (hwGetCaretPosition(hDoc, &qwStartPosition) != HWAPI_RESULT_SUCCESS)
+		return bReturn;
+
+	ZeroMemory(&result, sizeof(result));
+	__try
+	{
+		if (!IsClipboardFormatAvailable(CF_TEXT))
+			__leave;
+		if (!OpenClipboard(hMain))
+		{
+			MessageBox(hMain, _T("打开剪切板失败!"), _T("错误"), MB_OK);
+			__leave;
+		}
+		bOpen = TRUE;
+
+		hClip = GetClipboardData(CF_TEXT);
+		if (!hClip)
+			__leave;
+		pData = (LPSTR)GlobalLock(hClip);
+		if (!pData)
+			__leave;
+
+		size_t nText = strlen(pData);
+		DECODE_STATUS eStatus = CompareTextWithDocument(hSession, hDoc, qwStartPosition,
+			eMode, pData, nText, &result);
+		GlobalUnlock(hClip);
+		pData = NULL;
+		CloseClipboard();
+		bOpen = FALSE;
+
+		if (eStatus == DECODE_CANCELLED)
+			__leave;
+		if (eStatus == DECODE_INVALID)
+		{
+			MessageBox(hMain, _T("剪切板中不是有效的编码数据!"), _T("错误"), MB_OK);
+			__leave;
+		}
+
+		// Bookmarks go in once the comparison is over, not between reads
+		size_t nBookmarks = (result.nRanges < COMPARE_MAX_RANGES) ? result.nRanges : COMPARE_MAX_RANGES;
+		for (size_t i = 0; i < nBookmarks; i++)
+		{
+			HWAPI_BOOKMARK bookmark;
+			ZeroMemory(&bookmark, sizeof(bookmark));
+			bookmark.cbSize = sizeof(bookmark);
+			bookmark.qwAddress = result.pRanges[i].qwStart;
+			bookmark.dwArrayCount = ClampToDword(result.pRanges[i].qwLength);
+			bookmark.eType = HWAPI_DATATYPE_BLOB;
+			bookmark.eSign = HWAPI_SIGN_UNSIGNED;
+			bookmark.eByteOrder = HWAPI_BYTEORDER_LITTLE_ENDIAN;
+			_sntprintf(bookmark.cDescription, COUNTOF(bookmark.cDescription),
+				_T("differs from clipboard at +0x%I64X"), result.pRanges[i].qwStart - qwStartPosition);
+			hwBookmarksAdd(hDoc, &bookmark);
+		}
+
+		if (result.nRanges == 0)
+			hwOutputLog(hSession, HWLOG_INFO,
+				_T("Compared %I64u bytes at 0x%I64X with the clipboard: identical (%u ms)"),
+				result.qwCompared, qwStartPosition, GetTickCount() - dwStart);
+		else
+			hwOutputLog(hSession, HWLOG_INFO,
+				_T("Compared %I64u bytes at 0x%I64X with the clipboard: %I64u bytes differ in %Iu ranges (%u ms)"),
+				result.qwCompared, qwStartPosition, result.qwDiffering, result.nRanges,
+				GetTickCount() - dwStart);
+		if (result.nRanges > COMPARE_MAX_RANGES)
+			hwOutputLog(hSession, HWLOG_WARN,
+				_T("Only the first %u ranges were bookmarked"), COMPARE_MAX_RANGES);
+		if (result.qwDecoded > result.qwCompared)
+			hwOutputLog(hSession, HWLOG_WARN,
+				_T("%I64u decoded bytes run past the end of the document"),
+				result.qwDecoded - result.qwCompared);
+		if (result.nTextUsed != nText)
+			hwOutputLog(hSession, HWLOG_WARN,
+				_T("The clipboard text stopped decoding at character %Iu of %Iu"),
+				result.nTextUsed, nText);
+		bReturn = TRUE;
+	}
+	__finally
+	{
+		CompareResultFree(&result);
+		if (pData)
+			GlobalUnlock(hClip);
+		if (bOpen)
 			CloseClipboard();
-			// Commit the undo group
-			hwUndoEndGroup(hDoc);
+	}
+
+	return bReturn;
+}
+
+// Decodes base64 text into an exact pattern
+static BOOL ParseBase64Pattern(bytefind_pattern* pPattern, const char* pText, size_t nText)
+{
+	BOOL bReturn = FALSE;
+
+	if (nText == 0 || nText > FIND_PATTERN_MAX_TEXT)
+		return bReturn;
+
+	// DecodeTextChunk compacts the text, and the clipboard's must stay as it is
+	char* pCopy = (char*)malloc(nText);
+	if (!pCopy)
+		return bReturn;
+	memcpy(pCopy, pText, nText);
+
+	size_t nOut = 0;
+	size_t nUsed = 0;
+	if (DecodeTextChunk(DECODE_MODE_BASE64, pCopy, nText, TRUE,
+		(unsigned char*)pCopy, &nOut, &nUsed) != DECODE_INVALID)
+		bReturn = bytefind_init(pPattern, (const unsigned char*)pCopy, NULL, nOut);
+	free(pCopy);
+	return bReturn;
+}
+
+BOOL doFindDecodedPattern(HWSESSION hSession, HWDOCUMENT hDoc, DECODE_MODE eMode)
+{
+	BOOL bReturn = FALSE;
+	HWND hMain = hwGetWindowHandle(hSession);
+	HANDLE hClip = NULL;
+	LPSTR pData = NULL;
+	BOOL bOpen = FALSE;
+	BOOL bPattern = FALSE;
+	bytefind_pattern* pPattern = NULL;
+	FIND_RESULT result;
+
+	ZeroMemory(&result, sizeof(result));
+	__try
+	{
+		pPattern = (bytefind_pattern*)malloc(sizeof(bytefind_pattern));
+		if (!pPattern)
+			__leave;
+		if (!IsClipboardFormatAvailable(CF_TEXT))
+			__leave;
+		if (!OpenClipboard(hMain))
+		{
+			MessageBox(hMain, _T("打开剪切板失败!"), _T("错误"), MB_OK);
+			__leave;
 		}
+		bOpen = TRUE;
+
+		hClip = GetClipboardData(CF_TEXT);
+		if (!hClip)
+			__leave;
+		pData = (LPSTR)GlobalLock(hClip);
+		if (!pData)
+			__leave;
+
+		size_t nText = strlen(pData);
+		if (eMode == DECODE_MODE_HEX)
+			bPattern = bytefind_parse_hex(pPattern, pData, nText);
+		else
+			bPattern = ParseBase64Pattern(pPattern, pData, nText);
+		GlobalUnlock(hClip);
+		pData = NULL;
+		CloseClipboard();
+		bOpen = FALSE;
+
+		if (!bPattern)
+		{
+			MessageBox(hMain, _T("剪切板中不是有效的编码数据!"), _T("错误"), MB_OK);
+			__leave;
+		}
+
+		DWORD dwStart = GetTickCount();
+		if (!FindInDocument(hSession, hDoc, pPattern, &result))
+			__leave;
+		DWORD dwElapsed = GetTickCount() - dwStart;
+
+		// Bookmarks go in once the search is over, not between reads
+		for (size_t i = 0; i < result.nHits; i++)
+		{
+			HWAPI_BOOKMARK bookmark;
+			ZeroMemory(&bookmark, sizeof(bookmark));
+			bookmark.cbSize = sizeof(bookmark);
+			bookmark.qwAddress = result.pqwHits[i];
+			bookmark.dwArrayCount = ClampToDword(pPattern->len);
+			bookmark.eType = HWAPI_DATATYPE_BLOB;
+			bookmark.eSign = HWAPI_SIGN_UNSIGNED;
+			bookmark.eByteOrder = HWAPI_BYTEORDER_LITTLE_ENDIAN;
+			_sntprintf(bookmark.cDescription, COUNTOF(bookmark.cDescription),
+				_T("pattern match %Iu"), i + 1);
+			hwBookmarksAdd(hDoc, &bookmark);
+		}
+
+		// Select the first match from the caret on, wrapping around
+		QWORD qwCaret = 0;
+		if (result.nHits && hwGetCaretPosition(hDoc, &qwCaret) == HWAPI_RESULT_SUCCESS)
+		{
+			size_t nSelect = 0;
+			while (nSelect < result.nHits && result.pqwHits[nSelect] < qwCaret)
+				nSelect++;
+			if (nSelect == result.nHits)
+				nSelect = 0;
+			hwSetCaretPosition(hDoc, result.pqwHits[nSelect]);
+			hwSetSelection(hDoc, pPattern->len);
+		}
+
+		hwOutputLog(hSession, HWLOG_INFO,
+			_T("Found %I64u matches of a %Iu byte pattern in %I64u bytes (%u ms)"),
+			result.qwMatches, pPattern->len, result.qwSearched, dwElapsed);
+		if (result.qwMatches > result.nHits)
+			hwOutputLog(hSession, HWLOG_WARN,
+				_T("Only the first %u matches were bookmarked"), FIND_MAX_HITS);
+		bReturn = TRUE;
+	}
+	__finally
+	{
+		FindResultFree(&result);
+		free(pPattern);
+		if (pData)
+			GlobalUnlock(hClip);
+		if (bOpen)
+			CloseClipboard();
 	}
 
 	return bReturn;
@@ -0,0 +1,119 @@
+#include "ascii85.h"
+
+#include <string.h>
+
+#define ASCII85_FIRST '!'
+#define ASCII85_LAST  'u'
+
+static void
+ascii85_store(unsigned char* out, unsigned long v, int n)
+{
+	int k;
+
+	for (k = 0; k < n; k++) {
+		out[k] = (unsigned char)(v >> (24 - 8 * k));
+	}
+}
+
+size_t
+ascii85_decode_out_size(const char* in, size_t inlen)
+{
+	const char* p = in;
+	const char* end = in + inlen;
+	size_t z = 0;
+
+	while ((p = (const char*)memchr(p, 'z', end - p)) != NULL) {
+		z++;
+		p++;
+	}
+	/* plus a short last group */
+	return (inlen - z) / 5 * 4 + z * 4 + 4;
+}
+
+size_t
+ascii85_decode(const char* in, size_t inlen, unsigned char* out, int final, size_t* inused)
+{
+	size_t i = 0;
+	size_t j = 0;
+	size_t done = 0;        /* characters up to the last whole group */
+	unsigned long long v = 0;
+	int n = 0;              /* characters of the current group */
+
+	while (i < inlen) {
+		char c = in[i];
+
+		/* '<' is also a digit; "<~" is only looked for at the start */
+		if (c == '<' && i + 1 < inlen && in[i + 1] == '~' && j == 0 && n == 0) {
+			i += 2;
+			done = i;
+			continue;
+		}
+		if (c >= ASCII85_FIRST && c <= ASCII85_LAST) {
+			v = v * 85 + (unsigned)(c - ASCII85_FIRST);
+			i++;
+			if (++n == 5) {
+				if (v > 0xFFFFFFFFULL) {
+					break;
+				}
+				ascii85_store(out + j, (unsigned long)v, 4);
+				j += 4;
+				v = 0;
+				n = 0;
+				done = i;
+			}
+			continue;
+		}
+		if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+			i++;
+			if (n == 0) {
+				done = i;
+			}
+			continue;
+		}
+		if (c == 'z' && n == 0) {
+			ascii85_store(out + j, 0, 4);
+			j += 4;
+			done = ++i;
+			continue;
+		}
+		if (c == '~') {
+			/* "~>" ends the data, a short group included */
+			if (i + 1 >= inlen && !final) {
+				break;
+			}
+			if (i + 1 < inlen && in[i + 1] == '>' && n != 1) {
+				if (n) {
+					for (int k = n; k < 5; k++) {
+						v = v * 85 + (ASCII85_LAST - ASCII85_FIRST);
+					}
+					if (v > 0xFFFFFFFFULL) {
+						break;
+					}
+					ascii85_store(out + j, (unsigned long)v, n - 1);
+					j += n - 1;
+				}
+				for (i += 2; i < inlen && (in[i] == ' ' || in[i] == '\t' || in[i] == '\r' || in[i] == '\n'); i++) {
+				}
+				done = i;
+			}
+			*inused = done;
+			return j;
+		}
+		break;
+	}
+
+	/* a short last group without its "~>" */
+	if (i == inlen && final && n >= 2) {
+		for (int k = n; k < 5; k++) {
+			v = v * 85 + (ASCII85_LAST - ASCII85_FIRST);
+		}
+		if (v <= 0xFFFFFFFFULL) {
+			ascii85_store(out + j, (unsigned long)v, n - 1);
+			j += n - 1;
+			done = inlen;
+		}
+	}
+
+	*inused = done;
+	return j;
+}
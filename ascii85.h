@@ -0,0 +1,35 @@
+#pragma once
+
+#ifndef ASCII85_H
+#define ASCII85_H
+
+#include <stddef.h>
+
+/*
+ * Ascii85 as written by btoa and PostScript / PDF: five characters '!'..'u'
+ * per four bytes, 'z' for four zero bytes, optionally wrapped in "<~" and
+ * "~>".
+ */
+
+/*
+ * Output size for in[0..inlen): each 'z' stands for four bytes, so they
+ * are counted rather than assumed everywhere.
+ */
+size_t
+ascii85_decode_out_size(const char* in, size_t inlen);
+
+/*
+ * Skips blanks and line breaks, and a leading "<~". Stops at the first
+ * other character, at a group that overflows 32 bits, and after "~>"
+ * and the blanks behind it.
+ * A short last group of two to four characters is decoded as if padded
+ * with 'u' when final is non-zero, and left unconsumed otherwise so it
+ * can be completed by the next call.
+ * A 'z' yields four bytes, so out must not overlap in.
+ * inused receives the number of characters consumed.
+ * return values is out length
+ */
+size_t
+ascii85_decode(const char* in, size_t inlen, unsigned char* out, int final, size_t* inused);
+
+#endif /* ASCII85_H */
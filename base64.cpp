@@ -1,12 +1,27 @@
 ﻿/* This is a public domain base64 implementation written by WEI Zhicheng. */
 
-#include "stdafx.h"
 #include "base64.h"
 
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BASE64_SSSE3
+#include <tmmintrin.h>
+#include "cpu.h"
+#endif
+
 #define BASE64_PAD '='
 #define BASE64DE_FIRST '+'
 #define BASE64DE_LAST 'z'
 
+/* policy table classes above the 64 alphabet values */
+#define BASE64_PADDING 0xFD
+#define BASE64_SKIP    0xFE
+#define BASE64_INVALID 0xFF
+
+/* After a failed 16-character SIMD block, stay scalar for this many characters */
+#define BASE64_SCALAR_RUN 16
+
 /* BASE 64 encode table */
 static const char base64en[] = {
 	'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H',
@@ -70,18 +85,61 @@ static const unsigned char base64de[] = {
 															 49,  50,  51, 255, 255, 255, 255, 255
 };
 
-unsigned int
-base64_encode(const unsigned char* in, unsigned int inlen, char* out)
+#ifdef BASE64_SSSE3
+/*
+ * Encodes 12-byte blocks into 16 characters while 16 bytes can be read.
+ * Splits each 3 bytes into four 6-bit indices with two multiplies, then
+ * maps index ranges to ASCII offsets with one shuffle (W. Mula).
+ * return values is bytes consumed
+ */
+CPU_TARGET_SSSE3 static size_t
+base64_ssse3_encode(const unsigned char* in, size_t inlen, char* out)
+{
+	const __m128i spread = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+	const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'+' - 62, '/' - 63, 'A', 0, 0);
+	size_t i = 0;
+
+	for (; i + 16 <= inlen; i += 12, out += 16) {
+		const __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + i)), spread);
+		const __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi32(0x0FC0FC00)),
+			_mm_set1_epi32(0x04000040));
+		const __m128i t1 = _mm_mullo_epi16(_mm_and_si128(v, _mm_set1_epi32(0x003F03F0)),
+			_mm_set1_epi32(0x01000010));
+		const __m128i idx = _mm_or_si128(t0, t1);
+
+		/* 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, '+' -> 11, '/' -> 12 */
+		__m128i range = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+		range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), idx),
+			_mm_set1_epi8(13)));
+
+		_mm_storeu_si128((__m128i*)out, _mm_add_epi8(idx, _mm_shuffle_epi8(offsets, range)));
+	}
+
+	return i;
+}
+#endif
+
+size_t
+base64_encode64(const unsigned char* in, size_t inlen, char* out)
 {
 	int s;
-	unsigned int i;
-	unsigned int j;
+	size_t i;
+	size_t j;
 	unsigned char c;
 	unsigned char l;
 
 	s = 0;
 	l = 0;
-	for (i = j = 0; i < inlen; i++) {
+	i = j = 0;
+#ifdef BASE64_SSSE3
+	if (cpu_has_ssse3()) {
+		i = base64_ssse3_encode(in, inlen, out);
+		j = i / 3 * 4;
+	}
+#endif
+	for (; i < inlen; i++) {
 		c = in[i];
 
 		switch (s) {
@@ -119,11 +177,11 @@ base64_encode(const unsigned char* in, unsigned int inlen, char* out)
 	return j;
 }
 
-unsigned int
-base64_decode(const char* in, unsigned int inlen, unsigned char* out)
+size_t
+base64_decode64(const char* in, size_t inlen, unsigned char* out)
 {
-	unsigned int i;
-	unsigned int j;
+	size_t i;
+	size_t j;
 	unsigned char c;
 
 	if (inlen & 0x3) {
@@ -162,4 +220,221 @@ base64_decode(const char* in, unsigned int inlen, unsigned char* out)
 	}
 
 	return j;
-}
\ No newline at end of file
+}
+
+unsigned int
+base64_encode(const unsigned char* in, unsigned int inlen, char* out)
+{
+	return (unsigned int)base64_encode64(in, inlen, out);
+}
+
+unsigned int
+base64_decode(const char* in, unsigned int inlen, unsigned char* out)
+{
+	return (unsigned int)base64_decode64(in, inlen, out);
+}
+
+#ifdef BASE64_SSSE3
+/*
+ * Decodes 16-character blocks of the standard alphabet into 12 bytes each,
+ * up to the first block holding anything else (padding included). Nibble
+ * lookups validate the block and pick the ASCII offset of its range; two
+ * multiply-adds then pack the sextets (W. Mula).
+ * return values is characters consumed
+ */
+CPU_TARGET_SSSE3 static size_t
+base64_ssse3_decode(const char* in, size_t inlen, unsigned char* out)
+{
+	const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+		0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+		0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+		0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+	const __m128i nibble = _mm_set1_epi8(0x0F);
+	size_t i = 0;
+	int tail;
+
+	for (; i + 16 <= inlen; i += 16, out += 12) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+		const __m128i hi = _mm_and_si128(_mm_srli_epi32(v, 4), nibble);
+		const __m128i lo = _mm_and_si128(v, nibble);
+		const __m128i bad = _mm_and_si128(_mm_shuffle_epi8(lut_lo, lo), _mm_shuffle_epi8(lut_hi, hi));
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(bad, _mm_setzero_si128())) != 0xFFFF) {
+			break;
+		}
+
+		/* '/' shares its high nibble with '+' but needs its own offset */
+		const __m128i roll = _mm_shuffle_epi8(lut_roll,
+			_mm_add_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('/')), hi));
+		const __m128i sextets = _mm_add_epi8(v, roll);
+		const __m128i pairs = _mm_maddubs_epi16(sextets, _mm_set1_epi32(0x01400140));
+		const __m128i words = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+		const __m128i bytes = _mm_shuffle_epi8(words, pack);
+
+		/* 12 bytes, without touching the 4 after them; in place they land
+		   on characters already loaded, never on the next block */
+		_mm_storel_epi64((__m128i*)out, bytes);
+		tail = _mm_cvtsi128_si32(_mm_srli_si128(bytes, 8));
+		memcpy(out + 8, &tail, 4);
+	}
+
+	return i;
+}
+#endif
+
+/* alphabet value, or BASE64_PADDING / BASE64_SKIP / BASE64_INVALID under Policy */
+template <class Policy> struct base64_policy_de {
+	unsigned char table[256];
+
+	base64_policy_de()
+	{
+		int i;
+
+		for (i = 0; i < 256; i++) {
+			table[i] = (i >= BASE64DE_FIRST && i <= BASE64DE_LAST) ? base64de[i] : BASE64_INVALID;
+		}
+		if (Policy::urlsafe) {
+			table['+'] = BASE64_INVALID;
+			table['/'] = BASE64_INVALID;
+			table['-'] = 62;
+			table['_'] = 63;
+		}
+		table[BASE64_PAD] = BASE64_PADDING;
+		if (Policy::blanks) {
+			table[' '] = BASE64_SKIP;
+			table['\t'] = BASE64_SKIP;
+			table['\r'] = BASE64_SKIP;
+			table['\n'] = BASE64_SKIP;
+		}
+		if (Policy::skip_invalid) {
+			for (i = 0; i < 256; i++) {
+				if (table[i] == BASE64_INVALID) {
+					table[i] = BASE64_SKIP;
+				}
+			}
+		}
+	}
+};
+
+template <class Policy> static const unsigned char*
+base64_policy_table(void)
+{
+	static const base64_policy_de<Policy> de;
+	return de.table;
+}
+
+template <class Policy> size_t
+base64_decode_t(const char* in, size_t inlen, unsigned char* out, int final, size_t* inused)
+{
+	const unsigned char* de = base64_policy_table<Policy>();
+	const int skips = Policy::blanks || Policy::skip_invalid;
+	size_t i = 0;
+	size_t j = 0;
+	size_t done = 0;        /* characters up to the last whole quantum */
+	unsigned long acc = 0;
+	int n = 0;              /* characters of the current quantum */
+	unsigned char a, b, c, d;
+#ifdef BASE64_SSSE3
+	const int simd = !Policy::urlsafe && cpu_has_ssse3();
+	size_t scalar_until = 0;
+#endif
+
+	while (i < inlen) {
+		if (n == 0) {
+#ifdef BASE64_SSSE3
+			if (simd && i >= scalar_until) {
+				size_t k = base64_ssse3_decode(in + i, inlen - i, out + j);
+				i += k;
+				j += k / 4 * 3;
+				scalar_until = i + BASE64_SCALAR_RUN;
+			}
+#endif
+			for (; inlen - i >= 4; i += 4, j += 3) {
+				a = de[(unsigned char)in[i]];
+				b = de[(unsigned char)in[i + 1]];
+				c = de[(unsigned char)in[i + 2]];
+				d = de[(unsigned char)in[i + 3]];
+				if ((a | b | c | d) >= 64) {
+					break;
+				}
+				out[j] = (unsigned char)((a << 2) | (b >> 4));
+				out[j + 1] = (unsigned char)((b << 4) | (c >> 2));
+				out[j + 2] = (unsigned char)((c << 6) | d);
+			}
+			done = i;
+			if (i == inlen) {
+				break;
+			}
+		}
+
+		c = de[(unsigned char)in[i]];
+		if (c < 64) {
+			acc = (acc << 6) | c;
+			i++;
+			if (++n == 4) {
+				out[j++] = (unsigned char)(acc >> 16);
+				out[j++] = (unsigned char)(acc >> 8);
+				out[j++] = (unsigned char)acc;
+				acc = 0;
+				n = 0;
+				done = i;
+			}
+			continue;
+		}
+		if (skips && c == BASE64_SKIP) {
+			i++;
+			if (n == 0) {
+				done = i;
+			}
+			continue;
+		}
+		if (c == BASE64_PADDING && n >= 2) {
+			/* "xx==" or "xxx=": the quantum, and the data, end here */
+			size_t k = i;
+			int missing = 4 - n;
+			while (k < inlen && missing) {
+				c = de[(unsigned char)in[k]];
+				if (c == BASE64_PADDING) {
+					missing--;
+				}
+				else if (!skips || c != BASE64_SKIP) {
+					break;
+				}
+				k++;
+			}
+			if (missing == 0) {
+				while (skips && k < inlen && de[(unsigned char)in[k]] == BASE64_SKIP) {
+					k++;
+				}
+				out[j++] = (unsigned char)(acc >> (n * 6 - 8));
+				if (n == 3) {
+					out[j++] = (unsigned char)(acc >> 2);
+				}
+				done = k;
+			}
+			*inused = done;
+			return j;
+		}
+		break;
+	}
+
+	/* a short last quantum without its padding */
+	if (i == inlen && final && n >= 2 && Policy::padding == BASE64_PADDING_OPTIONAL) {
+		out[j++] = (unsigned char)(acc >> (n * 6 - 8));
+		if (n == 3) {
+			out[j++] = (unsigned char)(acc >> 2);
+		}
+		done = inlen;
+	}
+
+	*inused = done;
+	return j;
+}
+
+template size_t base64_decode_t<base64_policy_strict>(const char*, size_t, unsigned char*, int, size_t*);
+template size_t base64_decode_t<base64_policy_lines>(const char*, size_t, unsigned char*, int, size_t*);
+template size_t base64_decode_t<base64_policy_url>(const char*, size_t, unsigned char*, int, size_t*);
+template size_t base64_decode_t<base64_policy_filter>(const char*, size_t, unsigned char*, int, size_t*);
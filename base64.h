@@ -3,20 +3,90 @@
 #ifndef BASE64_H
 #define BASE64_H
 
+#include <stddef.h>
+#include <stdint.h>
+
+/* legacy sizes, only valid below 4 GB; see the 64 variants below */
 #define BASE64_ENCODE_OUT_SIZE(s) ((unsigned int)((((s) + 2) / 3) * 4 + 1))
 #define BASE64_DECODE_OUT_SIZE(s) ((unsigned int)(((s) / 4) * 3))
 
+/* largest input whose encoded size (with terminator) still fits in size_t */
+#define BASE64_ENCODE_MAX_IN ((SIZE_MAX - 1) / 4 * 3)
+
+/* encoded size including the terminating `\0', or 0 if it overflows size_t */
+#define BASE64_ENCODE_OUT_SIZE64(s) \
+	((size_t)(s) <= BASE64_ENCODE_MAX_IN ? (((size_t)(s) + 2) / 3) * 4 + 1 : 0)
+#define BASE64_DECODE_OUT_SIZE64(s) (((size_t)(s) / 4) * 3)
+
 /*
  * out is null-terminated encode string.
  * return values is out length, exclusive terminating `\0'
  */
-unsigned int
-base64_encode(const unsigned char* in, unsigned int inlen, char* out);
+size_t
+base64_encode64(const unsigned char* in, size_t inlen, char* out);
 
 /*
+ * out may be in.
  * return values is out length
  */
+size_t
+base64_decode64(const char* in, size_t inlen, unsigned char* out);
+
+/*
+ * 32-bit wrappers kept for existing callers
+ */
+unsigned int
+base64_encode(const unsigned char* in, unsigned int inlen, char* out);
+
 unsigned int
 base64_decode(const char* in, unsigned int inlen, unsigned char* out);
 
+#ifdef __cplusplus
+/*
+ * Policies for base64_decode_t. Each fixes one text convention at compile
+ * time, so the decode loop only carries the checks that convention needs:
+ *   blanks        skip ' ', '\t', '\r' and '\n'
+ *   urlsafe       '-' and '_' stand for '+' and '/' (RFC 4648 section 5)
+ *   padding       BASE64_PADDING_REQUIRED or BASE64_PADDING_OPTIONAL
+ *   skip_invalid  drop every character outside the alphabet instead of
+ *                 stopping there
+ */
+#define BASE64_PADDING_REQUIRED 0   /* a short last quantum needs its '=' */
+#define BASE64_PADDING_OPTIONAL 1   /* at the end, "QQ" decodes like "QQ==" */
+
+/* one unbroken, padded string */
+struct base64_policy_strict {
+	enum { blanks = 0, urlsafe = 0, padding = BASE64_PADDING_REQUIRED, skip_invalid = 0 };
+};
+
+/* MIME / PEM bodies: padded, wrapped into lines */
+struct base64_policy_lines {
+	enum { blanks = 1, urlsafe = 0, padding = BASE64_PADDING_REQUIRED, skip_invalid = 0 };
+};
+
+/* URL and file name safe alphabet, as used by JWTs, padding optional */
+struct base64_policy_url {
+	enum { blanks = 0, urlsafe = 1, padding = BASE64_PADDING_OPTIONAL, skip_invalid = 0 };
+};
+
+/* every base64 character in the text, anything else dropped */
+struct base64_policy_filter {
+	enum { blanks = 1, urlsafe = 0, padding = BASE64_PADDING_OPTIONAL, skip_invalid = 1 };
+};
+
+/*
+ * Decodes base64 text following Policy; instantiated in base64.cpp for the
+ * policies above. Stops at the first character the policy rejects, and
+ * after padding. Unless final is non-zero, an incomplete quantum at the
+ * end of the input is left unconsumed so it can be completed by the next
+ * call.
+ * out may be in: bytes are only written over characters already read,
+ * SIMD blocks included, and in[inused..inlen) is left as it was.
+ * inused receives the number of characters consumed.
+ * return values is out length
+ */
+template <class Policy> size_t
+base64_decode_t(const char* in, size_t inlen, unsigned char* out, int final, size_t* inused);
+#endif
+
 #endif /* BASE64_H */
\ No newline at end of file
@@ -0,0 +1,118 @@
+/*
+ * bufpool_bench.cpp : bufpool against malloc/free on repeated large buffers
+ *
+ * Built by CMakeLists.txt, or on its own from this directory:
+ *   g++ -O2 -I.. bufpool_bench.cpp ../bufpool.cpp -o bufpool_bench -lpthread
+ *   ./bufpool_bench [rounds]
+ *
+ * Every round allocates a buffer, fills it the way a decode fills its
+ * scratch space, and frees it again, as back-to-back plugin commands do.
+ * The pool gives the same pages back.  malloc maps large requests afresh
+ * and faults their pages in on every round, except where the C library
+ * keeps freed blocks around itself (glibc does so up to 32 MB once one
+ * has been freed).  The mixed rows cycle through the sizes of one decode:
+ * text chunk, output and carry.
+ */
+
+#include "bufpool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct workload {
+	const char* name;
+	size_t sizes[4];    /* allocated in turn, 0 ends the list */
+} workload;
+
+static const workload workloads[] = {
+	{ "64 KB",                { 64 << 10 } },
+	{ "1 MB",                 { 1 << 20 } },
+	{ "4 MB",                 { 4 << 20 } },
+	{ "16 MB",                { 16 << 20 } },
+	{ "64 MB",                { 64 << 20 } },
+	{ "mixed 1 MB / 512 KB",  { 1 << 20, 512 << 10, (1 << 20) + 4 } },
+	{ "mixed 16 MB / 8 MB",   { 16 << 20, 8 << 20, 64 << 10 } },
+};
+
+static double
+seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static size_t
+workload_count(const workload* w)
+{
+	size_t n = 0;
+
+	while (n < sizeof(w->sizes) / sizeof(w->sizes[0]) && w->sizes[n]) {
+		n++;
+	}
+	return n;
+}
+
+/* returns the seconds taken, or -1 if an allocation failed */
+static double
+run(const workload* w, int rounds, int pooled, unsigned long long* bytes)
+{
+	size_t n = workload_count(w);
+
+	*bytes = 0;
+	double t0 = seconds();
+	for (int r = 0; r < rounds; r++) {
+		size_t size = w->sizes[r % n];
+		unsigned char* p = (unsigned char*)(pooled ? bufpool_alloc(size) : malloc(size));
+		if (!p) {
+			return -1;
+		}
+		memset(p, r, size);
+		/* keeps the fill from being optimized away */
+		*bytes += p[size - 1] == (unsigned char)r ? size : 0;
+		if (pooled) {
+			bufpool_free(p);
+		}
+		else {
+			free(p);
+		}
+	}
+	return seconds() - t0;
+}
+
+int
+main(int argc, char** argv)
+{
+	int rounds = argc > 1 ? atoi(argv[1]) : 100;
+
+	if (rounds <= 0) {
+		return 1;
+	}
+	printf("%d rounds of alloc, fill, free per workload\n\n", rounds);
+	printf("%-22s %10s %10s %10s %10s %8s\n", "", "malloc ms", "MB/s", "pool ms", "MB/s",
+		"pool hits");
+
+	for (size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++) {
+		const workload* w = &workloads[i];
+		unsigned long long bytes0, bytes1;
+		bufpool_stats before, after;
+
+		double t0 = run(w, rounds, 0, &bytes0);
+		bufpool_get_stats(&before);
+		double t1 = run(w, rounds, 1, &bytes1);
+		bufpool_get_stats(&after);
+		bufpool_trim(1);
+
+		if (t0 < 0 || t1 < 0) {
+			printf("%-22s out of memory\n", w->name);
+			continue;
+		}
+		printf("%-22s %10.1f %10.0f %10.1f %10.0f %8llu%s\n", w->name,
+			t0 * 1e3, bytes0 / t0 / 1e6, t1 * 1e3, bytes1 / t1 / 1e6,
+			after.hits - before.hits, bytes0 == bytes1 ? "" : "  MISMATCH");
+	}
+	return 0;
+}
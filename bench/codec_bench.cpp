@@ -0,0 +1,366 @@
+/*
+ * codec_bench.cpp : throughput of the codec core through its C API, and
+ * the training run for profile-guided builds (see CMakeLists.txt)
+ *
+ *   codec_bench [-m megabytes] [file...]
+ *
+ * Without files it decodes a generated corpus in the layouts the plugin
+ * sees most: hex as pasted from debuggers and C sources, wrapped base64
+ * from mail and PEM, xxd dumps, Ascii85, bit strings. Files are sniffed and decoded as
+ * well, so a profile can be trained on real clipboard captures.
+ */
+
+#include "codec.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct text {
+	char* p;
+	size_t n;
+	size_t cap;
+} text;
+
+static void
+put(text* t, const char* s, size_t n)
+{
+	if (t->n + n > t->cap) {
+		t->cap = (t->n + n) * 2;
+		t->p = (char*)realloc(t->p, t->cap);
+		if (!t->p) {
+			exit(1);
+		}
+	}
+	memcpy(t->p + t->n, s, n);
+	t->n += n;
+}
+
+static void
+puts_(text* t, const char* s)
+{
+	put(t, s, strlen(s));
+}
+
+/* half text-like bytes, half random, as in real captures */
+static void
+fill_bytes(unsigned char* b, size_t n)
+{
+	static const char words[] = "The quick brown fox jumps over the lazy dog. ";
+	for (size_t i = 0; i < n; i++) {
+		b[i] = ((i / 4096) & 1) ? (unsigned char)rand() : (unsigned char)words[i % (sizeof(words) - 1)];
+	}
+}
+
+static const char hexdigits[] = "0123456789abcdef";
+
+/* hex with sep between bytes and a line break after every line bytes */
+static void
+layout_hex(text* t, const unsigned char* b, size_t n, const char* prefix,
+	const char* sep, size_t line, const char* eol)
+{
+	for (size_t i = 0; i < n; i++) {
+		char d[2] = { hexdigits[b[i] >> 4], hexdigits[b[i] & 15] };
+		if (i && line && i % line == 0) {
+			puts_(t, eol);
+		}
+		else if (i) {
+			puts_(t, sep);
+		}
+		puts_(t, prefix);
+		put(t, d, 2);
+	}
+}
+
+static void
+layout_base64(text* t, const unsigned char* b, size_t n, size_t width,
+	const char* eol, int url)
+{
+	char* s = (char*)malloc(codec_encode_bound(CODEC_BASE64, n));
+	size_t len = codec_encode(CODEC_BASE64, b, n, s);
+
+	if (url) {
+		for (size_t i = 0; i < len; i++) {
+			s[i] = (s[i] == '+') ? '-' : (s[i] == '/') ? '_' : s[i];
+		}
+		while (len && s[len - 1] == '=') {
+			len--;
+		}
+	}
+	for (size_t i = 0; i < len; i += width ? width : len) {
+		size_t k = (width && len - i > width) ? width : len - i;
+		put(t, s + i, k);
+		puts_(t, eol);
+	}
+	free(s);
+}
+
+static void
+layout_xxd(text* t, const unsigned char* b, size_t n)
+{
+	char line[96];
+
+	for (size_t i = 0; i < n; i += 16) {
+		int k = sprintf(line, "%08zx:", i);
+		for (size_t j = 0; j < 16; j++) {
+			if ((j & 1) == 0) {
+				line[k++] = ' ';
+			}
+			if (i + j < n) {
+				line[k++] = hexdigits[b[i + j] >> 4];
+				line[k++] = hexdigits[b[i + j] & 15];
+			}
+			else {
+				line[k++] = ' ';
+				line[k++] = ' ';
+			}
+		}
+		line[k++] = ' ';
+		line[k++] = ' ';
+		for (size_t j = 0; j < 16 && i + j < n; j++) {
+			line[k++] = (b[i + j] >= 0x20 && b[i + j] < 0x7f) ? (char)b[i + j] : '.';
+		}
+		line[k++] = '\n';
+		put(t, line, k);
+	}
+}
+
+static void
+layout_ascii85(text* t, const unsigned char* b, size_t n)
+{
+	puts_(t, "<~");
+	for (size_t i = 0; i < n; i += 4) {
+		size_t k = (n - i < 4) ? n - i : 4;
+		unsigned long v = 0;
+		char g[5];
+		for (size_t j = 0; j < 4; j++) {
+			v = v << 8 | (j < k ? b[i + j] : 0);
+		}
+		if (v == 0 && k == 4) {
+			puts_(t, "z");
+			continue;
+		}
+		for (int j = 4; j >= 0; j--) {
+			g[j] = (char)('!' + v % 85);
+			v /= 85;
+		}
+		put(t, g, k + 1);
+		if (i % 64 == 60) {
+			puts_(t, "\n");
+		}
+	}
+	puts_(t, "~>");
+}
+
+/* eight '0' / '1' per byte, sep between bytes and eol after every line */
+static void
+layout_bits(text* t, const unsigned char* b, size_t n, const char* sep,
+	size_t line, int lsb)
+{
+	for (size_t i = 0; i < n; i++) {
+		char d[8];
+		for (int k = 0; k < 8; k++) {
+			d[k] = (char)('0' + ((b[i] >> (lsb ? k : 7 - k)) & 1));
+		}
+		if (i && line && i % line == 0) {
+			puts_(t, "\n");
+		}
+		else if (i) {
+			puts_(t, sep);
+		}
+		put(t, d, 8);
+	}
+}
+
+static double
+seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* 1 MB steps, as the plugin's decode jobs */
+#define STEP (1024 * 1024)
+
+/* what a decoder may leave for the next step, as in the plugin */
+#define CARRY 256
+
+/* return values is MB/s of text, 0 if the decoder stopped early */
+static double
+run(int codec, const char* in, size_t inlen, unsigned char* out, size_t* outlen)
+{
+	double best = 1e30;
+
+	for (int r = 0; r < 3; r++) {
+		double t0 = seconds();
+		size_t pos = 0;
+		size_t n = 0;
+		while (pos < inlen) {
+			size_t step = (inlen - pos < STEP) ? inlen - pos : STEP;
+			size_t used = 0;
+			n += codec_decode(codec, in + pos, step, out + n, pos + step == inlen, &used);
+			if (used == 0) {
+				break;
+			}
+			pos += used;
+			/* only a pair or quantum cut by the step is finished by the
+			 * next one; padding ends the data */
+			if (used < step && (in[pos - 1] == '=' || step - used > CARRY)) {
+				break;
+			}
+		}
+		double t = seconds() - t0;
+		if (t < best) {
+			best = t;
+		}
+		*outlen = n;
+		if (pos != inlen) {
+			return 0;
+		}
+	}
+	return inlen / best / 1e6;
+}
+
+static void
+report(const char* name, int codec, const text* t, const unsigned char* want, size_t wantlen)
+{
+	size_t bound = codec_decode_bound(codec, t->p, t->n);
+	unsigned char* out = (unsigned char*)malloc(bound ? bound : 1);
+	size_t n = 0;
+	double v = run(codec, t->p, t->n, out, &n);
+	int sniffed = codec_sniff(t->p, t->n);
+
+	printf("%-34s %2d %2d %9.0f %s\n", name, codec, sniffed, v,
+		!v ? "stopped" : (want && (n != wantlen || memcmp(out, want, n))) ? "MISMATCH" : "");
+	free(out);
+}
+
+int
+main(int argc, char** argv)
+{
+	size_t size = 16 << 20;
+	int files = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+			size = (size_t)atoi(argv[++i]) << 20;
+		}
+		else {
+			files = 1;
+		}
+	}
+
+	printf("codec %u; MB/s of text\n\n", codec_version());
+	printf("%-34s %2s %2s %9s\n", "", "id", "sn", "decode");
+
+	if (!files) {
+		unsigned char* b = (unsigned char*)malloc(size);
+		fill_bytes(b, size);
+
+		struct {
+			const char* name;
+			int codec;
+			int kind;
+		} corpus[] = {
+			{ "hex, digits only",              CODEC_HEX_STRICT,    0 },
+			{ "hex, 16 spaced per line",       CODEC_HEX,           1 },
+			{ "hex, colon separated",          CODEC_HEX_SEPARATED, 2 },
+			{ "hex, C array (0x4d, ...)",      CODEC_HEX_PREFIXED,  3 },
+			{ "base64, one line",              CODEC_BASE64,        4 },
+			{ "base64, 76 columns CRLF",       CODEC_BASE64_LINES,  5 },
+			{ "base64, 64 columns LF (PEM)",   CODEC_BASE64_LINES,  6 },
+			{ "base64url, no padding",         CODEC_BASE64_URL,    7 },
+			{ "xxd",                           CODEC_HEXDUMP,       8 },
+			{ "Ascii85",                       CODEC_ASCII85,       9 },
+			{ "bits, 8 spaced bytes per line", CODEC_BITS_MSB,      10 },
+			{ "bits, unbroken, LSB first",     CODEC_BITS_LSB,      11 },
+		};
+
+		for (size_t i = 0; i < sizeof(corpus) / sizeof(corpus[0]); i++) {
+			text t = { 0, 0, 0 };
+			switch (corpus[i].kind) {
+			case 0: layout_hex(&t, b, size, "", "", 0, ""); break;
+			case 1: layout_hex(&t, b, size, "", " ", 16, "\r\n"); break;
+			case 2: layout_hex(&t, b, size, "", ":", 0, ""); break;
+			case 3: layout_hex(&t, b, size, "0x", ", ", 12, ",\n"); break;
+			case 4: layout_base64(&t, b, size, 0, "", 0); break;
+			case 5: layout_base64(&t, b, size, 76, "\r\n", 0); break;
+			case 6: layout_base64(&t, b, size, 64, "\n", 0); break;
+			case 7: layout_base64(&t, b, size, 0, "", 1); break;
+			case 8: layout_xxd(&t, b, size); break;
+			case 9: layout_ascii85(&t, b, size); break;
+			case 10: layout_bits(&t, b, size, " ", 8, 0); break;
+			case 11: layout_bits(&t, b, size, "", 0, 1); break;
+			}
+			report(corpus[i].name, corpus[i].codec, &t, b, size);
+
+			/* the lenient policies on the same text, for what their
+			 * tolerance costs over the strict kernel */
+			if (corpus[i].kind == 0) {
+				report("  as hex with blanks", CODEC_HEX, &t, b, size);
+				report("  as hex, filtered", CODEC_HEX_FILTER, &t, b, size);
+			}
+			if (corpus[i].kind == 4) {
+				report("  as base64, filtered", CODEC_BASE64_FILTER, &t, b, size);
+			}
+
+			/* the blanks-only pre-stage on the same text */
+			if (corpus[i].kind == 1 || corpus[i].kind == 5) {
+				double t0 = seconds();
+				codec_compact(t.p, t.n, t.p);
+				printf("%-34s %2s %2s %9.0f\n", "  compact", "", "", t.n / (seconds() - t0) / 1e6);
+			}
+			free(t.p);
+		}
+
+		/* a padded string longer than a step, then more base64: the
+		 * decoder must stop at the padding rather than go on with the
+		 * next string in the following step */
+		{
+			text t = { 0, 0, 0 };
+			size_t half = size / 2 - size / 2 % 3 + 1;
+			size_t n = 0;
+			layout_base64(&t, b, half, 0, "", 0);
+			layout_base64(&t, b + half, size - half, 0, "", 0);
+			unsigned char* out = (unsigned char*)malloc(codec_decode_bound(CODEC_BASE64, t.p, t.n));
+			run(CODEC_BASE64, t.p, t.n, out, &n);
+			printf("%-34s %2d %2s %9s %s\n", "base64, text after padding", CODEC_BASE64, "", "",
+				n == half && memcmp(out, b, n) == 0 ? "stops at the padding" : "DECODED PAST THE PADDING");
+			free(out);
+			free(t.p);
+		}
+		free(b);
+	}
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-m") == 0) {
+			i++;
+			continue;
+		}
+		FILE* f = fopen(argv[i], "rb");
+		text t = { 0, 0, 0 };
+		char buf[65536];
+		size_t k;
+		if (!f) {
+			printf("%-34s cannot be read\n", argv[i]);
+			continue;
+		}
+		while ((k = fread(buf, 1, sizeof(buf), f)) > 0) {
+			put(&t, buf, k);
+		}
+		fclose(f);
+		int codec = codec_sniff(t.p, t.n);
+		if (codec) {
+			report(argv[i], codec, &t, NULL, 0);
+		}
+		else {
+			printf("%-34s not recognised\n", argv[i]);
+		}
+		free(t.p);
+	}
+
+	return 0;
+}
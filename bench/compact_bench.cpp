@@ -0,0 +1,148 @@
+/*
+ * compact_bench.cpp : throughput of compact_text on wrapped text
+ *
+ * Built by CMakeLists.txt, or on its own from this directory:
+ *   g++ -O2 -I.. compact_bench.cpp ../compact.cpp ../cpu.cpp -o compact_bench
+ *   ./compact_bench [megabytes]
+ *
+ * Each layout is compacted with compact_text, with the one-character-
+ * at-a-time loop it replaces (as IsSkipChar), and copied with memcpy as
+ * the ceiling.
+ */
+
+#include "compact.h"
+#include "cpu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct layout {
+	const char* name;
+	int group;          /* digits between separators */
+	const char* sep;    /* separator after each group */
+	int line;           /* groups per line, 0 for one line */
+} layout;
+
+static const layout layouts[] = {
+	{ "hex, no separators",       2,  "",     0  },
+	{ "hex, 32 per line",         32, "",     1  },
+	{ "hex \"DE AD BE EF\"",      2,  " ",    16 },
+	{ "base64, 76 per line",      76, "",     1  },
+	{ "base64, 64 per line (PEM)", 64, "",    1  },
+};
+
+static const char digits[] = "0123456789ABCDEFghijklmnopqrstuvwxyz+/";
+
+static size_t
+fill(const layout* l, char* text, size_t size)
+{
+	size_t n = 0;
+	int groups = 0;
+
+	while (n + l->group + 4 <= size) {
+		for (int i = 0; i < l->group; i++) {
+			text[n++] = digits[rand() % (sizeof(digits) - 1)];
+		}
+		memcpy(text + n, l->sep, strlen(l->sep));
+		n += strlen(l->sep);
+		if (l->line && ++groups == l->line) {
+			if (n && text[n - 1] == ' ') {
+				n--;
+			}
+			text[n++] = '\r';
+			text[n++] = '\n';
+			groups = 0;
+		}
+	}
+	return n;
+}
+
+static size_t
+compact_scalar(const char* in, size_t inlen, char* out)
+{
+	size_t j = 0;
+
+	for (size_t i = 0; i < inlen; i++) {
+		char c = in[i];
+		if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+			continue;
+		}
+		out[j++] = c;
+	}
+	return j;
+}
+
+static double
+seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* 64 KB steps, as DecodeCompacted feeds the kernels */
+#define STEP (64 * 1024)
+
+static double
+run(int which, const compact_set* set, const char* text, size_t n, char* out, int reps, size_t* kept)
+{
+	double best = 1e30;
+
+	for (int r = 0; r < reps; r++) {
+		double t0 = seconds();
+		size_t total = 0;
+		for (size_t pos = 0; pos < n; pos += STEP) {
+			size_t step = (n - pos < STEP) ? n - pos : STEP;
+			if (which == 0) {
+				total += compact_text(set, text + pos, step, out);
+			}
+			else if (which == 1) {
+				total += compact_scalar(text + pos, step, out);
+			}
+			else {
+				memcpy(out, text + pos, step);
+				total += step;
+			}
+		}
+		double t = seconds() - t0;
+		if (t < best) {
+			best = t;
+		}
+		*kept = total;
+	}
+	return n / best / 1e6;
+}
+
+int
+main(int argc, char** argv)
+{
+	size_t size = (size_t)(argc > 1 ? atoi(argv[1]) : 64) << 20;
+	char* text = (char*)malloc(size);
+	char* out = (char*)malloc(STEP);
+	compact_set set;
+
+	if (!text || !out) {
+		return 1;
+	}
+	compact_set_init(&set, COMPACT_BLANKS);
+	printf("SSSE3: %s, %zu MB per pass, MB/s of input\n\n",
+		cpu_has_ssse3() ? "yes" : "no", size >> 20);
+	printf("%-28s %10s %10s %10s\n", "", "compact", "scalar", "memcpy");
+
+	for (size_t i = 0; i < sizeof(layouts) / sizeof(layouts[0]); i++) {
+		size_t n = fill(&layouts[i], text, size);
+		size_t k0, k1, k2;
+		double v0 = run(0, &set, text, n, out, 5, &k0);
+		double v1 = run(1, &set, text, n, out, 5, &k1);
+		double v2 = run(2, &set, text, n, out, 5, &k2);
+		printf("%-28s %10.0f %10.0f %10.0f%s\n", layouts[i].name, v0, v1, v2,
+			k0 == k1 ? "" : "  MISMATCH");
+	}
+
+	free(text);
+	free(out);
+	return 0;
+}
@@ -0,0 +1,235 @@
+/*
+ * writer_bench.cpp : host calls and time saved by editbuf on small edits
+ *
+ * Built by CMakeLists.txt, or on its own from this directory:
+ *   g++ -O2 -I.. writer_bench.cpp ../editbuf.cpp -o writer_bench
+ *   ./writer_bench [buffer KB] [microseconds per call]
+ *
+ * The host is a stand-in for the document: every call moves the bytes
+ * behind the edit, keeps an undo record with a copy of what it wrote, and
+ * then spins for the given time (2 us unless told otherwise) in place of
+ * what Hex Workshop does per edit besides that - undo bookkeeping,
+ * marking the view dirty, notifying other windows.  Each workload is run
+ * with a host call per edit and through an editbuf, and both documents
+ * are compared at the end.
+ */
+
+#include "editbuf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct undo {
+	struct undo* next;
+	unsigned long long offset;
+	size_t len;
+	/* the bytes follow */
+} undo;
+
+typedef struct host {
+	unsigned char* data;
+	size_t size;
+	size_t cap;
+	undo* undos;         /* newest first */
+	unsigned long long calls;
+} host;
+
+static double call_cost;    /* seconds each call spins for */
+
+static double seconds(void);
+
+static int
+host_call(void* ctx, int op, unsigned long long offset, const unsigned char* data, size_t len)
+{
+	host* h = (host*)ctx;
+	size_t at = (size_t)offset;
+
+	h->calls++;
+	if (op == EDITBUF_INSERT) {
+		if (at > h->size) {
+			return 0;
+		}
+		if (h->size + len > h->cap) {
+			size_t cap = h->cap ? h->cap : 4096;
+			while (cap < h->size + len) {
+				cap *= 2;
+			}
+			unsigned char* p = (unsigned char*)realloc(h->data, cap);
+			if (!p) {
+				return 0;
+			}
+			h->data = p;
+			h->cap = cap;
+		}
+		memmove(h->data + at + len, h->data + at, h->size - at);
+		h->size += len;
+	}
+	else if (at + len > h->size) {
+		return 0;
+	}
+	memcpy(h->data + at, data, len);
+
+	undo* u = (undo*)malloc(sizeof(undo) + len);
+	if (!u) {
+		return 0;
+	}
+	u->next = h->undos;
+	u->offset = offset;
+	u->len = len;
+	memcpy(u + 1, data, len);
+	h->undos = u;
+
+	for (double t0 = seconds(); seconds() - t0 < call_cost; ) {
+	}
+	return 1;
+}
+
+static void
+host_free(host* h)
+{
+	while (h->undos) {
+		undo* u = h->undos;
+		h->undos = u->next;
+		free(u);
+	}
+	free(h->data);
+	memset(h, 0, sizeof(*h));
+}
+
+static double
+seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#define SOURCE (1 << 20)
+
+typedef struct workload {
+	const char* name;
+	int op;
+	size_t edits;
+	size_t min_len;     /* edit lengths run from min_len to max_len */
+	size_t max_len;
+	size_t gap;         /* bytes skipped between writes */
+} workload;
+
+static const workload workloads[] = {
+	{ "decoded runs, 16-256 B",     EDITBUF_INSERT, 200000, 16, 256, 0   },
+	{ "chain chunks, 1-64 KB",      EDITBUF_INSERT, 2000,   1024, 65536, 0 },
+	{ "in-place writes, 48 B",      EDITBUF_WRITE,  500000, 48, 48,   0   },
+	{ "scattered writes, 48 B",     EDITBUF_WRITE,  200000, 48, 48,   16  },
+};
+
+static size_t
+edit_len(const workload* w, size_t i)
+{
+	if (w->max_len == w->min_len) {
+		return w->min_len;
+	}
+	return w->min_len + (i * 2654435761u) % (w->max_len - w->min_len + 1);
+}
+
+/* fills the document the writes go to; inserts start from nothing */
+static int
+prepare(const workload* w, host* h)
+{
+	size_t size = 0;
+
+	if (w->op == EDITBUF_INSERT) {
+		return 1;
+	}
+	for (size_t i = 0; i < w->edits; i++) {
+		size += edit_len(w, i) + w->gap;
+	}
+	h->data = (unsigned char*)calloc(size, 1);
+	h->size = h->cap = size;
+	return h->data != NULL;
+}
+
+static double
+run(const workload* w, const unsigned char* source, size_t cap, host* h, editbuf_stats* stats)
+{
+	editbuf eb;
+	unsigned long long offset = 0;
+
+	memset(stats, 0, sizeof(*stats));
+	if (!prepare(w, h)) {
+		return -1;
+	}
+	if (cap && !editbuf_init(&eb, cap, host_call, h)) {
+		return -1;
+	}
+
+	double t0 = seconds();
+	for (size_t i = 0; i < w->edits; i++) {
+		size_t len = edit_len(w, i);
+		const unsigned char* data = source + (i * 4099) % (SOURCE - len);
+		int ok;
+		if (!cap) {
+			ok = host_call(h, w->op, offset, data, len);
+		}
+		else if (w->op == EDITBUF_INSERT) {
+			ok = editbuf_insert(&eb, offset, data, len);
+		}
+		else {
+			ok = editbuf_write(&eb, offset, data, len);
+		}
+		if (!ok) {
+			return -1;
+		}
+		offset += len + w->gap;
+	}
+	if (cap) {
+		if (!editbuf_flush(&eb)) {
+			return -1;
+		}
+		*stats = eb.stats;
+		editbuf_free(&eb);
+	}
+	return seconds() - t0;
+}
+
+int
+main(int argc, char** argv)
+{
+	size_t cap = (size_t)(argc > 1 ? atoi(argv[1]) : 4096) << 10;
+	call_cost = (argc > 2 ? atof(argv[2]) : 2) * 1e-6;
+	unsigned char* source = (unsigned char*)malloc(SOURCE);
+
+	if (!source || cap == 0) {
+		return 1;
+	}
+	for (size_t i = 0; i < SOURCE; i++) {
+		source[i] = (unsigned char)rand();
+	}
+	printf("editbuf of %zu KB against a call per edit, %.1f us per call\n\n",
+		cap >> 10, call_cost * 1e6);
+	printf("%-26s %9s %11s %11s %9s %9s\n", "", "edits", "host calls", "with buffer",
+		"ms", "buffer ms");
+
+	for (size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++) {
+		const workload* w = &workloads[i];
+		host direct, buffered;
+		editbuf_stats stats;
+
+		memset(&direct, 0, sizeof(direct));
+		memset(&buffered, 0, sizeof(buffered));
+		double t0 = run(w, source, 0, &direct, &stats);
+		double t1 = run(w, source, cap, &buffered, &stats);
+		int same = t0 >= 0 && t1 >= 0 && direct.size == buffered.size &&
+			memcmp(direct.data, buffered.data, direct.size) == 0;
+
+		printf("%-26s %9zu %11llu %11llu %9.1f %9.1f%s\n", w->name, w->edits,
+			direct.calls, stats.host_calls, t0 * 1e3, t1 * 1e3, same ? "" : "  MISMATCH");
+		host_free(&direct);
+		host_free(&buffered);
+	}
+
+	free(source);
+	return 0;
+}
@@ -0,0 +1,156 @@
+#include "bitstr.h"
+
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BITSTR_SSE2
+#include <emmintrin.h>
+#endif
+
+/* spreads byte k of a 0/1 vector to bit 7 - k (MSB first) or bit k */
+#define BITSTR_MUL_MSB 0x8040201008040201ULL
+#define BITSTR_MUL_LSB 0x0102040810204080ULL
+
+static int
+bitstr_is_separator(unsigned char c)
+{
+	/* '0' and '1' are above ' ', so bits are told apart in two tests */
+	return c <= ' ' ? (c == ' ' || c == '\t' || c == '\r' || c == '\n') : c == '_';
+}
+
+static unsigned long long
+bitstr_load8(const char* p)
+{
+	unsigned long long v;
+
+	memcpy(&v, p, sizeof(v));	/* little-endian: first character in the low byte */
+	return v;
+}
+
+/*
+ * the byte spelled by the 8 characters of x.
+ * return values is -1 unless they are all '0' or '1'
+ */
+static int
+bitstr_pack8(unsigned long long x, int lsb)
+{
+	x ^= 0x3030303030303030ULL;
+	if (x & 0xFEFEFEFEFEFEFEFEULL) {
+		return -1;
+	}
+	/* the partial products land on distinct bits, so nothing carries into
+	 * the top byte */
+	return (int)((x * (lsb ? BITSTR_MUL_LSB : BITSTR_MUL_MSB)) >> 56);
+}
+
+#ifdef BITSTR_SSE2
+/*
+ * packs unbroken runs of 16 bits into two bytes each.
+ * return values is the bytes written; *pos is moved past their bits
+ */
+static size_t
+bitstr_pack16_sse2(const char* in, size_t inlen, size_t* pos, unsigned char* out, int lsb)
+{
+	const __m128i zero = _mm_set1_epi8('0');
+	const __m128i high = _mm_set1_epi8((char)0xFE);
+	size_t i = *pos;
+	size_t j = 0;
+
+	while (i + 16 <= inlen) {
+		__m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(in + i)), zero);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(v, high), _mm_setzero_si128())) != 0xFFFF) {
+			break;
+		}
+		if (!lsb) {
+			/* reverse each group of eight, so its first character ends up
+			 * in the top bit of the mask byte */
+			v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+			v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+			v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		}
+		/* bit 0 of every byte to its sign bit; bytes are 0 or 1, so
+		 * nothing crosses into the next byte */
+		unsigned int m = (unsigned int)_mm_movemask_epi8(_mm_slli_epi16(v, 7));
+		out[j] = (unsigned char)m;
+		out[j + 1] = (unsigned char)(m >> 8);
+		i += 16;
+		j += 2;
+	}
+	*pos = i;
+	return j;
+}
+#endif
+
+static size_t
+bitstr_decode(const char* in, size_t inlen, unsigned char* out, size_t* inused, int lsb)
+{
+	size_t i = 0;
+	size_t j = 0;
+
+	for (;;) {
+		while (i < inlen && bitstr_is_separator((unsigned char)in[i])) {
+			i++;
+		}
+
+		if (i + 8 <= inlen) {
+			int b = bitstr_pack8(bitstr_load8(in + i), lsb);
+			if (b >= 0) {
+				out[j++] = (unsigned char)b;
+				i += 8;
+				/* "01001000 01101001": one separator before each byte */
+				while (i + 9 <= inlen && bitstr_is_separator((unsigned char)in[i]) &&
+				    (b = bitstr_pack8(bitstr_load8(in + i + 1), lsb)) >= 0) {
+					out[j++] = (unsigned char)b;
+					i += 9;
+				}
+#ifdef BITSTR_SSE2
+				/* spaced bytes would fail every 16-character test, so
+				 * only runs that go on past a byte get one */
+				if (i < inlen && (in[i] == '0' || in[i] == '1')) {
+					j += bitstr_pack16_sse2(in, inlen, &i, out + j, lsb);
+				}
+#endif
+				continue;
+			}
+		}
+
+		/* a byte broken up by separators, the end of the input, or a
+		 * character that stops decoding */
+		unsigned int v = 0;
+		int n = 0;
+		size_t k = i;
+		while (k < inlen && n < 8) {
+			unsigned char c = (unsigned char)in[k];
+			if (c == '0' || c == '1') {
+				v = lsb ? v | ((unsigned int)(c - '0') << n) : (v << 1) | (c - '0');
+				n++;
+			}
+			else if (!bitstr_is_separator(c)) {
+				break;
+			}
+			k++;
+		}
+		if (n < 8) {
+			break;
+		}
+		out[j++] = (unsigned char)v;
+		i = k;
+	}
+
+	*inused = i;
+	return j;
+}
+
+size_t
+bitstr_decode_msb(const char* in, size_t inlen, unsigned char* out, int final, size_t* inused)
+{
+	(void)final;
+	return bitstr_decode(in, inlen, out, inused, 0);
+}
+
+size_t
+bitstr_decode_lsb(const char* in, size_t inlen, unsigned char* out, int final, size_t* inused)
+{
+	(void)final;
+	return bitstr_decode(in, inlen, out, inused, 1);
+}
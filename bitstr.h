@@ -0,0 +1,38 @@
+#pragma once
+
+#ifndef BITSTR_H
+#define BITSTR_H
+
+#include <stddef.h>
+
+/*
+ * Bit strings as protocol specs write them: "01001000 01101001",
+ * "0100_1000", or one unbroken run of '0' and '1'. Eight characters make
+ * a byte; blanks, line breaks and '_' may stand anywhere between them.
+ *
+ * Bytes whose eight characters are unbroken are packed without a loop
+ * over their bits: one multiply per byte, and longer runs 16 bits at a
+ * time with a compare and movemask under SSE2.
+ */
+
+#define BITSTR_DECODE_OUT_SIZE(s) ((s) / 8)
+
+/*
+ * Decodes the first character of each group of eight into the most
+ * significant bit of its byte ("01001000" is 0x48), or into the least
+ * significant bit (bitstr_decode_lsb: "00010010" is 0x48).
+ * Stops at the first character that is neither a bit nor a separator. A
+ * byte with fewer than eight bits before that point, or before the end of
+ * the input, is never consumed, so it can be completed by the next call;
+ * final is accepted for symmetry with hex_decode_t and otherwise unused.
+ * out may be in, and in[inused..inlen) is left as it was.
+ * inused receives the number of characters consumed.
+ * return values is out length
+ */
+size_t
+bitstr_decode_msb(const char* in, size_t inlen, unsigned char* out, int final, size_t* inused);
+
+size_t
+bitstr_decode_lsb(const char* in, size_t inlen, unsigned char* out, int final, size_t* inused);
+
+#endif /* BITSTR_H */
@@ -0,0 +1,203 @@
+#include "blobscan.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define BLOBSCAN_SSE2
+#include <emmintrin.h>
+#endif
+
+#define BLOBSCAN_VALID  0x01
+#define BLOBSCAN_NONHEX 0x02
+#define BLOBSCAN_EOL    0x04
+
+/* character classes, BLOBSCAN_* bits */
+static unsigned char blobclass[256];
+
+static int
+blobscan_init_table(void)
+{
+	int i;
+
+	for (i = 0; i < 26; i++) {
+		blobclass['A' + i] = BLOBSCAN_VALID | (i < 6 ? 0 : BLOBSCAN_NONHEX);
+		blobclass['a' + i] = BLOBSCAN_VALID | (i < 6 ? 0 : BLOBSCAN_NONHEX);
+	}
+	for (i = 0; i < 10; i++) {
+		blobclass['0' + i] = BLOBSCAN_VALID;
+	}
+	blobclass['+'] = BLOBSCAN_VALID | BLOBSCAN_NONHEX;
+	blobclass['/'] = BLOBSCAN_VALID | BLOBSCAN_NONHEX;
+	blobclass['='] = BLOBSCAN_VALID | BLOBSCAN_NONHEX;
+	blobclass['\r'] = BLOBSCAN_VALID | BLOBSCAN_EOL;
+	blobclass['\n'] = BLOBSCAN_VALID | BLOBSCAN_EOL;
+
+	return 1;
+}
+
+static const int blobscan_table_ready = blobscan_init_table();
+
+static unsigned int
+blobscan_popcount16(unsigned int x)
+{
+	x = x - ((x >> 1) & 0x5555);
+	x = (x & 0x3333) + ((x >> 2) & 0x3333);
+	x = (x + (x >> 4)) & 0x0F0F;
+	return (x + (x >> 8)) & 0x1F;
+}
+
+#ifdef BLOBSCAN_SSE2
+static __m128i
+blobscan_sse2_range(__m128i v, char lo, char hi)
+{
+	/* signed compares: bytes >= 0x80 are negative and never match */
+	return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8((char)(lo - 1))),
+		_mm_cmplt_epi8(v, _mm_set1_epi8((char)(hi + 1))));
+}
+
+/*
+ * Classifies 16 characters; returns the run character mask and, if
+ * requested, the masks of non-hex characters and line breaks.
+ */
+static unsigned int
+blobscan_sse2_classify(const unsigned char* in, unsigned int* nonhex, unsigned int* eol)
+{
+	const __m128i v = _mm_loadu_si128((const __m128i*)in);
+	const __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+	const __m128i letter = blobscan_sse2_range(lower, 'a', 'z');
+	const __m128i hexletter = blobscan_sse2_range(lower, 'a', 'f');
+	const __m128i digit = blobscan_sse2_range(v, '0', '9');
+	const __m128i sign = _mm_or_si128(
+		_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('+')), _mm_cmpeq_epi8(v, _mm_set1_epi8('/'))),
+		_mm_cmpeq_epi8(v, _mm_set1_epi8('=')));
+	const __m128i lb = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')),
+		_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+
+	if (nonhex) {
+		*nonhex = (unsigned int)_mm_movemask_epi8(
+			_mm_or_si128(_mm_andnot_si128(hexletter, letter), sign));
+	}
+	if (eol) {
+		*eol = (unsigned int)_mm_movemask_epi8(lb);
+	}
+	return (unsigned int)_mm_movemask_epi8(
+		_mm_or_si128(_mm_or_si128(letter, digit), _mm_or_si128(sign, lb)));
+}
+#endif
+
+size_t
+blobscan_edge(const unsigned char* in, size_t len, int backward)
+{
+	size_t n = 0;
+
+	if (!backward) {
+#ifdef BLOBSCAN_SSE2
+		while (len - n >= 16 && blobscan_sse2_classify(in + n, NULL, NULL) == 0xFFFF) {
+			n += 16;
+		}
+#endif
+		while (n < len && (blobclass[in[n]] & BLOBSCAN_VALID)) {
+			n++;
+		}
+	}
+	else {
+#ifdef BLOBSCAN_SSE2
+		while (len - n >= 16 && blobscan_sse2_classify(in + len - n - 16, NULL, NULL) == 0xFFFF) {
+			n += 16;
+		}
+#endif
+		while (n < len && (blobclass[in[len - n - 1]] & BLOBSCAN_VALID)) {
+			n++;
+		}
+	}
+	return n;
+}
+
+void
+blobscan_stats(const unsigned char* in, size_t len, blobscan_run* run)
+{
+	size_t i = 0;
+	size_t eols = 0;
+	unsigned int nonhex = 0;
+
+#ifdef BLOBSCAN_SSE2
+	for (; i + 16 <= len; i += 16) {
+		unsigned int nh, eol;
+		blobscan_sse2_classify(in + i, &nh, &eol);
+		nonhex |= nh;
+		eols += blobscan_popcount16(eol);
+	}
+#endif
+	for (; i < len; i++) {
+		nonhex |= blobclass[in[i]] & BLOBSCAN_NONHEX;
+		eols += (blobclass[in[i]] & BLOBSCAN_EOL) ? 1 : 0;
+	}
+
+	run->payload = len - eols;
+	run->nonhex = (nonhex != 0);
+	run->start = 0;
+	run->end = 0;
+	if (run->payload) {
+		run->start = 0;
+		while (blobclass[in[run->start]] & BLOBSCAN_EOL) {
+			run->start++;
+		}
+		run->end = len;
+		while (blobclass[in[run->end - 1]] & BLOBSCAN_EOL) {
+			run->end--;
+		}
+	}
+}
+
+size_t
+blobscan_find(const unsigned char* in, size_t len, size_t min_run,
+	size_t* pos, blobscan_run* runs, size_t maxruns)
+{
+	size_t i = *pos;
+	size_t count = 0;
+
+	if (min_run < BLOBSCAN_MIN_RUN) {
+		min_run = BLOBSCAN_MIN_RUN;
+	}
+
+	while (count < maxruns && i + 16 <= len) {
+		/*
+		 * Any run of 31 or more characters covers a whole 16-character
+		 * block, so only blocks made entirely of run characters need a
+		 * closer look. Random binary data almost never has one.
+		 */
+#ifdef BLOBSCAN_SSE2
+		if (blobscan_sse2_classify(in + i, NULL, NULL) != 0xFFFF) {
+			i += 16;
+			continue;
+		}
+#else
+		size_t k;
+		for (k = 16; k > 0 && (blobclass[in[i + k - 1]] & BLOBSCAN_VALID); k--) {
+		}
+		if (k) {
+			i += k;
+			continue;
+		}
+#endif
+		/* the run started in the previous block at the earliest */
+		size_t s = i;
+		while (s > *pos && (blobclass[in[s - 1]] & BLOBSCAN_VALID)) {
+			s--;
+		}
+		size_t e = i + 16 + blobscan_edge(in + i + 16, len - i - 16, 0);
+
+		blobscan_run* run = &runs[count];
+		blobscan_stats(in + s, e - s, run);
+		if (run->payload >= min_run) {
+			run->start += s;
+			run->end += s;
+			count++;
+		}
+		i = e;
+	}
+	if (count < maxruns) {
+		i = len;
+	}
+
+	*pos = i;
+	return count;
+}
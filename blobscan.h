@@ -0,0 +1,54 @@
+#pragma once
+
+#ifndef BLOBSCAN_H
+#define BLOBSCAN_H
+
+#include <stddef.h>
+
+/*
+ * Finds runs of base64 or hex text embedded in binary data.
+ *
+ * A run is a maximal sequence of base64 characters (A-Z a-z 0-9 + / =)
+ * and line breaks. Line breaks do not count towards its length and are
+ * trimmed from both ends. A run made of hex digits and line breaks only
+ * is reported as hex.
+ */
+
+/* shortest run blobscan_find can look for; see blobscan_find */
+#define BLOBSCAN_MIN_RUN 32
+
+typedef struct blobscan_run {
+	size_t start;    /* first character that is not a line break */
+	size_t end;      /* one past the last character that is not a line break */
+	size_t payload;  /* characters other than line breaks */
+	int nonhex;      /* non-zero if any character is not a hex digit */
+} blobscan_run;
+
+/*
+ * Length of the run touching the start (backward == 0) or the end
+ * (backward != 0) of in; 0 if the first / last character is not part of
+ * a run.
+ */
+size_t
+blobscan_edge(const unsigned char* in, size_t len, int backward);
+
+/*
+ * Fills run with the statistics of in[0..len), which must consist of run
+ * characters only. Positions are relative to in; start == end == 0 if
+ * the range holds line breaks only.
+ */
+void
+blobscan_stats(const unsigned char* in, size_t len, blobscan_run* run);
+
+/*
+ * Finds runs with at least min_run (>= BLOBSCAN_MIN_RUN) characters
+ * other than line breaks. The ends of in are treated as run boundaries.
+ * Starts at *pos and stores at most maxruns runs; *pos is advanced so the
+ * next call continues where this one stopped (*pos == len when done).
+ * return values is runs count
+ */
+size_t
+blobscan_find(const unsigned char* in, size_t len, size_t min_run,
+	size_t* pos, blobscan_run* runs, size_t maxruns);
+
+#endif /* BLOBSCAN_H */
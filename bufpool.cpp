@@ -0,0 +1,398 @@
+/* bufpool.cpp : plugin-lifetime pool of aligned scratch buffers */
+
+#include "bufpool.h"
+
+#include <mutex>
+#include <chrono>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#define BUFPOOL_HUGE_CLASS 21	/* 2 MB */
+
+/*
+ * Every buffer starts with one cache line of bookkeeping; the caller gets
+ * the memory right behind it, which keeps the 64-byte alignment of the
+ * page-aligned OS allocation.
+ */
+typedef struct bufpool_hdr {
+	struct bufpool_hdr* next;
+	unsigned long long last_use;
+	unsigned int cls;
+	unsigned int huge;
+} bufpool_hdr;
+
+static_assert(sizeof(bufpool_hdr) <= BUFPOOL_ALIGNMENT, "bufpool header exceeds one cache line");
+
+static std::mutex pool_lock;
+static bufpool_hdr* pool_idle[BUFPOOL_MAX_CLASS + 1];
+static int pool_large_pages;
+static bufpool_stats pool_stats;
+
+#ifdef _WIN32
+/* due when the oldest idle buffer times out; none once the pool is closed */
+static PTP_TIMER pool_timer;
+static int pool_closed;
+#endif
+
+static unsigned long long
+bufpool_now(void)
+{
+	return (unsigned long long)std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static unsigned int
+bufpool_class(size_t size)
+{
+	unsigned int cls = BUFPOOL_MIN_CLASS;
+
+	/* the header comes on top of size, which must not wrap around */
+	if (size > (size_t)-1 - BUFPOOL_ALIGNMENT) {
+		return BUFPOOL_MAX_CLASS;
+	}
+	size += BUFPOOL_ALIGNMENT;
+	while (cls < BUFPOOL_MAX_CLASS && ((size_t)1 << cls) < size) {
+		cls++;
+	}
+	return cls;
+}
+
+static bufpool_hdr*
+bufpool_os_alloc(unsigned int cls)
+{
+	size_t len = (size_t)1 << cls;
+	void* p = NULL;
+	unsigned int huge = 0;
+
+#ifdef _WIN32
+	if (pool_large_pages && cls >= BUFPOOL_HUGE_CLASS && GetLargePageMinimum() != 0) {
+		p = VirtualAlloc(NULL, len, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		huge = (p != NULL);
+	}
+	if (!p) {
+		p = VirtualAlloc(NULL, len, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	}
+#else
+#ifdef MAP_HUGETLB
+	if (pool_large_pages && cls >= BUFPOOL_HUGE_CLASS) {
+		p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (p == MAP_FAILED) {
+			p = NULL;
+		}
+		huge = (p != NULL);
+	}
+#endif
+	if (!p) {
+		p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED) {
+			return NULL;
+		}
+#ifdef MADV_HUGEPAGE
+		if (pool_large_pages && cls >= BUFPOOL_HUGE_CLASS) {
+			madvise(p, len, MADV_HUGEPAGE);
+		}
+#endif
+	}
+#endif
+	if (!p) {
+		return NULL;
+	}
+
+	bufpool_hdr* hdr = (bufpool_hdr*)p;
+	hdr->next = NULL;
+	hdr->last_use = 0;
+	hdr->cls = cls;
+	hdr->huge = huge;
+	return hdr;
+}
+
+static void
+bufpool_os_free(bufpool_hdr* hdr)
+{
+#ifdef _WIN32
+	VirtualFree(hdr, 0, MEM_RELEASE);
+#else
+	munmap(hdr, (size_t)1 << hdr->cls);
+#endif
+}
+
+/* caller holds pool_lock; unlinks what has to go onto *release */
+static void
+bufpool_collect(unsigned long long now, int force, bufpool_hdr** release)
+{
+	unsigned int cls;
+	bufpool_hdr** link;
+
+	/* idle timeout (or everything) */
+	for (cls = BUFPOOL_MIN_CLASS; cls <= BUFPOOL_MAX_CLASS; cls++) {
+		link = &pool_idle[cls];
+		while (*link) {
+			bufpool_hdr* hdr = *link;
+			if (force || now - hdr->last_use >= BUFPOOL_IDLE_TIMEOUT_MS) {
+				*link = hdr->next;
+				pool_stats.idle_bytes -= (size_t)1 << cls;
+				hdr->next = *release;
+				*release = hdr;
+			} else {
+				link = &hdr->next;
+			}
+		}
+	}
+
+	/* over budget: drop the largest classes first */
+	for (cls = BUFPOOL_MAX_CLASS; cls >= BUFPOOL_MIN_CLASS && pool_stats.idle_bytes > BUFPOOL_IDLE_BUDGET; cls--) {
+		while (pool_idle[cls] && pool_stats.idle_bytes > BUFPOOL_IDLE_BUDGET) {
+			bufpool_hdr* hdr = pool_idle[cls];
+			pool_idle[cls] = hdr->next;
+			pool_stats.idle_bytes -= (size_t)1 << cls;
+			hdr->next = *release;
+			*release = hdr;
+		}
+	}
+}
+
+#ifdef _WIN32
+static VOID CALLBACK
+bufpool_timer_proc(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_TIMER timer)
+{
+	(void)instance;
+	(void)context;
+	(void)timer;
+	bufpool_trim(0);
+}
+#endif
+
+/*
+ * caller holds pool_lock; sets the timer for when the oldest idle buffer
+ * times out, or stops it if nothing is idle
+ */
+static void
+bufpool_arm(unsigned long long now)
+{
+#ifdef _WIN32
+	unsigned long long oldest = 0;
+	int idle = 0;
+
+	for (unsigned int cls = BUFPOOL_MIN_CLASS; cls <= BUFPOOL_MAX_CLASS; cls++) {
+		for (bufpool_hdr* hdr = pool_idle[cls]; hdr; hdr = hdr->next) {
+			if (!idle || hdr->last_use < oldest) {
+				oldest = hdr->last_use;
+			}
+			idle = 1;
+		}
+	}
+
+	if (!idle) {
+		if (pool_timer) {
+			SetThreadpoolTimer(pool_timer, NULL, 0, 0);
+		}
+		return;
+	}
+	if (!pool_timer && !pool_closed) {
+		pool_timer = CreateThreadpoolTimer(bufpool_timer_proc, NULL, NULL);
+	}
+	if (!pool_timer) {
+		return;
+	}
+
+	/* at least 1 ms; a timer that fires a little early just sets itself
+	 * again from bufpool_trim */
+	unsigned long long wait = oldest + BUFPOOL_IDLE_TIMEOUT_MS > now ? oldest + BUFPOOL_IDLE_TIMEOUT_MS - now : 1;
+	/* relative due times are negative, in 100 ns units */
+	unsigned long long due = 0 - wait * 10000;
+	FILETIME ft;
+	ft.dwLowDateTime = (DWORD)due;
+	ft.dwHighDateTime = (DWORD)(due >> 32);
+	SetThreadpoolTimer(pool_timer, &ft, 0, 1000);
+#else
+	(void)now;
+#endif
+}
+
+static void
+bufpool_release(bufpool_hdr* release)
+{
+	unsigned long long count = 0;
+
+	while (release) {
+		bufpool_hdr* next = release->next;
+		bufpool_os_free(release);
+		release = next;
+		count++;
+	}
+
+	if (count) {
+		std::lock_guard<std::mutex> guard(pool_lock);
+		pool_stats.released += count;
+	}
+}
+
+void*
+bufpool_alloc(size_t size)
+{
+	bufpool_hdr* hdr = NULL;
+	bufpool_hdr* release = NULL;
+
+	if (size > ((size_t)1 << BUFPOOL_MAX_CLASS) - BUFPOOL_ALIGNMENT) {
+		return NULL;
+	}
+
+	unsigned int cls = bufpool_class(size);
+
+	{
+		std::lock_guard<std::mutex> guard(pool_lock);
+		unsigned long long now = bufpool_now();
+
+		/* an idle buffer of the same class, or the next one up */
+		if (pool_idle[cls]) {
+			hdr = pool_idle[cls];
+		} else if (cls < BUFPOOL_MAX_CLASS && pool_idle[cls + 1]) {
+			hdr = pool_idle[++cls];
+		}
+		if (hdr) {
+			pool_idle[cls] = hdr->next;
+			pool_stats.idle_bytes -= (size_t)1 << cls;
+			pool_stats.hits++;
+		} else {
+			pool_stats.misses++;
+		}
+		bufpool_collect(now, 0, &release);
+	}
+	bufpool_release(release);
+
+	if (!hdr) {
+		hdr = bufpool_os_alloc(cls);
+		if (!hdr) {
+			return NULL;
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(pool_lock);
+		pool_stats.busy_bytes += (size_t)1 << hdr->cls;
+	}
+	hdr->next = NULL;
+	return (unsigned char*)hdr + BUFPOOL_ALIGNMENT;
+}
+
+size_t
+bufpool_size(const void* p)
+{
+	const bufpool_hdr* hdr = (const bufpool_hdr*)((const unsigned char*)p - BUFPOOL_ALIGNMENT);
+
+	return ((size_t)1 << hdr->cls) - BUFPOOL_ALIGNMENT;
+}
+
+void
+bufpool_free(void* p)
+{
+	bufpool_hdr* release = NULL;
+
+	if (!p) {
+		return;
+	}
+
+	bufpool_hdr* hdr = (bufpool_hdr*)((unsigned char*)p - BUFPOOL_ALIGNMENT);
+	{
+		std::lock_guard<std::mutex> guard(pool_lock);
+		unsigned long long now = bufpool_now();
+
+		pool_stats.busy_bytes -= (size_t)1 << hdr->cls;
+		hdr->last_use = now;
+		hdr->next = pool_idle[hdr->cls];
+		pool_idle[hdr->cls] = hdr;
+		pool_stats.idle_bytes += (size_t)1 << hdr->cls;
+		bufpool_collect(now, 0, &release);
+		bufpool_arm(now);
+	}
+	bufpool_release(release);
+}
+
+#ifdef _WIN32
+/*
+ * enables SeLockMemoryPrivilege in the process token, which large pages
+ * need besides the user holding it.
+ * return values is 0 if the user does not hold it
+ */
+static int
+bufpool_lock_memory_privilege(void)
+{
+	HANDLE token;
+	TOKEN_PRIVILEGES tp;
+	int held = 0;
+
+	if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+		return 0;
+	}
+	tp.PrivilegeCount = 1;
+	tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+	if (LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &tp.Privileges[0].Luid) &&
+	    AdjustTokenPrivileges(token, FALSE, &tp, 0, NULL, NULL)) {
+		/* also succeeds for a privilege that is not held, but says so */
+		held = (GetLastError() == ERROR_SUCCESS);
+	}
+	CloseHandle(token);
+	return held;
+}
+#endif
+
+void
+bufpool_set_large_pages(int enable)
+{
+#ifdef _WIN32
+	/* every large-page VirtualAlloc would fail without the privilege */
+	if (enable) {
+		enable = bufpool_lock_memory_privilege();
+	}
+#endif
+	std::lock_guard<std::mutex> guard(pool_lock);
+	pool_large_pages = enable;
+}
+
+void
+bufpool_trim(int force)
+{
+	bufpool_hdr* release = NULL;
+
+	{
+		std::lock_guard<std::mutex> guard(pool_lock);
+		unsigned long long now = bufpool_now();
+
+		bufpool_collect(now, force, &release);
+		bufpool_arm(now);
+	}
+	bufpool_release(release);
+}
+
+void
+bufpool_close(void)
+{
+#ifdef _WIN32
+	PTP_TIMER timer;
+
+	{
+		std::lock_guard<std::mutex> guard(pool_lock);
+		timer = pool_timer;
+		pool_timer = NULL;
+		pool_closed = 1;
+	}
+	if (timer) {
+		SetThreadpoolTimer(timer, NULL, 0, 0);
+		WaitForThreadpoolTimerCallbacks(timer, TRUE);
+		CloseThreadpoolTimer(timer);
+	}
+#endif
+	bufpool_trim(1);
+}
+
+void
+bufpool_get_stats(bufpool_stats* stats)
+{
+	std::lock_guard<std::mutex> guard(pool_lock);
+	*stats = pool_stats;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#ifndef BUFPOOL_H
+#define BUFPOOL_H
+
+#include <stddef.h>
+
+/*
+ * Plugin-lifetime pool of scratch buffers.
+ *
+ * Buffers are 64-byte aligned and handed out in power-of-two size classes,
+ * so back-to-back operations of similar size get warm, already faulted-in
+ * memory back instead of fresh pages. Contents are NOT zeroed.
+ * Idle buffers are released after BUFPOOL_IDLE_TIMEOUT_MS, or once the
+ * idle total exceeds BUFPOOL_IDLE_BUDGET. On Win32 a thread-pool timer
+ * sees to the timeout; elsewhere it is checked on every call.
+ *
+ * Portable (Win32 / POSIX) and thread-safe.
+ */
+
+#define BUFPOOL_ALIGNMENT       64
+#define BUFPOOL_MIN_CLASS       16          /* 64 KB */
+#define BUFPOOL_MAX_CLASS       ((unsigned int)(sizeof(size_t) * 8 - 1))
+#define BUFPOOL_IDLE_TIMEOUT_MS 30000
+#define BUFPOOL_IDLE_BUDGET     ((size_t)512 * 1024 * 1024)
+
+typedef struct bufpool_stats {
+	unsigned long long hits;        /* requests served from the pool */
+	unsigned long long misses;      /* requests that went to the OS */
+	unsigned long long released;    /* buffers returned to the OS */
+	size_t idle_bytes;              /* bytes currently cached */
+	size_t busy_bytes;              /* bytes currently handed out */
+} bufpool_stats;
+
+/*
+ * returns a buffer of at least size bytes, or NULL
+ */
+void*
+bufpool_alloc(size_t size);
+
+/*
+ * returns the usable size of a buffer from bufpool_alloc
+ */
+size_t
+bufpool_size(const void* p);
+
+void
+bufpool_free(void* p);
+
+/*
+ * back size classes of 2 MB and up with huge/large pages when the OS
+ * allows it (falls back to normal pages silently). On Windows the user
+ * needs SeLockMemoryPrivilege ("Lock pages in memory"), which this
+ * enables in the process token; without it the option stays off. On
+ * Linux, huge pages must be reserved, or transparent huge pages enabled.
+ */
+void
+bufpool_set_large_pages(int enable);
+
+/*
+ * releases idle buffers; all of them if force is non-zero
+ */
+void
+bufpool_trim(int force);
+
+/*
+ * stops the idle timer, waiting for a callback in progress, and releases
+ * every idle buffer; call before the module is unloaded
+ */
+void
+bufpool_close(void);
+
+void
+bufpool_get_stats(bufpool_stats* stats);
+
+#endif /* BUFPOOL_H */
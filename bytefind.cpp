@@ -0,0 +1,263 @@
+#include "bytefind.h"
+
+#include <string.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BYTEFIND_SSE2
+#include <emmintrin.h>
+#endif
+
+/*
+ * the anchor filter gives way to Horspool for BYTEFIND_SKIP_SPAN positions
+ * once BYTEFIND_MISS_LIMIT candidates in a block of BYTEFIND_BLOCK
+ * positions failed to verify; patterns shorter than BYTEFIND_SKIP_MIN
+ * skip too little for that to pay
+ */
+#define BYTEFIND_BLOCK 1024
+#define BYTEFIND_MISS_LIMIT 32
+#define BYTEFIND_SKIP_SPAN 16384
+#define BYTEFIND_SKIP_MIN 8
+
+#define BYTEFIND_NONE ((size_t)-1)
+
+static int
+bytefind_hexval(char c)
+{
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+	if (c == '?') {
+		return 16;
+	}
+	return -1;
+}
+
+static int
+bytefind_popcount(unsigned char x)
+{
+	int n = 0;
+
+	for (; x; x &= (unsigned char)(x - 1)) {
+		n++;
+	}
+	return n;
+}
+
+int
+bytefind_init(bytefind_pattern* pat, const unsigned char* value,
+	const unsigned char* mask, size_t len)
+{
+	size_t i;
+	int best = -1;
+
+	if (len == 0 || len > BYTEFIND_MAX_PATTERN) {
+		return 0;
+	}
+
+	pat->len = len;
+	pat->exact = 1;
+	for (i = 0; i < len; i++) {
+		pat->mask[i] = mask ? mask[i] : 0xFF;
+		pat->value[i] = value[i] & pat->mask[i];
+		if (pat->mask[i] != 0xFF) {
+			pat->exact = 0;
+		}
+	}
+
+	/* the anchors are the first and last of the most specific bytes */
+	for (i = 0; i < len; i++) {
+		int bits = bytefind_popcount(pat->mask[i]);
+		if (bits > best) {
+			best = bits;
+			pat->anchor_first = i;
+		}
+		if (bits == best) {
+			pat->anchor_last = i;
+		}
+	}
+
+	/* a byte that matches position j of the pattern may shift it by no more
+	 * than len - 1 - j; later positions override earlier ones */
+	for (i = 0; i < 256; i++) {
+		pat->shift[i] = len;
+	}
+	for (i = 0; i + 1 < len; i++) {
+		if (pat->mask[i] == 0xFF) {
+			pat->shift[pat->value[i]] = len - 1 - i;
+		} else {
+			unsigned int c;
+			for (c = 0; c < 256; c++) {
+				if ((c & pat->mask[i]) == pat->value[i]) {
+					pat->shift[c] = len - 1 - i;
+				}
+			}
+		}
+	}
+	return 1;
+}
+
+int
+bytefind_parse_hex(bytefind_pattern* pat, const char* in, size_t inlen)
+{
+	unsigned char value[BYTEFIND_MAX_PATTERN];
+	unsigned char mask[BYTEFIND_MAX_PATTERN];
+	size_t len = 0;
+	size_t i = 0;
+
+	while (i < inlen) {
+		char c = in[i];
+		if (c == ' ' || c == '\t' || c == '\r' || c == '\n' ||
+		    c == ',' || c == ':' || c == '-') {
+			i++;
+			continue;
+		}
+
+		/* a byte is always two digits, so "4D5A" is two bytes */
+		if (i + 1 >= inlen || len == BYTEFIND_MAX_PATTERN) {
+			return 0;
+		}
+		int hi = bytefind_hexval(c);
+		int lo = bytefind_hexval(in[i + 1]);
+		if (hi < 0 || lo < 0) {
+			return 0;
+		}
+		value[len] = (unsigned char)(((hi & 15) << 4) | (lo & 15));
+		mask[len] = (unsigned char)((hi == 16 ? 0x00 : 0xF0) | (lo == 16 ? 0x00 : 0x0F));
+		if (hi == 16) {
+			value[len] &= 0x0F;
+		}
+		if (lo == 16) {
+			value[len] &= 0xF0;
+		}
+		len++;
+		i += 2;
+	}
+	return bytefind_init(pat, value, mask, len);
+}
+
+static int
+bytefind_verify(const bytefind_pattern* pat, const unsigned char* p)
+{
+	size_t i;
+
+	if (pat->exact) {
+		return memcmp(p, pat->value, pat->len) == 0;
+	}
+	for (i = 0; i < pat->len; i++) {
+		if ((p[i] & pat->mask[i]) != pat->value[i]) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * return values is the first match starting in [i, last], or
+ * BYTEFIND_NONE
+ */
+static size_t
+bytefind_horspool(const bytefind_pattern* pat, const unsigned char* hay,
+	size_t i, size_t last)
+{
+	const size_t tail = pat->len - 1;
+	const unsigned char tmask = pat->mask[tail];
+	const unsigned char tvalue = pat->value[tail];
+
+	while (i <= last) {
+		unsigned char c = hay[i + tail];
+		if ((c & tmask) == tvalue && bytefind_verify(pat, hay + i)) {
+			return i;
+		}
+		i += pat->shift[c];
+	}
+	return BYTEFIND_NONE;
+}
+
+#ifdef BYTEFIND_SSE2
+static unsigned int
+bytefind_ctz32(unsigned int x)
+{
+#if defined(__GNUC__)
+	return (unsigned int)__builtin_ctz(x);
+#else
+	unsigned long idx;
+	_BitScanForward(&idx, x);
+	return (unsigned int)idx;
+#endif
+}
+#endif
+
+size_t
+bytefind_next(const bytefind_pattern* pat, const unsigned char* hay,
+	size_t n, size_t start)
+{
+	size_t i = start;
+	size_t last;
+	size_t found;
+
+	if (pat->len > n || start > n - pat->len) {
+		return n;
+	}
+	last = n - pat->len;
+
+#ifdef BYTEFIND_SSE2
+	{
+		const __m128i vfirst = _mm_set1_epi8((char)pat->value[pat->anchor_first]);
+		const __m128i mfirst = _mm_set1_epi8((char)pat->mask[pat->anchor_first]);
+		const __m128i vlast = _mm_set1_epi8((char)pat->value[pat->anchor_last]);
+		const __m128i mlast = _mm_set1_epi8((char)pat->mask[pat->anchor_last]);
+		const unsigned char* pfirst = hay + pat->anchor_first;
+		const unsigned char* plast = hay + pat->anchor_last;
+		size_t block = i + BYTEFIND_BLOCK;
+		size_t misses = 0;
+
+		/* all 16 candidates of a step must be possible starts */
+		while (i <= last && last - i >= 15) {
+			const __m128i a = _mm_loadu_si128((const __m128i*)(pfirst + i));
+			const __m128i b = _mm_loadu_si128((const __m128i*)(plast + i));
+			unsigned int bits = (unsigned int)_mm_movemask_epi8(_mm_and_si128(
+				_mm_cmpeq_epi8(_mm_and_si128(a, mfirst), vfirst),
+				_mm_cmpeq_epi8(_mm_and_si128(b, mlast), vlast)));
+
+			while (bits) {
+				size_t k = i + bytefind_ctz32(bits);
+				if (bytefind_verify(pat, hay + k)) {
+					return k;
+				}
+				misses++;
+				bits &= bits - 1;
+			}
+			i += 16;
+
+			if (i < block) {
+				continue;
+			}
+			if (i <= last && misses >= BYTEFIND_MISS_LIMIT && pat->len >= BYTEFIND_SKIP_MIN) {
+				size_t end = (last - i < BYTEFIND_SKIP_SPAN) ? last : i + BYTEFIND_SKIP_SPAN - 1;
+				found = bytefind_horspool(pat, hay, i, end);
+				if (found != BYTEFIND_NONE) {
+					return found;
+				}
+				i = end + 1;
+			}
+			block = i + BYTEFIND_BLOCK;
+			misses = 0;
+		}
+	}
+#endif
+
+	if (i > last) {
+		return n;
+	}
+	found = bytefind_horspool(pat, hay, i, last);
+	return (found == BYTEFIND_NONE) ? n : found;
+}
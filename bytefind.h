@@ -0,0 +1,56 @@
+#pragma once
+
+#ifndef BYTEFIND_H
+#define BYTEFIND_H
+
+#include <stddef.h>
+
+/*
+ * Finds a byte pattern in a buffer.  Any bit of the pattern may be a
+ * wildcard, so "4D 5A ?? 00" and nibble wildcards such as "4? ?A" work
+ * the same way as plain bytes.  With SSE2, 16 candidate positions are
+ * filtered per step on two anchor bytes of the pattern (the first and
+ * last that are fully known) before the whole pattern is verified; where
+ * the anchors keep matching without the pattern doing so, the search
+ * switches to a Horspool skip loop for a while.  Elsewhere it is Horspool
+ * throughout.
+ */
+
+#define BYTEFIND_MAX_PATTERN 1024
+
+typedef struct bytefind_pattern {
+	unsigned char value[BYTEFIND_MAX_PATTERN];	/* wildcard bits are 0 */
+	unsigned char mask[BYTEFIND_MAX_PATTERN];	/* bits that must match */
+	size_t len;
+	size_t anchor_first;
+	size_t anchor_last;
+	int exact;					/* no wildcard bits at all */
+	size_t shift[256];			/* Horspool, by the byte under the last position */
+} bytefind_pattern;
+
+/*
+ * sets up pat for len bytes of value; mask may be NULL for an exact
+ * pattern.
+ * return values is 0 if len is 0 or over BYTEFIND_MAX_PATTERN
+ */
+int
+bytefind_init(bytefind_pattern* pat, const unsigned char* value,
+	const unsigned char* mask, size_t len);
+
+/*
+ * sets up pat from hex text: pairs of hex digits where either digit may
+ * be '?', separated by blanks, ',', ':' or '-' or not at all.
+ * return values is 0 if the text is not such a pattern
+ */
+int
+bytefind_parse_hex(bytefind_pattern* pat, const char* in, size_t inlen);
+
+/*
+ * return values is the offset of the first match at or after start that
+ * lies wholly inside hay[0..n), or n if there is none
+ */
+size_t
+bytefind_next(const bytefind_pattern* pat, const unsigned char* hay,
+	size_t n, size_t start);
+
+#endif /* BYTEFIND_H */
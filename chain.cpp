@@ -0,0 +1,299 @@
+// chain.cpp : transform chains - a decoder followed by byte transforms, run
+// over the clipboard text in cache-sized chunks
+//
+
+#include "stdafx.h"
+
+#include <tchar.h>
+
+#include "chain.h"
+#include "bufpool.h"
+#include "docwrite.h"
+#include "compact.h"
+#include "hex.h"
+#include "base64.h"
+#include "ascii85.h"
+
+// Digits a decoder may leave for the next chunk; more than that means it
+// stopped for good
+#define CHAIN_MAX_CARRY 16
+
+typedef struct _CHAIN_DECODER
+{
+	LPCTSTR       lpszName;
+	DECODE_KERNEL pfnDecode;
+	size_t        nExpand;	// most bytes out per character in
+} CHAIN_DECODER;
+
+// The text reaches the decoders with its blanks already compacted out
+static const CHAIN_DECODER g_ChainDecoders[] =
+{
+	{ _T("hex"),       hex_decode_t<hex_policy_separated>,  1 },
+	{ _T("base64"),    base64_decode_t<base64_policy_strict>, 1 },
+	{ _T("base64url"), base64_decode_t<base64_policy_url>,  1 },
+	{ _T("ascii85"),   ascii85_decode,                      4 },	// 'z' is four zeros
+};
+
+typedef struct _CHAIN_TRANSFORM
+{
+	LPCTSTR lpszName;
+	int     nKind;
+} CHAIN_TRANSFORM;
+
+static const CHAIN_TRANSFORM g_ChainTransforms[] =
+{
+	{ _T("xor"),     XFORM_XOR },
+	{ _T("add"),     XFORM_ADD },
+	{ _T("sub"),     XFORM_SUB },
+	{ _T("rol"),     XFORM_ROL },
+	{ _T("ror"),     XFORM_ROR },
+	{ _T("xorroll"), XFORM_XOR_ROLLING },
+	{ _T("rc4"),     XFORM_RC4 },
+};
+
+#define COUNTOF(a) (sizeof(a) / sizeof((a)[0]))
+
+static BOOL IsBlank(TCHAR c)
+{
+	return c == _T(' ') || c == _T('\t');
+}
+
+static int HexValue(TCHAR c)
+{
+	if (c >= _T('0') && c <= _T('9'))
+		return c - _T('0');
+	if (c >= _T('A') && c <= _T('F'))
+		return c - _T('A') + 10;
+	if (c >= _T('a') && c <= _T('f'))
+		return c - _T('a') + 10;
+	return -1;
+}
+
+// Reads "quoted text", or hex bytes with an optional 0x in front of each
+// group; a group with an odd number of digits starts with a zero digit
+static BOOL ParseKey(LPCTSTR p, LPCTSTR pEnd, unsigned char* pKey, size_t* pnKey)
+{
+	size_t nKey = 0;
+
+	if (p < pEnd && *p == _T('"'))
+	{
+		LPCTSTR pQuote = p + 1;
+		while (pQuote < pEnd && *pQuote != _T('"'))
+			pQuote++;
+		if (pQuote == pEnd || pQuote == p + 1)
+			return FALSE;
+		for (LPCTSTR q = pQuote + 1; q < pEnd; q++)
+		{
+			if (!IsBlank(*q))
+				return FALSE;
+		}
+#ifdef _UNICODE
+		// The key is matched against ANSI clipboard text, so it is ANSI too
+		int n = WideCharToMultiByte(CP_ACP, 0, p + 1, (int)(pQuote - p - 1),
+			(LPSTR)pKey, XFORM_MAX_KEY, NULL, NULL);
+		if (n <= 0)
+			return FALSE;
+		*pnKey = (size_t)n;
+#else
+		if ((size_t)(pQuote - p - 1) > XFORM_MAX_KEY)
+			return FALSE;
+		memcpy(pKey, p + 1, pQuote - p - 1);
+		*pnKey = pQuote - p - 1;
+#endif
+		return TRUE;
+	}
+
+	while (p < pEnd)
+	{
+		if (IsBlank(*p))
+		{
+			p++;
+			continue;
+		}
+		if (pEnd - p > 2 && p[0] == _T('0') && (p[1] == _T('x') || p[1] == _T('X')))
+			p += 2;
+
+		LPCTSTR pGroup = p;
+		while (p < pEnd && HexValue(*p) >= 0)
+			p++;
+		if (p == pGroup || (p < pEnd && !IsBlank(*p)))
+			return FALSE;
+
+		size_t nDigits = p - pGroup;
+		if (nKey + (nDigits + 1) / 2 > XFORM_MAX_KEY)
+			return FALSE;
+		if (nDigits & 1)
+			pKey[nKey++] = (unsigned char)HexValue(*pGroup++);
+		for (; pGroup < p; pGroup += 2)
+			pKey[nKey++] = (unsigned char)(HexValue(pGroup[0]) << 4 | HexValue(pGroup[1]));
+	}
+
+	*pnKey = nKey;
+	return nKey != 0;
+}
+
+// Reads one stage from [p, pEnd), blanks around it already trimmed
+static BOOL ParseStage(LPCTSTR p, LPCTSTR pEnd, CHAIN* pChain, BOOL bFirst)
+{
+	LPCTSTR pName = p;
+	while (p < pEnd && !IsBlank(*p))
+		p++;
+	size_t nName = p - pName;
+	while (p < pEnd && IsBlank(*p))
+		p++;
+
+	if (bFirst)
+	{
+		for (size_t i = 0; i < COUNTOF(g_ChainDecoders); i++)
+		{
+			if (_tcslen(g_ChainDecoders[i].lpszName) == nName &&
+				_tcsnicmp(pName, g_ChainDecoders[i].lpszName, nName) == 0 && p == pEnd)
+			{
+				pChain->pfnDecode = g_ChainDecoders[i].pfnDecode;
+				pChain->nTextStep = CHAIN_CHUNK_SIZE / g_ChainDecoders[i].nExpand - CHAIN_MAX_CARRY;
+				return TRUE;
+			}
+		}
+		return FALSE;
+	}
+
+	for (size_t i = 0; i < COUNTOF(g_ChainTransforms); i++)
+	{
+		if (_tcslen(g_ChainTransforms[i].lpszName) != nName ||
+			_tcsnicmp(pName, g_ChainTransforms[i].lpszName, nName) != 0)
+			continue;
+		if (pChain->nStages == CHAIN_MAX_STAGES)
+			return FALSE;
+
+		int nKind = g_ChainTransforms[i].nKind;
+		unsigned char key[XFORM_MAX_KEY];
+		size_t nKey = 0;
+		if (nKind == XFORM_ROL || nKind == XFORM_ROR)
+		{
+			// A bit count, not a key
+			if (pEnd - p != 1 || *p < _T('1') || *p > _T('7'))
+				return FALSE;
+			key[0] = (unsigned char)(*p - _T('0'));
+			nKey = 1;
+		}
+		else if (!ParseKey(p, pEnd, key, &nKey) || (nKind == XFORM_XOR_ROLLING && nKey > 2))
+		{
+			return FALSE;
+		}
+		return xform_init(&pChain->stages[pChain->nStages++], nKind, key, nKey);
+	}
+	return FALSE;
+}
+
+BOOL ChainParse(LPCTSTR lpszSpec, CHAIN* pChain, size_t* pnError)
+{
+	LPCTSTR p = lpszSpec;
+
+	pChain->pfnDecode = NULL;
+	pChain->nStages = 0;
+	*pnError = 0;
+
+	for (;;)
+	{
+		while (IsBlank(*p))
+			p++;
+		*pnError = p - lpszSpec;
+
+		LPCTSTR pBar = _tcschr(p, _T('|'));
+		LPCTSTR pEnd = pBar ? pBar : p + _tcslen(p);
+		while (pEnd > p && IsBlank(pEnd[-1]))
+			pEnd--;
+		if (pEnd == p || !ParseStage(p, pEnd, pChain, pChain->pfnDecode == NULL))
+			return FALSE;
+		if (!pBar)
+			return TRUE;
+		p = pBar + 1;
+	}
+}
+
+DECODE_STATUS ChainRun(HWSESSION hSession, HWDOCUMENT hDoc, QWORD qwPosition,
+	CHAIN* pChain, const char* pText, size_t nText, QWORD* pqwOut)
+{
+	DECODE_STATUS eStatus = DECODE_INVALID;
+	char* pBuf = NULL;
+	unsigned char* pOut = NULL;
+	DOC_WRITER* pWriter = NULL;
+	compact_set set;
+	size_t nCarry = 0;
+
+	*pqwOut = 0;
+	compact_set_init(&set, COMPACT_BLANKS);
+
+	__try
+	{
+		pBuf = (char*)bufpool_alloc(pChain->nTextStep + CHAIN_MAX_CARRY);
+		pOut = (unsigned char*)bufpool_alloc(CHAIN_CHUNK_SIZE);
+		if (!pBuf || !pOut)
+			__leave;
+		// The chunks reach the host as a few large inserts rather than
+		// one per chunk
+		pWriter = DocWriterOpen(hSession, hDoc);
+		if (!pWriter)
+			__leave;
+
+		eStatus = DECODE_OK;
+		for (size_t pos = 0; pos < nText; )
+		{
+			size_t n = nText - pos;
+			if (n > pChain->nTextStep)
+				n = pChain->nTextStep;
+			BOOL bFinal = (pos + n == nText);
+
+			// Compact, decode, transform: the chunk goes through every
+			// stage before the next one is read
+			size_t nBuf = nCarry + compact_text(&set, pText + pos, n, pBuf + nCarry);
+			size_t used = 0;
+			size_t nOut = pChain->pfnDecode(pBuf, nBuf, pOut, bFinal, &used);
+			for (size_t i = 0; i < pChain->nStages; i++)
+				xform_apply(&pChain->stages[i], pOut, nOut);
+
+			if (!DocWriterInsert(pWriter, qwPosition + *pqwOut, pOut, nOut))
+			{
+				eStatus = DECODE_INVALID;
+				break;
+			}
+			*pqwOut += nOut;
+			pos += n;
+
+			// A pair or quantum cut by the chunk boundary is finished with
+			// the next chunk; anything else left over stops the chain
+			nCarry = nBuf - used;
+			if (nCarry && (bFinal || nCarry > CHAIN_MAX_CARRY))
+			{
+				eStatus = *pqwOut ? DECODE_TRUNCATED : DECODE_INVALID;
+				break;
+			}
+			memmove(pBuf, pBuf + used, nCarry);
+
+			if (hwUpdateProgress(hSession, (int)((QWORD)pos * 100 / nText),
+				_T("Running transform chain")) == HWAPI_RESULT_USER_ABORT)
+			{
+				eStatus = DECODE_CANCELLED;
+				break;
+			}
+		}
+
+		if (!DocWriterFlush(pWriter))
+			eStatus = DECODE_INVALID;
+		if (eStatus == DECODE_CANCELLED && *pqwOut)
+		{
+			hwDeleteAt(hDoc, qwPosition, *pqwOut);
+			*pqwOut = 0;
+		}
+	}
+	__finally
+	{
+		DocWriterClose(pWriter, NULL);
+		if (pBuf)
+			bufpool_free(pBuf);
+		if (pOut)
+			bufpool_free(pOut);
+	}
+
+	return eStatus;
+}
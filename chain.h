@@ -0,0 +1,47 @@
+// chain.h : transform chains - a decoder followed by byte transforms, run
+// over the clipboard text in cache-sized chunks
+//
+
+#pragma once
+
+#include "hwapi.h"
+#include "decode.h"
+#include "xform.h"
+
+// Chains are named in the .ini file, one per key:
+//
+//   [Chains]
+//   Stage two=base64 | xor 5A | rc4 "infected"
+//
+// The first stage is the decoder: hex, base64, base64url or ascii85.  Any
+// number of these follow, separated by '|':
+//   xor <key>, add <key>, sub <key>   repeating key
+//   rol <bits>, ror <bits>            rotate each byte by 1 .. 7 bits
+//   xorroll <start> [step]            key byte grows by step (1) per byte
+//   rc4 <key>
+// Keys are hex bytes ("5A", "0x5A 0x13", "DEADBEEF") or "quoted text".
+#define CHAIN_SECTION _T("Chains")
+#define CHAIN_MAX_SPEC 1024
+#define CHAIN_MAX_STAGES 8
+
+// Decoded bytes per chunk; every stage works on a chunk while it is still
+// in the cache, and nothing in between is kept
+#define CHAIN_CHUNK_SIZE (64 * 1024)
+
+typedef struct _CHAIN
+{
+	DECODE_KERNEL pfnDecode;
+	size_t        nTextStep;	// characters per chunk, so the bytes fit
+	size_t        nStages;
+	xform_stage   stages[CHAIN_MAX_STAGES];
+} CHAIN;
+
+// Returns FALSE if lpszSpec is malformed; *pnError receives the offset of
+// the stage that could not be read
+BOOL ChainParse(LPCTSTR lpszSpec, CHAIN* pChain, size_t* pnError);
+
+// Runs pText through pChain and inserts the bytes at qwPosition, chunk by
+// chunk; call inside an undo group.  *pqwOut receives the bytes inserted.
+// On a user abort they are removed again.
+DECODE_STATUS ChainRun(HWSESSION hSession, HWDOCUMENT hDoc, QWORD qwPosition,
+	CHAIN* pChain, const char* pText, size_t nText, QWORD* pqwOut);
@@ -0,0 +1,148 @@
+// clipcache.cpp : keeps recent clipboard decodes so a repeated paste of the
+// same text skips the decode
+//
+
+#include "stdafx.h"
+
+#include <tchar.h>
+#include <string.h>
+
+#include "clipcache.h"
+#include "bufpool.h"
+#include "config.h"
+
+typedef struct _CLIPCACHE_ENTRY
+{
+	CLIPCACHE_KEY    key;
+	CLIPCACHE_RESULT result;
+	void*            pBuffer;	// NULL for a free slot
+	size_t           nBuffer;
+	ULONGLONG        qwLastUse;
+} CLIPCACHE_ENTRY;
+
+// Plugin commands all run on the execute thread, so there is no locking
+static CLIPCACHE_ENTRY g_Entries[CLIPCACHE_MAX_ENTRIES];
+static ULONGLONG g_qwUseCounter;
+static size_t g_nCached;
+
+static size_t ClipCacheBudget(void)
+{
+	return (size_t)ConfigGetInt(_T("Clipboard"), _T("CacheMB"), CLIPCACHE_DEFAULT_BUDGET_MB) *
+		1024 * 1024;
+}
+
+static void ClipCacheEvict(CLIPCACHE_ENTRY* pEntry)
+{
+	bufpool_free(pEntry->pBuffer);
+	g_nCached -= pEntry->nBuffer;
+	ZeroMemory(pEntry, sizeof(*pEntry));
+}
+
+static BOOL ClipCacheKeyEqual(const CLIPCACHE_KEY* pA, const CLIPCACHE_KEY* pB)
+{
+	if (pA->dwSequence != pB->dwSequence || pA->qwTextHash != pB->qwTextHash ||
+		pA->eMode != pB->eMode || pA->pfnKernel != pB->pfnKernel)
+		return FALSE;
+	if (pA->eMode == DECODE_MODE_HEX && !pA->pfnKernel)
+		return pA->uWordSize == pB->uWordSize && pA->bBigEndian == pB->bBigEndian;
+	if (pA->eMode == DECODE_MODE_NUMBERS)
+		return memcmp(&pA->number, &pB->number, sizeof(pA->number)) == 0;
+	return TRUE;
+}
+
+void ClipCacheKeyFromJob(CLIPCACHE_KEY* pKey, const DECODE_JOB* pJob)
+{
+	ZeroMemory(pKey, sizeof(*pKey));
+	pKey->dwSequence = GetClipboardSequenceNumber();
+	pKey->eMode = pJob->eMode;
+	pKey->uWordSize = pJob->uWordSize;
+	pKey->bBigEndian = pJob->bBigEndian;
+	pKey->number = pJob->number;
+	pKey->pfnKernel = pJob->pfnKernel;
+}
+
+ULONGLONG ClipCacheHash(const char* pText, size_t nText)
+{
+	const ULONGLONG qwPrime = 0x9E3779B97F4A7C15ULL;
+	ULONGLONG h = nText * qwPrime;
+	ULONGLONG w;
+	size_t i = 0;
+
+	// Eight characters per multiply; the text is memory bound anyway
+	for (; i + 8 <= nText; i += 8)
+	{
+		memcpy(&w, pText + i, 8);
+		h = (h ^ w) * qwPrime;
+		h ^= h >> 31;
+	}
+	w = 0;
+	memcpy(&w, pText + i, nText - i);
+	h = (h ^ w) * qwPrime;
+	return h ^ (h >> 29);
+}
+
+BOOL ClipCacheLookup(const CLIPCACHE_KEY* pKey, CLIPCACHE_RESULT* pResult)
+{
+	// Without either there is nothing to recognise the text by
+	if (pKey->dwSequence == 0 && pKey->qwTextHash == 0)
+		return FALSE;
+
+	for (size_t i = 0; i < CLIPCACHE_MAX_ENTRIES; i++)
+	{
+		CLIPCACHE_ENTRY* pEntry = &g_Entries[i];
+		if (pEntry->pBuffer && ClipCacheKeyEqual(&pEntry->key, pKey))
+		{
+			pEntry->qwLastUse = ++g_qwUseCounter;
+			*pResult = pEntry->result;
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+BOOL ClipCacheStore(const CLIPCACHE_KEY* pKey, const CLIPCACHE_RESULT* pResult,
+	void* pBuffer, size_t nBuffer)
+{
+	size_t nBudget = ClipCacheBudget();
+
+	if ((pKey->dwSequence == 0 && pKey->qwTextHash == 0) || nBuffer > nBudget)
+		return FALSE;
+
+	// Evict least recently used entries until the buffer and a slot fit
+	for (;;)
+	{
+		CLIPCACHE_ENTRY* pFree = NULL;
+		CLIPCACHE_ENTRY* pOldest = NULL;
+		for (size_t i = 0; i < CLIPCACHE_MAX_ENTRIES; i++)
+		{
+			CLIPCACHE_ENTRY* pEntry = &g_Entries[i];
+			if (!pEntry->pBuffer)
+				pFree = pEntry;
+			else if (!pOldest || pEntry->qwLastUse < pOldest->qwLastUse)
+				pOldest = pEntry;
+		}
+
+		if (pFree && g_nCached + nBuffer <= nBudget)
+		{
+			pFree->key = *pKey;
+			pFree->result = *pResult;
+			pFree->pBuffer = pBuffer;
+			pFree->nBuffer = nBuffer;
+			pFree->qwLastUse = ++g_qwUseCounter;
+			g_nCached += nBuffer;
+			return TRUE;
+		}
+		if (!pOldest)
+			return FALSE;
+		ClipCacheEvict(pOldest);
+	}
+}
+
+void ClipCacheClear(void)
+{
+	for (size_t i = 0; i < CLIPCACHE_MAX_ENTRIES; i++)
+	{
+		if (g_Entries[i].pBuffer)
+			ClipCacheEvict(&g_Entries[i]);
+	}
+}
@@ -0,0 +1,52 @@
+// clipcache.h : keeps recent clipboard decodes so a repeated paste of the
+// same text skips the decode
+//
+
+#pragma once
+
+#include "decode.h"
+
+// Decoded bytes kept at most, unless [Clipboard] CacheMB says otherwise
+#define CLIPCACHE_DEFAULT_BUDGET_MB 512
+#define CLIPCACHE_MAX_ENTRIES 8
+
+// What was decoded, and how
+typedef struct _CLIPCACHE_KEY
+{
+	DWORD          dwSequence;	// GetClipboardSequenceNumber, 0 if unavailable
+	ULONGLONG      qwTextHash;	// ClipCacheHash of the text when dwSequence is 0
+	DECODE_MODE    eMode;
+	unsigned int   uWordSize;
+	BOOL           bBigEndian;
+	numlist_format number;
+	DECODE_KERNEL  pfnKernel;
+} CLIPCACHE_KEY;
+
+typedef struct _CLIPCACHE_RESULT
+{
+	const unsigned char* pOut;
+	size_t        nOut;
+	size_t        nIn;		// length of the text
+	size_t        nInUsed;
+	DECODE_STATUS eStatus;
+} CLIPCACHE_RESULT;
+
+// Fills the decode settings of pJob and the current clipboard sequence
+// number into pKey; qwTextHash is left 0
+void ClipCacheKeyFromJob(CLIPCACHE_KEY* pKey, const DECODE_JOB* pJob);
+
+// 64-bit hash of the clipboard text, for hosts without sequence numbers
+ULONGLONG ClipCacheHash(const char* pText, size_t nText);
+
+// On a hit, pResult points into the cache and stays valid until the next
+// ClipCacheStore or ClipCacheClear
+BOOL ClipCacheLookup(const CLIPCACHE_KEY* pKey, CLIPCACHE_RESULT* pResult);
+
+// Hands pBuffer (a bufpool buffer of nBuffer bytes holding pResult->pOut)
+// to the cache, evicting the least recently used entries to make room.
+// Returns FALSE, leaving pBuffer with the caller, if it does not fit.
+BOOL ClipCacheStore(const CLIPCACHE_KEY* pKey, const CLIPCACHE_RESULT* pResult,
+	void* pBuffer, size_t nBuffer);
+
+// Releases every entry; called from DllMain
+void ClipCacheClear(void);
@@ -0,0 +1,134 @@
+/* codec.cpp : C API of the codec core */
+
+#include "codec.h"
+#include "hex.h"
+#include "base64.h"
+#include "ascii85.h"
+#include "hexdump.h"
+#include "bitstr.h"
+#include "compact.h"
+#include "sniff.h"
+
+typedef size_t (*codec_kernel)(const char* in, size_t inlen, unsigned char* out,
+	int final, size_t* inused);
+
+/* by CODEC_* */
+static const codec_kernel codec_kernels[] = {
+	0,
+	hex_decode_t<hex_policy_blanks>,
+	hex_decode_t<hex_policy_strict>,
+	hex_decode_t<hex_policy_separated>,
+	hex_decode_t<hex_policy_prefixed>,
+	hex_decode_t<hex_policy_filter>,
+	base64_decode_t<base64_policy_strict>,
+	base64_decode_t<base64_policy_lines>,
+	base64_decode_t<base64_policy_url>,
+	base64_decode_t<base64_policy_filter>,
+	ascii85_decode,
+	hexdump_parse,
+	bitstr_decode_msb,
+	bitstr_decode_lsb,
+};
+
+#define CODEC_COUNT (sizeof(codec_kernels) / sizeof(codec_kernels[0]))
+
+/* by SNIFF_* */
+static const int codec_sniffed[] = {
+	0,
+	CODEC_HEX_SEPARATED,
+	CODEC_HEX_PREFIXED,
+	CODEC_HEXDUMP,
+	CODEC_BASE64_LINES,
+	CODEC_BASE64_URL,
+	0,                      /* PEM blocks / data: URIs need their envelope read */
+	CODEC_ASCII85,
+	0,                      /* Intel HEX records carry addresses */
+};
+
+unsigned int
+codec_version(void)
+{
+	return CODEC_VERSION;
+}
+
+size_t
+codec_decode_bound(int codec, const char* in, size_t inlen)
+{
+	if (codec <= 0 || (size_t)codec >= CODEC_COUNT) {
+		return 0;
+	}
+	if (codec == CODEC_ASCII85) {
+		return ascii85_decode_out_size(in, inlen);
+	}
+	if (codec >= CODEC_BASE64 && codec <= CODEC_BASE64_FILTER) {
+		/* an unpadded last quantum adds up to two bytes */
+		return BASE64_DECODE_OUT_SIZE64(inlen) + 2;
+	}
+	if (codec == CODEC_BITS_MSB || codec == CODEC_BITS_LSB) {
+		return BITSTR_DECODE_OUT_SIZE(inlen);
+	}
+	return HEX_DECODE_OUT_SIZE(inlen);
+}
+
+size_t
+codec_decode(int codec, const char* in, size_t inlen, unsigned char* out,
+	int final, size_t* inused)
+{
+	if (codec <= 0 || (size_t)codec >= CODEC_COUNT) {
+		*inused = 0;
+		return 0;
+	}
+	return codec_kernels[codec](in, inlen, out, final, inused);
+}
+
+size_t
+codec_encode_bound(int codec, size_t inlen)
+{
+	if (codec == CODEC_HEX) {
+		return HEX_ENCODE_OUT_SIZE(inlen, 0);
+	}
+	if (codec == CODEC_BASE64) {
+		return BASE64_ENCODE_OUT_SIZE64(inlen);
+	}
+	return 0;
+}
+
+size_t
+codec_encode(int codec, const unsigned char* in, size_t inlen, char* out)
+{
+	if (codec == CODEC_HEX) {
+		return hex_encode(in, inlen, out, 0);
+	}
+	if (codec == CODEC_BASE64) {
+		return base64_encode64(in, inlen, out);
+	}
+	return 0;
+}
+
+/* blanks and line breaks, built on first use */
+struct codec_blanks {
+	compact_set set;
+
+	codec_blanks()
+	{
+		compact_set_init(&set, COMPACT_BLANKS);
+	}
+};
+
+size_t
+codec_compact(const char* in, size_t inlen, char* out)
+{
+	static const codec_blanks blanks;
+	return compact_text(&blanks.set, in, inlen, out);
+}
+
+int
+codec_sniff(const char* text, size_t len)
+{
+	int format = sniff_format(text, len < SNIFF_SAMPLE_SIZE ? len : SNIFF_SAMPLE_SIZE);
+
+	if (format < 0 || (size_t)format >= sizeof(codec_sniffed) / sizeof(codec_sniffed[0])) {
+		return 0;
+	}
+	return codec_sniffed[format];
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <stddef.h>
+
+/*
+ * C API of the codec core: the hex / base64 family of text decoders and
+ * encoders the plugin is built on, for use outside Hex Workshop. The
+ * numbers below are part of the API and never change meaning; new codecs
+ * get new numbers.
+ *
+ * The plugin itself links the same library but calls the kernels through
+ * their C++ headers (hex.h, base64.h, ...).
+ */
+
+#define CODEC_VERSION 1
+
+/* text conventions; see the policies in hex.h and base64.h, and bitstr.h */
+#define CODEC_HEX            1   /* pairs, blanks between them */
+#define CODEC_HEX_STRICT     2   /* digits only */
+#define CODEC_HEX_SEPARATED  3   /* "de:ad:be:ef", "DE-AD", "DE,AD" */
+#define CODEC_HEX_PREFIXED   4   /* "0x4D, 0x5A", "\x4d\x5a" */
+#define CODEC_HEX_FILTER     5   /* every hex digit, anything else dropped */
+#define CODEC_BASE64         6   /* one unbroken, padded string */
+#define CODEC_BASE64_LINES   7   /* MIME / PEM bodies */
+#define CODEC_BASE64_URL     8   /* URL-safe alphabet, padding optional */
+#define CODEC_BASE64_FILTER  9   /* every base64 character, anything else dropped */
+#define CODEC_ASCII85        10  /* btoa / Adobe, "<~" "~>" optional */
+#define CODEC_HEXDUMP        11  /* xxd and hexdump -C text */
+#define CODEC_BITS_MSB       12  /* "01001000 01101001", first bit the most significant */
+#define CODEC_BITS_LSB       13  /* the same, first bit the least significant */
+
+#if defined(__GNUC__)
+#define CODEC_API __attribute__((visibility("default")))
+#else
+#define CODEC_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * return values is CODEC_VERSION of the library
+ */
+CODEC_API unsigned int
+codec_version(void);
+
+/*
+ * Output size codec_decode needs for in[0..inlen).
+ * return values is 0 for an unknown codec
+ */
+CODEC_API size_t
+codec_decode_bound(int codec, const char* in, size_t inlen);
+
+/*
+ * Decodes text; stops at the first character the codec rejects. Unless
+ * final is non-zero, an incomplete pair / quantum / group at the end of
+ * the input is left unconsumed so it can be completed by the next call.
+ * Except for CODEC_ASCII85, out may be in: decoding in place needs no
+ * second buffer, and in[inused..inlen) is left as it was.
+ * inused receives the number of characters consumed.
+ * return values is out length
+ */
+CODEC_API size_t
+codec_decode(int codec, const char* in, size_t inlen, unsigned char* out,
+	int final, size_t* inused);
+
+/*
+ * Output size codec_encode needs, including the terminating `\0'.
+ * return values is 0 unless codec is CODEC_HEX or CODEC_BASE64
+ */
+CODEC_API size_t
+codec_encode_bound(int codec, size_t inlen);
+
+/*
+ * Upper-case hex digits, or padded base64, on one line.
+ * out is null-terminated encode string.
+ * return values is out length, exclusive terminating `\0'
+ */
+CODEC_API size_t
+codec_encode(int codec, const unsigned char* in, size_t inlen, char* out);
+
+/*
+ * Copies in to out without blanks and line breaks; out may be in and
+ * must hold inlen bytes.
+ * return values is out length
+ */
+CODEC_API size_t
+codec_compact(const char* in, size_t inlen, char* out);
+
+/*
+ * Guesses the codec of a text from its first few KB.
+ * return values is CODEC_*, or 0 if the text matches none
+ */
+CODEC_API int
+codec_sniff(const char* text, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CODEC_H */
@@ -0,0 +1,136 @@
+/* compact.cpp : separator removal ahead of the decode kernels */
+
+#include "compact.h"
+#include "cpu.h"
+
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define COMPACT_SSSE3
+#include <tmmintrin.h>
+#endif
+
+#ifdef COMPACT_SSSE3
+/* shuffles that move the kept bytes of 8 to the front, by keep mask */
+struct compact_tables {
+	unsigned char pack[256][8];
+	unsigned char count[256];
+
+	compact_tables()
+	{
+		int m;
+		int k;
+
+		for (m = 0; m < 256; m++) {
+			int n = 0;
+			for (k = 0; k < 8; k++) {
+				if (m & (1 << k)) {
+					pack[m][n++] = (unsigned char)k;
+				}
+			}
+			count[m] = (unsigned char)n;
+			for (; n < 8; n++) {
+				pack[m][n] = 0x80;
+			}
+		}
+	}
+};
+
+static const compact_tables*
+compact_tables_get(void)
+{
+	static const compact_tables tables;
+	return &tables;
+}
+
+/*
+ * Whole 16-byte blocks while they last.
+ * return values is characters consumed; *outlen receives bytes written
+ */
+CPU_TARGET_SSSE3 static size_t
+compact_ssse3(const compact_set* set, const char* in, size_t inlen, char* out, size_t* outlen)
+{
+	const compact_tables* t = compact_tables_get();
+	const __m128i rows = _mm_loadu_si128((const __m128i*)set->lo_rows);
+	/* bit h for high nibble h < 8; 0x80 and up are never separators */
+	const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)0x80, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i mask = _mm_set1_epi8(0x0F);
+	size_t i = 0;
+	size_t j = 0;
+
+	for (; inlen - i >= 16; i += 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+		const __m128i hit = _mm_and_si128(_mm_shuffle_epi8(rows, _mm_and_si128(v, mask)),
+			_mm_shuffle_epi8(bits, _mm_and_si128(_mm_srli_epi16(v, 4), mask)));
+		const unsigned int keep = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(hit, _mm_setzero_si128()));
+
+		if (keep == 0xFFFF) {
+			_mm_storeu_si128((__m128i*)(out + j), v);
+			j += 16;
+			continue;
+		}
+
+		/* 8 bytes per half: the stores never reach past in + i + 16 */
+		const unsigned int lo = keep & 0xFF;
+		const unsigned int hi = keep >> 8;
+		_mm_storel_epi64((__m128i*)(out + j),
+			_mm_shuffle_epi8(v, _mm_loadl_epi64((const __m128i*)t->pack[lo])));
+		j += t->count[lo];
+		_mm_storel_epi64((__m128i*)(out + j),
+			_mm_shuffle_epi8(_mm_srli_si128(v, 8), _mm_loadl_epi64((const __m128i*)t->pack[hi])));
+		j += t->count[hi];
+	}
+
+	*outlen = j;
+	return i;
+}
+#endif
+
+void
+compact_set_init(compact_set* set, const char* chars)
+{
+	memset(set, 0, sizeof(*set));
+	set->ascii_only = 1;
+	for (; *chars; chars++) {
+		unsigned char c = (unsigned char)*chars;
+		set->member[c] = 1;
+		if (c < 0x80) {
+			set->lo_rows[c & 0x0F] |= (unsigned char)(1 << (c >> 4));
+		}
+		else {
+			set->ascii_only = 0;
+		}
+	}
+}
+
+size_t
+compact_text(const compact_set* set, const char* in, size_t inlen, char* out)
+{
+	size_t i = 0;
+	size_t j = 0;
+
+#ifdef COMPACT_SSSE3
+	if (set->ascii_only && cpu_has_ssse3()) {
+		i = compact_ssse3(set, in, inlen, out, &j);
+	}
+#endif
+	for (; i < inlen; i++) {
+		out[j] = in[i];
+		j += !set->member[(unsigned char)in[i]];
+	}
+
+	return j;
+}
+
+size_t
+compact_locate(const compact_set* set, const char* in, size_t inlen, size_t kept)
+{
+	size_t i;
+
+	for (i = 0; i < inlen; i++) {
+		if (!set->member[(unsigned char)in[i]] && kept-- == 0) {
+			return i;
+		}
+	}
+	return inlen;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#ifndef COMPACT_H
+#define COMPACT_H
+
+#include <stddef.h>
+
+/*
+ * Removes separator characters from text before it is decoded, so the
+ * decode kernels only ever see unbroken digits. With SSSE3, 16 characters
+ * are classified with two nibble lookups and the rest are left-packed with
+ * one shuffle per half; runs without separators are copied as they are.
+ *
+ * Builds without the plugin's precompiled header, so the Linux benchmark
+ * in bench/ can use it as is.
+ */
+
+/* blanks and line breaks, as IsSkipChar */
+#define COMPACT_BLANKS " \t\r\n"
+
+typedef struct compact_set {
+	unsigned char member[256];   /* non-zero for separators */
+	unsigned char lo_rows[16];   /* by low nibble: bit h set if 0xh? is a separator */
+	int ascii_only;              /* no separator at or above 0x80 */
+} compact_set;
+
+/*
+ * chars holds the separators, a null-terminated string.
+ */
+void
+compact_set_init(compact_set* set, const char* chars);
+
+/*
+ * Copies in[0..inlen) to out without the separators; out may be in.
+ * out must hold inlen bytes: the vector stores write past the end of the
+ * output, but never past out + inlen.
+ * return values is out length
+ */
+size_t
+compact_text(const compact_set* set, const char* in, size_t inlen, char* out);
+
+/*
+ * Position in in[0..inlen) of the character that compact_text put at
+ * out[kept], or inlen if there are not that many.
+ */
+size_t
+compact_locate(const compact_set* set, const char* in, size_t inlen, size_t kept);
+
+#endif /* COMPACT_H */
@@ -0,0 +1,178 @@
+// compare.cpp : compares decoded hex / base64 text with the bytes of the
+// document, without changing either
+//
+
+#include "stdafx.h"
+
+#include <tchar.h>
+
+#include "compare.h"
+#include "bufpool.h"
+#include "memdiff.h"
+#include "docread.h"
+
+static void AddRange(COMPARE_RESULT* pResult, QWORD qwStart, QWORD qwEnd)
+{
+	if (pResult->nRanges < COMPARE_MAX_RANGES)
+	{
+		pResult->pRanges[pResult->nRanges].qwStart = qwStart;
+		pResult->pRanges[pResult->nRanges].qwLength = qwEnd - qwStart;
+	}
+	pResult->nRanges++;
+}
+
+// Adds the ranges where pDecoded and pDocument differ.  *pbOpen says a
+// range is still open from the last chunk (since *pqwOpenStart), and on
+// return whether one runs on past the end of this one.
+static void CompareChunk(COMPARE_RESULT* pResult, QWORD qwAt,
+	const unsigned char* pDecoded, const unsigned char* pDocument, size_t n,
+	BOOL* pbOpen, QWORD* pqwOpenStart)
+{
+	size_t i = 0;
+
+	while (i < n)
+	{
+		if (!*pbOpen)
+		{
+			i += memdiff_mismatch(pDecoded + i, pDocument + i, n - i);
+			if (i == n)
+				break;
+			*pbOpen = TRUE;
+			*pqwOpenStart = qwAt + i;
+		}
+
+		size_t nDiffering = memdiff_match(pDecoded + i, pDocument + i, n - i);
+		pResult->qwDiffering += nDiffering;
+		i += nDiffering;
+		if (i == n)
+			break;
+		AddRange(pResult, *pqwOpenStart, qwAt + i);
+		*pbOpen = FALSE;
+	}
+}
+
+DECODE_STATUS CompareTextWithDocument(HWSESSION hSession, HWDOCUMENT hDoc,
+	QWORD qwPosition, DECODE_MODE eMode, const char* pText, size_t nText,
+	COMPARE_RESULT* pResult)
+{
+	DECODE_STATUS eStatus = DECODE_INVALID;
+	char* pChunk = NULL;
+	DOC_READER* pReader = NULL;
+	DOC_SPAN span;
+	size_t nSpanUsed = 0;
+	QWORD qwSize = 0;
+	BOOL bOpen = FALSE;
+	QWORD qwOpenStart = 0;
+
+	ZeroMemory(pResult, sizeof(*pResult));
+	ZeroMemory(&span, sizeof(span));
+	if (hwGetDocumentSize(hDoc, &qwSize) != HWAPI_RESULT_SUCCESS || qwPosition > qwSize)
+		return eStatus;
+
+	__try
+	{
+		// The text is decoded where it was copied to, and never inserted
+		pChunk = (char*)bufpool_alloc(DECODE_CHUNK_SIZE);
+		pResult->pRanges = (COMPARE_RANGE*)bufpool_alloc(COMPARE_MAX_RANGES * sizeof(COMPARE_RANGE));
+		if (!pChunk || !pResult->pRanges)
+			__leave;
+
+		// The text never decodes to more bytes than it has characters
+		QWORD qwRange = qwSize - qwPosition;
+		if (qwRange > (QWORD)nText)
+			qwRange = nText;
+		pReader = DocReaderOpen(hSession, hDoc, qwPosition, qwRange, 0);
+		if (!pReader)
+			__leave;
+
+		size_t nPos = 0;
+		eStatus = DECODE_OK;
+		while (nPos < nText)
+		{
+			size_t nChunk = DECODE_CHUNK_SIZE;
+			if (nText - nPos < nChunk)
+				nChunk = nText - nPos;
+			BOOL bFinal = (nPos + nChunk == nText);
+
+			// DecodeTextChunk compacts the text, and the clipboard's must
+			// stay as it is
+			memcpy(pChunk, pText + nPos, nChunk);
+			size_t nOut = 0;
+			size_t nUsed = 0;
+			eStatus = DecodeTextChunk(eMode, pChunk, nChunk, bFinal,
+				(unsigned char*)pChunk, &nOut, &nUsed);
+			if (eStatus == DECODE_INVALID)
+				break;
+			// A token longer than a whole chunk cannot be decoded
+			if (nUsed == 0 && !bFinal)
+			{
+				eStatus = DECODE_INVALID;
+				break;
+			}
+
+			// Only what the document has can be compared
+			QWORD qwAt = qwPosition + pResult->qwDecoded;
+			size_t nCompare = 0;
+			if (qwAt < qwSize)
+				nCompare = (qwSize - qwAt < (QWORD)nOut) ? (size_t)(qwSize - qwAt) : nOut;
+			for (size_t nDone = 0; nDone < nCompare; )
+			{
+				if (nSpanUsed == span.nData)
+				{
+					if (!DocReaderNext(pReader, &span) || span.nData == 0)
+					{
+						eStatus = DECODE_INVALID;
+						break;
+					}
+					nSpanUsed = 0;
+				}
+				size_t n = span.nData - nSpanUsed;
+				if (nCompare - nDone < n)
+					n = nCompare - nDone;
+				CompareChunk(pResult, qwAt + nDone, (const unsigned char*)pChunk + nDone,
+					span.pData + nSpanUsed, n, &bOpen, &qwOpenStart);
+				nDone += n;
+				nSpanUsed += n;
+			}
+			if (eStatus == DECODE_INVALID)
+				break;
+			pResult->qwCompared += nCompare;
+			pResult->qwDecoded += nOut;
+			nPos += nUsed;
+			pResult->nTextUsed = nPos;
+
+			// Base64 padding ends the data before the end of the text
+			if (eStatus != DECODE_OK || bFinal)
+				break;
+
+			if (hwUpdateProgress(hSession, (int)((QWORD)nPos * 100 / nText),
+				_T("Comparing with document")) == HWAPI_RESULT_USER_ABORT)
+			{
+				eStatus = DECODE_CANCELLED;
+				break;
+			}
+		}
+
+		// A range still open ends where the comparison did
+		if (bOpen)
+			AddRange(pResult, qwOpenStart, qwPosition + pResult->qwCompared);
+	}
+	__finally
+	{
+		if (pChunk)
+			bufpool_free(pChunk);
+		DocReaderClose(pReader, NULL);
+	}
+
+	if (eStatus == DECODE_INVALID || eStatus == DECODE_CANCELLED)
+		CompareResultFree(pResult);
+	return eStatus;
+}
+
+void CompareResultFree(COMPARE_RESULT* pResult)
+{
+	if (pResult->pRanges)
+		bufpool_free(pResult->pRanges);
+	pResult->pRanges = NULL;
+	pResult->nRanges = 0;
+}
@@ -0,0 +1,38 @@
+// compare.h : compares decoded hex / base64 text with the bytes of the
+// document, without changing either
+//
+
+#pragma once
+
+#include "hwapi.h"
+#include "decode.h"
+
+// Differing ranges kept for bookmarking; further ones are only counted
+#define COMPARE_MAX_RANGES 4096
+
+typedef struct _COMPARE_RANGE
+{
+	QWORD qwStart;		// document offset
+	QWORD qwLength;
+} COMPARE_RANGE;
+
+typedef struct _COMPARE_RESULT
+{
+	QWORD          qwDecoded;	// bytes the text decoded to
+	QWORD          qwCompared;	// of those, bytes the document had to compare with
+	QWORD          qwDiffering;	// bytes that differ
+	size_t         nRanges;		// differing ranges, all of them
+	COMPARE_RANGE* pRanges;		// the first COMPARE_MAX_RANGES; see CompareResultFree
+	size_t         nTextUsed;	// characters decoded
+} COMPARE_RESULT;
+
+// Decodes pText (DECODE_MODE_HEX or DECODE_MODE_BASE64, as
+// DecodeTextChunk reads it) a chunk at a time and compares the bytes with
+// the document from qwPosition on.  Decoded bytes past the end of the
+// document are counted in qwDecoded only.  A range that differs across
+// two chunks is reported once.
+DECODE_STATUS CompareTextWithDocument(HWSESSION hSession, HWDOCUMENT hDoc,
+	QWORD qwPosition, DECODE_MODE eMode, const char* pText, size_t nText,
+	COMPARE_RESULT* pResult);
+
+void CompareResultFree(COMPARE_RESULT* pResult);
@@ -0,0 +1,59 @@
+// config.cpp : plugin settings read from an .ini file next to the DLL
+//
+
+#include "stdafx.h"
+
+#include <tchar.h>
+
+#include "config.h"
+
+static TCHAR g_szIniPath[MAX_PATH];
+
+void ConfigInit(HMODULE hModule)
+{
+	DWORD nLen = GetModuleFileName(hModule, g_szIniPath, MAX_PATH);
+	if (nLen == 0 || nLen >= MAX_PATH)
+	{
+		g_szIniPath[0] = 0;
+		return;
+	}
+
+	// Swap the extension of the DLL for .ini
+	LPTSTR lpszDot = _tcsrchr(g_szIniPath, _T('.'));
+	LPTSTR lpszSlash = _tcsrchr(g_szIniPath, _T('\\'));
+	if (!lpszDot || (lpszSlash && lpszDot < lpszSlash))
+		lpszDot = g_szIniPath + nLen;
+	if (lpszDot + 4 >= g_szIniPath + MAX_PATH)
+	{
+		g_szIniPath[0] = 0;
+		return;
+	}
+	_tcscpy(lpszDot, _T(".ini"));
+}
+
+void ConfigGetString(LPCTSTR lpszSection, LPCTSTR lpszKey, LPCTSTR lpszDefault,
+	LPTSTR lpszOut, DWORD nOut)
+{
+	if (!g_szIniPath[0])
+	{
+		_tcsncpy(lpszOut, lpszDefault, nOut);
+		lpszOut[nOut - 1] = 0;
+		return;
+	}
+	GetPrivateProfileString(lpszSection, lpszKey, lpszDefault, lpszOut, nOut, g_szIniPath);
+}
+
+UINT ConfigGetInt(LPCTSTR lpszSection, LPCTSTR lpszKey, UINT uDefault)
+{
+	if (!g_szIniPath[0])
+		return uDefault;
+	return GetPrivateProfileInt(lpszSection, lpszKey, uDefault, g_szIniPath);
+}
+
+void ConfigGetKeys(LPCTSTR lpszSection, LPTSTR lpszOut, DWORD nOut)
+{
+	lpszOut[0] = 0;
+	lpszOut[1] = 0;
+	if (g_szIniPath[0])
+		GetPrivateProfileString(lpszSection, NULL, _T(""), lpszOut, nOut, g_szIniPath);
+}
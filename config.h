@@ -0,0 +1,25 @@
+// config.h : plugin settings read from an .ini file next to the DLL
+//
+
+#pragma once
+
+// Settings live in <plugin name>.ini beside the plugin DLL, for example
+//
+//   [Autoexec]
+//   HexExtensions=hex
+//   Base64Extensions=b64;pem
+//
+// Missing files, sections and keys fall back to the defaults passed in.
+
+// Remembers where the plugin was loaded from; called from DllMain
+void ConfigInit(HMODULE hModule);
+
+// Copies the value of [lpszSection] lpszKey, or lpszDefault, to lpszOut
+void ConfigGetString(LPCTSTR lpszSection, LPCTSTR lpszKey, LPCTSTR lpszDefault,
+	LPTSTR lpszOut, DWORD nOut);
+
+UINT ConfigGetInt(LPCTSTR lpszSection, LPCTSTR lpszKey, UINT uDefault);
+
+// Copies the key names of [lpszSection] to lpszOut, each null-terminated,
+// with an empty name after the last
+void ConfigGetKeys(LPCTSTR lpszSection, LPTSTR lpszOut, DWORD nOut);
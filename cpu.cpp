@@ -0,0 +1,46 @@
+/* cpu.cpp : run-time CPU feature checks */
+
+#include "cpu.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CPU_CPUID(leaf, r) __cpuid(r, leaf)
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define CPU_CPUID(leaf, r) __cpuid(leaf, r[0], r[1], r[2], r[3])
+#endif
+
+/* -1 until detected; racing first calls store the same value */
+static volatile int cpu_flags = -1;
+
+static int
+cpu_detect(void)
+{
+	int flags = 0;
+
+#ifdef CPU_CPUID
+	int r[4];
+
+	CPU_CPUID(0, r);
+	if (r[0] >= 1) {
+		CPU_CPUID(1, r);
+		if (r[2] & (1 << 9)) {
+			flags |= CPU_SSSE3;
+		}
+	}
+#endif
+
+	return flags;
+}
+
+int
+cpu_features(void)
+{
+	int flags = cpu_flags;
+
+	if (flags < 0) {
+		flags = cpu_detect();
+		cpu_flags = flags;
+	}
+	return flags;
+}
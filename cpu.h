@@ -0,0 +1,28 @@
+#pragma once
+
+#ifndef CPU_H
+#define CPU_H
+
+/*
+ * Run-time CPU feature checks for kernels that go beyond the SSE2
+ * baseline. Detection runs once, on first use.
+ */
+
+#define CPU_SSSE3 0x01
+
+/* gcc / clang only emit instructions the function is marked for */
+#if defined(__GNUC__)
+#define CPU_TARGET_SSSE3 __attribute__((target("ssse3")))
+#else
+#define CPU_TARGET_SSSE3
+#endif
+
+/*
+ * return values is CPU_* bits
+ */
+int
+cpu_features(void);
+
+#define cpu_has_ssse3() ((cpu_features() & CPU_SSSE3) != 0)
+
+#endif /* CPU_H */
@@ -0,0 +1,597 @@
+// decode.cpp : chunked decode jobs shared by the plugin commands
+//
+
+#include "stdafx.h"
+
+#include <string.h>
+
+#include "decode.h"
+#include "hex.h"
+#include "base64.h"
+#include "ascii85.h"
+#include "ihex.h"
+#include "bitstr.h"
+#include "compact.h"
+#include "bufpool.h"
+
+void DecodeJobInit(DECODE_JOB* pJob, DECODE_MODE eMode,
+	const char* pIn, size_t nIn)
+{
+	pJob->eMode = eMode;
+	pJob->pIn = pIn;
+	pJob->nIn = nIn;
+	pJob->uWordSize = 1;
+	pJob->bBigEndian = TRUE;
+	pJob->number.size = 1;
+	pJob->number.is_float = 0;
+	pJob->number.is_signed = 0;
+	pJob->number.bigendian = 0;
+	pJob->pfnKernel = (eMode == DECODE_MODE_ASCII85) ? ascii85_decode :
+		(eMode == DECODE_MODE_BITS) ? bitstr_decode_msb : NULL;
+	pJob->pOut = NULL;
+	pJob->nOut = 0;
+	pJob->nInUsed = 0;
+	pJob->eStatus = DECODE_OK;
+	WorkerProgressInit(&pJob->progress, nIn);
+}
+
+size_t DecodeJobOutSize(const DECODE_JOB* pJob)
+{
+	if (pJob->eMode == DECODE_MODE_ASCII85)
+		return ascii85_decode_out_size(pJob->pIn, pJob->nIn);
+	if (pJob->eMode == DECODE_MODE_INTEL_HEX)
+		return IHEX_DECODE_OUT_SIZE(pJob->nIn);
+	if (pJob->eMode == DECODE_MODE_BITS)
+		return BITSTR_DECODE_OUT_SIZE(pJob->nIn);
+	// An unpadded last quantum adds up to two bytes
+	if (pJob->pfnKernel && pJob->eMode == DECODE_MODE_BASE64)
+		return BASE64_DECODE_OUT_SIZE64(pJob->nIn) + 2;
+	if (pJob->eMode == DECODE_MODE_BASE64)
+		return BASE64_DECODE_OUT_SIZE64(pJob->nIn);
+	if (pJob->eMode == DECODE_MODE_NUMBERS)
+		return NUMLIST_OUT_SIZE(pJob->nIn, pJob->number.size);
+	if (pJob->uWordSize > 1)
+		return HEX_DECODE_WORDS_OUT_SIZE(pJob->nIn, pJob->uWordSize);
+	return HEX_DECODE_OUT_SIZE(pJob->nIn);
+}
+
+static DECODE_STATUS DecodeHex(DECODE_JOB* pJob)
+{
+	size_t pos = 0;
+
+	while (pos < pJob->nIn)
+	{
+		if (WorkerCancelled(&pJob->progress))
+			return DECODE_CANCELLED;
+
+		size_t n = pJob->nIn - pos;
+		if (n > DECODE_CHUNK_SIZE)
+			n = DECODE_CHUNK_SIZE;
+
+		size_t used = 0;
+		pJob->nOut += hex_decode(pJob->pIn + pos, n, pJob->pOut + pJob->nOut, &used);
+		pos += used;
+		pJob->nInUsed = pos;
+		WorkerProgressSet(&pJob->progress, pos);
+
+		if (used == n)
+			continue;
+		// A pair split by the chunk boundary is picked up by the next chunk
+		if (n - used == 1 && pos + 1 < pJob->nIn && IsHexChar(pJob->pIn[pos]))
+			continue;
+
+		// A single character left over is reported, anything else is malformed
+		if (pos + 1 >= pJob->nIn)
+			return DECODE_TRUNCATED;
+		pJob->nOut = 0;
+		return DECODE_INVALID;
+	}
+
+	return DECODE_OK;
+}
+
+static DECODE_STATUS DecodeHexWords(DECODE_JOB* pJob)
+{
+	size_t pos = 0;
+
+	while (pos < pJob->nIn)
+	{
+		if (WorkerCancelled(&pJob->progress))
+			return DECODE_CANCELLED;
+
+		size_t n = pJob->nIn - pos;
+		if (n > DECODE_CHUNK_SIZE)
+			n = DECODE_CHUNK_SIZE;
+		BOOL bFinal = (pos + n == pJob->nIn);
+
+		size_t used = 0;
+		pJob->nOut += hex_decode_words(pJob->pIn + pos, n, pJob->pOut + pJob->nOut,
+			pJob->uWordSize, pJob->bBigEndian, bFinal, &used);
+		pos += used;
+		pJob->nInUsed = pos;
+		WorkerProgressSet(&pJob->progress, pos);
+
+		if (used == n)
+			continue;
+		// A group cut by the chunk boundary is finished by the next chunk
+		if (!bFinal && IsHexChar(pJob->pIn[pos]))
+			continue;
+
+		pJob->nOut = 0;
+		return DECODE_INVALID;
+	}
+
+	return DECODE_OK;
+}
+
+static DECODE_STATUS DecodeNumbers(DECODE_JOB* pJob)
+{
+	size_t pos = 0;
+
+	while (pos < pJob->nIn)
+	{
+		if (WorkerCancelled(&pJob->progress))
+			return DECODE_CANCELLED;
+
+		size_t n = pJob->nIn - pos;
+		if (n > DECODE_CHUNK_SIZE)
+			n = DECODE_CHUNK_SIZE;
+		BOOL bFinal = (pos + n == pJob->nIn);
+
+		size_t used = 0;
+		pJob->nOut += numlist_parse(pJob->pIn + pos, n, pJob->pOut + pJob->nOut,
+			&pJob->number, bFinal, &used);
+		pos += used;
+		pJob->nInUsed = pos;
+		WorkerProgressSet(&pJob->progress, pos);
+
+		if (used == n)
+			continue;
+		// A value cut by the chunk boundary is finished by the next chunk;
+		// a token longer than a whole chunk is not a number
+		if (!bFinal && used > 0)
+			continue;
+
+		pJob->nOut = 0;
+		return DECODE_INVALID;
+	}
+
+	return DECODE_OK;
+}
+
+static DECODE_STATUS DecodeIntelHex(DECODE_JOB* pJob)
+{
+	size_t pos = 0;
+	ihex_state state;
+
+	ihex_init(&state);
+	while (pos < pJob->nIn)
+	{
+		if (WorkerCancelled(&pJob->progress))
+			return DECODE_CANCELLED;
+
+		size_t n = pJob->nIn - pos;
+		if (n > DECODE_CHUNK_SIZE)
+			n = DECODE_CHUNK_SIZE;
+		BOOL bFinal = (pos + n == pJob->nIn);
+
+		size_t used = 0;
+		pJob->nOut += ihex_decode(pJob->pIn + pos, n, pJob->pOut + pJob->nOut,
+			&state, bFinal, &used);
+		pos += used;
+		pJob->nInUsed = pos;
+		WorkerProgressSet(&pJob->progress, pos);
+
+		if (used == n)
+			continue;
+		// A record cut by the chunk boundary is finished by the next chunk
+		if (!bFinal && used > 0)
+			continue;
+
+		// A bad record or a gap: the records before it are kept
+		if (pJob->nOut == 0)
+			return DECODE_INVALID;
+		return DECODE_TRUNCATED;
+	}
+
+	return DECODE_OK;
+}
+
+static DECODE_STATUS DecodeBase64(DECODE_JOB* pJob)
+{
+	size_t pos = 0;
+
+	if (pJob->nIn & 0x3)
+		return DECODE_INVALID;
+
+	while (pos < pJob->nIn)
+	{
+		if (WorkerCancelled(&pJob->progress))
+			return DECODE_CANCELLED;
+
+		size_t n = pJob->nIn - pos;
+		if (n > DECODE_CHUNK_SIZE)
+			n = DECODE_CHUNK_SIZE;
+
+		size_t ret = base64_decode64(pJob->pIn + pos, n, pJob->pOut + pJob->nOut);
+		if (ret == 0 && pJob->pIn[pos] != '=')
+		{
+			pJob->nOut = 0;
+			return DECODE_INVALID;
+		}
+		pJob->nOut += ret;
+		pos += n;
+		pJob->nInUsed = pos;
+		WorkerProgressSet(&pJob->progress, pos);
+
+		// Padding ends the data
+		if (ret != BASE64_DECODE_OUT_SIZE64(n))
+			break;
+	}
+
+	return DECODE_OK;
+}
+
+// Text compacted per step: small enough that the compacted digits are
+// still in the cache when the kernel reads them
+#define COMPACT_CHUNK_SIZE (64 * 1024)
+
+// Position in pJob->pIn of the first of the last nKept digits of
+// pIn[pos..pos+n), walking back over the separators
+static size_t CompactedTail(const compact_set* pSet, const char* pIn, size_t pos,
+	size_t n, size_t nKept)
+{
+	size_t i = pos + n;
+
+	while (nKept && i > pos)
+	{
+		if (!pSet->member[(unsigned char)pIn[--i]])
+			nKept--;
+	}
+	return i;
+}
+
+static BOOL IsBase64Char(char c)
+{
+	return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+		(c >= '0' && c <= '9') || c == '+' || c == '/';
+}
+
+// Plain hex and base64: blanks are compacted out of each step first, so
+// the strict kernels run on unbroken digits. A pair or quantum cut by the
+// end of a step is carried to the front of the next one.
+static DECODE_STATUS DecodeCompacted(DECODE_JOB* pJob, char* pBuf)
+{
+	compact_set set;
+	BOOL bHex = (pJob->eMode == DECODE_MODE_HEX);
+	size_t nCarry = 0;
+	size_t aCarryPos[4];	// where the carried digits are in pIn
+	size_t pos = 0;
+
+	compact_set_init(&set, COMPACT_BLANKS);
+	while (pos < pJob->nIn)
+	{
+		if (WorkerCancelled(&pJob->progress))
+			return DECODE_CANCELLED;
+
+		size_t n = pJob->nIn - pos;
+		if (n > COMPACT_CHUNK_SIZE)
+			n = COMPACT_CHUNK_SIZE;
+		BOOL bFinal = (pos + n == pJob->nIn);
+
+		size_t nText = nCarry + compact_text(&set, pJob->pIn + pos, n, pBuf + nCarry);
+		size_t used = 0;
+		if (bHex)
+			pJob->nOut += hex_decode_t<hex_policy_strict>(pBuf, nText,
+				pJob->pOut + pJob->nOut, bFinal, &used);
+		else
+			pJob->nOut += base64_decode_t<base64_policy_strict>(pBuf, nText,
+				pJob->pOut + pJob->nOut, bFinal, &used);
+		size_t nLeft = nText - used;
+
+		// Where the kernel stopped, in the original text
+		size_t nStop;
+		if (used < nCarry)
+			nStop = aCarryPos[used];
+		else
+			nStop = CompactedTail(&set, pJob->pIn, pos, n, nLeft);
+
+		// Padding ends the data; only blanks may follow it, and anything
+		// else is left undecoded
+		if (!bHex && used && pBuf[used - 1] == '=')
+		{
+			pJob->nInUsed = nStop;
+			if (nLeft == 0 && compact_locate(&set, pJob->pIn + nStop, pJob->nIn - nStop, 0) == pJob->nIn - nStop)
+				pJob->nInUsed = pJob->nIn;
+			WorkerProgressSet(&pJob->progress, pJob->nIn);
+			return pJob->nInUsed == pJob->nIn ? DECODE_OK : DECODE_TRUNCATED;
+		}
+
+		BOOL bDigits = TRUE;
+		for (size_t i = used; i < nText; i++)
+			bDigits = bDigits && (bHex ? IsHexChar(pBuf[i]) : IsBase64Char(pBuf[i]));
+
+		// A pair or quantum cut by the step boundary is finished by the next
+		// step; at the end it is reported, anything else is malformed
+		if (nLeft >= (size_t)(bHex ? 2 : 4) || !bDigits)
+		{
+			pJob->nInUsed = nStop;
+			pJob->nOut = 0;
+			return DECODE_INVALID;
+		}
+		if (bFinal)
+		{
+			pJob->nInUsed = nLeft ? nStop : pJob->nIn;
+			WorkerProgressSet(&pJob->progress, pJob->nIn);
+			return nLeft ? DECODE_TRUNCATED : DECODE_OK;
+		}
+
+		for (size_t i = 0; i < nLeft; i++)
+		{
+			aCarryPos[i] = (used + i < nCarry) ? aCarryPos[used + i] :
+				CompactedTail(&set, pJob->pIn, pos, n, nText - used - i);
+			pBuf[i] = pBuf[used + i];
+		}
+		nCarry = nLeft;
+		pos += n;
+		pJob->nInUsed = nCarry ? aCarryPos[0] : pos;
+		WorkerProgressSet(&pJob->progress, pos);
+	}
+
+	return DECODE_OK;
+}
+
+// Characters a kernel may leave for the next chunk: a pair or quantum, a
+// byte of bits broken up by blanks, a hex dump line cut short.  More than
+// that means it stopped for good.
+#define DECODE_MAX_CARRY 256
+
+// Whether the text consumed up to pos ends the data, so that nothing after
+// it may be decoded: base64 padding, or the "~>" of Ascii85
+static BOOL DecodeKernelEnded(const DECODE_JOB* pJob, size_t pos)
+{
+	while (pos > 0 && IsSkipChar(pJob->pIn[pos - 1]))
+		pos--;
+
+	if (pJob->eMode == DECODE_MODE_BASE64)
+		return pos > 0 && pJob->pIn[pos - 1] == '=';
+	if (pJob->eMode == DECODE_MODE_ASCII85)
+		return pos > 1 && pJob->pIn[pos - 2] == '~' && pJob->pIn[pos - 1] == '>';
+	return FALSE;
+}
+
+static DECODE_STATUS DecodeKernel(DECODE_JOB* pJob)
+{
+	size_t pos = 0;
+
+	while (pos < pJob->nIn)
+	{
+		if (WorkerCancelled(&pJob->progress))
+			return DECODE_CANCELLED;
+
+		size_t n = pJob->nIn - pos;
+		if (n > DECODE_CHUNK_SIZE)
+			n = DECODE_CHUNK_SIZE;
+		BOOL bFinal = (pos + n == pJob->nIn);
+
+		size_t used = 0;
+		pJob->nOut += pJob->pfnKernel(pJob->pIn + pos, n, pJob->pOut + pJob->nOut,
+			bFinal, &used);
+		pos += used;
+		pJob->nInUsed = pos;
+		WorkerProgressSet(&pJob->progress, pos);
+
+		if (used == n)
+			continue;
+		// A pair or quantum cut by the chunk boundary is finished by the
+		// next chunk; the kernel is not restarted after the end of the data
+		if (!bFinal && used > 0 && n - used <= DECODE_MAX_CARRY &&
+			!DecodeKernelEnded(pJob, pos))
+			continue;
+
+		// Blanks and line breaks after the last of the data are not cut
+		// off, even for policies that allow none in between
+		size_t nTail = pos;
+		while (nTail < pJob->nIn && IsSkipChar(pJob->pIn[nTail]))
+			nTail++;
+		if (nTail == pJob->nIn)
+		{
+			pJob->nInUsed = nTail;
+			WorkerProgressSet(&pJob->progress, nTail);
+			return DECODE_OK;
+		}
+
+		// The policy stops here; what was decoded so far is kept
+		return DECODE_TRUNCATED;
+	}
+
+	return DECODE_OK;
+}
+
+static DECODE_STATUS DecodeHexChunk(char* pText, size_t nText, BOOL bFinal,
+	unsigned char* pOut, size_t* pnOut, size_t* pnUsed)
+{
+	*pnOut = hex_decode(pText, nText, pOut, pnUsed);
+	if (*pnUsed == nText)
+		return DECODE_OK;
+
+	// A pair cut by the chunk boundary is read again with the next chunk
+	if (!bFinal && nText - *pnUsed == 1 && IsHexChar(pText[*pnUsed]))
+		return DECODE_OK;
+	if (bFinal && nText - *pnUsed == 1)
+		return DECODE_TRUNCATED;
+	return DECODE_INVALID;
+}
+
+// Length of the armor line at pText[i] ('-' never occurs in base64), or 0
+// if it is not terminated before nText
+static size_t DecodeArmorLine(const char* pText, size_t nText, size_t i)
+{
+	const char* pEol = (const char*)memchr(pText + i, '\n', nText - i);
+	return pEol ? (size_t)(pEol - pText) + 1 - i : 0;
+}
+
+static DECODE_STATUS DecodeBase64Chunk(char* pText, size_t nText, BOOL bFinal,
+	unsigned char* pOut, size_t* pnOut, size_t* pnUsed)
+{
+	// Count the characters to decode; an armor line cut by the chunk end
+	// is left for the next chunk
+	size_t nEnd = nText;
+	size_t n = 0;
+	for (size_t i = 0; i < nEnd; i++)
+	{
+		if (pText[i] == '-')
+		{
+			size_t nArmor = DecodeArmorLine(pText, nText, i);
+			if (nArmor == 0 && !bFinal)
+				nEnd = i;
+			i = nArmor ? i + nArmor - 1 : nEnd;
+			continue;
+		}
+		if (!IsSkipChar(pText[i]))
+			n++;
+	}
+	size_t nQuanta = n & ~(size_t)3;
+
+	// Compact up to the last whole quantum; the characters after it are
+	// left for the next chunk (or for the caller, at the end)
+	size_t nKept = 0;
+	*pnUsed = nEnd;
+	for (size_t i = 0; i < nEnd; i++)
+	{
+		if (pText[i] == '-')
+		{
+			size_t nArmor = DecodeArmorLine(pText, nEnd, i);
+			i = nArmor ? i + nArmor - 1 : nEnd;
+			continue;
+		}
+		if (IsSkipChar(pText[i]))
+			continue;
+		if (nKept == nQuanta)
+		{
+			*pnUsed = i;
+			break;
+		}
+		pText[nKept++] = pText[i];
+	}
+
+	*pnOut = base64_decode64(pText, nQuanta, pOut);
+	if (*pnOut == 0 && nQuanta && pText[0] != '=')
+		return DECODE_INVALID;
+
+	// Padding ends the data
+	if (*pnOut != BASE64_DECODE_OUT_SIZE64(nQuanta))
+		return (bFinal && n == nQuanta) ? DECODE_OK : DECODE_TRUNCATED;
+	if (bFinal && n != nQuanta)
+		return DECODE_TRUNCATED;
+	return DECODE_OK;
+}
+
+DECODE_STATUS DecodeTextChunk(DECODE_MODE eMode, char* pText, size_t nText,
+	BOOL bFinal, unsigned char* pOut, size_t* pnOut, size_t* pnUsed)
+{
+	if (eMode == DECODE_MODE_HEX)
+		return DecodeHexChunk(pText, nText, bFinal, pOut, pnOut, pnUsed);
+	if (eMode == DECODE_MODE_BASE64)
+		return DecodeBase64Chunk(pText, nText, bFinal, pOut, pnOut, pnUsed);
+
+	*pnOut = 0;
+	*pnUsed = 0;
+	return DECODE_INVALID;
+}
+
+DWORD WINAPI DecodeJobProc(LPVOID pParam)
+{
+	DECODE_JOB* pJob = (DECODE_JOB*)pParam;
+	char* pBuf;
+
+	if (pJob->pfnKernel)
+		pJob->eStatus = DecodeKernel(pJob);
+	else if (pJob->eMode == DECODE_MODE_HEX && pJob->uWordSize > 1)
+		pJob->eStatus = DecodeHexWords(pJob);
+	else if (pJob->eMode == DECODE_MODE_NUMBERS)
+		pJob->eStatus = DecodeNumbers(pJob);
+	else if (pJob->eMode == DECODE_MODE_INTEL_HEX)
+		pJob->eStatus = DecodeIntelHex(pJob);
+	else if ((pBuf = (char*)bufpool_alloc(COMPACT_CHUNK_SIZE + 4)) != NULL)
+	{
+		pJob->eStatus = DecodeCompacted(pJob, pBuf);
+		bufpool_free(pBuf);
+	}
+	// Without the buffer, hex skips blanks itself and base64 takes none
+	else if (pJob->eMode == DECODE_MODE_HEX)
+		pJob->eStatus = DecodeHex(pJob);
+	else
+		pJob->eStatus = DecodeBase64(pJob);
+
+	return 0;
+}
+
+// Decodes the body starting at pJob->pIn[nStart] until the kernel stops at
+// its end marker; returns where it stopped
+static size_t DecodeEnvelopeBody(ENVELOPE_JOB* pJob, size_t nStart)
+{
+	size_t pos = nStart;
+
+	while (pos < pJob->nIn)
+	{
+		size_t n = pJob->nIn - pos;
+		if (n > DECODE_CHUNK_SIZE)
+			n = DECODE_CHUNK_SIZE;
+		BOOL bFinal = (pos + n == pJob->nIn);
+
+		size_t used = 0;
+		pJob->nOut += base64_decode_t<base64_policy_lines>(pJob->pIn + pos, n,
+			pJob->pOut + pJob->nOut, bFinal, &used);
+		pos += used;
+		WorkerProgressSet(&pJob->progress, pos);
+
+		// A quantum cut by the chunk boundary is finished by the next chunk
+		if (used == n || (!bFinal && used > 0))
+			continue;
+		break;
+	}
+
+	return pos;
+}
+
+DWORD WINAPI EnvelopeJobProc(LPVOID pParam)
+{
+	ENVELOPE_JOB* pJob = (ENVELOPE_JOB*)pParam;
+	envelope_scan scan;
+	envelope_block block;
+
+	pJob->nBlocks = 0;
+	pJob->nOut = 0;
+	pJob->eStatus = DECODE_OK;
+	envelope_scan_init(&scan, pJob->pIn, pJob->nIn);
+
+	while (pJob->nBlocks < ENVELOPE_MAX_BLOCKS && envelope_next(&scan, &block))
+	{
+		if (WorkerCancelled(&pJob->progress))
+		{
+			pJob->eStatus = DECODE_CANCELLED;
+			return 0;
+		}
+
+		ENVELOPE_BLOCK_INFO* pInfo = &pJob->pBlocks[pJob->nBlocks];
+		pInfo->nKind = block.kind;
+		memcpy(pInfo->szLabel, pJob->pIn + block.label, block.label_len);
+		pInfo->szLabel[block.label_len] = 0;
+		pInfo->nOutStart = pJob->nOut;
+
+		envelope_close(&scan, &block, DecodeEnvelopeBody(pJob, block.start));
+		pInfo->nOut = pJob->nOut - pInfo->nOutStart;
+		pInfo->bComplete = block.complete;
+
+		// A header with nothing decodable behind it is not a block
+		if (pInfo->nOut)
+			pJob->nBlocks++;
+	}
+
+	if (pJob->nBlocks == 0)
+		pJob->eStatus = DECODE_INVALID;
+	else if (pJob->nBlocks == ENVELOPE_MAX_BLOCKS)
+		pJob->eStatus = DECODE_TRUNCATED;
+	return 0;
+}
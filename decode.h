@@ -0,0 +1,104 @@
+// decode.h : chunked decode jobs shared by the plugin commands
+//
+
+#pragma once
+
+#include "worker.h"
+#include "numlist.h"
+#include "envelope.h"
+
+// Input processed between two cancel checks / progress updates.
+// Must stay a multiple of 4 so base64 chunks split on quantum boundaries.
+#define DECODE_CHUNK_SIZE (1024 * 1024)
+
+typedef enum _DECODE_MODE
+{
+	DECODE_MODE_HEX,
+	DECODE_MODE_BASE64,
+	DECODE_MODE_NUMBERS,
+	DECODE_MODE_ASCII85,
+	DECODE_MODE_INTEL_HEX,
+	DECODE_MODE_BITS
+} DECODE_MODE;
+
+typedef enum _DECODE_STATUS
+{
+	DECODE_OK,			// all input decoded
+	DECODE_TRUNCATED,	// decoding stopped before the end of the input
+	DECODE_INVALID,		// malformed input; nothing should be inserted
+	DECODE_CANCELLED	// user abort
+} DECODE_STATUS;
+
+// A policy-specialised decoder, i.e. an instance of hex_decode_t or
+// base64_decode_t, or another kernel with the same contract such as
+// bitstr_decode_msb
+typedef size_t (*DECODE_KERNEL)(const char* pIn, size_t nIn, unsigned char* pOut,
+	int final, size_t* pnUsed);
+
+typedef struct _DECODE_JOB
+{
+	DECODE_MODE     eMode;
+	const char*     pIn;
+	size_t          nIn;
+	unsigned int    uWordSize;	// hex only: 1 for plain bytes, else 2, 4 or 8
+	BOOL            bBigEndian;	// hex only: byte order of words
+	numlist_format  number;		// numbers only: element type of the list
+	DECODE_KERNEL   pfnKernel;	// hex / base64: NULL, or the decoder for one convention; bits: the bit order
+	unsigned char*  pOut;		// at least DecodeJobOutSize bytes
+	size_t          nOut;		// [out] decoded length
+	size_t          nInUsed;	// [out] characters consumed
+	DECODE_STATUS   eStatus;	// [out]
+	WORKER_PROGRESS progress;
+} DECODE_JOB;
+
+// Sets up a job for plain bytes; callers set uWordSize/bBigEndian or
+// pfnKernel, and pOut afterwards.  Ascii85 jobs get ascii85_decode as
+// their kernel, bit strings bitstr_decode_msb.
+void DecodeJobInit(DECODE_JOB* pJob, DECODE_MODE eMode,
+	const char* pIn, size_t nIn);
+
+// Size of the output buffer pJob->pOut must provide
+size_t DecodeJobOutSize(const DECODE_JOB* pJob);
+
+// Worker entry point (see RunWorker); decodes pJob in DECODE_CHUNK_SIZE
+// steps, checking for a user abort between chunks. Plain hex and base64
+// have their blanks compacted out first, in smaller steps.
+DWORD WINAPI DecodeJobProc(LPVOID pParam);
+
+// Envelopes decoded by one ENVELOPE_JOB at most
+#define ENVELOPE_MAX_BLOCKS 4096
+
+typedef struct _ENVELOPE_BLOCK_INFO
+{
+	int             nKind;		// ENVELOPE_PEM or ENVELOPE_DATA_URI
+	char            szLabel[ENVELOPE_MAX_LABEL + 1];
+	size_t          nOutStart;	// offset of the block's bytes in pOut
+	size_t          nOut;		// bytes decoded
+	BOOL            bComplete;	// body decoded up to its end marker
+} ENVELOPE_BLOCK_INFO;
+
+typedef struct _ENVELOPE_JOB
+{
+	const char*     pIn;
+	size_t          nIn;
+	unsigned char*  pOut;		// at least BASE64_DECODE_OUT_SIZE64(nIn) bytes
+	ENVELOPE_BLOCK_INFO* pBlocks;	// ENVELOPE_MAX_BLOCKS entries
+	size_t          nBlocks;	// [out]
+	size_t          nOut;		// [out] decoded length of all blocks
+	DECODE_STATUS   eStatus;	// [out] DECODE_INVALID if no envelope was found
+	WORKER_PROGRESS progress;
+} ENVELOPE_JOB;
+
+// Worker entry point; finds PEM blocks and base64 data: URIs in pJob->pIn
+// in one pass and decodes their bodies back to back into pJob->pOut.
+DWORD WINAPI EnvelopeJobProc(LPVOID pParam);
+
+// Decodes one chunk of hex or base64 text for callers that stream text
+// themselves.  Blanks and line breaks are skipped; for base64 so are
+// "-----BEGIN ...-----" style armor lines, and pText is compacted in
+// place.  A hex pair or base64 quantum (or armor line) cut by the end of a
+// chunk is left unconsumed unless bFinal; pnUsed receives the characters
+// consumed and pnOut the bytes written to pOut (at most nText bytes).
+// pOut may be pText: the bytes then replace the text they came from.
+DECODE_STATUS DecodeTextChunk(DECODE_MODE eMode, char* pText, size_t nText,
+	BOOL bFinal, unsigned char* pOut, size_t* pnOut, size_t* pnUsed);
@@ -0,0 +1,304 @@
+// docedit.cpp : decodes / encodes a range of the document where it sits
+//
+
+#include "stdafx.h"
+
+#include <tchar.h>
+
+#include "docedit.h"
+#include "bufpool.h"
+#include "hex.h"
+#include "base64.h"
+#include "hexdump.h"
+#include "docread.h"
+#include "docwrite.h"
+
+typedef struct _DOCEDIT_PASS
+{
+	HWSESSION   hSession;
+	HWDOCUMENT  hDoc;
+	DECODE_MODE eMode;
+	QWORD       qwStart;
+	QWORD       qwLength;
+	char*       pText;		// DECODE_CHUNK_SIZE characters, decoded in place
+	DOC_WRITER* pWriter;	// NULL: only check the text
+	QWORD       qwUsed;		// [out] characters decoded
+	QWORD       qwOut;		// [out] bytes decoded
+} DOCEDIT_PASS;
+
+static DECODE_STATUS RunPass(DOCEDIT_PASS* pPass, int nBasePercent)
+{
+	QWORD qwPos = 0;
+	DECODE_STATUS eStatus = DECODE_OK;
+
+	pPass->qwUsed = 0;
+	pPass->qwOut = 0;
+
+	while (qwPos < pPass->qwLength && eStatus == DECODE_OK)
+	{
+		size_t nText = DECODE_CHUNK_SIZE;
+		if (pPass->qwLength - qwPos < nText)
+			nText = (size_t)(pPass->qwLength - qwPos);
+		BOOL bFinal = (qwPos + nText == pPass->qwLength);
+
+		if (hwReadAt(pPass->hDoc, pPass->qwStart + qwPos, pPass->pText, nText) != HWAPI_RESULT_SUCCESS)
+			return DECODE_INVALID;
+
+		size_t nOut = 0;
+		size_t nUsed = 0;
+		unsigned char* pOut = (unsigned char*)pPass->pText;
+		eStatus = DecodeTextChunk(pPass->eMode, pPass->pText, nText, bFinal,
+			pOut, &nOut, &nUsed);
+		if (eStatus == DECODE_INVALID)
+			return eStatus;
+		// A token longer than a whole chunk cannot be decoded
+		if (nUsed == 0 && !bFinal)
+			return DECODE_INVALID;
+
+		// Output never outgrows the text consumed, so it only overwrites
+		// characters that have already been read, even while some of it
+		// waits in the writer
+		if (pPass->pWriter &&
+			!DocWriterWrite(pPass->pWriter, pPass->qwStart + pPass->qwOut, pOut, nOut))
+			return DECODE_INVALID;
+		pPass->qwOut += nOut;
+		qwPos += nUsed;
+		pPass->qwUsed = qwPos;
+
+		int nPercent = nBasePercent + (int)(qwPos * 50 / pPass->qwLength);
+		if (hwUpdateProgress(pPass->hSession, nPercent, _T("Decoding selection")) == HWAPI_RESULT_USER_ABORT &&
+			!pPass->pWriter)
+			return DECODE_CANCELLED;
+	}
+
+	return eStatus;
+}
+
+DECODE_STATUS DecodeRangeInPlace(HWSESSION hSession, HWDOCUMENT hDoc,
+	QWORD qwStart, QWORD qwLength, DECODE_MODE eMode, QWORD* pqwOut)
+{
+	DECODE_STATUS eStatus = DECODE_INVALID;
+	DOCEDIT_PASS pass;
+
+	*pqwOut = 0;
+	if (eMode != DECODE_MODE_HEX && eMode != DECODE_MODE_BASE64)
+		return eStatus;
+
+	ZeroMemory(&pass, sizeof(pass));
+	pass.hSession = hSession;
+	pass.hDoc = hDoc;
+	pass.eMode = eMode;
+	pass.qwStart = qwStart;
+	pass.qwLength = qwLength;
+
+	__try
+	{
+		pass.pText = (char*)bufpool_alloc(DECODE_CHUNK_SIZE);
+		if (!pass.pText)
+			__leave;
+
+		// Check everything before the first write
+		eStatus = RunPass(&pass, 0);
+		if (eStatus == DECODE_INVALID || eStatus == DECODE_CANCELLED)
+			__leave;
+
+		// The second pass is not cancelled half-way through
+		pass.pWriter = DocWriterOpen(hSession, hDoc);
+		if (!pass.pWriter)
+		{
+			eStatus = DECODE_INVALID;
+			__leave;
+		}
+		eStatus = RunPass(&pass, 50);
+		if (!DocWriterClose(pass.pWriter, NULL))
+			eStatus = DECODE_INVALID;
+		// The host refused an edit: the text behind it is left alone
+		if (eStatus == DECODE_INVALID)
+			__leave;
+		if (pass.qwUsed > pass.qwOut)
+			hwDeleteAt(hDoc, qwStart + pass.qwOut, pass.qwUsed - pass.qwOut);
+		*pqwOut = pass.qwOut;
+	}
+	__finally
+	{
+		if (pass.pText)
+			bufpool_free(pass.pText);
+	}
+
+	return eStatus;
+}
+
+// Bytes per line, 0 if the text is not wrapped
+static QWORD EncodeLineBytes(const ENCODE_FORMAT* pFormat)
+{
+	QWORD qwBytes;
+
+	if (pFormat->uLineWidth == 0)
+		return 0;
+	if (pFormat->eMode == DECODE_MODE_BASE64)
+	{
+		qwBytes = pFormat->uLineWidth / 4 * 3;
+		return qwBytes ? qwBytes : 3;
+	}
+	qwBytes = pFormat->cSeparator ? (pFormat->uLineWidth + 1) / 3 : pFormat->uLineWidth / 2;
+	return qwBytes ? qwBytes : 1;
+}
+
+QWORD EncodedLength(const ENCODE_FORMAT* pFormat, QWORD qwLength)
+{
+	QWORD qwLineBytes = EncodeLineBytes(pFormat);
+	QWORD qwLines = qwLineBytes ? (qwLength + qwLineBytes - 1) / qwLineBytes : 1;
+
+	if (qwLength == 0)
+		return 0;
+	if (pFormat->eMode == DECODE_MODE_BASE64)
+		return (qwLength + 2) / 3 * 4 + (qwLines - 1) * 2;
+	return qwLength * 2 + (pFormat->cSeparator ? qwLength - qwLines : 0) + (qwLines - 1) * 2;
+}
+
+// Encodes one chunk; chunks other than the first start with whatever joins
+// them to the previous one (a line break or a separator)
+static size_t EncodeChunk(const ENCODE_FORMAT* pFormat, const unsigned char* pIn,
+	size_t nIn, BOOL bFirst, char* pText)
+{
+	size_t nLineBytes = (size_t)EncodeLineBytes(pFormat);
+	size_t nText = 0;
+
+	if (!bFirst && nLineBytes)
+	{
+		pText[nText++] = '\r';
+		pText[nText++] = '\n';
+	}
+	else if (!bFirst && pFormat->eMode == DECODE_MODE_HEX && pFormat->cSeparator)
+	{
+		pText[nText++] = pFormat->cSeparator;
+	}
+
+	for (size_t i = 0; i < nIn; )
+	{
+		size_t n = nIn - i;
+		if (nLineBytes && n > nLineBytes)
+			n = nLineBytes;
+
+		if (i)
+		{
+			pText[nText++] = '\r';
+			pText[nText++] = '\n';
+		}
+		if (pFormat->eMode == DECODE_MODE_BASE64)
+			nText += base64_encode64(pIn + i, n, pText + nText);
+		else
+			nText += hex_encode(pIn + i, n, pText + nText, pFormat->cSeparator);
+		i += n;
+	}
+
+	return nText;
+}
+
+BOOL EncodeRangeInPlace(HWSESSION hSession, HWDOCUMENT hDoc,
+	QWORD qwStart, QWORD qwLength, const ENCODE_FORMAT* pFormat, QWORD* pqwOut)
+{
+	BOOL bReturn = FALSE;
+	unsigned char* pIn = NULL;
+	char* pText = NULL;
+
+	*pqwOut = 0;
+	if (qwLength == 0)
+		return bReturn;
+
+	// Chunks hold whole lines, and whole base64 quanta
+	QWORD qwUnit = EncodeLineBytes(pFormat);
+	if (qwUnit == 0)
+		qwUnit = (pFormat->eMode == DECODE_MODE_BASE64) ? 3 : 1;
+	QWORD qwChunk = (ENCODE_CHUNK_SIZE + qwUnit - 1) / qwUnit * qwUnit;
+	size_t nTextMax = (size_t)EncodedLength(pFormat, qwChunk) + 3;
+
+	QWORD qwTotal = EncodedLength(pFormat, qwLength);
+	QWORD qwChunks = (qwLength + qwChunk - 1) / qwChunk;
+
+	__try
+	{
+		pIn = (unsigned char*)bufpool_alloc((size_t)qwChunk);
+		pText = (char*)bufpool_alloc(nTextMax);
+		if (!pIn || !pText)
+			__leave;
+
+		hwUpdateProgress(hSession, 0, _T("Encoding selection"));
+
+		// Make room for the text behind the selection
+		ZeroMemory(pText, nTextMax);
+		for (QWORD qwGrow = qwTotal - qwLength; qwGrow; )
+		{
+			size_t n = (qwGrow < nTextMax) ? (size_t)qwGrow : nTextMax;
+			if (hwInsertAt(hDoc, qwStart + qwLength, pText, n) != HWAPI_RESULT_SUCCESS)
+				__leave;
+			qwGrow -= n;
+		}
+
+		// Last chunk first: the text of chunk k starts at or after the end
+		// of chunk k's bytes, so it never covers bytes not yet read
+		for (QWORD k = qwChunks; k-- > 0; )
+		{
+			QWORD qwPos = k * qwChunk;
+			size_t nIn = (size_t)((qwLength - qwPos < qwChunk) ? qwLength - qwPos : qwChunk);
+
+			if (hwReadAt(hDoc, qwStart + qwPos, pIn, nIn) != HWAPI_RESULT_SUCCESS)
+				__leave;
+			size_t nText = EncodeChunk(pFormat, pIn, nIn, k == 0, pText);
+			hwWriteAt(hDoc, qwStart + EncodedLength(pFormat, qwPos), pText, nText);
+
+			hwUpdateProgress(hSession, (int)((qwChunks - k) * 100 / qwChunks), _T("Encoding selection"));
+		}
+
+		*pqwOut = qwTotal;
+		bReturn = TRUE;
+	}
+	__finally
+	{
+		if (pIn)
+			bufpool_free(pIn);
+		if (pText)
+			bufpool_free(pText);
+	}
+
+	return bReturn;
+}
+
+BOOL HexdumpRange(HWSESSION hSession, HWDOCUMENT hDoc,
+	QWORD qwStart, QWORD qwLength, int nStyle, char* pText)
+{
+	BOOL bReturn = FALSE;
+	DOC_READER* pReader = NULL;
+	int nDigits = hexdump_offset_digits(qwStart, qwLength);
+	size_t nText = 0;
+
+	__try
+	{
+		// Windows are whole lines, so each one formats on its own
+		pReader = DocReaderOpen(hSession, hDoc, qwStart, qwLength, HEXDUMP_CHUNK_SIZE);
+		if (!pReader)
+			__leave;
+
+		for (QWORD qwPos = 0; qwPos < qwLength; )
+		{
+			DOC_SPAN span;
+			if (!DocReaderNext(pReader, &span) || span.nData == 0)
+				__leave;
+			nText += hexdump_format(span.pData, span.nData, span.qwOffset, nStyle, nDigits,
+				qwPos + span.nData == qwLength, pText + nText);
+			qwPos += span.nData;
+
+			if (hwUpdateProgress(hSession, (int)(qwPos * 100 / qwLength), _T("Formatting hex dump")) == HWAPI_RESULT_USER_ABORT)
+				__leave;
+		}
+
+		pText[nText] = 0;
+		bReturn = TRUE;
+	}
+	__finally
+	{
+		DocReaderClose(pReader, NULL);
+	}
+
+	return bReturn;
+}
@@ -0,0 +1,52 @@
+// docedit.h : decodes / encodes a range of the document where it sits
+//
+
+#pragma once
+
+#include "hwapi.h"
+#include "decode.h"
+
+// Replaces the hex (DECODE_MODE_HEX) or base64 (DECODE_MODE_BASE64) text
+// at [qwStart, qwStart + qwLength) with the bytes it decodes to, reading
+// DECODE_CHUNK_SIZE characters at a time.  Blanks and line breaks are
+// skipped.  The text is checked in a first pass, so DECODE_INVALID and
+// DECODE_CANCELLED leave the document untouched; on DECODE_TRUNCATED the
+// characters that could not be decoded are left behind the output.
+// DECODE_INVALID is also returned when the host refuses an edit of the
+// second pass; what was written so far is then left for the undo group.
+// pqwOut receives the decoded length.  Call inside an undo group.
+DECODE_STATUS DecodeRangeInPlace(HWSESSION hSession, HWDOCUMENT hDoc,
+	QWORD qwStart, QWORD qwLength, DECODE_MODE eMode, QWORD* pqwOut);
+
+// Bytes encoded per chunk by EncodeRangeInPlace (rounded to whole lines)
+#define ENCODE_CHUNK_SIZE (256 * 1024)
+
+typedef struct _ENCODE_FORMAT
+{
+	DECODE_MODE  eMode;			// DECODE_MODE_HEX or DECODE_MODE_BASE64
+	unsigned int uLineWidth;	// characters per line, 0 for a single line
+	char         cSeparator;	// hex only: between bytes on a line, or 0
+} ENCODE_FORMAT;
+
+// Length of the text EncodeRangeInPlace writes for qwLength bytes; lines
+// end in CR LF, the last one without
+QWORD EncodedLength(const ENCODE_FORMAT* pFormat, QWORD qwLength);
+
+// Replaces the bytes at [qwStart, qwStart + qwLength) with their hex or
+// base64 text.  The document is grown once and then filled from the back,
+// so no chunk is moved after it was written and memory stays at two chunk
+// buffers.  Not cancellable once started.  pqwOut receives the text
+// length.  Call inside an undo group.
+BOOL EncodeRangeInPlace(HWSESSION hSession, HWDOCUMENT hDoc,
+	QWORD qwStart, QWORD qwLength, const ENCODE_FORMAT* pFormat, QWORD* pqwOut);
+
+// Largest window formatted at a time by HexdumpRange (whole lines)
+#define HEXDUMP_CHUNK_SIZE (1024 * 1024)
+
+// Formats [qwStart, qwStart + qwLength) as hexdump text (see hexdump.h)
+// into pText, which must hold hexdump_size(nStyle, ...) bytes plus a
+// terminating null; offsets are document addresses.  The document is read
+// ahead through a DocReader (see docread.h) while a window is formatted.
+// Returns FALSE if it cannot be read or the user aborts.
+BOOL HexdumpRange(HWSESSION hSession, HWDOCUMENT hDoc,
+	QWORD qwStart, QWORD qwLength, int nStyle, char* pText);
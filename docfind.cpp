@@ -0,0 +1,258 @@
+// docfind.cpp : finds a byte pattern, wildcards and all, throughout a document
+//
+
+#include "stdafx.h"
+
+#include <tchar.h>
+#include <stdlib.h>
+
+#include "docfind.h"
+#include "docread.h"
+
+// Initial number of matches a chunk can hold before it grows
+#define FIND_CHUNK_HITS 64
+
+typedef struct _FIND_CHUNK
+{
+	const unsigned char* pData;
+	size_t  nStarts;	// positions a match may start at
+	size_t* pHits;		// match offsets from pData, at most FIND_MAX_HITS
+	size_t  nHits;
+	size_t  nMaxHits;
+	QWORD   qwMatches;
+	BOOL    bFailed;	// out of memory
+} FIND_CHUNK;
+
+typedef struct _FIND_WINDOW
+{
+	QWORD          qwOffset;	// document offset of the first chunk
+	size_t         nChunks;
+	const bytefind_pattern* pPattern;
+	volatile LONG  lNext;		// next chunk handed to a callback
+	PTP_WORK       pWork;		// NULL: search on the execute thread
+	FIND_CHUNK     chunks[FIND_WINDOW_CHUNKS];
+} FIND_WINDOW;
+
+static void FindChunk(FIND_CHUNK* pChunk, const bytefind_pattern* pPattern)
+{
+	size_t nHay = pChunk->nStarts + pPattern->len - 1;
+
+	pChunk->nHits = 0;
+	pChunk->qwMatches = 0;
+	pChunk->bFailed = FALSE;
+	for (size_t i = bytefind_next(pPattern, pChunk->pData, nHay, 0); i < nHay;
+		i = bytefind_next(pPattern, pChunk->pData, nHay, i + 1))
+	{
+		pChunk->qwMatches++;
+		if (pChunk->nHits == FIND_MAX_HITS)
+			continue;
+		if (pChunk->nHits == pChunk->nMaxHits)
+		{
+			size_t nMax = pChunk->nMaxHits ? pChunk->nMaxHits * 2 : FIND_CHUNK_HITS;
+			size_t* pHits = (size_t*)realloc(pChunk->pHits, nMax * sizeof(size_t));
+			if (!pHits)
+			{
+				pChunk->bFailed = TRUE;
+				return;
+			}
+			pChunk->pHits = pHits;
+			pChunk->nMaxHits = nMax;
+		}
+		pChunk->pHits[pChunk->nHits++] = i;
+	}
+}
+
+static VOID CALLBACK FindChunkCallback(PTP_CALLBACK_INSTANCE pInstance,
+	PVOID pContext, PTP_WORK pWork)
+{
+	FIND_WINDOW* pWindow = (FIND_WINDOW*)pContext;
+	LONG i = InterlockedIncrement(&pWindow->lNext) - 1;
+
+	if (i < (LONG)pWindow->nChunks)
+		FindChunk(&pWindow->chunks[i], pWindow->pPattern);
+}
+
+static FIND_WINDOW* FindWindowCreate(const bytefind_pattern* pPattern)
+{
+	FIND_WINDOW* pWindow = (FIND_WINDOW*)calloc(1, sizeof(FIND_WINDOW));
+	if (!pWindow)
+		return NULL;
+
+	pWindow->pPattern = pPattern;
+	pWindow->pWork = CreateThreadpoolWork(FindChunkCallback, pWindow, NULL);
+	return pWindow;
+}
+
+static void FindWindowDestroy(FIND_WINDOW* pWindow)
+{
+	if (!pWindow)
+		return;
+
+	if (pWindow->pWork)
+	{
+		WaitForThreadpoolWorkCallbacks(pWindow->pWork, TRUE);
+		CloseThreadpoolWork(pWindow->pWork);
+	}
+	for (size_t i = 0; i < FIND_WINDOW_CHUNKS; i++)
+		free(pWindow->chunks[i].pHits);
+	free(pWindow);
+}
+
+// Splits a window of the document into chunks of match starts; a chunk
+// reads up to pattern length - 1 bytes into the next one, and matches
+// that run past the end of the window are left to FindStraddling
+static void FindWindowSet(FIND_WINDOW* pWindow, const DOC_SPAN* pSpan)
+{
+	size_t nLength = pWindow->pPattern->len;
+	size_t nStarts = (pSpan->nData < nLength) ? 0 : pSpan->nData - nLength + 1;
+
+	pWindow->qwOffset = pSpan->qwOffset;
+	pWindow->nChunks = 0;
+	for (size_t nPos = 0; nPos < nStarts; nPos += FIND_CHUNK_SIZE)
+	{
+		FIND_CHUNK* pChunk = &pWindow->chunks[pWindow->nChunks++];
+		pChunk->pData = pSpan->pData + nPos;
+		pChunk->nStarts = nStarts - nPos;
+		if (pChunk->nStarts > FIND_CHUNK_SIZE)
+			pChunk->nStarts = FIND_CHUNK_SIZE;
+	}
+}
+
+static void FindWindowSubmit(FIND_WINDOW* pWindow)
+{
+	pWindow->lNext = 0;
+	for (size_t i = 0; i < pWindow->nChunks; i++)
+	{
+		if (pWindow->pWork)
+			SubmitThreadpoolWork(pWindow->pWork);
+		else
+			FindChunk(&pWindow->chunks[i], pWindow->pPattern);
+	}
+}
+
+static void FindWindowWait(FIND_WINDOW* pWindow)
+{
+	if (pWindow->pWork)
+		WaitForThreadpoolWorkCallbacks(pWindow->pWork, FALSE);
+}
+
+static void FindAddHit(FIND_RESULT* pResult, QWORD qwOffset)
+{
+	if (pResult->nHits < FIND_MAX_HITS)
+		pResult->pqwHits[pResult->nHits++] = qwOffset;
+	pResult->qwMatches++;
+}
+
+// Finds the matches that start in the last pattern length - 1 bytes of
+// one window, copied to pStitch, and end in the next one, whose first
+// bytes follow them in pStitch
+static void FindStraddling(const bytefind_pattern* pPattern, const unsigned char* pStitch,
+	size_t nStitch, QWORD qwTail, FIND_RESULT* pResult)
+{
+	// pStitch holds fewer than two pattern lengths, so every match found
+	// starts in the tail
+	for (size_t i = bytefind_next(pPattern, pStitch, nStitch, 0); i < nStitch;
+		i = bytefind_next(pPattern, pStitch, nStitch, i + 1))
+		FindAddHit(pResult, qwTail + i);
+}
+
+// Appends the chunk matches in document order
+static BOOL FindMerge(const FIND_WINDOW* pWindow, FIND_RESULT* pResult)
+{
+	QWORD qwBase = pWindow->qwOffset;
+
+	for (size_t i = 0; i < pWindow->nChunks; i++, qwBase += FIND_CHUNK_SIZE)
+	{
+		const FIND_CHUNK* pChunk = &pWindow->chunks[i];
+		if (pChunk->bFailed)
+			return FALSE;
+
+		for (size_t j = 0; j < pChunk->nHits && pResult->nHits < FIND_MAX_HITS; j++)
+			pResult->pqwHits[pResult->nHits++] = qwBase + pChunk->pHits[j];
+		pResult->qwMatches += pChunk->qwMatches;
+	}
+	return TRUE;
+}
+
+BOOL FindInDocument(HWSESSION hSession, HWDOCUMENT hDoc,
+	const bytefind_pattern* pPattern, FIND_RESULT* pResult)
+{
+	BOOL bReturn = FALSE;
+	QWORD qwSize = 0;
+	DOC_READER* pReader = NULL;
+	FIND_WINDOW* pWindow = NULL;
+	unsigned char* pStitch = NULL;
+	size_t nTail = 0;
+	QWORD qwTail = 0;
+	LPCTSTR lpszStatus = _T("Searching for pattern");
+
+	ZeroMemory(pResult, sizeof(FIND_RESULT));
+
+	__try
+	{
+		if (hwGetDocumentSize(hDoc, &qwSize) != HWAPI_RESULT_SUCCESS)
+			__leave;
+		pResult->pqwHits = (QWORD*)malloc(FIND_MAX_HITS * sizeof(QWORD));
+		pStitch = (unsigned char*)malloc(2 * (BYTEFIND_MAX_PATTERN - 1));
+		pWindow = FindWindowCreate(pPattern);
+		if (!pResult->pqwHits || !pStitch || !pWindow)
+			__leave;
+		// The reader fetches the next window while the pool searches this one
+		pReader = DocReaderOpen(hSession, hDoc, 0, qwSize, (size_t)FIND_WINDOW_CHUNKS * FIND_CHUNK_SIZE);
+		if (!pReader)
+			__leave;
+
+		hwUpdateProgress(hSession, 0, lpszStatus);
+		for (;;)
+		{
+			DOC_SPAN span;
+			if (!DocReaderNext(pReader, &span))
+				__leave;
+			if (span.nData == 0)
+				break;
+
+			FindWindowSet(pWindow, &span);
+			FindWindowSubmit(pWindow);
+
+			// The previous window's tail comes before this window's matches
+			if (nTail)
+			{
+				size_t nHead = (span.nData < pPattern->len - 1) ? span.nData : pPattern->len - 1;
+				memcpy(pStitch + nTail, span.pData, nHead);
+				FindStraddling(pPattern, pStitch, nTail + nHead, qwTail, pResult);
+			}
+
+			FindWindowWait(pWindow);
+			if (!FindMerge(pWindow, pResult))
+				__leave;
+
+			// Keep the tail before the window goes back to the reader.  Only
+			// the last window can be shorter than a pattern.
+			nTail = (span.nData < pPattern->len - 1) ? span.nData : pPattern->len - 1;
+			memcpy(pStitch, span.pData + span.nData - nTail, nTail);
+			qwTail = span.qwOffset + span.nData - nTail;
+			pResult->qwSearched = span.qwOffset + span.nData;
+
+			if (hwUpdateProgress(hSession, (int)(pResult->qwSearched * 100 / qwSize),
+				lpszStatus) == HWAPI_RESULT_USER_ABORT)
+				__leave;
+		}
+
+		bReturn = TRUE;
+	}
+	__finally
+	{
+		// Callbacks are done with the window before the reader lets it go
+		FindWindowDestroy(pWindow);
+		DocReaderClose(pReader, NULL);
+		free(pStitch);
+	}
+
+	return bReturn;
+}
+
+void FindResultFree(FIND_RESULT* pResult)
+{
+	free(pResult->pqwHits);
+	ZeroMemory(pResult, sizeof(FIND_RESULT));
+}
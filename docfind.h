@@ -0,0 +1,35 @@
+// docfind.h : finds a byte pattern, wildcards and all, throughout a document
+//
+
+#pragma once
+
+#include "hwapi.h"
+#include "bytefind.h"
+
+// Document bytes searched by one thread pool callback
+#define FIND_CHUNK_SIZE (1024 * 1024)
+// Chunks per window of the document (see docread.h); the next window is
+// read ahead while one is searched
+#define FIND_WINDOW_CHUNKS 32
+// Matches kept for selecting and bookmarking; further ones are only counted
+#define FIND_MAX_HITS 4096
+
+typedef struct _FIND_RESULT
+{
+	QWORD* pqwHits;		// offsets of the first FIND_MAX_HITS matches, ascending
+	size_t nHits;
+	QWORD  qwMatches;	// all of them
+	QWORD  qwSearched;	// document bytes looked at
+} FIND_RESULT;
+
+// Finds every match of pPattern in the document, overlapping ones
+// included, spreading the chunks over the system thread pool.  The last
+// pattern length - 1 bytes of each window are kept and searched together
+// with the start of the next one, so matches across the window boundary
+// are found.  Returns
+// FALSE if the user cancelled or the search failed; matches found up to
+// that point are kept in pResult either way.
+BOOL FindInDocument(HWSESSION hSession, HWDOCUMENT hDoc,
+	const bytefind_pattern* pPattern, FIND_RESULT* pResult);
+
+void FindResultFree(FIND_RESULT* pResult);
@@ -0,0 +1,233 @@
+// docread.cpp : streams a range of the document through a prefetch thread,
+// so the host reads the next window while the caller works on this one
+//
+
+#include "stdafx.h"
+
+#include <tchar.h>
+#include <stdlib.h>
+
+#include "docread.h"
+#include "bufpool.h"
+#include "config.h"
+
+#define DOC_READER_SECTION  _T("Reader")
+
+typedef struct _DOC_WINDOW
+{
+	unsigned char* pBuffer;
+	QWORD          qwOffset;
+	size_t         nData;		// 0 past the end of the range
+	BOOL           bFailed;		// hwReadAt refused
+} DOC_WINDOW;
+
+struct _DOC_READER
+{
+	HWSESSION      hSession;
+	HWDOCUMENT     hDoc;
+	QWORD          qwNext;		// next offset the prefetch thread reads
+	QWORD          qwEnd;
+	size_t         nWindow;
+	size_t         nBuffers;
+	DOC_WINDOW     windows[DOC_READER_MAX_BUFFERS];
+	size_t         nTake;		// window the caller takes next
+	BOOL           bHeld;		// the caller has the window before nTake
+	BOOL           bDone;		// the caller has seen the end, or a failure
+	HANDLE         hFilled;		// counts windows ready for the caller
+	HANDLE         hFree;		// counts buffers ready for the prefetch thread
+	HANDLE         hThread;		// NULL: windows are read by DocReaderNext
+	volatile LONG  lStop;
+	LONGLONG       llReadTicks;	// written by whichever thread reads
+	LONGLONG       llIdleTicks;	// written by the prefetch thread only
+	LONGLONG       llStallTicks;
+	DOC_READER_STATS stats;
+};
+
+static LONGLONG DocReaderTicks(void)
+{
+	LARGE_INTEGER li;
+
+	QueryPerformanceCounter(&li);
+	return li.QuadPart;
+}
+
+static DWORD DocReaderMs(LONGLONG llTicks)
+{
+	LARGE_INTEGER liFrequency;
+
+	if (!QueryPerformanceFrequency(&liFrequency) || liFrequency.QuadPart == 0)
+		return 0;
+	return (DWORD)(llTicks * 1000 / liFrequency.QuadPart);
+}
+
+// Fills window nIndex with the next part of the range
+static void DocReaderFill(DOC_READER* pReader, size_t nIndex)
+{
+	DOC_WINDOW* pWindow = &pReader->windows[nIndex];
+	QWORD qwLength = pReader->qwEnd - pReader->qwNext;
+	if (qwLength > (QWORD)pReader->nWindow)
+		qwLength = pReader->nWindow;
+
+	pWindow->qwOffset = pReader->qwNext;
+	pWindow->nData = (size_t)qwLength;
+	pWindow->bFailed = FALSE;
+	if (qwLength == 0)
+		return;
+
+	LONGLONG llStart = DocReaderTicks();
+	if (hwReadAt(pReader->hDoc, pReader->qwNext, pWindow->pBuffer, qwLength) != HWAPI_RESULT_SUCCESS)
+	{
+		pWindow->nData = 0;
+		pWindow->bFailed = TRUE;
+	}
+	pReader->llReadTicks += DocReaderTicks() - llStart;
+	pReader->qwNext += qwLength;
+}
+
+static DWORD WINAPI DocReaderThread(LPVOID pParam)
+{
+	DOC_READER* pReader = (DOC_READER*)pParam;
+
+	for (size_t nIndex = 0; ; nIndex = (nIndex + 1) % pReader->nBuffers)
+	{
+		LONGLONG llStart = DocReaderTicks();
+		WaitForSingleObject(pReader->hFree, INFINITE);
+		pReader->llIdleTicks += DocReaderTicks() - llStart;
+		if (pReader->lStop)
+			break;
+
+		DocReaderFill(pReader, nIndex);
+		BOOL bLast = (pReader->windows[nIndex].nData == 0);
+		ReleaseSemaphore(pReader->hFilled, 1, NULL);
+		// The end (or a failure) is handed over like any other window
+		if (bLast)
+			break;
+	}
+	return 0;
+}
+
+static size_t DocReaderWindowSize(size_t nMaxWindow)
+{
+	size_t nWindow = (size_t)ConfigGetInt(DOC_READER_SECTION, _T("WindowKB"), DOC_READER_WINDOW_KB) * 1024;
+
+	if (nMaxWindow && nWindow > nMaxWindow)
+		nWindow = nMaxWindow;
+	nWindow -= nWindow % DOC_READER_WINDOW_ALIGN;
+	return nWindow ? nWindow : DOC_READER_WINDOW_ALIGN;
+}
+
+DOC_READER* DocReaderOpen(HWSESSION hSession, HWDOCUMENT hDoc,
+	QWORD qwStart, QWORD qwLength, size_t nMaxWindow)
+{
+	DOC_READER* pReader = (DOC_READER*)calloc(1, sizeof(DOC_READER));
+	if (!pReader)
+		return NULL;
+
+	pReader->hSession = hSession;
+	pReader->hDoc = hDoc;
+	pReader->qwNext = qwStart;
+	pReader->qwEnd = qwStart + qwLength;
+	pReader->nWindow = DocReaderWindowSize(nMaxWindow);
+	pReader->nBuffers = ConfigGetInt(DOC_READER_SECTION, _T("Buffers"), DOC_READER_BUFFERS);
+	if (pReader->nBuffers < 2)
+		pReader->nBuffers = 2;
+	if (pReader->nBuffers > DOC_READER_MAX_BUFFERS)
+		pReader->nBuffers = DOC_READER_MAX_BUFFERS;
+
+	// A short range needs no more buffers than it has windows, plus the end
+	QWORD qwWindows = (qwLength + pReader->nWindow - 1) / pReader->nWindow + 1;
+	if ((QWORD)pReader->nBuffers > qwWindows)
+		pReader->nBuffers = (size_t)qwWindows;
+
+	for (size_t i = 0; i < pReader->nBuffers; i++)
+	{
+		pReader->windows[i].pBuffer = (unsigned char*)bufpool_alloc(pReader->nWindow);
+		if (!pReader->windows[i].pBuffer)
+		{
+			DocReaderClose(pReader, NULL);
+			return NULL;
+		}
+	}
+
+	pReader->hFilled = CreateSemaphore(NULL, 0, (LONG)pReader->nBuffers, NULL);
+	pReader->hFree = CreateSemaphore(NULL, (LONG)pReader->nBuffers, (LONG)pReader->nBuffers, NULL);
+	if (pReader->hFilled && pReader->hFree)
+		pReader->hThread = CreateThread(NULL, 0, DocReaderThread, pReader, 0, NULL);
+	return pReader;
+}
+
+BOOL DocReaderNext(DOC_READER* pReader, DOC_SPAN* pSpan)
+{
+	ZeroMemory(pSpan, sizeof(DOC_SPAN));
+	if (pReader->bHeld)
+	{
+		pReader->bHeld = FALSE;
+		if (pReader->hThread)
+			ReleaseSemaphore(pReader->hFree, 1, NULL);
+	}
+	if (pReader->bDone)
+		return TRUE;
+
+	DOC_WINDOW* pWindow = &pReader->windows[pReader->nTake];
+	if (pReader->hThread)
+	{
+		LONGLONG llStart = DocReaderTicks();
+		WaitForSingleObject(pReader->hFilled, INFINITE);
+		pReader->llStallTicks += DocReaderTicks() - llStart;
+	}
+	else
+	{
+		DocReaderFill(pReader, pReader->nTake);
+	}
+	pReader->nTake = (pReader->nTake + 1) % pReader->nBuffers;
+
+	if (pWindow->bFailed || pWindow->nData == 0)
+	{
+		pReader->bDone = TRUE;
+		return !pWindow->bFailed;
+	}
+
+	pSpan->pData = pWindow->pBuffer;
+	pSpan->nData = pWindow->nData;
+	pSpan->qwOffset = pWindow->qwOffset;
+	pReader->bHeld = TRUE;
+	pReader->stats.qwRead += pWindow->nData;
+	pReader->stats.dwWindows++;
+	return TRUE;
+}
+
+void DocReaderClose(DOC_READER* pReader, DOC_READER_STATS* pStats)
+{
+	if (!pReader)
+		return;
+
+	if (pReader->hThread)
+	{
+		// Wake the prefetch thread if it waits for a buffer
+		InterlockedExchange(&pReader->lStop, 1);
+		ReleaseSemaphore(pReader->hFree, 1, NULL);
+		WaitForSingleObject(pReader->hThread, INFINITE);
+		CloseHandle(pReader->hThread);
+	}
+	if (pReader->hFilled)
+		CloseHandle(pReader->hFilled);
+	if (pReader->hFree)
+		CloseHandle(pReader->hFree);
+	for (size_t i = 0; i < pReader->nBuffers; i++)
+	{
+		if (pReader->windows[i].pBuffer)
+			bufpool_free(pReader->windows[i].pBuffer);
+	}
+
+	pReader->stats.dwReadMs = DocReaderMs(pReader->llReadTicks);
+	pReader->stats.dwStallMs = DocReaderMs(pReader->llStallTicks);
+	pReader->stats.dwIdleMs = DocReaderMs(pReader->llIdleTicks);
+	if (pReader->stats.dwWindows && ConfigGetInt(DOC_READER_SECTION, _T("LogStats"), 0))
+		hwOutputLog(pReader->hSession, HWLOG_INFO,
+			_T("Read %I64u bytes in %u windows of %Iu KB: %u ms in hwReadAt, %u ms waiting for the document, %u ms waiting for the caller"),
+			pReader->stats.qwRead, pReader->stats.dwWindows, pReader->nWindow / 1024,
+			pReader->stats.dwReadMs, pReader->stats.dwStallMs, pReader->stats.dwIdleMs);
+	if (pStats)
+		*pStats = pReader->stats;
+	free(pReader);
+}
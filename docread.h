@@ -0,0 +1,58 @@
+// docread.h : streams a range of the document through a prefetch thread,
+// so the host reads the next window while the caller works on this one
+//
+
+#pragma once
+
+#include "hwapi.h"
+
+// Window size unless the .ini says otherwise:
+//
+//   [Reader]
+//   WindowKB=32768
+//   Buffers=2
+//   LogStats=1
+//
+// Windows are whole multiples of DOC_READER_WINDOW_ALIGN.  One buffer is
+// held by the caller and the rest are filled ahead of it; LogStats writes
+// the stall times of each reader to the log when it is closed.
+#define DOC_READER_WINDOW_KB 32768
+#define DOC_READER_WINDOW_ALIGN (64 * 1024)
+#define DOC_READER_BUFFERS 2
+#define DOC_READER_MAX_BUFFERS 8
+
+typedef struct _DOC_READER DOC_READER;
+
+// A window of the document, valid until the next DocReaderNext or
+// DocReaderClose
+typedef struct _DOC_SPAN
+{
+	const unsigned char* pData;
+	size_t nData;		// 0 at the end of the range
+	QWORD  qwOffset;	// document offset of pData
+} DOC_SPAN;
+
+typedef struct _DOC_READER_STATS
+{
+	QWORD qwRead;		// bytes handed to the caller
+	DWORD dwWindows;
+	DWORD dwReadMs;		// in hwReadAt
+	DWORD dwStallMs;	// caller waiting for a window: the host is slower
+	DWORD dwIdleMs;		// prefetch thread waiting for a buffer: the caller is slower
+} DOC_READER_STATS;
+
+// Starts reading [qwStart, qwStart + qwLength).  The window is the
+// configured size, capped at nMaxWindow unless that is 0.  hwReadAt is
+// called from the prefetch thread, so the document must not be changed
+// until the reader is closed.  Returns NULL if memory runs out; without a
+// thread the windows are read on demand instead.
+DOC_READER* DocReaderOpen(HWSESSION hSession, HWDOCUMENT hDoc,
+	QWORD qwStart, QWORD qwLength, size_t nMaxWindow);
+
+// Gives back the previous window and returns the next one, waiting for it
+// if need be.  Returns FALSE if the document could not be read.
+BOOL DocReaderNext(DOC_READER* pReader, DOC_SPAN* pSpan);
+
+// Stops the prefetch thread, whether or not the range was read to the end.
+// pStats, if not NULL, receives the counters.
+void DocReaderClose(DOC_READER* pReader, DOC_READER_STATS* pStats);
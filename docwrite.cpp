@@ -0,0 +1,91 @@
+// docwrite.cpp : gathers small document edits into few host calls, and
+// repaints the view once when the writer is closed
+//
+
+#include "stdafx.h"
+
+#include <tchar.h>
+#include <stdlib.h>
+
+#include "docwrite.h"
+#include "config.h"
+
+#define DOC_WRITER_SECTION  _T("Writer")
+
+struct _DOC_WRITER
+{
+	HWSESSION  hSession;
+	HWDOCUMENT hDoc;
+	editbuf    eb;
+};
+
+static int DocWriterCall(void* pContext, int nOp, unsigned long long qwOffset,
+	const unsigned char* pData, size_t nData)
+{
+	DOC_WRITER* pWriter = (DOC_WRITER*)pContext;
+	HWAPI_RESULT eResult;
+
+	if (nOp == EDITBUF_INSERT)
+		eResult = hwInsertAt(pWriter->hDoc, (QWORD)qwOffset, (void*)pData, nData);
+	else
+		eResult = hwWriteAt(pWriter->hDoc, (QWORD)qwOffset, (void*)pData, nData);
+	return eResult == HWAPI_RESULT_SUCCESS;
+}
+
+DOC_WRITER* DocWriterOpen(HWSESSION hSession, HWDOCUMENT hDoc)
+{
+	DOC_WRITER* pWriter = (DOC_WRITER*)calloc(1, sizeof(DOC_WRITER));
+	if (!pWriter)
+		return NULL;
+
+	size_t nBuffer = (size_t)ConfigGetInt(DOC_WRITER_SECTION, _T("BufferKB"), DOC_WRITER_BUFFER_KB) * 1024;
+	if (nBuffer == 0)
+		nBuffer = 1024;
+
+	pWriter->hSession = hSession;
+	pWriter->hDoc = hDoc;
+	if (!editbuf_init(&pWriter->eb, nBuffer, DocWriterCall, pWriter))
+	{
+		free(pWriter);
+		return NULL;
+	}
+	return pWriter;
+}
+
+BOOL DocWriterWrite(DOC_WRITER* pWriter, QWORD qwOffset, const void* pData, size_t nData)
+{
+	return editbuf_write(&pWriter->eb, (unsigned long long)qwOffset, pData, nData);
+}
+
+BOOL DocWriterInsert(DOC_WRITER* pWriter, QWORD qwOffset, const void* pData, size_t nData)
+{
+	return editbuf_insert(&pWriter->eb, (unsigned long long)qwOffset, pData, nData);
+}
+
+BOOL DocWriterFlush(DOC_WRITER* pWriter)
+{
+	return editbuf_flush(&pWriter->eb);
+}
+
+BOOL DocWriterClose(DOC_WRITER* pWriter, editbuf_stats* pStats)
+{
+	if (!pWriter)
+		return FALSE;
+
+	BOOL bReturn = editbuf_flush(&pWriter->eb);
+	const editbuf_stats* pCounts = &pWriter->eb.stats;
+
+	if (pCounts->host_calls)
+		hwRefreshView(pWriter->hDoc);
+	if (pCounts->edits && ConfigGetInt(DOC_WRITER_SECTION, _T("LogStats"), 0))
+		hwOutputLog(pWriter->hSession, HWLOG_INFO,
+			_T("Wrote %I64u bytes in %I64u edits with %I64u host calls (%I64u saved, %I64u too large to gather)"),
+			pCounts->bytes, pCounts->edits, pCounts->host_calls,
+			pCounts->edits - pCounts->host_calls, pCounts->direct);
+	if (pStats)
+		*pStats = *pCounts;
+
+	editbuf_free(&pWriter->eb);
+	free(pWriter);
+	return bReturn;
+}
@@ -0,0 +1,39 @@
+// docwrite.h : gathers small document edits into few host calls, and
+// repaints the view once when the writer is closed
+//
+
+#pragma once
+
+#include "hwapi.h"
+#include "editbuf.h"
+
+// Bytes gathered before they go to the host unless the .ini says otherwise:
+//
+//   [Writer]
+//   BufferKB=4096
+//   LogStats=1
+//
+// LogStats writes the number of edits and host calls of each writer to the
+// log when it is closed.
+#define DOC_WRITER_BUFFER_KB 4096
+
+typedef struct _DOC_WRITER DOC_WRITER;
+
+// Returns NULL if memory runs out
+DOC_WRITER* DocWriterOpen(HWSESSION hSession, HWDOCUMENT hDoc);
+
+// Overwrites nData bytes at qwOffset, or inserts them in front of the byte
+// at qwOffset.  pData may be reused as soon as the call returns; the edit
+// itself may not reach the document before the next DocWriterFlush.
+// Returns FALSE once the host has refused an edit.
+BOOL DocWriterWrite(DOC_WRITER* pWriter, QWORD qwOffset, const void* pData, size_t nData);
+BOOL DocWriterInsert(DOC_WRITER* pWriter, QWORD qwOffset, const void* pData, size_t nData);
+
+// Hands the gathered edit to the host, as needed before the document is
+// read or changed some other way
+BOOL DocWriterFlush(DOC_WRITER* pWriter);
+
+// Flushes, repaints the view if anything was written, and frees pWriter.
+// pStats, if not NULL, receives the counters.  Returns FALSE if the host
+// refused an edit at any point.
+BOOL DocWriterClose(DOC_WRITER* pWriter, editbuf_stats* pStats);
@@ -0,0 +1,93 @@
+#include "editbuf.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int
+editbuf_init(editbuf* eb, size_t cap, editbuf_flush_fn flush, void* ctx)
+{
+	memset(eb, 0, sizeof(*eb));
+	eb->flush = flush;
+	eb->ctx = ctx;
+	eb->cap = cap;
+	eb->buf = (unsigned char*)malloc(cap);
+	return eb->buf != NULL;
+}
+
+static int
+editbuf_call(editbuf* eb, int op, unsigned long long offset,
+	const unsigned char* data, size_t len)
+{
+	eb->stats.host_calls++;
+	if (!eb->flush(eb->ctx, op, offset, data, len)) {
+		eb->failed = 1;
+	}
+	return !eb->failed;
+}
+
+int
+editbuf_flush(editbuf* eb)
+{
+	size_t len = eb->len;
+
+	eb->len = 0;
+	if (len == 0 || eb->failed) {
+		return !eb->failed;
+	}
+	return editbuf_call(eb, eb->op, eb->offset, eb->buf, len);
+}
+
+static int
+editbuf_add(editbuf* eb, int op, unsigned long long offset, const void* data, size_t len)
+{
+	if (eb->failed) {
+		return 0;
+	}
+	if (len == 0) {
+		return 1;
+	}
+	eb->stats.edits++;
+	eb->stats.bytes += len;
+
+	/* inserts continue where the pending one ends as well, since the bytes
+	 * it inserted moved everything behind it */
+	if (eb->len && (op != eb->op || offset != eb->offset + eb->len ||
+	    eb->len + len > eb->cap)) {
+		if (!editbuf_flush(eb)) {
+			return 0;
+		}
+	}
+
+	if (len >= eb->cap) {
+		eb->stats.direct++;
+		return editbuf_call(eb, op, offset, (const unsigned char*)data, len);
+	}
+
+	if (eb->len == 0) {
+		eb->op = op;
+		eb->offset = offset;
+	}
+	memcpy(eb->buf + eb->len, data, len);
+	eb->len += len;
+	return 1;
+}
+
+int
+editbuf_write(editbuf* eb, unsigned long long offset, const void* data, size_t len)
+{
+	return editbuf_add(eb, EDITBUF_WRITE, offset, data, len);
+}
+
+int
+editbuf_insert(editbuf* eb, unsigned long long offset, const void* data, size_t len)
+{
+	return editbuf_add(eb, EDITBUF_INSERT, offset, data, len);
+}
+
+void
+editbuf_free(editbuf* eb)
+{
+	free(eb->buf);
+	eb->buf = NULL;
+	eb->len = 0;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#ifndef EDITBUF_H
+#define EDITBUF_H
+
+#include <stddef.h>
+
+/*
+ * Write combining for document edits. An insert or overwrite that starts
+ * where the pending one ends is appended to it, so a run of small edits
+ * reaches the host as one call. Anything else (another kind of edit, a
+ * gap, or a full buffer) flushes the pending edit first; an edit at least
+ * as large as the buffer goes straight through.
+ *
+ * The host is whatever the flush function talks to, so the same code
+ * drives the plugin's document calls and the benchmark's stand-in.
+ */
+
+#define EDITBUF_WRITE  1
+#define EDITBUF_INSERT 2
+
+/*
+ * hands one combined edit to the host.
+ * return values is 0 if the host refused it
+ */
+typedef int (*editbuf_flush_fn)(void* ctx, int op, unsigned long long offset,
+	const unsigned char* data, size_t len);
+
+typedef struct editbuf_stats {
+	unsigned long long edits;       /* editbuf_write / editbuf_insert calls */
+	unsigned long long host_calls;  /* flush function calls */
+	unsigned long long bytes;
+	unsigned long long direct;      /* edits that went straight through */
+} editbuf_stats;
+
+typedef struct editbuf {
+	editbuf_flush_fn flush;
+	void* ctx;
+	unsigned char* buf;
+	size_t cap;
+	size_t len;                     /* pending bytes */
+	int op;                         /* of the pending edit */
+	unsigned long long offset;
+	int failed;                     /* the host refused an edit */
+	editbuf_stats stats;
+} editbuf;
+
+/*
+ * return values is 0 if the cap byte buffer cannot be allocated
+ */
+int
+editbuf_init(editbuf* eb, size_t cap, editbuf_flush_fn flush, void* ctx);
+
+/*
+ * overwrites len bytes at offset, or inserts them in front of the byte at
+ * offset; data may be reused as soon as the call returns.
+ * return values is 0 once the host has refused an edit
+ */
+int
+editbuf_write(editbuf* eb, unsigned long long offset, const void* data, size_t len);
+
+int
+editbuf_insert(editbuf* eb, unsigned long long offset, const void* data, size_t len);
+
+/*
+ * hands the pending edit to the host
+ */
+int
+editbuf_flush(editbuf* eb);
+
+/*
+ * frees the buffer; a pending edit is dropped, so flush first
+ */
+void
+editbuf_free(editbuf* eb);
+
+#endif /* EDITBUF_H */
@@ -0,0 +1,223 @@
+#include "envelope.h"
+
+#include <string.h>
+
+#define PEM_DASHES    "-----"
+#define PEM_BEGIN     "-----BEGIN "
+#define PEM_END       "-----END "
+#define DATA_SCHEME   "data"
+#define DATA_BASE64   ";base64,"
+
+/* longest media type plus parameters of a data: URI */
+#define DATA_MAX_PARAMS 256
+
+static size_t
+envelope_find_char(const char* in, size_t inlen, size_t from, char c)
+{
+	const char* p;
+
+	if (from >= inlen) {
+		return inlen;
+	}
+	p = (const char*)memchr(in + from, c, inlen - from);
+	return p ? (size_t)(p - in) : inlen;
+}
+
+static int
+envelope_lower(int c)
+{
+	return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+/* in[at..) starts with s, ignoring ASCII case */
+static int
+envelope_match(const char* in, size_t inlen, size_t at, const char* s, int nocase)
+{
+	size_t n = strlen(s);
+	size_t i;
+
+	if (at > inlen || inlen - at < n) {
+		return 0;
+	}
+	for (i = 0; i < n; i++) {
+		int c = (unsigned char)in[at + i];
+		if (nocase ? envelope_lower(c) != s[i] : c != s[i]) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* one past the end of the line holding in[at] */
+static size_t
+envelope_next_line(const char* in, size_t inlen, size_t at)
+{
+	size_t eol = envelope_find_char(in, inlen, at, '\n');
+	return eol < inlen ? eol + 1 : inlen;
+}
+
+static int
+envelope_blank_line(const char* in, size_t inlen, size_t at)
+{
+	for (; at < inlen && in[at] != '\n'; at++) {
+		if (in[at] != ' ' && in[at] != '\t' && in[at] != '\r') {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* "-----BEGIN label-----" at d */
+static int
+envelope_pem(const envelope_scan* scan, size_t d, envelope_block* block)
+{
+	const char* in = scan->in;
+	size_t inlen = scan->inlen;
+	size_t label = d + sizeof(PEM_BEGIN) - 1;
+	size_t i;
+
+	if (!envelope_match(in, inlen, d, PEM_BEGIN, 0)) {
+		return 0;
+	}
+	for (i = label; i < inlen && i - label <= ENVELOPE_MAX_LABEL; i++) {
+		if (in[i] == '\n' || in[i] == '\r') {
+			return 0;
+		}
+		if (envelope_match(in, inlen, i, PEM_DASHES, 0)) {
+			break;
+		}
+	}
+	if (i >= inlen || i - label > ENVELOPE_MAX_LABEL) {
+		return 0;
+	}
+
+	block->kind = ENVELOPE_PEM;
+	block->header = d;
+	block->label = label;
+	block->label_len = i - label;
+	block->start = envelope_next_line(in, inlen, i);
+
+	/* RFC 1421 headers ("Proc-Type: ...") run up to a blank line */
+	i = block->start;
+	if (envelope_find_char(in, envelope_next_line(in, inlen, i), i, ':') <
+		envelope_next_line(in, inlen, i)) {
+		while (i < inlen && !envelope_blank_line(in, inlen, i)) {
+			i = envelope_next_line(in, inlen, i);
+		}
+		block->start = envelope_next_line(in, inlen, i);
+	}
+	return 1;
+}
+
+/* "data:[media type][;param]*;base64," with c at the ':' */
+static int
+envelope_data_uri(const envelope_scan* scan, size_t c, envelope_block* block)
+{
+	const char* in = scan->in;
+	size_t inlen = scan->inlen;
+	size_t i;
+	size_t label_end;
+
+	if (c < sizeof(DATA_SCHEME) - 1 ||
+		!envelope_match(in, inlen, c - (sizeof(DATA_SCHEME) - 1), DATA_SCHEME, 1)) {
+		return 0;
+	}
+
+	label_end = 0;
+	for (i = c + 1; i < inlen && i - c <= DATA_MAX_PARAMS; i++) {
+		char ch = in[i];
+		if (ch == ',' || ch == '"' || ch == '\'' || ch == '\n' || ch == ' ' || ch == ')') {
+			break;
+		}
+		if (ch == ';' && !label_end) {
+			label_end = i;
+		}
+	}
+	if (i >= inlen || in[i] != ',' ||
+		i < c + sizeof(DATA_BASE64) - 2 ||
+		!envelope_match(in, inlen, i + 2 - sizeof(DATA_BASE64), DATA_BASE64, 1)) {
+		return 0;
+	}
+
+	block->kind = ENVELOPE_DATA_URI;
+	block->header = c - (sizeof(DATA_SCHEME) - 1);
+	block->label = c + 1;
+	block->label_len = label_end - (c + 1);
+	if (block->label_len > ENVELOPE_MAX_LABEL) {
+		block->label_len = ENVELOPE_MAX_LABEL;
+	}
+	block->start = i + 1;
+	return 1;
+}
+
+void
+envelope_scan_init(envelope_scan* scan, const char* in, size_t inlen)
+{
+	scan->in = in;
+	scan->inlen = inlen;
+	scan->pos = 0;
+	scan->next_dash = envelope_find_char(in, inlen, 0, '-');
+	scan->next_colon = envelope_find_char(in, inlen, 0, ':');
+}
+
+int
+envelope_next(envelope_scan* scan, envelope_block* block)
+{
+	for (;;) {
+		/* each memchr result is kept until pos passes it */
+		if (scan->next_dash < scan->pos) {
+			scan->next_dash = envelope_find_char(scan->in, scan->inlen, scan->pos, '-');
+		}
+		if (scan->next_colon < scan->pos) {
+			scan->next_colon = envelope_find_char(scan->in, scan->inlen, scan->pos, ':');
+		}
+		if (scan->next_dash >= scan->inlen && scan->next_colon >= scan->inlen) {
+			scan->pos = scan->inlen;
+			return 0;
+		}
+
+		memset(block, 0, sizeof(*block));
+		if (scan->next_dash < scan->next_colon) {
+			scan->pos = scan->next_dash + 1;
+			if (envelope_pem(scan, scan->next_dash, block)) {
+				break;
+			}
+		}
+		else {
+			scan->pos = scan->next_colon + 1;
+			if (envelope_data_uri(scan, scan->next_colon, block)) {
+				break;
+			}
+		}
+	}
+
+	scan->pos = block->start;
+	return 1;
+}
+
+void
+envelope_close(envelope_scan* scan, envelope_block* block, size_t body_end)
+{
+	const char* in = scan->in;
+	size_t inlen = scan->inlen;
+	size_t i = body_end;
+
+	block->end = body_end;
+	scan->pos = body_end;
+	if (block->kind != ENVELOPE_PEM) {
+		/* a data: URI has no end marker of its own */
+		block->complete = 1;
+		return;
+	}
+
+	while (i < inlen && (in[i] == ' ' || in[i] == '\t' || in[i] == '\r' || in[i] == '\n')) {
+		i++;
+	}
+	if (envelope_match(in, inlen, i, PEM_END, 0) &&
+		inlen - (i + sizeof(PEM_END) - 1) >= block->label_len &&
+		memcmp(in + i + sizeof(PEM_END) - 1, in + block->label, block->label_len) == 0 &&
+		envelope_match(in, inlen, i + sizeof(PEM_END) - 1 + block->label_len, PEM_DASHES, 0)) {
+		block->complete = 1;
+		scan->pos = envelope_next_line(in, inlen, i);
+	}
+}
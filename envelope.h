@@ -0,0 +1,68 @@
+#pragma once
+
+#ifndef ENVELOPE_H
+#define ENVELOPE_H
+
+#include <stddef.h>
+
+/*
+ * Finds base64 payloads wrapped in envelopes:
+ *
+ *   -----BEGIN CERTIFICATE-----        PEM armor (RFC 7468), optionally
+ *   Proc-Type: 4,ENCRYPTED             with RFC 1421 header lines that
+ *                                      end at a blank line
+ *   MIIB...
+ *   -----END CERTIFICATE-----
+ *
+ *   data:application/octet-stream;base64,AAEC...     data: URIs (RFC 2397)
+ *
+ * Neither '-' nor ':' occurs in base64 text, so only those characters are
+ * looked at between envelopes. The scanner does not find where a body
+ * ends: the caller decodes it with a streaming kernel, which stops at the
+ * first character outside the body, and hands that position back to
+ * envelope_close.
+ */
+
+#define ENVELOPE_PEM      1
+#define ENVELOPE_DATA_URI 2
+
+/* longest label / media type looked for */
+#define ENVELOPE_MAX_LABEL 64
+
+typedef struct envelope_block {
+	int kind;           /* ENVELOPE_PEM or ENVELOPE_DATA_URI */
+	size_t header;      /* first character of the envelope */
+	size_t label;       /* "CERTIFICATE", or the media type of a data: URI */
+	size_t label_len;
+	size_t start;       /* first character of the base64 body */
+	size_t end;         /* one past the body, set by envelope_close */
+	int complete;       /* PEM: the matching END line was found;
+	                       data: URIs are always complete */
+} envelope_block;
+
+typedef struct envelope_scan {
+	const char* in;
+	size_t inlen;
+	size_t pos;         /* where the next search starts */
+	size_t next_dash;   /* next '-' at or after pos, inlen if none */
+	size_t next_colon;  /* next ':' at or after pos, inlen if none */
+} envelope_scan;
+
+void
+envelope_scan_init(envelope_scan* scan, const char* in, size_t inlen);
+
+/*
+ * Finds the next envelope header at or after scan->pos.
+ * return values is 1 with block filled in up to start, 0 if there is none
+ */
+int
+envelope_next(envelope_scan* scan, envelope_block* block);
+
+/*
+ * Records body_end (where decoding the body stopped) and, for PEM, steps
+ * over the matching END line; the next search starts after it.
+ */
+void
+envelope_close(envelope_scan* scan, envelope_block* block, size_t body_end);
+
+#endif /* ENVELOPE_H */
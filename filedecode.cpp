@@ -0,0 +1,189 @@
+// filedecode.cpp : decodes a hex / base64 text file into a new document
+//
+
+#include "stdafx.h"
+
+#include <tchar.h>
+#include <string.h>
+
+#include "filedecode.h"
+#include "bufpool.h"
+#include "docwrite.h"
+
+BOOL FileViewEnsure(FILE_VIEW* pFile, QWORD qwPos, size_t n)
+{
+	if (pFile->pView && qwPos >= pFile->qwViewStart &&
+		qwPos + n <= pFile->qwViewStart + pFile->nView)
+		return TRUE;
+
+	if (pFile->pView)
+		UnmapViewOfFile(pFile->pView);
+
+	// Views start on an allocation granularity boundary
+	pFile->qwViewStart = qwPos & ~(QWORD)(pFile->dwGranularity - 1);
+	pFile->nView = FILE_DECODE_VIEW_SIZE;
+	if (pFile->qwSize - pFile->qwViewStart < pFile->nView)
+		pFile->nView = (size_t)(pFile->qwSize - pFile->qwViewStart);
+
+	pFile->pView = (const char*)MapViewOfFile(pFile->hMapping, FILE_MAP_READ,
+		(DWORD)(pFile->qwViewStart >> 32), (DWORD)pFile->qwViewStart, pFile->nView);
+	return pFile->pView != NULL;
+}
+
+// A read error on the file surfaces as an in-page exception rather than
+// an error code
+BOOL FileViewCopy(FILE_VIEW* pFile, QWORD qwPos, void* pDest, size_t n)
+{
+	__try
+	{
+		memcpy(pDest, pFile->pView + (size_t)(qwPos - pFile->qwViewStart), n);
+	}
+	__except (GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR ?
+		EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH)
+	{
+		return FALSE;
+	}
+	return TRUE;
+}
+
+BOOL FileViewOpen(FILE_VIEW* pFile, LPCTSTR lpszFile)
+{
+	LARGE_INTEGER size;
+	SYSTEM_INFO info;
+
+	ZeroMemory(pFile, sizeof(*pFile));
+	pFile->hFile = CreateFile(lpszFile, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+		NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (pFile->hFile == INVALID_HANDLE_VALUE)
+	{
+		pFile->hFile = NULL;
+		return FALSE;
+	}
+	if (!GetFileSizeEx(pFile->hFile, &size))
+		return FALSE;
+	pFile->qwSize = (QWORD)size.QuadPart;
+
+	GetSystemInfo(&info);
+	pFile->dwGranularity = info.dwAllocationGranularity;
+
+	// Empty files cannot be mapped, and need not be
+	if (pFile->qwSize == 0)
+		return TRUE;
+	pFile->hMapping = CreateFileMapping(pFile->hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	return pFile->hMapping != NULL;
+}
+
+void FileViewClose(FILE_VIEW* pFile)
+{
+	if (pFile->pView)
+		UnmapViewOfFile(pFile->pView);
+	if (pFile->hMapping)
+		CloseHandle(pFile->hMapping);
+	if (pFile->hFile)
+		CloseHandle(pFile->hFile);
+}
+
+DECODE_STATUS DecodeFileToDocument(HWSESSION hSession, LPCTSTR lpszFile,
+	DECODE_MODE eMode, FILE_DECODE_RESULT* pResult)
+{
+	DECODE_STATUS eStatus = DECODE_INVALID;
+	FILE_VIEW file;
+	char* pText = NULL;
+	DOC_WRITER* pWriter = NULL;
+	DWORD dwStart = GetTickCount();
+
+	ZeroMemory(pResult, sizeof(*pResult));
+
+	__try
+	{
+		if (!FileViewOpen(&file, lpszFile))
+			__leave;
+		pResult->qwSize = file.qwSize;
+
+		// Each chunk is decoded where it was copied to
+		pText = (char*)bufpool_alloc(DECODE_CHUNK_SIZE);
+		if (!pText)
+			__leave;
+
+		pResult->hNewDoc = hwNewDocument(hSession);
+		if (!pResult->hNewDoc)
+			__leave;
+		pWriter = DocWriterOpen(hSession, pResult->hNewDoc);
+		if (!pWriter)
+			__leave;
+
+		QWORD qwPos = 0;
+		eStatus = DECODE_OK;
+		while (qwPos < file.qwSize)
+		{
+			size_t nText = DECODE_CHUNK_SIZE;
+			if (file.qwSize - qwPos < nText)
+				nText = (size_t)(file.qwSize - qwPos);
+			BOOL bFinal = (qwPos + nText == file.qwSize);
+
+			if (!FileViewEnsure(&file, qwPos, nText) ||
+				!FileViewCopy(&file, qwPos, pText, nText))
+			{
+				eStatus = DECODE_INVALID;
+				break;
+			}
+
+			// Text editors like to start UTF-8 files with a byte order mark
+			size_t nSkip = 0;
+			if (qwPos == 0 && nText >= 3 && memcmp(pText, "\xEF\xBB\xBF", 3) == 0)
+				nSkip = 3;
+
+			size_t nOut = 0;
+			size_t nUsed = 0;
+			unsigned char* pOut = (unsigned char*)pText + nSkip;
+			eStatus = DecodeTextChunk(eMode, pText + nSkip, nText - nSkip, bFinal,
+				pOut, &nOut, &nUsed);
+			nUsed += nSkip;
+			if (eStatus == DECODE_INVALID)
+				break;
+			// A token longer than a whole chunk cannot be decoded
+			if (nUsed == 0 && !bFinal)
+			{
+				eStatus = DECODE_INVALID;
+				break;
+			}
+
+			if (!DocWriterInsert(pWriter, pResult->qwOut, pOut, nOut))
+			{
+				eStatus = DECODE_INVALID;
+				break;
+			}
+			pResult->qwOut += nOut;
+			qwPos += nUsed;
+			pResult->qwIn = qwPos;
+
+			// Base64 padding ends the data before the end of the file
+			if (eStatus != DECODE_OK || bFinal)
+				break;
+
+			if (hwUpdateProgress(hSession, (int)(qwPos * 100 / file.qwSize),
+				_T("Decoding file")) == HWAPI_RESULT_USER_ABORT)
+			{
+				eStatus = DECODE_CANCELLED;
+				break;
+			}
+		}
+	}
+	__finally
+	{
+		if (pWriter && !DocWriterClose(pWriter, NULL) && eStatus != DECODE_CANCELLED)
+			eStatus = DECODE_INVALID;
+		FileViewClose(&file);
+		if (pText)
+			bufpool_free(pText);
+	}
+
+	if (pResult->hNewDoc && (eStatus == DECODE_INVALID || eStatus == DECODE_CANCELLED))
+	{
+		hwCloseDocument(pResult->hNewDoc);
+		pResult->hNewDoc = NULL;
+	}
+	pResult->dwElapsed = GetTickCount() - dwStart;
+
+	return eStatus;
+}
@@ -0,0 +1,50 @@
+// filedecode.h : decodes a hex / base64 text file into a new document
+//
+
+#pragma once
+
+#include "hwapi.h"
+#include "decode.h"
+
+// Bytes of the file mapped at a time; must exceed DECODE_CHUNK_SIZE plus
+// the allocation granularity
+#define FILE_DECODE_VIEW_SIZE (64 * 1024 * 1024)
+
+// A read-only file mapped FILE_DECODE_VIEW_SIZE bytes at a time
+typedef struct _FILE_VIEW
+{
+	HANDLE      hFile;
+	HANDLE      hMapping;
+	QWORD       qwSize;
+	DWORD       dwGranularity;
+	const char* pView;
+	QWORD       qwViewStart;
+	size_t      nView;
+} FILE_VIEW;
+
+// Opens lpszFile for reading; FileViewClose cleans up after a failure too
+BOOL FileViewOpen(FILE_VIEW* pFile, LPCTSTR lpszFile);
+
+// Moves the view so that it covers [qwPos, qwPos + n)
+BOOL FileViewEnsure(FILE_VIEW* pFile, QWORD qwPos, size_t n);
+
+// Copies n mapped bytes from qwPos, which FileViewEnsure has covered
+BOOL FileViewCopy(FILE_VIEW* pFile, QWORD qwPos, void* pDest, size_t n);
+
+void FileViewClose(FILE_VIEW* pFile);
+
+typedef struct _FILE_DECODE_RESULT
+{
+	HWDOCUMENT hNewDoc;	// document holding the bytes, NULL on failure
+	QWORD      qwIn;	// characters decoded
+	QWORD      qwOut;	// bytes produced
+	QWORD      qwSize;	// file size
+	DWORD      dwElapsed;	// milliseconds
+} FILE_DECODE_RESULT;
+
+// Maps lpszFile in FILE_DECODE_VIEW_SIZE windows and streams it through
+// DecodeTextChunk into a document created with hwNewDocument.  A UTF-8
+// byte order mark is skipped.  The new document is closed again unless the
+// result is DECODE_OK or DECODE_TRUNCATED (decoding stopped at qwIn).
+DECODE_STATUS DecodeFileToDocument(HWSESSION hSession, LPCTSTR lpszFile,
+	DECODE_MODE eMode, FILE_DECODE_RESULT* pResult);
@@ -0,0 +1,349 @@
+// fileindex.cpp : checkpoint index of a hex / base64 text file, kept in a
+// sidecar file, for decoding a window of the bytes without the rest
+//
+
+#include "stdafx.h"
+
+#include <tchar.h>
+#include <string.h>
+
+#include "fileindex.h"
+#include "filedecode.h"
+#include "bufpool.h"
+#include "docwrite.h"
+#include "hex.h"
+#include "base64.h"
+
+#define FILE_INDEX_MAGIC   0x58495748	// "HWIX"
+#define FILE_INDEX_VERSION 1
+
+// The sidecar holds this header, then the checkpoints as seekidx_point
+typedef struct _FILE_INDEX_HEADER
+{
+	DWORD    dwMagic;
+	DWORD    dwVersion;
+	DWORD    dwMode;		// DECODE_MODE
+	DWORD    dwReserved;
+	QWORD    qwTextSize;
+	FILETIME ftWritten;
+	QWORD    qwTextUsed;
+	QWORD    qwOut;
+	QWORD    qwPoints;
+} FILE_INDEX_HEADER;
+
+static BOOL GetSidecarName(LPCTSTR lpszFile, LPTSTR lpszSidecar)
+{
+	if (_tcslen(lpszFile) + _tcslen(FILE_INDEX_EXTENSION) >= MAX_PATH)
+		return FALSE;
+	_sntprintf(lpszSidecar, MAX_PATH, _T("%s%s"), lpszFile, FILE_INDEX_EXTENSION);
+	return TRUE;
+}
+
+// Size and last write time, which tell whether an index is still valid
+static BOOL GetTextFileStamp(LPCTSTR lpszFile, QWORD* pqwSize, FILETIME* pftWritten)
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+
+	if (!GetFileAttributesEx(lpszFile, GetFileExInfoStandard, &data))
+		return FALSE;
+	*pqwSize = ((QWORD)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+	*pftWritten = data.ftLastWriteTime;
+	return TRUE;
+}
+
+DECODE_STATUS FileIndexBuild(HWSESSION hSession, LPCTSTR lpszFile,
+	DECODE_MODE eMode, UINT uIntervalKB, FILE_INDEX* pIndex)
+{
+	DECODE_STATUS eStatus = DECODE_INVALID;
+	FILE_VIEW file;
+	char* pText = NULL;
+	seekidx_state state;
+
+	ZeroMemory(pIndex, sizeof(*pIndex));
+	ZeroMemory(&file, sizeof(file));
+	pIndex->eMode = eMode;
+	if (eMode != DECODE_MODE_HEX && eMode != DECODE_MODE_BASE64)
+		return eStatus;
+	seekidx_init(&state, eMode == DECODE_MODE_HEX ? SEEKIDX_HEX : SEEKIDX_BASE64,
+		(unsigned long long)uIntervalKB * 1024);
+
+	__try
+	{
+		if (!GetTextFileStamp(lpszFile, &pIndex->qwTextSize, &pIndex->ftWritten) ||
+			!FileViewOpen(&file, lpszFile))
+			__leave;
+
+		// Checkpoints are at least an interval apart
+		size_t nMax = (size_t)SEEKIDX_POINTS_MAX(file.qwSize, state.interval);
+		pIndex->pPoints = (seekidx_point*)bufpool_alloc(nMax * sizeof(seekidx_point));
+		pText = (char*)bufpool_alloc(DECODE_CHUNK_SIZE);
+		if (!pIndex->pPoints || !pText)
+			__leave;
+
+		eStatus = DECODE_OK;
+		for (QWORD qwPos = 0; qwPos < file.qwSize && !state.done; )
+		{
+			size_t nText = DECODE_CHUNK_SIZE;
+			if (file.qwSize - qwPos < nText)
+				nText = (size_t)(file.qwSize - qwPos);
+
+			if (!FileViewEnsure(&file, qwPos, nText) ||
+				!FileViewCopy(&file, qwPos, pText, nText))
+			{
+				eStatus = DECODE_INVALID;
+				break;
+			}
+
+			// Offsets count from the start of the file, byte order mark
+			// included, like those of DecodeFileToDocument
+			size_t nSkip = 0;
+			if (qwPos == 0 && nText >= 3 && memcmp(pText, "\xEF\xBB\xBF", 3) == 0)
+			{
+				nSkip = 3;
+				state.text = state.next = 3;
+			}
+
+			pIndex->nPoints += seekidx_scan(&state, pText + nSkip, nText - nSkip,
+				pIndex->pPoints + pIndex->nPoints);
+			qwPos += nText;
+
+			if (hwUpdateProgress(hSession, (int)(qwPos * 100 / file.qwSize),
+				_T("Indexing file")) == HWAPI_RESULT_USER_ABORT)
+			{
+				eStatus = DECODE_CANCELLED;
+				break;
+			}
+		}
+
+		pIndex->qwTextUsed = state.text;
+		pIndex->qwOut = seekidx_decoded_size(&state);
+		if (eStatus == DECODE_OK && pIndex->qwOut == 0)
+			eStatus = DECODE_INVALID;
+		else if (eStatus == DECODE_OK && state.done)
+			eStatus = DECODE_TRUNCATED;
+	}
+	__finally
+	{
+		FileViewClose(&file);
+		if (pText)
+			bufpool_free(pText);
+	}
+
+	if (eStatus == DECODE_INVALID || eStatus == DECODE_CANCELLED)
+		FileIndexFree(pIndex);
+	return eStatus;
+}
+
+BOOL FileIndexSave(LPCTSTR lpszFile, const FILE_INDEX* pIndex)
+{
+	TCHAR szSidecar[MAX_PATH];
+	FILE_INDEX_HEADER header;
+	DWORD dwPoints = (DWORD)(pIndex->nPoints * sizeof(seekidx_point));
+	DWORD dwWritten = 0;
+	BOOL bReturn;
+
+	if (!GetSidecarName(lpszFile, szSidecar))
+		return FALSE;
+	HANDLE hFile = CreateFile(szSidecar, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return FALSE;
+
+	ZeroMemory(&header, sizeof(header));
+	header.dwMagic = FILE_INDEX_MAGIC;
+	header.dwVersion = FILE_INDEX_VERSION;
+	header.dwMode = (DWORD)pIndex->eMode;
+	header.qwTextSize = pIndex->qwTextSize;
+	header.ftWritten = pIndex->ftWritten;
+	header.qwTextUsed = pIndex->qwTextUsed;
+	header.qwOut = pIndex->qwOut;
+	header.qwPoints = pIndex->nPoints;
+
+	bReturn = WriteFile(hFile, &header, sizeof(header), &dwWritten, NULL) &&
+		dwWritten == sizeof(header) &&
+		WriteFile(hFile, pIndex->pPoints, dwPoints, &dwWritten, NULL) &&
+		dwWritten == dwPoints;
+	CloseHandle(hFile);
+
+	// Half an index would only be turned down by FileIndexLoad later
+	if (!bReturn)
+		DeleteFile(szSidecar);
+	return bReturn;
+}
+
+BOOL FileIndexLoad(LPCTSTR lpszFile, FILE_INDEX* pIndex)
+{
+	TCHAR szSidecar[MAX_PATH];
+	FILE_INDEX_HEADER header;
+	QWORD qwTextSize;
+	FILETIME ftWritten;
+	DWORD dwRead = 0;
+	BOOL bReturn = FALSE;
+	HANDLE hFile = INVALID_HANDLE_VALUE;
+
+	ZeroMemory(pIndex, sizeof(*pIndex));
+	if (!GetSidecarName(lpszFile, szSidecar) ||
+		!GetTextFileStamp(lpszFile, &qwTextSize, &ftWritten))
+		return bReturn;
+
+	__try
+	{
+		hFile = CreateFile(szSidecar, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL, NULL);
+		if (hFile == INVALID_HANDLE_VALUE)
+			__leave;
+		if (!ReadFile(hFile, &header, sizeof(header), &dwRead, NULL) || dwRead != sizeof(header))
+			__leave;
+
+		// Written for this file as it is now, and sane
+		if (header.dwMagic != FILE_INDEX_MAGIC || header.dwVersion != FILE_INDEX_VERSION ||
+			(header.dwMode != DECODE_MODE_HEX && header.dwMode != DECODE_MODE_BASE64) ||
+			header.qwTextSize != qwTextSize || CompareFileTime(&header.ftWritten, &ftWritten) != 0 ||
+			header.qwPoints == 0 ||
+			header.qwPoints > SEEKIDX_POINTS_MAX(qwTextSize, SEEKIDX_MIN_INTERVAL))
+			__leave;
+
+		DWORD dwPoints = (DWORD)(header.qwPoints * sizeof(seekidx_point));
+		pIndex->pPoints = (seekidx_point*)bufpool_alloc(dwPoints);
+		if (!pIndex->pPoints)
+			__leave;
+		if (!ReadFile(hFile, pIndex->pPoints, dwPoints, &dwRead, NULL) || dwRead != dwPoints ||
+			pIndex->pPoints[0].out != 0)
+			__leave;
+
+		pIndex->eMode = (DECODE_MODE)header.dwMode;
+		pIndex->qwTextSize = header.qwTextSize;
+		pIndex->ftWritten = header.ftWritten;
+		pIndex->qwTextUsed = header.qwTextUsed;
+		pIndex->qwOut = header.qwOut;
+		pIndex->nPoints = (size_t)header.qwPoints;
+		bReturn = TRUE;
+	}
+	__finally
+	{
+		if (hFile != INVALID_HANDLE_VALUE)
+			CloseHandle(hFile);
+		if (!bReturn)
+			FileIndexFree(pIndex);
+	}
+
+	return bReturn;
+}
+
+void FileIndexFree(FILE_INDEX* pIndex)
+{
+	if (pIndex->pPoints)
+		bufpool_free(pIndex->pPoints);
+	pIndex->pPoints = NULL;
+	pIndex->nPoints = 0;
+}
+
+DECODE_STATUS FileIndexExtract(HWSESSION hSession, LPCTSTR lpszFile,
+	const FILE_INDEX* pIndex, QWORD qwOffset, QWORD qwLength,
+	HWDOCUMENT hDoc, QWORD qwPosition, QWORD* pqwOut)
+{
+	DECODE_STATUS eStatus = DECODE_INVALID;
+	FILE_VIEW file;
+	char* pText = NULL;
+	DOC_WRITER* pWriter = NULL;
+	// The conventions seekidx_scan indexes by
+	DECODE_KERNEL pfnKernel = (pIndex->eMode == DECODE_MODE_HEX) ?
+		hex_decode_t<hex_policy_blanks> : base64_decode_t<base64_policy_lines>;
+
+	*pqwOut = 0;
+	if (qwOffset >= pIndex->qwOut || qwLength == 0)
+		return eStatus;
+
+	// Only the text from the checkpoint before the window is decoded
+	const seekidx_point* pPoint = &pIndex->pPoints[seekidx_find(pIndex->pPoints,
+		pIndex->nPoints, qwOffset)];
+	QWORD qwSkip = qwOffset - pPoint->out;
+	QWORD qwPos = pPoint->text;
+
+	ZeroMemory(&file, sizeof(file));
+	__try
+	{
+		pText = (char*)bufpool_alloc(DECODE_CHUNK_SIZE);
+		if (!pText || !FileViewOpen(&file, lpszFile))
+			__leave;
+		pWriter = DocWriterOpen(hSession, hDoc);
+		if (!pWriter)
+			__leave;
+
+		eStatus = DECODE_OK;
+		while (*pqwOut < qwLength)
+		{
+			// Nothing decodes past where the index says the data ends
+			if (qwPos > pIndex->qwTextUsed || qwPos >= file.qwSize)
+			{
+				eStatus = DECODE_TRUNCATED;
+				break;
+			}
+
+			size_t nText = DECODE_CHUNK_SIZE;
+			if (file.qwSize - qwPos < nText)
+				nText = (size_t)(file.qwSize - qwPos);
+			BOOL bFinal = (qwPos + nText == file.qwSize);
+
+			if (!FileViewEnsure(&file, qwPos, nText) ||
+				!FileViewCopy(&file, qwPos, pText, nText))
+			{
+				eStatus = DECODE_INVALID;
+				break;
+			}
+
+			// The chunk is decoded where it was copied to; a pair or
+			// quantum cut by its end is read again with the next one
+			unsigned char* pOut = (unsigned char*)pText;
+			size_t nUsed = 0;
+			size_t nOut = pfnKernel(pText, nText, pOut, bFinal, &nUsed);
+			if (nOut <= qwSkip)
+			{
+				qwSkip -= nOut;
+			}
+			else
+			{
+				size_t n = nOut - (size_t)qwSkip;
+				if (n > qwLength - *pqwOut)
+					n = (size_t)(qwLength - *pqwOut);
+				if (!DocWriterInsert(pWriter, qwPosition + *pqwOut, pOut + qwSkip, n))
+				{
+					eStatus = DECODE_INVALID;
+					break;
+				}
+				*pqwOut += n;
+				qwSkip = 0;
+			}
+			if (nUsed == 0)
+			{
+				eStatus = DECODE_TRUNCATED;
+				break;
+			}
+			qwPos += nUsed;
+
+			if (hwUpdateProgress(hSession, (int)(*pqwOut * 100 / qwLength),
+				_T("Extracting decoded range")) == HWAPI_RESULT_USER_ABORT)
+			{
+				eStatus = DECODE_CANCELLED;
+				break;
+			}
+		}
+
+		if (!DocWriterFlush(pWriter))
+			eStatus = DECODE_INVALID;
+		if (eStatus == DECODE_CANCELLED && *pqwOut)
+		{
+			hwDeleteAt(hDoc, qwPosition, *pqwOut);
+			*pqwOut = 0;
+		}
+	}
+	__finally
+	{
+		DocWriterClose(pWriter, NULL);
+		FileViewClose(&file);
+		if (pText)
+			bufpool_free(pText);
+	}
+
+	return eStatus;
+}
@@ -0,0 +1,51 @@
+// fileindex.h : checkpoint index of a hex / base64 text file, kept in a
+// sidecar file, for decoding a window of the bytes without the rest
+//
+
+#pragma once
+
+#include "hwapi.h"
+#include "decode.h"
+#include "seekidx.h"
+
+// The sidecar is named after the text file with this appended
+#define FILE_INDEX_EXTENSION _T(".hwidx")
+
+// Characters between checkpoints, in KB, unless the .ini says otherwise
+#define FILE_INDEX_INTERVAL_KB 256
+
+typedef struct _FILE_INDEX
+{
+	DECODE_MODE    eMode;		// DECODE_MODE_HEX or DECODE_MODE_BASE64
+	QWORD          qwTextSize;	// size of the text file when indexed
+	FILETIME       ftWritten;	// and its last write time
+	QWORD          qwTextUsed;	// characters up to where the data ends
+	QWORD          qwOut;		// decoded size
+	size_t         nPoints;
+	seekidx_point* pPoints;		// from bufpool_alloc; see FileIndexFree
+} FILE_INDEX;
+
+// Reads lpszFile once and records a checkpoint about every uIntervalKB KB
+// of text.  DECODE_TRUNCATED means the data ends before the end of the
+// file (at pIndex->qwTextUsed), DECODE_INVALID that it has no data or
+// could not be read.
+DECODE_STATUS FileIndexBuild(HWSESSION hSession, LPCTSTR lpszFile,
+	DECODE_MODE eMode, UINT uIntervalKB, FILE_INDEX* pIndex);
+
+// Writes the sidecar of lpszFile
+BOOL FileIndexSave(LPCTSTR lpszFile, const FILE_INDEX* pIndex);
+
+// Reads the sidecar of lpszFile.  Fails if there is none, or if the file
+// has been written to since it was indexed.
+BOOL FileIndexLoad(LPCTSTR lpszFile, FILE_INDEX* pIndex);
+
+void FileIndexFree(FILE_INDEX* pIndex);
+
+// Decodes the bytes [qwOffset, qwOffset + qwLength) of lpszFile into hDoc
+// at qwPosition, starting from the last checkpoint at or before qwOffset.
+// *pqwOut receives the bytes inserted; fewer than qwLength (the window
+// runs past the data) is DECODE_TRUNCATED.  A user abort deletes them
+// again.
+DECODE_STATUS FileIndexExtract(HWSESSION hSession, LPCTSTR lpszFile,
+	const FILE_INDEX* pIndex, QWORD qwOffset, QWORD qwLength,
+	HWDOCUMENT hDoc, QWORD qwPosition, QWORD* pqwOut);
@@ -0,0 +1,409 @@
+#include "hex.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define HEX_SSE2
+#include <emmintrin.h>
+#endif
+
+#define HEX_INVALID 0xFF
+#define HEX_SKIP    0xFE
+
+/* After a failed 16-character SIMD block, stay scalar for this many characters */
+#define HEX_SCALAR_RUN 16
+
+/* ASCII order for hex decode: nibble value, HEX_SKIP for blanks, HEX_INVALID otherwise */
+static unsigned char hexde[256];
+
+static int
+hex_init_table(void)
+{
+	int i;
+
+	for (i = 0; i < 256; i++) {
+		hexde[i] = HEX_INVALID;
+	}
+	for (i = 0; i < 10; i++) {
+		hexde['0' + i] = (unsigned char)i;
+	}
+	for (i = 0; i < 6; i++) {
+		hexde['A' + i] = (unsigned char)(10 + i);
+		hexde['a' + i] = (unsigned char)(10 + i);
+	}
+	hexde[' '] = HEX_SKIP;
+	hexde['\t'] = HEX_SKIP;
+	hexde['\r'] = HEX_SKIP;
+	hexde['\n'] = HEX_SKIP;
+
+	return 1;
+}
+
+static const int hex_table_ready = hex_init_table();
+
+#ifdef HEX_SSE2
+/*
+ * Converts 16 hex digits into 8 bytes, one byte per 16-bit lane (not yet
+ * packed). Returns 0 if any of the 16 characters is not a hex digit of the
+ * given case.
+ */
+static int
+hex_sse2_lanes(const char* in, __m128i* lanes, int letters = HEX_CASE_ANY)
+{
+	const __m128i v = _mm_loadu_si128((const __m128i*)in);
+	const __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+	const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+		_mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+	const __m128i cased = (letters == HEX_CASE_ANY) ? lower : v;
+	const char first = (letters == HEX_CASE_UPPER) ? 'A' : 'a';
+	const __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(cased, _mm_set1_epi8(first - 1)),
+		_mm_cmplt_epi8(cased, _mm_set1_epi8(first + 5 + 1)));
+
+	if (_mm_movemask_epi8(_mm_or_si128(digit, alpha)) != 0xFFFF) {
+		return 0;
+	}
+
+	const __m128i nib = _mm_or_si128(
+		_mm_and_si128(digit, _mm_sub_epi8(v, _mm_set1_epi8('0'))),
+		_mm_and_si128(alpha, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+
+	/* lane = high nibble (even character) << 4 | low nibble (odd character) */
+	*lanes = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(nib, _mm_set1_epi16(0x00FF)), 4),
+		_mm_srli_epi16(nib, 8));
+	return 1;
+}
+
+/*
+ * Reverses the byte order inside each word; bytes still sit one per
+ * 16-bit lane, so this is a lane shuffle ahead of the pack.
+ */
+static __m128i
+hex_sse2_swap(__m128i lanes, unsigned int wordsize)
+{
+	switch (wordsize) {
+	case 2:
+		lanes = _mm_shufflelo_epi16(lanes, _MM_SHUFFLE(2, 3, 0, 1));
+		return _mm_shufflehi_epi16(lanes, _MM_SHUFFLE(2, 3, 0, 1));
+	case 4:
+		lanes = _mm_shufflelo_epi16(lanes, _MM_SHUFFLE(0, 1, 2, 3));
+		return _mm_shufflehi_epi16(lanes, _MM_SHUFFLE(0, 1, 2, 3));
+	case 8:
+		lanes = _mm_shufflelo_epi16(lanes, _MM_SHUFFLE(0, 1, 2, 3));
+		lanes = _mm_shufflehi_epi16(lanes, _MM_SHUFFLE(0, 1, 2, 3));
+		return _mm_shuffle_epi32(lanes, _MM_SHUFFLE(1, 0, 3, 2));
+	}
+	return lanes;
+}
+
+/*
+ * 8 bytes for 16 digits: decoding in place, out + j never passes the
+ * digits just loaded, so no text is overwritten before it is read.
+ */
+static void
+hex_sse2_store(unsigned char* out, __m128i lanes)
+{
+	_mm_storel_epi64((__m128i*)out, _mm_packus_epi16(lanes, lanes));
+}
+#endif
+
+#ifdef HEX_SSE2
+/* 16 bytes to 32 upper-case hex digits */
+static void
+hex_sse2_encode(const unsigned char* in, char* out)
+{
+	const __m128i v = _mm_loadu_si128((const __m128i*)in);
+	const __m128i mask = _mm_set1_epi8(0x0F);
+	const __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+	const __m128i lo = _mm_and_si128(v, mask);
+	const __m128i nine = _mm_set1_epi8(9);
+	const __m128i zero = _mm_set1_epi8('0');
+	const __m128i alpha = _mm_set1_epi8('A' - '0' - 10);
+
+	const __m128i hc = _mm_add_epi8(_mm_add_epi8(hi, zero), _mm_and_si128(_mm_cmpgt_epi8(hi, nine), alpha));
+	const __m128i lc = _mm_add_epi8(_mm_add_epi8(lo, zero), _mm_and_si128(_mm_cmpgt_epi8(lo, nine), alpha));
+
+	_mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi8(hc, lc));
+	_mm_storeu_si128((__m128i*)(out + 16), _mm_unpackhi_epi8(hc, lc));
+}
+#endif
+
+size_t
+hex_encode(const unsigned char* in, size_t inlen, char* out, char sep)
+{
+	static const char digits[] = "0123456789ABCDEF";
+	size_t i = 0;
+	size_t j = 0;
+
+#ifdef HEX_SSE2
+	if (!sep) {
+		for (; i + 16 <= inlen; i += 16, j += 32) {
+			hex_sse2_encode(in + i, out + j);
+		}
+	}
+#endif
+	for (; i < inlen; i++) {
+		if (sep && i) {
+			out[j++] = sep;
+		}
+		out[j++] = digits[in[i] >> 4];
+		out[j++] = digits[in[i] & 0xF];
+	}
+
+	out[j] = 0;
+
+	return j;
+}
+
+size_t
+hex_decode(const char* in, size_t inlen, unsigned char* out, size_t* inused)
+{
+	size_t i;
+	size_t j;
+	size_t scalar_until = 0;
+	unsigned char hi;
+	unsigned char lo;
+
+	for (i = j = 0; i < inlen; ) {
+#ifdef HEX_SSE2
+		if (i >= scalar_until && inlen - i >= 16) {
+			__m128i lanes;
+			if (hex_sse2_lanes(in + i, &lanes)) {
+				hex_sse2_store(out + j, lanes);
+				i += 16;
+				j += 8;
+				continue;
+			}
+			scalar_until = i + HEX_SCALAR_RUN;
+		}
+#endif
+		hi = hexde[(unsigned char)in[i]];
+		if (hi == HEX_SKIP) {
+			i++;
+			continue;
+		}
+		if (hi == HEX_INVALID || i + 1 >= inlen) {
+			break;
+		}
+		lo = hexde[(unsigned char)in[i + 1]];
+		if (lo >= 16) {
+			break;
+		}
+		out[j++] = (unsigned char)((hi << 4) | lo);
+		i += 2;
+	}
+
+	*inused = i;
+	return j;
+}
+
+static size_t
+hex_store_word(unsigned char* out, unsigned long long v, unsigned int wordsize, int bigendian)
+{
+	unsigned int k;
+
+	for (k = 0; k < wordsize; k++) {
+		unsigned int shift = bigendian ? (wordsize - 1 - k) * 8 : k * 8;
+		out[k] = (unsigned char)(v >> shift);
+	}
+	return wordsize;
+}
+
+size_t
+hex_decode_words(const char* in, size_t inlen, unsigned char* out,
+	unsigned int wordsize, int bigendian, int final, size_t* inused)
+{
+	size_t i;
+	size_t j;
+	size_t k;
+	size_t scalar_until = 0;
+	unsigned int digits = wordsize * 2;
+	unsigned int n;
+	unsigned char c;
+	unsigned long long v;
+
+	for (i = j = 0; i < inlen; ) {
+		c = hexde[(unsigned char)in[i]];
+		if (c == HEX_SKIP) {
+			i++;
+			continue;
+		}
+		if (c == HEX_INVALID) {
+			break;
+		}
+
+		/* i is at a word boundary inside a group */
+#ifdef HEX_SSE2
+		if (i >= scalar_until && inlen - i >= 16) {
+			__m128i lanes;
+			if (hex_sse2_lanes(in + i, &lanes)) {
+				if (!bigendian) {
+					lanes = hex_sse2_swap(lanes, wordsize);
+				}
+				hex_sse2_store(out + j, lanes);
+				i += 16;
+				j += 8;
+				continue;
+			}
+			scalar_until = i + HEX_SCALAR_RUN;
+		}
+#endif
+		v = 0;
+		for (k = i, n = 0; k < inlen && n < digits && (c = hexde[(unsigned char)in[k]]) < 16; k++, n++) {
+			v = (v << 4) | c;
+		}
+		if (n < digits) {
+			/* short word ends the group */
+			if (k == inlen && !final) {
+				break;
+			}
+			if (k < inlen && c == HEX_INVALID) {
+				break;
+			}
+		}
+		j += hex_store_word(out + j, v, wordsize, bigendian);
+		i = k;
+	}
+
+	*inused = i;
+	return j;
+}
+
+/* nibble value, HEX_SKIP for what Policy skips, HEX_INVALID otherwise */
+template <class Policy> struct hex_policy_de {
+	unsigned char table[256];
+
+	hex_policy_de()
+	{
+		int i;
+
+		for (i = 0; i < 256; i++) {
+			unsigned char c = hexde[i];
+			if (c < 16 && i >= 'A') {
+				if ((Policy::letters == HEX_CASE_UPPER && i >= 'a') ||
+					(Policy::letters == HEX_CASE_LOWER && i < 'a')) {
+					c = HEX_INVALID;
+				}
+			}
+			if (c == HEX_SKIP && !Policy::blanks) {
+				c = HEX_INVALID;
+			}
+			if (c == HEX_INVALID && Policy::separators && Policy::is_separator((unsigned char)i)) {
+				c = HEX_SKIP;
+			}
+			if (c == HEX_INVALID && Policy::skip_invalid) {
+				c = HEX_SKIP;
+			}
+			table[i] = c;
+		}
+	}
+};
+
+template <class Policy> static const unsigned char*
+hex_policy_table(void)
+{
+	static const hex_policy_de<Policy> de;
+	return de.table;
+}
+
+template <class Policy> size_t
+hex_decode_t(const char* in, size_t inlen, unsigned char* out, int final, size_t* inused)
+{
+	const unsigned char* de = hex_policy_table<Policy>();
+	size_t i = 0;
+	size_t j = 0;
+	unsigned char hi = 0;
+	unsigned char lo;
+
+	(void)final;
+
+	if (Policy::skip_invalid) {
+		/* digits pair up across whatever is dropped between them */
+		size_t done = 0;
+		int half = 0;
+
+		for (; i < inlen; i++) {
+			lo = de[(unsigned char)in[i]];
+			if (lo >= 16) {
+				continue;
+			}
+			if (half) {
+				out[j++] = (unsigned char)((hi << 4) | lo);
+				done = i + 1;
+			}
+			else {
+				hi = lo;
+			}
+			half = !half;
+		}
+
+		*inused = half ? done : inlen;
+		return j;
+	}
+
+	if (!Policy::blanks && !Policy::separators) {
+		/* nothing to skip: blocks run back to back until one fails */
+#ifdef HEX_SSE2
+		__m128i lanes;
+		while (inlen - i >= 16 && hex_sse2_lanes(in + i, &lanes, Policy::letters)) {
+			hex_sse2_store(out + j, lanes);
+			i += 16;
+			j += 8;
+		}
+#endif
+		for (; i + 1 < inlen; i += 2) {
+			hi = de[(unsigned char)in[i]];
+			lo = de[(unsigned char)in[i + 1]];
+			if ((hi | lo) >= 16) {
+				break;
+			}
+			out[j++] = (unsigned char)((hi << 4) | lo);
+		}
+
+		*inused = i;
+		return j;
+	}
+
+	size_t scalar_until = 0;
+	while (i < inlen) {
+#ifdef HEX_SSE2
+		/* prefixes break every block of 16, so those inputs stay scalar */
+		if (!Policy::prefixed && i >= scalar_until && inlen - i >= 16) {
+			__m128i lanes;
+			if (hex_sse2_lanes(in + i, &lanes, Policy::letters)) {
+				hex_sse2_store(out + j, lanes);
+				i += 16;
+				j += 8;
+				continue;
+			}
+			scalar_until = i + HEX_SCALAR_RUN;
+		}
+#endif
+		if (Policy::prefixed && (in[i] == '0' || in[i] == '\\') &&
+			i + 1 < inlen && (in[i + 1] == 'x' || in[i + 1] == 'X')) {
+			i += 2;
+			continue;
+		}
+		hi = de[(unsigned char)in[i]];
+		if (hi == HEX_SKIP) {
+			i++;
+			continue;
+		}
+		if (hi == HEX_INVALID || i + 1 >= inlen) {
+			break;
+		}
+		lo = de[(unsigned char)in[i + 1]];
+		if (lo >= 16) {
+			break;
+		}
+		out[j++] = (unsigned char)((hi << 4) | lo);
+		i += 2;
+	}
+
+	*inused = i;
+	return j;
+}
+
+template size_t hex_decode_t<hex_policy_strict>(const char*, size_t, unsigned char*, int, size_t*);
+template size_t hex_decode_t<hex_policy_strict_upper>(const char*, size_t, unsigned char*, int, size_t*);
+template size_t hex_decode_t<hex_policy_blanks>(const char*, size_t, unsigned char*, int, size_t*);
+template size_t hex_decode_t<hex_policy_separated>(const char*, size_t, unsigned char*, int, size_t*);
+template size_t hex_decode_t<hex_policy_filter>(const char*, size_t, unsigned char*, int, size_t*);
+template size_t hex_decode_t<hex_policy_prefixed>(const char*, size_t, unsigned char*, int, size_t*);
@@ -0,0 +1,119 @@
+#pragma once
+
+#ifndef HEX_H
+#define HEX_H
+
+#include <stddef.h>
+
+#define IsHexChar(a) ((a >= '0' && a <= '9') || (a >= 'A' && a <= 'F') || (a >= 'a' && a <= 'f'))
+#define IsSkipChar(a) ((a == ' ') || (a == 0xd) || (a == 0xa) || (a == '\t'))
+
+/* encoded size including the terminating `\0'; sep is 0 or 1 separator character */
+#define HEX_ENCODE_OUT_SIZE(s, sep) ((s) * 2 + ((s) ? ((s) - 1) * (sep) : 0) + 1)
+#define HEX_DECODE_OUT_SIZE(s) ((s) / 2)
+/* worst case for hex_decode_words: one-digit groups, one word each */
+#define HEX_DECODE_WORDS_OUT_SIZE(s, w) (((s) / 2 + 1) * (w))
+
+/*
+ * Writes two upper-case hex digits per byte, with sep between bytes
+ * unless sep is 0.
+ * out is null-terminated encode string.
+ * return values is out length, exclusive terminating `\0'
+ */
+size_t
+hex_encode(const unsigned char* in, size_t inlen, char* out, char sep);
+
+/*
+ * Decodes pairs of hex digits, skipping blanks between pairs.
+ * Stops at the first character that is neither a digit nor a blank, or
+ * when a single digit is left at the end of the input.
+ * out may be in; in[inused..inlen) is left as it was.
+ * inused receives the number of characters consumed.
+ * return values is out length
+ */
+size_t
+hex_decode(const char* in, size_t inlen, unsigned char* out, size_t* inused);
+
+/*
+ * Decodes blank-separated groups of hex digits as wordsize-byte values
+ * (2, 4 or 8) written most significant digit first, e.g. "DEADBEEF".
+ * A group is split into words from the left; a shorter last word is
+ * zero-extended. Words are stored big-endian if bigendian is non-zero,
+ * little-endian otherwise.
+ * Unless final is non-zero, an unterminated group at the end of the input
+ * is left unconsumed so it can be completed by the next call.
+ * A one-digit group yields a whole word, so out must not overlap in.
+ * inused receives the number of characters consumed.
+ * return values is out length
+ */
+size_t
+hex_decode_words(const char* in, size_t inlen, unsigned char* out,
+	unsigned int wordsize, int bigendian, int final, size_t* inused);
+
+#ifdef __cplusplus
+/*
+ * Policies for hex_decode_t. Each fixes one text convention at compile
+ * time, so the decode loop only carries the checks that convention needs:
+ *   blanks        skip ' ', '\t', '\r' and '\n' between pairs
+ *   separators    skip the characters accepted by is_separator between pairs
+ *   letters       HEX_CASE_ANY, HEX_CASE_UPPER or HEX_CASE_LOWER digits
+ *   skip_invalid  drop every other character instead of stopping there; a
+ *                 pair may then straddle the dropped characters
+ *   prefixed      skip a "0x" or "\x" in front of a pair
+ */
+#define HEX_CASE_ANY   0
+#define HEX_CASE_UPPER 1
+#define HEX_CASE_LOWER 2
+
+/* "DEADBEEF": nothing but digits */
+struct hex_policy_strict {
+	enum { blanks = 0, separators = 0, letters = HEX_CASE_ANY, skip_invalid = 0, prefixed = 0 };
+	static int is_separator(unsigned char) { return 0; }
+};
+
+/* "DEADBEEF" as hex_encode writes it: upper-case digits only */
+struct hex_policy_strict_upper {
+	enum { blanks = 0, separators = 0, letters = HEX_CASE_UPPER, skip_invalid = 0, prefixed = 0 };
+	static int is_separator(unsigned char) { return 0; }
+};
+
+/* "DE AD BE EF", line breaks allowed: what hex_decode accepts */
+struct hex_policy_blanks {
+	enum { blanks = 1, separators = 0, letters = HEX_CASE_ANY, skip_invalid = 0, prefixed = 0 };
+	static int is_separator(unsigned char) { return 0; }
+};
+
+/* "de:ad:be:ef", "DE-AD-BE-EF", "DE,AD,BE,EF" */
+struct hex_policy_separated {
+	enum { blanks = 1, separators = 1, letters = HEX_CASE_ANY, skip_invalid = 0, prefixed = 0 };
+	static int is_separator(unsigned char c) { return c == ':' || c == '-' || c == ',' || c == '.'; }
+};
+
+/* every hex digit in the text, anything else dropped */
+struct hex_policy_filter {
+	enum { blanks = 0, separators = 0, letters = HEX_CASE_ANY, skip_invalid = 1, prefixed = 0 };
+	static int is_separator(unsigned char) { return 0; }
+};
+
+/* "0x4D, 0x5A, 0x90", "{ 0x4d,0x5a }", "\x4d\x5a\x90": C and Python literals */
+struct hex_policy_prefixed {
+	enum { blanks = 1, separators = 1, letters = HEX_CASE_ANY, skip_invalid = 0, prefixed = 1 };
+	static int is_separator(unsigned char c) { return c == ',' || c == ';' || c == '{' || c == '}'; }
+};
+
+/*
+ * Decodes hex text following Policy; instantiated in hex.cpp for the
+ * policies above. Stops at the first character the policy rejects. A
+ * digit left without its partner is never consumed, so it can be
+ * completed by the next call; final is accepted for symmetry with
+ * base64_decode_t and otherwise unused.
+ * out may be in: bytes are only written over digits already read, SIMD
+ * blocks included, and in[inused..inlen) is left as it was.
+ * inused receives the number of characters consumed.
+ * return values is out length
+ */
+template <class Policy> size_t
+hex_decode_t(const char* in, size_t inlen, unsigned char* out, int final, size_t* inused);
+#endif
+
+#endif /* HEX_H */
@@ -0,0 +1,363 @@
+#include "hexdump.h"
+
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define HEXDUMP_SSSE3
+#include <tmmintrin.h>
+#include "cpu.h"
+#endif
+
+/*
+ * A line after its offset, described once per style. Each entry is a
+ * literal character, or the hex digit / ASCII column of one of the 16
+ * bytes; the scalar and the SSSE3 writers both walk the same template.
+ */
+#define HEXDUMP_LITERAL 0
+#define HEXDUMP_DIGIT   1   /* value: digit 0..31, two per byte */
+#define HEXDUMP_ASCII   2   /* value: byte 0..15 */
+
+/* longest template, rounded up to whole 16-byte blocks */
+#define HEXDUMP_MAX_LINE 80
+
+static const char hexdump_digits[] = "0123456789abcdef";
+
+struct hexdump_layout {
+	unsigned char kind[HEXDUMP_MAX_LINE];
+	unsigned char value[HEXDUMP_MAX_LINE];
+	size_t len;
+#ifdef HEXDUMP_SSSE3
+	/* per 16-byte block: shuffles picking from the low / high 16 digits
+	   and the ASCII column, and the literals in between */
+	__m128i from_lo[HEXDUMP_MAX_LINE / 16];
+	__m128i from_hi[HEXDUMP_MAX_LINE / 16];
+	__m128i from_ascii[HEXDUMP_MAX_LINE / 16];
+	__m128i literal[HEXDUMP_MAX_LINE / 16];
+#endif
+
+	void put(int k, int v)
+	{
+		kind[len] = (unsigned char)k;
+		value[len] = (unsigned char)v;
+		len++;
+	}
+
+	explicit hexdump_layout(int style)
+	{
+		int i;
+
+		len = 0;
+		if (style == HEXDUMP_XXD) {
+			put(HEXDUMP_LITERAL, ':');
+			put(HEXDUMP_LITERAL, ' ');
+			for (i = 0; i < 32; i++) {
+				put(HEXDUMP_DIGIT, i);
+				if (i % 4 == 3) {
+					put(HEXDUMP_LITERAL, ' ');
+				}
+			}
+			put(HEXDUMP_LITERAL, ' ');
+			for (i = 0; i < 16; i++) {
+				put(HEXDUMP_ASCII, i);
+			}
+		}
+		else {
+			put(HEXDUMP_LITERAL, ' ');
+			put(HEXDUMP_LITERAL, ' ');
+			for (i = 0; i < 16; i++) {
+				put(HEXDUMP_DIGIT, i * 2);
+				put(HEXDUMP_DIGIT, i * 2 + 1);
+				put(HEXDUMP_LITERAL, ' ');
+				if (i == 7) {
+					put(HEXDUMP_LITERAL, ' ');
+				}
+			}
+			put(HEXDUMP_LITERAL, ' ');
+			put(HEXDUMP_LITERAL, '|');
+			for (i = 0; i < 16; i++) {
+				put(HEXDUMP_ASCII, i);
+			}
+			put(HEXDUMP_LITERAL, '|');
+		}
+		put(HEXDUMP_LITERAL, '\r');
+		put(HEXDUMP_LITERAL, '\n');
+
+#ifdef HEXDUMP_SSSE3
+		for (size_t b = 0; b < HEXDUMP_MAX_LINE / 16; b++) {
+			unsigned char lo[16], hi[16], ascii[16], lit[16];
+			for (i = 0; i < 16; i++) {
+				size_t p = b * 16 + i;
+				int k = p < len ? kind[p] : HEXDUMP_LITERAL;
+				int v = p < len ? value[p] : 0;
+				lo[i] = (k == HEXDUMP_DIGIT && v < 16) ? (unsigned char)v : 0x80;
+				hi[i] = (k == HEXDUMP_DIGIT && v >= 16) ? (unsigned char)(v - 16) : 0x80;
+				ascii[i] = (k == HEXDUMP_ASCII) ? (unsigned char)v : 0x80;
+				lit[i] = (k == HEXDUMP_LITERAL) ? (unsigned char)v : 0;
+			}
+			from_lo[b] = _mm_loadu_si128((const __m128i*)lo);
+			from_hi[b] = _mm_loadu_si128((const __m128i*)hi);
+			from_ascii[b] = _mm_loadu_si128((const __m128i*)ascii);
+			literal[b] = _mm_loadu_si128((const __m128i*)lit);
+		}
+#endif
+	}
+};
+
+static const hexdump_layout*
+hexdump_layout_of(int style)
+{
+	static const hexdump_layout xxd(HEXDUMP_XXD);
+	static const hexdump_layout canonical(HEXDUMP_CANONICAL);
+	return style == HEXDUMP_XXD ? &xxd : &canonical;
+}
+
+static char
+hexdump_printable(unsigned char c)
+{
+	return (c >= 0x20 && c < 0x7F) ? (char)c : '.';
+}
+
+static size_t
+hexdump_offset(unsigned long long offset, int digits, char* out)
+{
+	int i;
+
+	for (i = digits - 1; i >= 0; i--) {
+		out[i] = hexdump_digits[offset & 0xF];
+		offset >>= 4;
+	}
+	return (size_t)digits;
+}
+
+/* one line of n bytes (1..16); a short line keeps the hex columns aligned */
+static size_t
+hexdump_line(const hexdump_layout* layout, const unsigned char* in, size_t n, char* out)
+{
+	size_t i;
+	size_t j = 0;
+
+	for (i = 0; i < layout->len; i++) {
+		unsigned int v = layout->value[i];
+		switch (layout->kind[i]) {
+		case HEXDUMP_DIGIT:
+			if (v / 2 >= n) {
+				out[j++] = ' ';
+			}
+			else {
+				out[j++] = hexdump_digits[(v & 1) ? (in[v / 2] & 0xF) : (in[v / 2] >> 4)];
+			}
+			break;
+		case HEXDUMP_ASCII:
+			if (v < n) {
+				out[j++] = hexdump_printable(in[v]);
+			}
+			break;
+		default:
+			out[j++] = (char)v;
+			break;
+		}
+	}
+	return j;
+}
+
+#ifdef HEXDUMP_SSSE3
+/*
+ * One full line: nibbles become digits with one shuffle each, bytes
+ * outside 0x20..0x7e become '.', and every 16-byte block of the line is
+ * put together from three shuffles and the literals. Stores whole blocks,
+ * so up to 15 bytes past the line are overwritten.
+ */
+CPU_TARGET_SSSE3 static size_t
+hexdump_ssse3_line(const hexdump_layout* layout, const unsigned char* in, char* out)
+{
+	const __m128i digits = _mm_loadu_si128((const __m128i*)hexdump_digits);
+	const __m128i mask = _mm_set1_epi8(0x0F);
+	const __m128i v = _mm_loadu_si128((const __m128i*)in);
+	const __m128i hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+	const __m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(v, mask));
+	const __m128i digits_lo = _mm_unpacklo_epi8(hi, lo);
+	const __m128i digits_hi = _mm_unpackhi_epi8(hi, lo);
+
+	/* signed compares: 0x80..0xff are negative and fail the first one */
+	const __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(0x1F)),
+		_mm_cmplt_epi8(v, _mm_set1_epi8(0x7F)));
+	const __m128i ascii = _mm_or_si128(_mm_and_si128(printable, v),
+		_mm_andnot_si128(printable, _mm_set1_epi8('.')));
+
+	size_t b;
+	for (b = 0; b * 16 < layout->len; b++) {
+		__m128i block = _mm_or_si128(_mm_shuffle_epi8(digits_lo, layout->from_lo[b]),
+			_mm_shuffle_epi8(digits_hi, layout->from_hi[b]));
+		block = _mm_or_si128(block, _mm_shuffle_epi8(ascii, layout->from_ascii[b]));
+		_mm_storeu_si128((__m128i*)(out + b * 16), _mm_or_si128(block, layout->literal[b]));
+	}
+	return layout->len;
+}
+#endif
+
+int
+hexdump_offset_digits(unsigned long long offset, unsigned long long len)
+{
+	unsigned long long last = offset + len;
+	int digits = 8;
+
+	while (digits < 16 && (last >> (digits * 4)) != 0) {
+		digits++;
+	}
+	return digits;
+}
+
+unsigned long long
+hexdump_size(int style, int digits, unsigned long long len)
+{
+	const hexdump_layout* layout = hexdump_layout_of(style);
+	unsigned long long lines = (len + HEXDUMP_LINE_BYTES - 1) / HEXDUMP_LINE_BYTES;
+	unsigned long long size;
+
+	if (len == 0) {
+		return 0;
+	}
+	/* a short last line leaves out the ASCII columns of missing bytes */
+	size = lines * (digits + layout->len) - (lines * HEXDUMP_LINE_BYTES - len);
+	if (style == HEXDUMP_CANONICAL) {
+		size += digits + 2;
+	}
+	return size;
+}
+
+size_t
+hexdump_format(const unsigned char* in, size_t inlen, unsigned long long offset,
+	int style, int digits, int final, char* out)
+{
+	const hexdump_layout* layout = hexdump_layout_of(style);
+	size_t i = 0;
+	size_t j = 0;
+
+#ifdef HEXDUMP_SSSE3
+	/* the whole-block stores spill into the next line, written afterwards */
+	if (cpu_has_ssse3()) {
+		for (; inlen - i >= 2 * HEXDUMP_LINE_BYTES; i += HEXDUMP_LINE_BYTES) {
+			j += hexdump_offset(offset + i, digits, out + j);
+			j += hexdump_ssse3_line(layout, in + i, out + j);
+		}
+	}
+#endif
+	for (; i < inlen; i += HEXDUMP_LINE_BYTES) {
+		size_t n = inlen - i < HEXDUMP_LINE_BYTES ? inlen - i : HEXDUMP_LINE_BYTES;
+		j += hexdump_offset(offset + i, digits, out + j);
+		j += hexdump_line(layout, in + i, n, out + j);
+	}
+
+	if (final && style == HEXDUMP_CANONICAL && inlen) {
+		j += hexdump_offset(offset + inlen, digits, out + j);
+		out[j++] = '\r';
+		out[j++] = '\n';
+	}
+	return j;
+}
+
+static int
+hexdump_nibble(char c)
+{
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+/*
+ * The bytes of the line in[0..len), line break excluded.
+ * return values is bytes written, or -1 if the line does not parse
+ */
+static int
+hexdump_parse_line(const char* in, size_t len, unsigned char* out)
+{
+	size_t i = 0;
+	size_t k;
+	int xxd;
+	int n = 0;
+
+	while (len && (in[len - 1] == '\r' || in[len - 1] == ' ')) {
+		len--;
+	}
+	while (i < len && (in[i] == ' ' || in[i] == '\t')) {
+		i++;
+	}
+	if (i == len) {
+		return 0;
+	}
+
+	/* the offset */
+	for (k = i; k < len && hexdump_nibble(in[k]) >= 0; k++) {
+	}
+	if (k == i || (k < len && in[k] != ':' && in[k] != ' ')) {
+		return -1;
+	}
+	xxd = (k < len && in[k] == ':');
+	i = k + xxd;
+
+	while (i < len && n < HEXDUMP_LINE_BYTES) {
+		/* blanks between groups; two end the hex columns of xxd */
+		for (k = i; k < len && in[k] == ' '; k++) {
+		}
+		if (k == i && n) {
+			return -1;
+		}
+		if ((xxd && k - i >= 2 && n) || k == len || in[k] == '|') {
+			break;
+		}
+		i = k;
+
+		/* one group: a byte, or two in xxd */
+		for (k = i; k < len && in[k] != ' '; k++) {
+		}
+		if ((k - i) & 1) {
+			return -1;
+		}
+		for (; i < k && n < HEXDUMP_LINE_BYTES; i += 2) {
+			int hi = hexdump_nibble(in[i]);
+			int lo = hexdump_nibble(in[i + 1]);
+			if (hi < 0 || lo < 0) {
+				return -1;
+			}
+			out[n++] = (unsigned char)((hi << 4) | lo);
+		}
+	}
+
+	return n;
+}
+
+size_t
+hexdump_parse(const char* in, size_t inlen, unsigned char* out, int final, size_t* inused)
+{
+	size_t i = 0;
+	size_t j = 0;
+	unsigned char line[HEXDUMP_LINE_BYTES];
+
+	while (i < inlen) {
+		const char* eol = (const char*)memchr(in + i, '\n', inlen - i);
+		size_t end = eol ? (size_t)(eol - in) : inlen;
+		int n;
+
+		if (!eol && !final) {
+			break;
+		}
+		/* a line that fails half-way must not have been written over in */
+		n = hexdump_parse_line(in + i, end - i, line);
+		if (n < 0) {
+			break;
+		}
+		memcpy(out + j, line, n);
+		j += n;
+		i = eol ? end + 1 : inlen;
+	}
+
+	*inused = i;
+	return j;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#ifndef HEXDUMP_H
+#define HEXDUMP_H
+
+#include <stddef.h>
+
+/*
+ * Formats bytes as hexdump text, 16 bytes per line, lines ending in CRLF:
+ *
+ * HEXDUMP_XXD        like xxd
+ *   00000000: 4865 6c6c 6f2c 2077 6f72 6c64 210a 0000  Hello, world!...
+ * HEXDUMP_CANONICAL  like hexdump -Cv, followed by a line with the end offset
+ *   00000000  48 65 6c 6c 6f 2c 20 77  6f 72 6c 64 21 0a 00 00  |Hello, world!...|
+ *   00000010
+ *
+ * Offsets are printed with a fixed number of digits for the whole dump,
+ * at least 8. Repeated lines are never folded into '*', so the length of
+ * the text only depends on the byte count.
+ */
+
+#define HEXDUMP_XXD       0
+#define HEXDUMP_CANONICAL 1
+
+#define HEXDUMP_LINE_BYTES 16
+
+/*
+ * Digits needed for the offsets of a dump of len bytes starting at offset.
+ */
+int
+hexdump_offset_digits(unsigned long long offset, unsigned long long len);
+
+/*
+ * Exact length of the text for len bytes, without a terminating `\0'.
+ */
+unsigned long long
+hexdump_size(int style, int digits, unsigned long long len);
+
+/*
+ * Formats the lines for in[0..inlen); offset is the address printed for
+ * in[0]. Every call but the last must pass a multiple of
+ * HEXDUMP_LINE_BYTES. final appends the end offset line of
+ * HEXDUMP_CANONICAL.
+ * return values is out length
+ */
+size_t
+hexdump_format(const unsigned char* in, size_t inlen, unsigned long long offset,
+	int style, int digits, int final, char* out);
+
+/*
+ * Reads the bytes back out of xxd or hexdump -C text: the offset of each
+ * line is skipped, then hex groups are read up to the ASCII column (after
+ * 16 bytes, a run of two blanks in xxd text, or the '|' of hexdump -C).
+ * Lines holding only an offset are skipped. Stops at the first line that
+ * does not parse, such as the '*' hexdump writes for repeated lines.
+ * Unless final is non-zero, a line without its line break is left
+ * unconsumed so it can be completed by the next call.
+ * out may be in; in[inused..inlen) is left as it was.
+ * inused receives the number of characters consumed.
+ * return values is out length
+ */
+size_t
+hexdump_parse(const char* in, size_t inlen, unsigned char* out, int final, size_t* inused);
+
+#endif /* HEXDUMP_H */
@@ -0,0 +1,120 @@
+#include "ihex.h"
+#include "hex.h"
+
+#include <string.h>
+
+#define IHEX_DATA              0x00
+#define IHEX_END_OF_FILE       0x01
+#define IHEX_EXTENDED_SEGMENT  0x02
+#define IHEX_START_SEGMENT     0x03
+#define IHEX_EXTENDED_LINEAR   0x04
+#define IHEX_START_LINEAR      0x05
+
+/* length, address, type, 255 data bytes and checksum */
+#define IHEX_MAX_RECORD (1 + 2 + 1 + 255 + 1)
+
+void
+ihex_init(ihex_state* state)
+{
+	memset(state, 0, sizeof(*state));
+}
+
+/*
+ * One record, line break excluded.
+ * return values is data bytes written, or -1 if the record is rejected
+ */
+static int
+ihex_record(const char* in, size_t len, unsigned char* out, ihex_state* state)
+{
+	unsigned char rec[IHEX_MAX_RECORD];
+	size_t used;
+	size_t n;
+	size_t k;
+	unsigned char sum = 0;
+	unsigned long address;
+
+	while (len && (in[len - 1] == '\r' || in[len - 1] == ' ' || in[len - 1] == '\t')) {
+		len--;
+	}
+	while (len && (in[0] == ' ' || in[0] == '\t')) {
+		in++;
+		len--;
+	}
+	if (len == 0) {
+		return 0;
+	}
+	if (in[0] != ':' || len < 11 || len > 1 + 2 * IHEX_MAX_RECORD || !(len & 1)) {
+		return -1;
+	}
+
+	/* the digits go through the same kernel as pasted hex */
+	n = hex_decode_t<hex_policy_strict>(in + 1, len - 1, rec, 1, &used);
+	if (used != len - 1 || n != (size_t)rec[0] + 5) {
+		return -1;
+	}
+	for (k = 0; k < n; k++) {
+		sum = (unsigned char)(sum + rec[k]);
+	}
+	if (sum != 0) {
+		return -1;
+	}
+
+	address = ((unsigned long)rec[1] << 8) | rec[2];
+	switch (rec[3]) {
+	case IHEX_DATA:
+		address += state->base;
+		if (state->started && address != state->next) {
+			return -1;
+		}
+		memcpy(out, rec + 4, rec[0]);
+		state->started = 1;
+		state->next = address + rec[0];
+		return rec[0];
+	case IHEX_END_OF_FILE:
+		state->ended = 1;
+		return 0;
+	case IHEX_EXTENDED_SEGMENT:
+		if (rec[0] != 2) {
+			return -1;
+		}
+		state->base = (((unsigned long)rec[4] << 8) | rec[5]) << 4;
+		return 0;
+	case IHEX_EXTENDED_LINEAR:
+		if (rec[0] != 2) {
+			return -1;
+		}
+		state->base = (((unsigned long)rec[4] << 8) | rec[5]) << 16;
+		return 0;
+	case IHEX_START_SEGMENT:
+	case IHEX_START_LINEAR:
+		return 0;
+	}
+	return -1;
+}
+
+size_t
+ihex_decode(const char* in, size_t inlen, unsigned char* out, ihex_state* state,
+	int final, size_t* inused)
+{
+	size_t i = 0;
+	size_t j = 0;
+
+	while (i < inlen && !state->ended) {
+		const char* eol = (const char*)memchr(in + i, '\n', inlen - i);
+		size_t end = eol ? (size_t)(eol - in) : inlen;
+		int n;
+
+		if (!eol && !final) {
+			break;
+		}
+		n = ihex_record(in + i, end - i, out + j, state);
+		if (n < 0) {
+			break;
+		}
+		j += n;
+		i = eol ? end + 1 : inlen;
+	}
+
+	*inused = state->ended ? inlen : i;
+	return j;
+}
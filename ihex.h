@@ -0,0 +1,42 @@
+#pragma once
+
+#ifndef IHEX_H
+#define IHEX_H
+
+#include <stddef.h>
+
+/*
+ * Intel HEX records, ":LLAAAATT<data>CC" one per line. Data records
+ * (type 00) are written out back to back; extended address records (02,
+ * 04) and start address records (03, 05) only set the address of the
+ * data that follows.
+ */
+
+#define IHEX_DECODE_OUT_SIZE(s) ((s) / 2)
+
+/* carried from one call to the next */
+typedef struct ihex_state {
+	unsigned long base;     /* from the last 02 / 04 record */
+	unsigned long next;     /* address the next data record must start at */
+	int started;            /* a data record was seen */
+	int ended;              /* the end of file record was seen */
+} ihex_state;
+
+void
+ihex_init(ihex_state* state);
+
+/*
+ * Stops at a record that does not parse or fails its checksum, and at a
+ * data record that does not continue where the previous one ended (the
+ * bytes are not placed at their addresses, so a gap would be lost).
+ * Everything after the end of file record (type 01) is consumed unread.
+ * Unless final is non-zero, a record without its line break is left
+ * unconsumed so it can be completed by the next call.
+ * inused receives the number of characters consumed.
+ * return values is out length
+ */
+size_t
+ihex_decode(const char* in, size_t inlen, unsigned char* out, ihex_state* state,
+	int final, size_t* inused);
+
+#endif /* IHEX_H */
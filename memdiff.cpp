@@ -0,0 +1,93 @@
+#include "memdiff.h"
+
+#include <string.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MEMDIFF_SSE2
+#include <emmintrin.h>
+#endif
+
+static unsigned int
+memdiff_ctz32(unsigned int x)
+{
+#if defined(__GNUC__)
+	return (unsigned int)__builtin_ctz(x);
+#else
+	unsigned long idx;
+	_BitScanForward(&idx, x);
+	return (unsigned int)idx;
+#endif
+}
+
+#ifdef MEMDIFF_SSE2
+/* bit i set where a[i] == b[i], for 32 bytes */
+static unsigned int
+memdiff_eq32(const unsigned char* a, const unsigned char* b)
+{
+	const __m128i a0 = _mm_loadu_si128((const __m128i*)a);
+	const __m128i a1 = _mm_loadu_si128((const __m128i*)(a + 16));
+	const __m128i b0 = _mm_loadu_si128((const __m128i*)b);
+	const __m128i b1 = _mm_loadu_si128((const __m128i*)(b + 16));
+
+	return (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(a0, b0)) |
+		((unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(a1, b1)) << 16);
+}
+#endif
+
+size_t
+memdiff_mismatch(const unsigned char* a, const unsigned char* b, size_t n)
+{
+	size_t i = 0;
+
+#ifdef MEMDIFF_SSE2
+	for (; n - i >= 32; i += 32) {
+		unsigned int ne = ~memdiff_eq32(a + i, b + i);
+		if (ne) {
+			return i + memdiff_ctz32(ne);
+		}
+	}
+#else
+	for (; n - i >= 8; i += 8) {
+		unsigned long long x;
+		unsigned long long y;
+		memcpy(&x, a + i, 8);
+		memcpy(&y, b + i, 8);
+		if (x != y) {
+			break;
+		}
+	}
+#endif
+
+	for (; i < n; i++) {
+		if (a[i] != b[i]) {
+			break;
+		}
+	}
+	return i;
+}
+
+size_t
+memdiff_match(const unsigned char* a, const unsigned char* b, size_t n)
+{
+	size_t i = 0;
+
+#ifdef MEMDIFF_SSE2
+	for (; n - i >= 32; i += 32) {
+		unsigned int eq = memdiff_eq32(a + i, b + i);
+		if (eq) {
+			return i + memdiff_ctz32(eq);
+		}
+	}
+#endif
+
+	/* differing runs are short in the usual case, so bytewise is fine here */
+	for (; i < n; i++) {
+		if (a[i] == b[i]) {
+			break;
+		}
+	}
+	return i;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#ifndef MEMDIFF_H
+#define MEMDIFF_H
+
+#include <stddef.h>
+
+/*
+ * Finds where two buffers start or stop differing, comparing 32 bytes per
+ * step with SSE2 equality masks (8 bytes per step elsewhere). Walking a
+ * pair of buffers with memdiff_mismatch and memdiff_match in turn yields
+ * every differing range in a single pass.
+ */
+
+/*
+ * return values is the offset of the first byte where a and b differ,
+ * or n if they are equal
+ */
+size_t
+memdiff_mismatch(const unsigned char* a, const unsigned char* b, size_t n);
+
+/*
+ * return values is the offset of the first byte where a and b agree,
+ * or n if they differ throughout
+ */
+size_t
+memdiff_match(const unsigned char* a, const unsigned char* b, size_t n);
+
+#endif /* MEMDIFF_H */
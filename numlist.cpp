@@ -0,0 +1,628 @@
+#include "numlist.h"
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/* longest value handed to the strtod fallback */
+#define NUMLIST_MAX_TOKEN 1024
+
+/* 5^-342 .. 5^308 as 128-bit values, see numlist_pow5.inc */
+#define NUMLIST_SMALLEST_POW5 (-342)
+static const unsigned long long numlist_pow5[] = {
+#include "numlist_pow5.inc"
+};
+
+/* IEEE binary formats and their Eisel-Lemire limits */
+typedef struct numlist_binary {
+	int mantissa_bits;
+	int minimum_exponent;
+	int infinite_power;
+	int min_round_even;     /* q range in which ties can occur (binary16
+	                           subnormals reach down to 5^27 in w) */
+	int max_round_even;
+	int smallest_pow10;     /* below: always zero */
+	int largest_pow10;      /* above: always infinity */
+} numlist_binary;
+
+static const numlist_binary numlist_binary16 = { 10, -15, 0x1F, -27, 5, -27, 4 };
+static const numlist_binary numlist_binary32 = { 23, -127, 0xFF, -17, 10, -65, 38 };
+static const numlist_binary numlist_binary64 = { 52, -1023, 0x7FF, -4, 23, -342, 308 };
+
+static const double numlist_exact_pow10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const float numlist_exact_pow10f[] = {
+	1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+static const unsigned long long numlist_pow10_u64[] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+	10000000ULL, 100000000ULL
+};
+
+typedef struct numlist_u128 {
+	unsigned long long lo;
+	unsigned long long hi;
+} numlist_u128;
+
+static numlist_u128
+numlist_mul128(unsigned long long a, unsigned long long b)
+{
+	numlist_u128 r;
+#if defined(__SIZEOF_INT128__)
+	unsigned __int128 p = (unsigned __int128)a * b;
+	r.lo = (unsigned long long)p;
+	r.hi = (unsigned long long)(p >> 64);
+#elif defined(_M_X64)
+	r.lo = _umul128(a, b, &r.hi);
+#else
+	unsigned long long a0 = (unsigned int)a, a1 = a >> 32;
+	unsigned long long b0 = (unsigned int)b, b1 = b >> 32;
+	unsigned long long p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+	unsigned long long mid = (p00 >> 32) + (unsigned int)p01 + (unsigned int)p10;
+	r.lo = (mid << 32) | (unsigned int)p00;
+	r.hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+#endif
+	return r;
+}
+
+static int
+numlist_clz64(unsigned long long x)
+{
+#if defined(__GNUC__)
+	return __builtin_clzll(x);
+#elif defined(_M_X64)
+	unsigned long idx;
+	_BitScanReverse64(&idx, x);
+	return 63 - (int)idx;
+#else
+	unsigned long idx;
+	if (_BitScanReverse(&idx, (unsigned long)(x >> 32))) {
+		return 31 - (int)idx;
+	}
+	_BitScanReverse(&idx, (unsigned long)x);
+	return 63 - (int)idx;
+#endif
+}
+
+static int
+numlist_ctz64(unsigned long long x)
+{
+#if defined(__GNUC__)
+	return __builtin_ctzll(x);
+#elif defined(_M_X64)
+	unsigned long idx;
+	_BitScanForward64(&idx, x);
+	return (int)idx;
+#else
+	unsigned long idx;
+	if (_BitScanForward(&idx, (unsigned long)x)) {
+		return (int)idx;
+	}
+	_BitScanForward(&idx, (unsigned long)(x >> 32));
+	return 32 + (int)idx;
+#endif
+}
+
+/* ---------------------------------------------------------------------- */
+/* SWAR decimal digits                                                     */
+
+static unsigned long long
+numlist_load8(const char* p)
+{
+	unsigned long long v;
+
+	memcpy(&v, p, sizeof(v));	/* little-endian: first character in the low byte */
+	return v;
+}
+
+/* number of leading decimal digits in the 8 characters of x */
+static unsigned int
+numlist_digits8(unsigned long long x)
+{
+	unsigned long long t = ((x & 0xF0F0F0F0F0F0F0F0ULL) ^ 0x3030303030303030ULL) |
+		(((x + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) ^ 0x3030303030303030ULL);
+
+	return t ? (unsigned int)numlist_ctz64(t) / 8 : 8;
+}
+
+/* value of 8 decimal digits */
+static unsigned int
+numlist_parse8(unsigned long long x)
+{
+	const unsigned long long mask = 0x000000FF000000FFULL;
+	const unsigned long long mul1 = 100 + (1000000ULL << 32);
+	const unsigned long long mul2 = 1 + (10000ULL << 32);
+
+	x -= 0x3030303030303030ULL;
+	x = (x * 10) + (x >> 8);
+	x = (((x & mask) * mul1) + (((x >> 16) & mask) * mul2)) >> 32;
+	return (unsigned int)x;
+}
+
+/*
+ * Reads up to 8 digits at p with one load; limit is the end of readable
+ * memory. Returns the digit count, *value their value.
+ */
+static unsigned int
+numlist_swar_digits(const char* p, const char* limit, unsigned int* value)
+{
+	if (limit - p < 8) {
+		return 0;
+	}
+
+	unsigned long long x = numlist_load8(p);
+	unsigned int n = numlist_digits8(x);
+	if (n == 0) {
+		return 0;
+	}
+	if (n < 8) {
+		/* leading '0' characters keep the value and align the digits */
+		x = (x << (8 * (8 - n))) | (0x3030303030303030ULL >> (8 * n));
+	}
+	*value = numlist_parse8(x);
+	return n;
+}
+
+/* ---------------------------------------------------------------------- */
+/* integers                                                                */
+
+static int
+numlist_digit_value(char c)
+{
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+	return 99;
+}
+
+static int
+numlist_parse_int(const char* p, const char* e, const char* limit,
+	const numlist_format* fmt, unsigned long long* bits)
+{
+	int neg = 0;
+	unsigned int base = 10;
+	unsigned long long v = 0;
+	unsigned int bitcount = fmt->size * 8;
+
+	if (p < e && (*p == '+' || *p == '-')) {
+		neg = (*p == '-');
+		p++;
+	}
+	if (e - p > 2 && p[0] == '0') {
+		switch (p[1]) {
+		case 'x': case 'X': base = 16; p += 2; break;
+		case 'o': case 'O': base = 8; p += 2; break;
+		case 'b': case 'B': base = 2; p += 2; break;
+		}
+	}
+	if (p == e) {
+		return 0;
+	}
+
+	if (base == 10) {
+		while (p < e) {
+			unsigned int chunk;
+			unsigned int n = numlist_swar_digits(p, limit, &chunk);
+			if (n == 0) {
+				/* not a digit, or too close to the end of the buffer */
+				int d = numlist_digit_value(*p);
+				if (d > 9) {
+					break;
+				}
+				chunk = (unsigned int)d;
+				n = 1;
+			}
+			if (v > (~0ULL - chunk) / numlist_pow10_u64[n]) {
+				return 0;
+			}
+			v = v * numlist_pow10_u64[n] + chunk;
+			p += n;
+		}
+	} else {
+		for (; p < e; p++) {
+			unsigned int d = (unsigned int)numlist_digit_value(*p);
+			if (d >= base || v > (~0ULL - d) / base) {
+				return 0;
+			}
+			v = v * base + d;
+		}
+	}
+	if (p != e) {
+		return 0;
+	}
+
+	/* range check */
+	unsigned long long half = 1ULL << (bitcount - 1);
+	if (neg) {
+		if (v > half) {
+			return 0;
+		}
+	} else if (fmt->is_signed) {
+		if (v > half - 1) {
+			return 0;
+		}
+	} else if (bitcount < 64 && v > (half << 1) - 1) {
+		return 0;
+	}
+
+	*bits = neg ? 0 - v : v;
+	return 1;
+}
+
+/* ---------------------------------------------------------------------- */
+/* floats                                                                  */
+
+typedef struct numlist_adjusted {
+	unsigned long long mantissa;
+	int power2;
+} numlist_adjusted;
+
+static numlist_u128
+numlist_product(long long q, unsigned long long w, int precision)
+{
+	int index = 2 * (int)(q - NUMLIST_SMALLEST_POW5);
+	numlist_u128 first = numlist_mul128(w, numlist_pow5[index]);
+	unsigned long long precision_mask = 0xFFFFFFFFFFFFFFFFULL >> precision;
+
+	if ((first.hi & precision_mask) == precision_mask) {
+		numlist_u128 second = numlist_mul128(w, numlist_pow5[index + 1]);
+		first.lo += second.hi;
+		if (second.hi > first.lo) {
+			first.hi++;
+		}
+	}
+	return first;
+}
+
+/* Eisel-Lemire: w * 10^q correctly rounded, w != 0 */
+static numlist_adjusted
+numlist_compute_float(long long q, unsigned long long w, const numlist_binary* b)
+{
+	numlist_adjusted answer;
+
+	if (w == 0 || q < b->smallest_pow10) {
+		answer.mantissa = 0;
+		answer.power2 = 0;
+		return answer;
+	}
+	if (q > b->largest_pow10) {
+		answer.mantissa = 0;
+		answer.power2 = b->infinite_power;
+		return answer;
+	}
+
+	int lz = numlist_clz64(w);
+	w <<= lz;
+	numlist_u128 product = numlist_product(q, w, b->mantissa_bits + 3);
+
+	int upperbit = (int)(product.hi >> 63);
+	int shift = upperbit + 64 - b->mantissa_bits - 3;
+	int power = (int)((((152170 + 65536) * q) >> 16) + 63);
+
+	answer.mantissa = product.hi >> shift;
+	answer.power2 = power + upperbit - lz - b->minimum_exponent;
+
+	if (answer.power2 <= 0) {
+		/* subnormal */
+		int extra = -answer.power2 + 1;
+		if (extra >= 64) {
+			answer.mantissa = 0;
+			answer.power2 = 0;
+			return answer;
+		}
+		answer.mantissa >>= extra;
+		/* only binary16 has ties down here */
+		if (product.lo <= 1 && q >= b->min_round_even && q <= b->max_round_even &&
+			(answer.mantissa & 3) == 1 && shift + extra < 64 &&
+			(product.hi & ((1ULL << (shift + extra)) - 1)) == 0) {
+			answer.mantissa &= ~1ULL;
+		}
+		answer.mantissa += (answer.mantissa & 1);
+		answer.mantissa >>= 1;
+		answer.power2 = (answer.mantissa < (1ULL << b->mantissa_bits)) ? 0 : 1;
+		return answer;
+	}
+
+	/* exactly halfway: round to even */
+	if (product.lo <= 1 && q >= b->min_round_even && q <= b->max_round_even &&
+		(answer.mantissa & 3) == 1) {
+		if ((answer.mantissa << shift) == product.hi) {
+			answer.mantissa &= ~1ULL;
+		}
+	}
+
+	answer.mantissa += (answer.mantissa & 1);
+	answer.mantissa >>= 1;
+	if (answer.mantissa >= (2ULL << b->mantissa_bits)) {
+		answer.mantissa = 1ULL << b->mantissa_bits;
+		answer.power2++;
+	}
+	answer.mantissa &= ~(1ULL << b->mantissa_bits);
+	if (answer.power2 >= b->infinite_power) {
+		answer.power2 = b->infinite_power;
+		answer.mantissa = 0;
+	}
+	return answer;
+}
+
+static unsigned long long
+numlist_float_bits(numlist_adjusted am, const numlist_binary* b)
+{
+	return am.mantissa | ((unsigned long long)am.power2 << b->mantissa_bits);
+}
+
+/* round-to-nearest-even conversion, used by the strtod fallback only */
+static unsigned long long
+numlist_double_to_half(double d)
+{
+	unsigned long long x;
+	memcpy(&x, &d, sizeof(x));
+
+	unsigned long long sign = (x >> 48) & 0x8000;
+	int exp = (int)((x >> 52) & 0x7FF);
+	unsigned long long mant = x & ((1ULL << 52) - 1);
+
+	if (exp == 0x7FF) {
+		return sign | 0x7C00 | (mant ? 0x200 : 0);
+	}
+
+	int e = exp - 1023 + 15;
+	if (e >= 0x1F) {
+		return sign | 0x7C00;
+	}
+
+	int shift = 42;
+	if (e <= 0) {
+		if (e < -10) {
+			return sign;
+		}
+		mant |= 1ULL << 52;
+		shift = 42 + 1 - e;
+		e = 0;
+	}
+
+	unsigned long long h = mant >> shift;
+	unsigned long long rem = mant & ((1ULL << shift) - 1);
+	unsigned long long halfway = 1ULL << (shift - 1);
+	if (rem > halfway || (rem == halfway && (h & 1))) {
+		h++;
+	}
+	/* a mantissa carry correctly bumps the exponent */
+	return sign | (((unsigned long long)e << 10) + h);
+}
+
+static int
+numlist_match(const char* p, const char* e, const char* word)
+{
+	size_t n = strlen(word);
+
+	if ((size_t)(e - p) != n) {
+		return 0;
+	}
+	for (size_t i = 0; i < n; i++) {
+		if ((p[i] | 0x20) != word[i]) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static int
+numlist_parse_float(const char* p, const char* e, const char* limit,
+	const numlist_format* fmt, unsigned long long* bits)
+{
+	const numlist_binary* b = fmt->size == 2 ? &numlist_binary16 :
+		fmt->size == 4 ? &numlist_binary32 : &numlist_binary64;
+	const char* start = p;
+	int neg = 0;
+	unsigned long long sign = 1ULL << (fmt->size * 8 - 1);
+
+	if (p < e && (*p == '+' || *p == '-')) {
+		neg = (*p == '-');
+		p++;
+	}
+
+	/* specials */
+	if (p < e && !(*p >= '0' && *p <= '9') && *p != '.') {
+		unsigned long long all = (1ULL << (b->mantissa_bits)) - 1;
+		unsigned long long inf = (unsigned long long)b->infinite_power << b->mantissa_bits;
+		if (numlist_match(p, e, "inf") || numlist_match(p, e, "infinity")) {
+			*bits = inf | (neg ? sign : 0);
+			return 1;
+		}
+		if (numlist_match(p, e, "nan")) {
+			*bits = inf | (all & ~(all >> 1)) | (neg ? sign : 0);
+			return 1;
+		}
+		return 0;
+	}
+
+	/* significand: the first 19 significant digits go into w */
+	unsigned long long w = 0;
+	int ndigits = 0;
+	long long exp10 = 0;
+	int truncated = 0;
+	int any = 0;
+	int frac = 0;
+
+	for (; p < e; ) {
+		if (*p == '.') {
+			if (frac) {
+				return 0;
+			}
+			frac = 1;
+			p++;
+			continue;
+		}
+		if (ndigits > 0 && ndigits + 8 <= 19) {
+			unsigned int chunk;
+			unsigned int n = numlist_swar_digits(p, limit, &chunk);
+			if (n > 0) {
+				w = w * numlist_pow10_u64[n] + chunk;
+				ndigits += n;
+				exp10 -= frac ? n : 0;
+				any = 1;
+				p += n;
+				continue;
+			}
+		}
+		if (!(*p >= '0' && *p <= '9')) {
+			break;
+		}
+		any = 1;
+		if (ndigits < 19) {
+			if (w != 0 || *p != '0') {
+				w = w * 10 + (unsigned long long)(*p - '0');
+				ndigits++;
+			}
+			exp10 -= frac;
+		} else {
+			exp10 += frac ? 0 : 1;
+			truncated |= (*p != '0');
+		}
+		p++;
+	}
+	if (!any) {
+		return 0;
+	}
+
+	if (p < e && (*p == 'e' || *p == 'E')) {
+		int eneg = 0;
+		long long ev = 0;
+		p++;
+		if (p < e && (*p == '+' || *p == '-')) {
+			eneg = (*p == '-');
+			p++;
+		}
+		if (p == e) {
+			return 0;
+		}
+		for (; p < e && *p >= '0' && *p <= '9'; p++) {
+			if (ev < 100000) {
+				ev = ev * 10 + (*p - '0');
+			}
+		}
+		exp10 += eneg ? -ev : ev;
+	}
+	if (p != e) {
+		return 0;
+	}
+
+	unsigned long long result;
+	if (w == 0) {
+		result = 0;
+	} else if (!truncated && b == &numlist_binary64 && w <= (1ULL << 53) &&
+		exp10 >= -22 && exp10 <= 22) {
+		/* Clinger's fast path: both operands exact, one rounding */
+		double d = (double)w;
+		d = exp10 < 0 ? d / numlist_exact_pow10[-exp10] : d * numlist_exact_pow10[exp10];
+		memcpy(&result, &d, sizeof(result));
+	} else if (!truncated && b == &numlist_binary32 && w <= (1ULL << 24) &&
+		exp10 >= -10 && exp10 <= 10) {
+		float f = (float)w;
+		unsigned int fb;
+		f = exp10 < 0 ? f / numlist_exact_pow10f[-exp10] : f * numlist_exact_pow10f[exp10];
+		memcpy(&fb, &f, sizeof(fb));
+		result = fb;
+	} else {
+		numlist_adjusted am = numlist_compute_float(exp10, w, b);
+		if (truncated) {
+			/* the dropped digits only matter if they could change the rounding */
+			numlist_adjusted up = numlist_compute_float(exp10, w + 1, b);
+			if (up.mantissa != am.mantissa || up.power2 != am.power2) {
+				char token[NUMLIST_MAX_TOKEN];
+				size_t len = (size_t)(e - start);
+				if (len >= sizeof(token)) {
+					return 0;
+				}
+				memcpy(token, start, len);
+				token[len] = 0;
+				if (b == &numlist_binary64) {
+					double d = strtod(token, NULL);
+					memcpy(&result, &d, sizeof(result));
+				} else if (b == &numlist_binary32) {
+					float f = strtof(token, NULL);
+					unsigned int fb;
+					memcpy(&fb, &f, sizeof(fb));
+					result = fb;
+				} else {
+					result = numlist_double_to_half(strtod(token, NULL));
+				}
+				*bits = result;
+				return 1;
+			}
+		}
+		result = numlist_float_bits(am, b);
+	}
+
+	*bits = result | (neg ? sign : 0);
+	return 1;
+}
+
+/* ---------------------------------------------------------------------- */
+
+static int
+numlist_is_sep(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ',' || c == ';';
+}
+
+static size_t
+numlist_store(unsigned char* out, unsigned long long v, unsigned int size, int bigendian)
+{
+	unsigned int k;
+
+	for (k = 0; k < size; k++) {
+		unsigned int shift = bigendian ? (size - 1 - k) * 8 : k * 8;
+		out[k] = (unsigned char)(v >> shift);
+	}
+	return size;
+}
+
+size_t
+numlist_parse(const char* in, size_t inlen, unsigned char* out,
+	const numlist_format* fmt, int final, size_t* inused)
+{
+	const char* limit = in + inlen;
+	size_t i;
+	size_t j;
+	size_t k;
+	unsigned long long bits;
+
+	for (i = j = 0; i < inlen; ) {
+		if (numlist_is_sep(in[i])) {
+			i++;
+			continue;
+		}
+
+		for (k = i; k < inlen && !numlist_is_sep(in[k]); k++) {
+		}
+		if (k == inlen && !final) {
+			break;
+		}
+
+		int ok = fmt->is_float ?
+			numlist_parse_float(in + i, in + k, limit, fmt, &bits) :
+			numlist_parse_int(in + i, in + k, limit, fmt, &bits);
+		if (!ok) {
+			break;
+		}
+		j += numlist_store(out + j, bits, fmt->size, fmt->bigendian);
+		i = k;
+	}
+
+	*inused = i;
+	return j;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#ifndef NUMLIST_H
+#define NUMLIST_H
+
+#include <stddef.h>
+
+/*
+ * Parses lists of numbers such as "1, 2, 65535, -3" or "3.14159 2.5e-3"
+ * into packed binary values.
+ *
+ * Values are separated by any run of blanks, commas or semicolons.
+ * Integers are decimal, or hex / octal / binary with a 0x / 0o / 0b
+ * prefix, optionally signed. Floats accept the usual decimal and
+ * exponent notation plus inf / infinity / nan, and are rounded correctly
+ * (Eisel-Lemire) to binary16, binary32 or binary64.
+ */
+
+typedef struct numlist_format {
+	unsigned int size;      /* 1, 2, 4 or 8 bytes */
+	int is_float;           /* IEEE binary16/32/64 by size */
+	int is_signed;          /* integers: range -2^(n-1) .. 2^(n-1)-1; otherwise
+	                           0 .. 2^n-1, negatives stored two's complement
+	                           down to -2^(n-1) */
+	int bigendian;
+} numlist_format;
+
+/* worst case: one-digit values with one separator each */
+#define NUMLIST_OUT_SIZE(s, size) (((s) / 2 + 1) * (size))
+
+/*
+ * Stops at the first malformed or out-of-range value.
+ * Unless final is non-zero, an unterminated value at the end of the input
+ * is left unconsumed so it can be completed by the next call.
+ * inused receives the number of characters consumed.
+ * return values is out length
+ */
+size_t
+numlist_parse(const char* in, size_t inlen, unsigned char* out,
+	const numlist_format* fmt, int final, size_t* inused);
+
+#endif /* NUMLIST_H */
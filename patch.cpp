@@ -0,0 +1,344 @@
+// patch.cpp : patch scripts - lists of "offset: hex bytes" edits, applied to
+// the document in offset order with as few calls as the edits allow
+//
+
+#include "stdafx.h"
+
+#include <tchar.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "patch.h"
+#include "bufpool.h"
+#include "hex.h"
+
+// Runs applied between two progress updates
+#define PATCH_PROGRESS_STEP 1024
+
+#define PATCH_VERB_NONE    0
+#define PATCH_VERB_REPLACE 1
+#define PATCH_VERB_INSERT  2
+
+static BOOL IsBlank(char c)
+{
+	return c == ' ' || c == '\t';
+}
+
+static int HexValue(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	c |= 0x20;
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	return -1;
+}
+
+// "insert" or "replace", any case, followed by a blank or the end of the
+// line; p is moved past it and the blanks after it
+static int ReadVerb(const char** pp, const char* pEnd)
+{
+	static const struct { const char* lpszWord; int nVerb; } verbs[] =
+	{
+		{ "replace", PATCH_VERB_REPLACE },
+		{ "insert",  PATCH_VERB_INSERT },
+	};
+	const char* p = *pp;
+
+	for (size_t i = 0; i < sizeof(verbs) / sizeof(verbs[0]); i++)
+	{
+		size_t n = strlen(verbs[i].lpszWord);
+		size_t k = 0;
+		if ((size_t)(pEnd - p) < n)
+			continue;
+		while (k < n && (p[k] | 0x20) == verbs[i].lpszWord[k])
+			k++;
+		if (k < n || (p + n < pEnd && !IsBlank(p[n])))
+			continue;
+
+		for (p += n; p < pEnd && IsBlank(*p); p++)
+			;
+		*pp = p;
+		return verbs[i].nVerb;
+	}
+	return PATCH_VERB_NONE;
+}
+
+// One line without its line break; *pbEmpty is set for blank and comment
+// lines.  The bytes go to pOut.
+static BOOL ParseLine(const char* p, const char* pEnd, PATCH_EDIT* pEdit,
+	unsigned char* pOut, BOOL* pbEmpty)
+{
+	QWORD qwOffset = 0;
+	int nVerb;
+	int nDigits = 0;
+	size_t nUsed;
+
+	// Comments run to the end of the line
+	for (const char* q = p; q < pEnd; q++)
+	{
+		if (*q == '#' || *q == ';')
+		{
+			pEnd = q;
+			break;
+		}
+	}
+	while (p < pEnd && IsBlank(*p))
+		p++;
+	while (pEnd > p && (IsBlank(pEnd[-1]) || pEnd[-1] == '\r'))
+		pEnd--;
+	*pbEmpty = (p == pEnd);
+	if (*pbEmpty)
+		return TRUE;
+
+	nVerb = ReadVerb(&p, pEnd);
+
+	if (pEnd - p > 2 && p[0] == '0' && (p[1] | 0x20) == 'x')
+		p += 2;
+	for (; p < pEnd && HexValue(*p) >= 0; p++)
+	{
+		// QWORD is signed, so offsets stop short of 2^63
+		if (++nDigits > 16 || (nDigits == 16 && (qwOffset >> 59)))
+			return FALSE;
+		qwOffset = (qwOffset << 4) | HexValue(*p);
+	}
+	while (p < pEnd && IsBlank(*p))
+		p++;
+	if (nDigits == 0 || p == pEnd || *p != ':')
+		return FALSE;
+	for (p++; p < pEnd && IsBlank(*p); p++)
+		;
+
+	if (nVerb == PATCH_VERB_NONE)
+		nVerb = ReadVerb(&p, pEnd);
+
+	size_t nLength = hex_decode(p, pEnd - p, pOut, &nUsed);
+	if (nLength == 0 || nUsed != (size_t)(pEnd - p))
+		return FALSE;
+
+	pEdit->qwOffset = qwOffset;
+	pEdit->qwReplaced = (nVerb == PATCH_VERB_INSERT) ? 0 : nLength;
+	pEdit->nLength = nLength;
+	return TRUE;
+}
+
+BOOL PatchParse(const char* pText, size_t nText, PATCH_SET* pSet, size_t* pnErrorLine)
+{
+	const char* pEnd = pText + nText;
+	size_t nLines = 1;
+	size_t nLine = 0;
+
+	ZeroMemory(pSet, sizeof(*pSet));
+	*pnErrorLine = 0;
+
+	// Room for an edit per line, and a byte per two characters
+	for (const char* p = pText; (p = (const char*)memchr(p, '\n', pEnd - p)) != NULL; p++)
+		nLines++;
+	pSet->pEdits = (PATCH_EDIT*)bufpool_alloc(nLines * sizeof(PATCH_EDIT));
+	pSet->pData = (unsigned char*)bufpool_alloc(nText / 2 + 1);
+	if (!pSet->pEdits || !pSet->pData)
+	{
+		PatchFree(pSet);
+		return FALSE;
+	}
+
+	for (const char* p = pText; p < pEnd; )
+	{
+		const char* pLineEnd = (const char*)memchr(p, '\n', pEnd - p);
+		if (!pLineEnd)
+			pLineEnd = pEnd;
+		nLine++;
+
+		PATCH_EDIT* pEdit = &pSet->pEdits[pSet->nEdits];
+		BOOL bEmpty;
+		if (!ParseLine(p, pLineEnd, pEdit, pSet->pData + pSet->nData, &bEmpty))
+		{
+			*pnErrorLine = nLine;
+			PatchFree(pSet);
+			return FALSE;
+		}
+		if (!bEmpty)
+		{
+			pEdit->nData = pSet->nData;
+			pEdit->nLine = nLine;
+			pSet->nData += pEdit->nLength;
+			pSet->nEdits++;
+		}
+		p = pLineEnd + 1;
+	}
+
+	return TRUE;
+}
+
+// By offset; at the same offset inserts come first, then script order
+static int CompareByOffset(const void* a, const void* b)
+{
+	const PATCH_EDIT* pA = (const PATCH_EDIT*)a;
+	const PATCH_EDIT* pB = (const PATCH_EDIT*)b;
+
+	if (pA->qwOffset != pB->qwOffset)
+		return pA->qwOffset < pB->qwOffset ? -1 : 1;
+	if ((pA->qwReplaced == 0) != (pB->qwReplaced == 0))
+		return pA->qwReplaced == 0 ? -1 : 1;
+	if (pA->nLine != pB->nLine)
+		return pA->nLine < pB->nLine ? -1 : 1;
+	return 0;
+}
+
+static int CompareByLine(const void* a, const void* b)
+{
+	const PATCH_EDIT* pA = *(const PATCH_EDIT* const*)a;
+	const PATCH_EDIT* pB = *(const PATCH_EDIT* const*)b;
+
+	if (pA->nLine != pB->nLine)
+		return pA->nLine < pB->nLine ? -1 : 1;
+	return 0;
+}
+
+BOOL PatchMerge(PATCH_SET* pSet)
+{
+	BOOL bReturn = FALSE;
+	PATCH_EDIT* pEdits = pSet->pEdits;
+	size_t nEdits = pSet->nEdits;
+	unsigned char* pData = NULL;
+	unsigned char* pRegion = NULL;
+	const PATCH_EDIT** ppReplaces = NULL;
+	size_t nRuns = 0;
+	size_t nOut = 0;
+
+	if (nEdits == 0)
+		return TRUE;
+
+	qsort(pEdits, nEdits, sizeof(PATCH_EDIT), CompareByOffset);
+
+	__try
+	{
+		// Runs never hold more bytes than the edits they merge
+		pData = (unsigned char*)bufpool_alloc(pSet->nData);
+		pRegion = (unsigned char*)bufpool_alloc(pSet->nData);
+		ppReplaces = (const PATCH_EDIT**)bufpool_alloc(nEdits * sizeof(PATCH_EDIT*));
+		if (!pData || !pRegion || !ppReplaces)
+			__leave;
+
+		for (size_t i = 0, j; i < nEdits; i = j)
+		{
+			QWORD qwStart = pEdits[i].qwOffset;
+			QWORD qwEnd = qwStart + pEdits[i].qwReplaced;
+			QWORD qwCovered = qwStart;
+			size_t nReplaces = 0;
+			BOOL bOverlap = FALSE;
+
+			// Everything that starts inside or right behind the run joins it
+			for (j = i; j < nEdits && pEdits[j].qwOffset <= qwEnd; j++)
+			{
+				if (pEdits[j].qwReplaced == 0)
+					continue;
+				if (pEdits[j].qwOffset < qwCovered)
+					bOverlap = TRUE;
+				if (qwCovered < pEdits[j].qwOffset + pEdits[j].qwReplaced)
+					qwCovered = pEdits[j].qwOffset + pEdits[j].qwReplaced;
+				qwEnd = qwCovered;
+				ppReplaces[nReplaces++] = &pEdits[j];
+			}
+
+			// The replaced bytes first; where they overlap, in script order
+			if (bOverlap)
+				qsort(ppReplaces, nReplaces, sizeof(PATCH_EDIT*), CompareByLine);
+			for (size_t k = 0; k < nReplaces; k++)
+			{
+				memcpy(pRegion + (ppReplaces[k]->qwOffset - qwStart),
+					pSet->pData + ppReplaces[k]->nData, ppReplaces[k]->nLength);
+			}
+
+			// then the inserts threaded in at their offsets
+			size_t nRunStart = nOut;
+			QWORD qwCursor = qwStart;
+			for (size_t k = i; k < j; k++)
+			{
+				if (pEdits[k].qwReplaced != 0)
+					continue;
+				memcpy(pData + nOut, pRegion + (qwCursor - qwStart), (size_t)(pEdits[k].qwOffset - qwCursor));
+				nOut += (size_t)(pEdits[k].qwOffset - qwCursor);
+				qwCursor = pEdits[k].qwOffset;
+				memcpy(pData + nOut, pSet->pData + pEdits[k].nData, pEdits[k].nLength);
+				nOut += pEdits[k].nLength;
+			}
+			memcpy(pData + nOut, pRegion + (qwCursor - qwStart), (size_t)(qwEnd - qwCursor));
+			nOut += (size_t)(qwEnd - qwCursor);
+
+			// Every edit of the run has been read, so its slot can be reused
+			PATCH_EDIT* pRun = &pEdits[nRuns++];
+			pRun->nLine = pEdits[i].nLine;
+			pRun->qwOffset = qwStart;
+			pRun->qwReplaced = qwEnd - qwStart;
+			pRun->nLength = nOut - nRunStart;
+			pRun->nData = nRunStart;
+		}
+
+		bufpool_free(pSet->pData);
+		pSet->pData = pData;
+		pSet->nData = nOut;
+		pSet->nEdits = nRuns;
+		pData = NULL;
+		bReturn = TRUE;
+	}
+	__finally
+	{
+		if (pData)
+			bufpool_free(pData);
+		if (pRegion)
+			bufpool_free(pRegion);
+		if (ppReplaces)
+			bufpool_free((void*)ppReplaces);
+	}
+
+	return bReturn;
+}
+
+QWORD PatchExtent(const PATCH_SET* pSet)
+{
+	if (pSet->nEdits == 0)
+		return 0;
+	const PATCH_EDIT* pLast = &pSet->pEdits[pSet->nEdits - 1];
+	return pLast->qwOffset + pLast->qwReplaced;
+}
+
+BOOL PatchApply(HWSESSION hSession, HWDOCUMENT hDoc, const PATCH_SET* pSet, size_t* pnApplied)
+{
+	// Bytes the runs so far have added in front of the next one
+	QWORD qwShift = 0;
+	size_t i;
+
+	for (i = 0; i < pSet->nEdits; i++)
+	{
+		const PATCH_EDIT* pRun = &pSet->pEdits[i];
+		void* pBytes = pSet->pData + pRun->nData;
+		QWORD qwAt = pRun->qwOffset + qwShift;
+		HWAPI_RESULT eResult;
+
+		if (pRun->qwReplaced == (QWORD)pRun->nLength)
+			eResult = hwWriteAt(hDoc, qwAt, pBytes, pRun->nLength);
+		else if (pRun->qwReplaced == 0)
+			eResult = hwInsertAt(hDoc, qwAt, pBytes, pRun->nLength);
+		else
+			eResult = hwReplaceAt(hDoc, qwAt, pBytes, pRun->qwReplaced, pRun->nLength);
+		if (eResult != HWAPI_RESULT_SUCCESS)
+			break;
+		qwShift += pRun->nLength - pRun->qwReplaced;
+
+		if (i % PATCH_PROGRESS_STEP == PATCH_PROGRESS_STEP - 1)
+			hwUpdateProgress(hSession, (int)(i * 100 / pSet->nEdits), _T("Applying patch"));
+	}
+
+	*pnApplied = i;
+	return i == pSet->nEdits;
+}
+
+void PatchFree(PATCH_SET* pSet)
+{
+	if (pSet->pEdits)
+		bufpool_free(pSet->pEdits);
+	if (pSet->pData)
+		bufpool_free(pSet->pData);
+	ZeroMemory(pSet, sizeof(*pSet));
+}
@@ -0,0 +1,61 @@
+// patch.h : patch scripts - lists of "offset: hex bytes" edits, applied to
+// the document in offset order with as few calls as the edits allow
+//
+
+#pragma once
+
+#include "hwapi.h"
+
+// One edit per line:
+//
+//   0x1000: 90 90 90
+//   2000: replace EB FE
+//   insert 0x3000: 00 00 00 00
+//
+// Offsets are hex, "0x" optional, and refer to the document as it was
+// before the script, so an insert does not move the edits after it.  The
+// verb, "replace" (the default) or "insert", goes before the offset or
+// after the colon.  An insert goes in front of the byte at its offset;
+// inserts at the same offset keep their order, and where replaced ranges
+// overlap the later line wins.  Blank lines and anything after '#' or ';'
+// are ignored.
+
+// An edit replaces qwReplaced bytes at qwOffset with nLength bytes; an
+// insert replaces none.  PatchMerge turns the edits into runs of the same
+// form that neither touch nor overlap.
+typedef struct _PATCH_EDIT
+{
+	QWORD  qwOffset;	// in the document before the script
+	QWORD  qwReplaced;
+	size_t nLength;
+	size_t nData;		// where its bytes start in PATCH_SET::pData
+	size_t nLine;		// script line, from 1
+} PATCH_EDIT;
+
+typedef struct _PATCH_SET
+{
+	PATCH_EDIT*    pEdits;	// from bufpool_alloc; see PatchFree
+	size_t         nEdits;
+	unsigned char* pData;
+	size_t         nData;
+} PATCH_SET;
+
+// Reads the script in pText.  Returns FALSE if a line is malformed, with
+// *pnErrorLine set to its number, or if memory runs out (*pnErrorLine 0).
+BOOL PatchParse(const char* pText, size_t nText, PATCH_SET* pSet, size_t* pnErrorLine);
+
+// Sorts the edits by offset and merges every group that touches or
+// overlaps into one run.  Returns FALSE if memory runs out.
+BOOL PatchMerge(PATCH_SET* pSet);
+
+// End of the last run in the document before the script; after PatchMerge
+QWORD PatchExtent(const PATCH_SET* pSet);
+
+// Applies the runs of a merged set, one hwWriteAt, hwInsertAt or
+// hwReplaceAt each, from the lowest offset up.  Call inside an undo group,
+// after checking PatchExtent against the document size.  Not cancellable
+// once started.  *pnApplied receives the runs applied; fewer than
+// pSet->nEdits means the document refused one.
+BOOL PatchApply(HWSESSION hSession, HWDOCUMENT hDoc, const PATCH_SET* pSet, size_t* pnApplied);
+
+void PatchFree(PATCH_SET* pSet);
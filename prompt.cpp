@@ -0,0 +1,136 @@
+// prompt.cpp : a one-line text prompt for commands that need a parameter
+//
+
+#include "stdafx.h"
+
+#include <tchar.h>
+
+#include "prompt.h"
+
+#define PROMPT_ID_EDIT 100
+
+// Room for the in-memory dialog template: four controls, and the title
+// and label cut to PROMPT_MAX_TEXT characters each
+#define PROMPT_TEMPLATE_DWORDS 1024
+
+typedef struct _PROMPT
+{
+	LPTSTR lpszText;
+	size_t nText;
+} PROMPT;
+
+// Controls start on a DWORD boundary
+static WORD* PromptAlign(WORD* p)
+{
+	return (WORD*)(((ULONG_PTR)p + 3) & ~(ULONG_PTR)3);
+}
+
+// Templates hold UTF-16 strings whatever the build's character set
+static WORD* PromptString(WORD* p, LPCTSTR lpszText)
+{
+	size_t n = _tcslen(lpszText);
+	if (n >= PROMPT_MAX_TEXT)
+		n = PROMPT_MAX_TEXT - 1;
+#ifdef UNICODE
+	memcpy(p, lpszText, n * sizeof(WCHAR));
+#else
+	n = MultiByteToWideChar(CP_ACP, 0, lpszText, (int)n, (LPWSTR)p, PROMPT_MAX_TEXT);
+#endif
+	p[n] = 0;
+	return p + n + 1;
+}
+
+static WORD* PromptControl(WORD* p, DWORD dwStyle, short x, short y, short cx, short cy,
+	WORD wId, WORD wClass, LPCTSTR lpszText)
+{
+	DLGITEMTEMPLATE* pItem = (DLGITEMTEMPLATE*)PromptAlign(p);
+
+	pItem->style = WS_CHILD | WS_VISIBLE | dwStyle;
+	pItem->dwExtendedStyle = 0;
+	pItem->x = x;
+	pItem->y = y;
+	pItem->cx = cx;
+	pItem->cy = cy;
+	pItem->id = wId;
+
+	// A predefined class by atom, then the text and no creation data
+	p = (WORD*)(pItem + 1);
+	*p++ = 0xFFFF;
+	*p++ = wClass;
+	p = PromptString(p, lpszText);
+	*p++ = 0;
+	return p;
+}
+
+static INT_PTR CALLBACK PromptDialogProc(HWND hDlg, UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+	PROMPT* pPrompt = (PROMPT*)GetWindowLongPtr(hDlg, DWLP_USER);
+
+	switch (uMsg)
+	{
+	case WM_INITDIALOG:
+		SetWindowLongPtr(hDlg, DWLP_USER, lParam);
+		pPrompt = (PROMPT*)lParam;
+		SendDlgItemMessage(hDlg, PROMPT_ID_EDIT, EM_LIMITTEXT, pPrompt->nText - 1, 0);
+		SetDlgItemText(hDlg, PROMPT_ID_EDIT, pPrompt->lpszText);
+		SendDlgItemMessage(hDlg, PROMPT_ID_EDIT, EM_SETSEL, 0, -1);
+		SetFocus(GetDlgItem(hDlg, PROMPT_ID_EDIT));
+		// Focus has been set
+		return FALSE;
+
+	case WM_COMMAND:
+		if (LOWORD(wParam) == IDOK)
+		{
+			GetDlgItemText(hDlg, PROMPT_ID_EDIT, pPrompt->lpszText, (int)pPrompt->nText);
+			EndDialog(hDlg, IDOK);
+			return TRUE;
+		}
+		if (LOWORD(wParam) == IDCANCEL)
+		{
+			EndDialog(hDlg, IDCANCEL);
+			return TRUE;
+		}
+		break;
+	}
+
+	return FALSE;
+}
+
+BOOL PromptText(HWND hOwner, LPCTSTR lpszTitle, LPCTSTR lpszLabel,
+	LPTSTR lpszText, size_t nText)
+{
+	DWORD adwTemplate[PROMPT_TEMPLATE_DWORDS];
+	DLGTEMPLATE* pDialog = (DLGTEMPLATE*)adwTemplate;
+	PROMPT prompt;
+
+	if (nText < 2)
+		return FALSE;
+	prompt.lpszText = lpszText;
+	prompt.nText = nText;
+
+	// No resource script: the template is put together here, in dialog units
+	ZeroMemory(adwTemplate, sizeof(adwTemplate));
+	pDialog->style = WS_POPUP | WS_BORDER | WS_SYSMENU | WS_CAPTION |
+		DS_MODALFRAME | DS_SETFONT | DS_CENTER;
+	pDialog->cdit = 4;
+	pDialog->cx = 280;
+	pDialog->cy = 70;
+
+	// No menu, the default class, the title, then the font
+	WORD* p = (WORD*)(pDialog + 1);
+	*p++ = 0;
+	*p++ = 0;
+	p = PromptString(p, lpszTitle);
+	*p++ = 8;
+	p = PromptString(p, _T("MS Shell Dlg"));
+
+	// Static, edit and button classes by atom; the label may take two lines
+	p = PromptControl(p, SS_LEFT, 7, 7, 266, 18, (WORD)-1, 0x0082, lpszLabel);
+	p = PromptControl(p, WS_BORDER | WS_TABSTOP | ES_AUTOHSCROLL, 7, 28, 266, 14,
+		PROMPT_ID_EDIT, 0x0081, _T(""));
+	p = PromptControl(p, WS_TABSTOP | BS_DEFPUSHBUTTON, 169, 49, 50, 14, IDOK, 0x0080, _T("OK"));
+	PromptControl(p, WS_TABSTOP | BS_PUSHBUTTON, 223, 49, 50, 14, IDCANCEL, 0x0080, _T("Cancel"));
+
+	return DialogBoxIndirectParam(GetModuleHandle(NULL), pDialog, hOwner,
+		PromptDialogProc, (LPARAM)&prompt) == IDOK;
+}
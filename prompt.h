@@ -0,0 +1,14 @@
+// prompt.h : a one-line text prompt for commands that need a parameter
+//
+
+#pragma once
+
+// Longest text a prompt accepts, terminator included
+#define PROMPT_MAX_TEXT 256
+
+// Shows a modal dialog over hOwner with lpszLabel above an edit box that
+// starts out holding lpszText.  On OK the text entered replaces lpszText
+// (nText characters at most, terminator included).
+// Returns FALSE if the dialog was cancelled or could not be shown.
+BOOL PromptText(HWND hOwner, LPCTSTR lpszTitle, LPCTSTR lpszLabel,
+	LPTSTR lpszText, size_t nText);
@@ -0,0 +1,299 @@
+// scanner.cpp : finds base64 / hex text embedded in a document
+//
+
+#include "stdafx.h"
+
+#include <tchar.h>
+#include <stdlib.h>
+
+#include "scanner.h"
+#include "blobscan.h"
+#include "docread.h"
+
+// Initial number of complete runs a chunk can hold before it grows
+#define SCAN_CHUNK_RUNS 64
+
+typedef struct _SCAN_CHUNK
+{
+	const unsigned char* pData;
+	size_t        nData;
+	size_t        nHead;	// run touching the start; nData if the chunk is one run
+	blobscan_run  head;
+	blobscan_run  tail;		// run touching the end
+	blobscan_run* pRuns;	// complete runs in between
+	size_t        nRuns;
+	size_t        nMaxRuns;
+	BOOL          bFailed;	// out of memory
+} SCAN_CHUNK;
+
+typedef struct _SCAN_BATCH
+{
+	QWORD          qwOffset;	// document offset of the first chunk
+	size_t         nChunks;
+	size_t         nMinRun;
+	volatile LONG  lNext;		// next chunk handed to a callback
+	PTP_WORK       pWork;		// NULL: scan on the execute thread
+	SCAN_CHUNK     chunks[SCAN_BATCH_CHUNKS];
+} SCAN_BATCH;
+
+// Run that may continue into the next chunk
+typedef struct _SCAN_OPEN
+{
+	QWORD qwStart;
+	QWORD qwEnd;
+	QWORD qwPayload;
+	BOOL  bNonHex;
+} SCAN_OPEN;
+
+static void ScanChunk(SCAN_CHUNK* pChunk, size_t nMinRun)
+{
+	const unsigned char* p = pChunk->pData;
+	size_t n = pChunk->nData;
+
+	pChunk->nRuns = 0;
+	pChunk->bFailed = FALSE;
+
+	pChunk->nHead = blobscan_edge(p, n, 0);
+	blobscan_stats(p, pChunk->nHead, &pChunk->head);
+	if (pChunk->nHead == n)
+		return;
+
+	size_t nTail = blobscan_edge(p, n, 1);
+	size_t nTailStart = n - nTail;
+	blobscan_stats(p + nTailStart, nTail, &pChunk->tail);
+	pChunk->tail.start += nTailStart;
+	pChunk->tail.end += nTailStart;
+
+	// Complete runs lie between the invalid characters ending the head and
+	// starting the tail
+	const unsigned char* pMid = p + pChunk->nHead;
+	size_t nMid = nTailStart - pChunk->nHead;
+	size_t pos = 0;
+	while (pos < nMid)
+	{
+		if (pChunk->nRuns == pChunk->nMaxRuns)
+		{
+			size_t nMax = pChunk->nMaxRuns ? pChunk->nMaxRuns * 2 : SCAN_CHUNK_RUNS;
+			blobscan_run* pRuns = (blobscan_run*)realloc(pChunk->pRuns, nMax * sizeof(blobscan_run));
+			if (!pRuns)
+			{
+				pChunk->bFailed = TRUE;
+				return;
+			}
+			pChunk->pRuns = pRuns;
+			pChunk->nMaxRuns = nMax;
+		}
+		pChunk->nRuns += blobscan_find(pMid, nMid, nMinRun, &pos,
+			pChunk->pRuns + pChunk->nRuns, pChunk->nMaxRuns - pChunk->nRuns);
+	}
+	for (size_t i = 0; i < pChunk->nRuns; i++)
+	{
+		pChunk->pRuns[i].start += pChunk->nHead;
+		pChunk->pRuns[i].end += pChunk->nHead;
+	}
+}
+
+static VOID CALLBACK ScanChunkCallback(PTP_CALLBACK_INSTANCE pInstance,
+	PVOID pContext, PTP_WORK pWork)
+{
+	SCAN_BATCH* pBatch = (SCAN_BATCH*)pContext;
+	LONG i = InterlockedIncrement(&pBatch->lNext) - 1;
+
+	if (i < (LONG)pBatch->nChunks)
+		ScanChunk(&pBatch->chunks[i], pBatch->nMinRun);
+}
+
+static SCAN_BATCH* ScanBatchCreate(size_t nMinRun)
+{
+	SCAN_BATCH* pBatch = (SCAN_BATCH*)calloc(1, sizeof(SCAN_BATCH));
+	if (!pBatch)
+		return NULL;
+
+	pBatch->nMinRun = nMinRun;
+	pBatch->pWork = CreateThreadpoolWork(ScanChunkCallback, pBatch, NULL);
+	return pBatch;
+}
+
+static void ScanBatchDestroy(SCAN_BATCH* pBatch)
+{
+	if (!pBatch)
+		return;
+
+	if (pBatch->pWork)
+	{
+		WaitForThreadpoolWorkCallbacks(pBatch->pWork, TRUE);
+		CloseThreadpoolWork(pBatch->pWork);
+	}
+	for (size_t i = 0; i < SCAN_BATCH_CHUNKS; i++)
+		free(pBatch->chunks[i].pRuns);
+	free(pBatch);
+}
+
+// Splits a window of the document into chunks
+static void ScanBatchSet(SCAN_BATCH* pBatch, const DOC_SPAN* pSpan)
+{
+	pBatch->qwOffset = pSpan->qwOffset;
+	pBatch->nChunks = 0;
+	for (size_t nPos = 0; nPos < pSpan->nData; nPos += SCAN_CHUNK_SIZE)
+	{
+		SCAN_CHUNK* pChunk = &pBatch->chunks[pBatch->nChunks++];
+		pChunk->pData = pSpan->pData + nPos;
+		pChunk->nData = pSpan->nData - nPos;
+		if (pChunk->nData > SCAN_CHUNK_SIZE)
+			pChunk->nData = SCAN_CHUNK_SIZE;
+	}
+}
+
+static void ScanBatchSubmit(SCAN_BATCH* pBatch)
+{
+	pBatch->lNext = 0;
+	for (size_t i = 0; i < pBatch->nChunks; i++)
+	{
+		if (pBatch->pWork)
+			SubmitThreadpoolWork(pBatch->pWork);
+		else
+			ScanChunk(&pBatch->chunks[i], pBatch->nMinRun);
+	}
+}
+
+static void ScanBatchWait(SCAN_BATCH* pBatch)
+{
+	if (pBatch->pWork)
+		WaitForThreadpoolWorkCallbacks(pBatch->pWork, FALSE);
+}
+
+static BOOL ScanAddHit(SCAN_RESULT* pResult, QWORD qwStart, QWORD qwEnd, BOOL bHex)
+{
+	if (pResult->nHits == pResult->nMaxHits)
+	{
+		size_t nMax = pResult->nMaxHits ? pResult->nMaxHits * 2 : 64;
+		SCAN_HIT* pHits = (SCAN_HIT*)realloc(pResult->pHits, nMax * sizeof(SCAN_HIT));
+		if (!pHits)
+			return FALSE;
+		pResult->pHits = pHits;
+		pResult->nMaxHits = nMax;
+	}
+
+	SCAN_HIT* pHit = &pResult->pHits[pResult->nHits++];
+	pHit->qwStart = qwStart;
+	pHit->qwEnd = qwEnd;
+	pHit->bHex = bHex;
+	return TRUE;
+}
+
+static void ScanExtend(SCAN_OPEN* pOpen, QWORD qwBase, const blobscan_run* pRun)
+{
+	// Line breaks only; nothing to anchor the run on yet
+	if (pRun->payload == 0)
+		return;
+
+	if (pOpen->qwPayload == 0)
+		pOpen->qwStart = qwBase + pRun->start;
+	pOpen->qwEnd = qwBase + pRun->end;
+	pOpen->qwPayload += pRun->payload;
+	pOpen->bNonHex |= (pRun->nonhex != 0);
+}
+
+static BOOL ScanClose(SCAN_OPEN* pOpen, size_t nMinRun, SCAN_RESULT* pResult)
+{
+	BOOL bReturn = TRUE;
+
+	if (pOpen->qwPayload >= nMinRun)
+		bReturn = ScanAddHit(pResult, pOpen->qwStart, pOpen->qwEnd, !pOpen->bNonHex);
+	ZeroMemory(pOpen, sizeof(SCAN_OPEN));
+	return bReturn;
+}
+
+// Stitches the chunk results together in document order
+static BOOL ScanMerge(SCAN_BATCH* pBatch, SCAN_OPEN* pOpen, SCAN_RESULT* pResult)
+{
+	QWORD qwBase = pBatch->qwOffset;
+
+	for (size_t i = 0; i < pBatch->nChunks; i++, qwBase += SCAN_CHUNK_SIZE)
+	{
+		const SCAN_CHUNK* pChunk = &pBatch->chunks[i];
+		if (pChunk->bFailed)
+			return FALSE;
+
+		ScanExtend(pOpen, qwBase, &pChunk->head);
+		if (pChunk->nHead == pChunk->nData)
+			continue;
+		if (!ScanClose(pOpen, pBatch->nMinRun, pResult))
+			return FALSE;
+
+		for (size_t j = 0; j < pChunk->nRuns; j++)
+		{
+			const blobscan_run* pRun = &pChunk->pRuns[j];
+			if (!ScanAddHit(pResult, qwBase + pRun->start, qwBase + pRun->end, !pRun->nonhex))
+				return FALSE;
+		}
+		ScanExtend(pOpen, qwBase, &pChunk->tail);
+	}
+	return TRUE;
+}
+
+BOOL ScanDocument(HWSESSION hSession, HWDOCUMENT hDoc,
+	size_t nMinRun, SCAN_RESULT* pResult)
+{
+	BOOL bReturn = FALSE;
+	QWORD qwSize = 0;
+	DOC_READER* pReader = NULL;
+	SCAN_BATCH* pBatch = NULL;
+	SCAN_OPEN open;
+	LPCTSTR lpszStatus = _T("Scanning for encoded data");
+
+	ZeroMemory(pResult, sizeof(SCAN_RESULT));
+	ZeroMemory(&open, sizeof(open));
+	if (nMinRun < BLOBSCAN_MIN_RUN)
+		nMinRun = BLOBSCAN_MIN_RUN;
+
+	__try
+	{
+		if (hwGetDocumentSize(hDoc, &qwSize) != HWAPI_RESULT_SUCCESS)
+			__leave;
+		pBatch = ScanBatchCreate(nMinRun);
+		if (!pBatch)
+			__leave;
+		// The reader fetches the next window while the pool scans this one
+		pReader = DocReaderOpen(hSession, hDoc, 0, qwSize, (size_t)SCAN_BATCH_CHUNKS * SCAN_CHUNK_SIZE);
+		if (!pReader)
+			__leave;
+
+		hwUpdateProgress(hSession, 0, lpszStatus);
+		for (;;)
+		{
+			DOC_SPAN span;
+			if (!DocReaderNext(pReader, &span))
+				__leave;
+			if (span.nData == 0)
+				break;
+
+			ScanBatchSet(pBatch, &span);
+			ScanBatchSubmit(pBatch);
+			ScanBatchWait(pBatch);
+			if (!ScanMerge(pBatch, &open, pResult))
+				__leave;
+			pResult->qwScanned = span.qwOffset + span.nData;
+
+			if (hwUpdateProgress(hSession, (int)(pResult->qwScanned * 100 / qwSize),
+				lpszStatus) == HWAPI_RESULT_USER_ABORT)
+				__leave;
+		}
+
+		bReturn = ScanClose(&open, nMinRun, pResult);
+	}
+	__finally
+	{
+		// Callbacks are done with the window before the reader lets it go
+		ScanBatchDestroy(pBatch);
+		DocReaderClose(pReader, NULL);
+	}
+
+	return bReturn;
+}
+
+void ScanResultFree(SCAN_RESULT* pResult)
+{
+	free(pResult->pHits);
+	ZeroMemory(pResult, sizeof(SCAN_RESULT));
+}
@@ -0,0 +1,36 @@
+// scanner.h : finds base64 / hex text embedded in a document
+//
+
+#pragma once
+
+#include "hwapi.h"
+
+// Document bytes scanned by one thread pool callback
+#define SCAN_CHUNK_SIZE (1024 * 1024)
+// Chunks per batch, a window of the document (see docread.h); the next
+// window is read ahead while one batch is scanned
+#define SCAN_BATCH_CHUNKS 32
+
+typedef struct _SCAN_HIT
+{
+	QWORD qwStart;	// first character of the run
+	QWORD qwEnd;	// one past the last character
+	BOOL  bHex;		// hex digits only, otherwise base64
+} SCAN_HIT;
+
+typedef struct _SCAN_RESULT
+{
+	SCAN_HIT* pHits;
+	size_t    nHits;
+	size_t    nMaxHits;
+	QWORD     qwScanned;	// document bytes looked at
+} SCAN_RESULT;
+
+// Scans the document for runs of at least nMinRun base64 / hex characters
+// (see blobscan.h), spreading the chunks over the system thread pool.
+// Returns FALSE if the user cancelled or the scan failed; hits found up
+// to that point are kept in pResult either way.
+BOOL ScanDocument(HWSESSION hSession, HWDOCUMENT hDoc,
+	size_t nMinRun, SCAN_RESULT* pResult);
+
+void ScanResultFree(SCAN_RESULT* pResult);
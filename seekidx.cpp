@@ -0,0 +1,229 @@
+/* seekidx.cpp : checkpoint index for random access into hex / base64 text */
+
+#include "seekidx.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define SEEKIDX_SSE2
+#include <emmintrin.h>
+#endif
+
+/* character classes */
+#define SEEKIDX_DIGIT 0
+#define SEEKIDX_BLANK 1
+#define SEEKIDX_PAD   2
+#define SEEKIDX_OTHER 3
+
+/* After a block with anything but digits and blanks, stay scalar for this many characters */
+#define SEEKIDX_SCALAR_RUN 16
+
+/* class of every character, by codec */
+struct seekidx_tables {
+	unsigned char hex[256];
+	unsigned char base64[256];
+
+	seekidx_tables()
+	{
+		int i;
+
+		for (i = 0; i < 256; i++) {
+			hex[i] = SEEKIDX_OTHER;
+			base64[i] = SEEKIDX_OTHER;
+		}
+		for (i = 0; i < 10; i++) {
+			hex['0' + i] = SEEKIDX_DIGIT;
+			base64['0' + i] = SEEKIDX_DIGIT;
+		}
+		for (i = 0; i < 6; i++) {
+			hex['A' + i] = SEEKIDX_DIGIT;
+			hex['a' + i] = SEEKIDX_DIGIT;
+		}
+		for (i = 0; i < 26; i++) {
+			base64['A' + i] = SEEKIDX_DIGIT;
+			base64['a' + i] = SEEKIDX_DIGIT;
+		}
+		base64['+'] = SEEKIDX_DIGIT;
+		base64['/'] = SEEKIDX_DIGIT;
+		base64['='] = SEEKIDX_PAD;
+
+		hex[' '] = hex['\t'] = hex['\r'] = hex['\n'] = SEEKIDX_BLANK;
+		base64[' '] = base64['\t'] = base64['\r'] = base64['\n'] = SEEKIDX_BLANK;
+	}
+};
+
+static const seekidx_tables*
+seekidx_tables_get(void)
+{
+	static const seekidx_tables tables;
+	return &tables;
+}
+
+#ifdef SEEKIDX_SSE2
+static unsigned int
+seekidx_popcount16(unsigned int m)
+{
+	m = m - ((m >> 1) & 0x5555);
+	m = (m & 0x3333) + ((m >> 2) & 0x3333);
+	m = (m + (m >> 4)) & 0x0F0F;
+	return (m + (m >> 8)) & 0x1F;
+}
+
+/* characters from lo to hi */
+static __m128i
+seekidx_sse2_range(__m128i v, char lo, char hi)
+{
+	return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+		_mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+}
+
+/*
+ * Digit and blank masks of 16 characters, one bit per character.
+ */
+static void
+seekidx_sse2_classify(const char* in, int codec, unsigned int* digit, unsigned int* blank)
+{
+	const __m128i v = _mm_loadu_si128((const __m128i*)in);
+	__m128i d = seekidx_sse2_range(v, '0', '9');
+
+	if (codec == SEEKIDX_HEX) {
+		d = _mm_or_si128(d, seekidx_sse2_range(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'f'));
+	}
+	else {
+		d = _mm_or_si128(d, seekidx_sse2_range(v, 'A', 'Z'));
+		d = _mm_or_si128(d, seekidx_sse2_range(v, 'a', 'z'));
+		d = _mm_or_si128(d, _mm_cmpeq_epi8(v, _mm_set1_epi8('+')));
+		d = _mm_or_si128(d, _mm_cmpeq_epi8(v, _mm_set1_epi8('/')));
+	}
+
+	const __m128i b = _mm_or_si128(
+		_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+		_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))));
+
+	*digit = (unsigned int)_mm_movemask_epi8(d);
+	*blank = (unsigned int)_mm_movemask_epi8(b);
+}
+#endif
+
+int
+seekidx_init(seekidx_state* st, int codec, unsigned long long interval)
+{
+	if (codec != SEEKIDX_HEX && codec != SEEKIDX_BASE64) {
+		return 0;
+	}
+
+	st->codec = codec;
+	st->interval = interval < SEEKIDX_MIN_INTERVAL ? SEEKIDX_MIN_INTERVAL : interval;
+	st->text = 0;
+	st->digits = 0;
+	st->next = 0;
+	st->tail = 0;
+	st->padded = 0;
+	st->done = 0;
+	return 1;
+}
+
+size_t
+seekidx_scan(seekidx_state* st, const char* in, size_t inlen,
+	seekidx_point* points)
+{
+	const int hex = (st->codec == SEEKIDX_HEX);
+	const unsigned char* cls = hex ? seekidx_tables_get()->hex : seekidx_tables_get()->base64;
+	const unsigned int unit = hex ? 2 : 4;
+	const unsigned int bytes = hex ? 1 : 3;
+	unsigned long long digits = st->digits;
+	size_t i = 0;
+	size_t n = 0;
+	size_t scalar_until = 0;
+
+	if (st->done) {
+		return 0;
+	}
+
+	while (i < inlen) {
+		/* a checkpoint is due: wait for the next pair / quantum boundary */
+		if (st->text + i >= st->next) {
+			if (digits % unit == 0) {
+				points[n].text = st->text + i;
+				points[n].out = digits / unit * bytes;
+				n++;
+				st->next = st->text + i + st->interval;
+			}
+		}
+#ifdef SEEKIDX_SSE2
+		else if (!st->padded && i >= scalar_until && inlen - i >= 16) {
+			unsigned int digit;
+			unsigned int blank;
+
+			seekidx_sse2_classify(in + i, st->codec, &digit, &blank);
+			if ((digit | blank) == 0xFFFF) {
+				/* hex: a blank must not come after an odd number of digits */
+				unsigned int parity = digit;
+				parity ^= parity << 1;
+				parity ^= parity << 2;
+				parity ^= parity << 4;
+				parity ^= parity << 8;
+				parity = ((parity << 1) ^ ((digits & 1) ? 0xFFFF : 0)) & 0xFFFF;
+
+				if (!hex || (blank & parity) == 0) {
+					digits += seekidx_popcount16(digit);
+					i += 16;
+					continue;
+				}
+			}
+			scalar_until = i + SEEKIDX_SCALAR_RUN;
+		}
+#endif
+
+		unsigned char c = cls[(unsigned char)in[i]];
+		if (st->padded) {
+			if (c != SEEKIDX_PAD && c != SEEKIDX_BLANK) {
+				st->done = 1;
+				break;
+			}
+		}
+		else if (c == SEEKIDX_DIGIT) {
+			digits++;
+		}
+		else if (c == SEEKIDX_PAD && digits % 4 >= 2) {
+			/* "xx==" and "xxx=" still yield their bytes */
+			st->tail = (unsigned int)(digits % 4) - 1;
+			st->padded = 1;
+		}
+		else if (c != SEEKIDX_BLANK || (hex && (digits & 1))) {
+			st->done = 1;
+			break;
+		}
+		i++;
+	}
+
+	st->text += i;
+	st->digits = digits;
+	return n;
+}
+
+unsigned long long
+seekidx_decoded_size(const seekidx_state* st)
+{
+	if (st->codec == SEEKIDX_HEX) {
+		return st->digits / 2;
+	}
+	return st->digits / 4 * 3 + st->tail;
+}
+
+size_t
+seekidx_find(const seekidx_point* points, size_t n, unsigned long long out)
+{
+	size_t lo = 0;
+	size_t hi = n;
+
+	/* the last point with points[k].out <= out lies in [lo, hi) */
+	while (hi - lo > 1) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (points[mid].out <= out) {
+			lo = mid;
+		}
+		else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#ifndef SEEKIDX_H
+#define SEEKIDX_H
+
+#include <stddef.h>
+
+/*
+ * Checkpoints for random access into long hex or base64 texts. Each one
+ * pairs a text offset where decoding can start over, on a pair or quantum
+ * boundary, with the decoded offset of the first byte decoded from there;
+ * blanks and line breaks between the digits are allowed anywhere. The
+ * text is indexed in one pass, a chunk at a time, with SSE2 counting the
+ * digits of 16 characters at once between checkpoints.
+ *
+ * Hex text is decoded from a checkpoint with hex_policy_blanks, base64
+ * text with base64_policy_lines.
+ */
+
+#define SEEKIDX_HEX    1
+#define SEEKIDX_BASE64 2
+
+/* closest checkpoints allowed, in characters */
+#define SEEKIDX_MIN_INTERVAL 4096
+
+/* checkpoints one seekidx_scan call can add for inlen characters */
+#define SEEKIDX_POINTS_MAX(inlen, interval) ((inlen) / (interval) + 1)
+
+typedef struct seekidx_point {
+	unsigned long long text;     /* text offset where decoding starts */
+	unsigned long long out;      /* decoded offset of its first byte */
+} seekidx_point;
+
+typedef struct seekidx_state {
+	int codec;                   /* SEEKIDX_HEX or SEEKIDX_BASE64 */
+	unsigned long long interval; /* characters between checkpoints */
+	unsigned long long text;     /* characters scanned */
+	unsigned long long digits;   /* digits among them */
+	unsigned long long next;     /* no checkpoint before this text offset */
+	unsigned int tail;           /* base64: bytes of a padded last quantum */
+	int padded;                  /* base64: padding seen, only more may follow */
+	int done;                    /* the data ended at text */
+} seekidx_state;
+
+/*
+ * interval is raised to SEEKIDX_MIN_INTERVAL if below.
+ * return values is 0 for an unknown codec
+ */
+int
+seekidx_init(seekidx_state* st, int codec, unsigned long long interval);
+
+/*
+ * Scans in[0..inlen), the text following what earlier calls scanned, and
+ * appends a checkpoint to points about every interval characters, the
+ * first at offset 0. points must hold SEEKIDX_POINTS_MAX(inlen, interval)
+ * entries. The data ends where the decoder would stop: at any character
+ * other than a digit or a blank, in hex at a blank inside a pair, and in
+ * base64 after padding. st->done is then set and st->text is where it
+ * ended; padding, and blanks after it, are counted in st->text.
+ * return values is the number of checkpoints added
+ */
+size_t
+seekidx_scan(seekidx_state* st, const char* in, size_t inlen,
+	seekidx_point* points);
+
+/*
+ * return values is the decoded size of the text scanned so far
+ */
+unsigned long long
+seekidx_decoded_size(const seekidx_state* st);
+
+/*
+ * return values is the index of the last of points[0..n) at or before
+ * decoded offset out; points are in order, points[0].out is 0
+ */
+size_t
+seekidx_find(const seekidx_point* points, size_t n, unsigned long long out);
+
+#endif /* SEEKIDX_H */
@@ -0,0 +1,317 @@
+#include "sniff.h"
+#include "envelope.h"
+#include "hexdump.h"
+#include "ihex.h"
+
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SNIFF_SSE2
+#include <emmintrin.h>
+#endif
+
+/* character classes; every character falls in exactly one */
+#define SNIFF_C_HEX     0   /* 0-9 A-F a-f */
+#define SNIFF_C_X       1   /* x X */
+#define SNIFF_C_LETTER  2   /* other letters */
+#define SNIFF_C_B64     3   /* + / */
+#define SNIFF_C_DASH    4   /* - */
+#define SNIFF_C_LOW     5   /* _ */
+#define SNIFF_C_PAD     6   /* = */
+#define SNIFF_C_BLANK   7   /* space, tab, CR, LF */
+#define SNIFF_C_SEP     8   /* : , . between hex pairs */
+#define SNIFF_C_LIST    9   /* ; \ { } around prefixed hex */
+#define SNIFF_C_PUNCT   10  /* other punctuation up to 'u': Ascii85 only */
+#define SNIFF_C_OTHER   11  /* controls, 0x7f and up, | ~ */
+#define SNIFF_CLASSES   12
+
+typedef struct sniff_counts {
+	size_t c[SNIFF_CLASSES];
+	size_t beyond_u;        /* v..y { }: letters and LIST that Ascii85 lacks */
+} sniff_counts;
+
+static int
+sniff_class(unsigned char c)
+{
+	if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'F') || (c >= 'a' && c <= 'f')) {
+		return SNIFF_C_HEX;
+	}
+	if (c == 'x' || c == 'X') {
+		return SNIFF_C_X;
+	}
+	if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')) {
+		return SNIFF_C_LETTER;
+	}
+	switch (c) {
+	case '+': case '/':
+		return SNIFF_C_B64;
+	case '-':
+		return SNIFF_C_DASH;
+	case '_':
+		return SNIFF_C_LOW;
+	case '=':
+		return SNIFF_C_PAD;
+	case ' ': case '\t': case '\r': case '\n':
+		return SNIFF_C_BLANK;
+	case ':': case ',': case '.':
+		return SNIFF_C_SEP;
+	case ';': case '\\': case '{': case '}':
+		return SNIFF_C_LIST;
+	}
+	if (c >= '!' && c <= 'u') {
+		return SNIFF_C_PUNCT;
+	}
+	return SNIFF_C_OTHER;
+}
+
+static void
+sniff_count_scalar(const unsigned char* in, size_t inlen, sniff_counts* counts)
+{
+	size_t i;
+
+	for (i = 0; i < inlen; i++) {
+		counts->c[sniff_class(in[i])]++;
+		if ((in[i] >= 'v' && in[i] <= 'y') || in[i] == '{' || in[i] == '}') {
+			counts->beyond_u++;
+		}
+	}
+}
+
+#ifdef SNIFF_SSE2
+/* c in [lo, hi]; signed compares, so 0x80 and up never match */
+#define SNIFF_RANGE(v, lo, hi) _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8((lo) - 1)), \
+	_mm_cmplt_epi8(v, _mm_set1_epi8((hi) + 1)))
+#define SNIFF_EQ(v, c) _mm_cmpeq_epi8(v, _mm_set1_epi8(c))
+
+/*
+ * Counts 16 characters at a time: each class is a mask, added into byte
+ * counters that are summed before they can overflow.
+ * return values is characters counted
+ */
+static size_t
+sniff_count_sse2(const unsigned char* in, size_t inlen, sniff_counts* counts)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i acc[SNIFF_CLASSES + 1];
+	__m128i m[SNIFF_CLASSES + 1];
+	size_t i = 0;
+	int k;
+
+	while (inlen - i >= 16) {
+		size_t end = i + 255 * 16;
+		if (end > inlen) {
+			end = inlen;
+		}
+		for (k = 0; k <= SNIFF_CLASSES; k++) {
+			acc[k] = zero;
+		}
+
+		for (; end - i >= 16; i += 16) {
+			const __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+			const __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+			const __m128i alpha = SNIFF_RANGE(lower, 'a', 'z');
+
+			m[SNIFF_C_HEX] = _mm_or_si128(SNIFF_RANGE(v, '0', '9'), SNIFF_RANGE(lower, 'a', 'f'));
+			m[SNIFF_C_X] = SNIFF_EQ(lower, 'x');
+			m[SNIFF_C_LETTER] = _mm_andnot_si128(_mm_or_si128(m[SNIFF_C_HEX], m[SNIFF_C_X]), alpha);
+			m[SNIFF_C_B64] = _mm_or_si128(SNIFF_EQ(v, '+'), SNIFF_EQ(v, '/'));
+			m[SNIFF_C_DASH] = SNIFF_EQ(v, '-');
+			m[SNIFF_C_LOW] = SNIFF_EQ(v, '_');
+			m[SNIFF_C_PAD] = SNIFF_EQ(v, '=');
+			m[SNIFF_C_BLANK] = _mm_or_si128(_mm_or_si128(SNIFF_EQ(v, ' '), SNIFF_EQ(v, '\t')),
+				_mm_or_si128(SNIFF_EQ(v, '\r'), SNIFF_EQ(v, '\n')));
+			m[SNIFF_C_SEP] = _mm_or_si128(SNIFF_EQ(v, ':'), _mm_or_si128(SNIFF_EQ(v, ','), SNIFF_EQ(v, '.')));
+			m[SNIFF_C_LIST] = _mm_or_si128(_mm_or_si128(SNIFF_EQ(v, ';'), SNIFF_EQ(v, '\\')),
+				_mm_or_si128(SNIFF_EQ(v, '{'), SNIFF_EQ(v, '}')));
+
+			__m128i known = _mm_or_si128(_mm_or_si128(m[SNIFF_C_HEX], m[SNIFF_C_X]), m[SNIFF_C_LETTER]);
+			known = _mm_or_si128(known, _mm_or_si128(m[SNIFF_C_B64], m[SNIFF_C_DASH]));
+			known = _mm_or_si128(known, _mm_or_si128(m[SNIFF_C_LOW], m[SNIFF_C_PAD]));
+			known = _mm_or_si128(known, _mm_or_si128(m[SNIFF_C_BLANK], m[SNIFF_C_SEP]));
+			known = _mm_or_si128(known, m[SNIFF_C_LIST]);
+			m[SNIFF_C_PUNCT] = _mm_andnot_si128(known, SNIFF_RANGE(v, '!', 'u'));
+			m[SNIFF_C_OTHER] = _mm_andnot_si128(_mm_or_si128(known, m[SNIFF_C_PUNCT]),
+				_mm_set1_epi8(-1));
+			m[SNIFF_CLASSES] = _mm_or_si128(SNIFF_RANGE(v, 'v', 'y'),
+				_mm_or_si128(SNIFF_EQ(v, '{'), SNIFF_EQ(v, '}')));
+
+			/* a set mask byte is -1 */
+			for (k = 0; k <= SNIFF_CLASSES; k++) {
+				acc[k] = _mm_sub_epi8(acc[k], m[k]);
+			}
+		}
+
+		for (k = 0; k <= SNIFF_CLASSES; k++) {
+			const __m128i sum = _mm_sad_epu8(acc[k], zero);
+			size_t n = (size_t)_mm_cvtsi128_si32(sum) + (size_t)_mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+			if (k < SNIFF_CLASSES) {
+				counts->c[k] += n;
+			}
+			else {
+				counts->beyond_u += n;
+			}
+		}
+	}
+
+	return i;
+}
+#endif
+
+/* one past the end of the first line, line break excluded */
+static size_t
+sniff_line_end(const char* in, size_t inlen)
+{
+	const char* eol = (const char*)memchr(in, '\n', inlen);
+	return eol ? (size_t)(eol - in) : inlen;
+}
+
+static int
+sniff_is_hex(char c)
+{
+	return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'F') || (c >= 'a' && c <= 'f');
+}
+
+/* ":LLAAAATT...CC" with a good checksum */
+static int
+sniff_intel_hex(const char* in, size_t inlen)
+{
+	unsigned char out[256];
+	size_t len = sniff_line_end(in, inlen);
+	size_t used;
+	ihex_state state;
+
+	if (in[0] != ':' || len > 2 * 260 + 2) {
+		return 0;
+	}
+	ihex_init(&state);
+	ihex_decode(in, len, out, &state, 1, &used);
+	return used == len;
+}
+
+/* "00000000: 4865 6c6c" or "00000000  48 65 6c 6c ... |He..|" */
+static int
+sniff_hexdump(const char* in, size_t inlen)
+{
+	unsigned char out[HEXDUMP_LINE_BYTES];
+	size_t len = sniff_line_end(in, inlen);
+	size_t k = 0;
+	size_t used;
+
+	while (k < len && sniff_is_hex(in[k])) {
+		k++;
+	}
+	if (k < 4 || k + 2 > len) {
+		return 0;
+	}
+	if (!(in[k] == ':' && in[k + 1] == ' ') &&
+		!(in[k] == ' ' && in[k + 1] == ' ' && memchr(in + k, '|', len - k))) {
+		return 0;
+	}
+	return hexdump_parse(in, len, out, 1, &used) > 0 && used == len;
+}
+
+static int
+sniff_envelope(const char* in, size_t inlen)
+{
+	envelope_scan scan;
+	envelope_block block;
+
+	envelope_scan_init(&scan, in, inlen);
+	return envelope_next(&scan, &block);
+}
+
+int
+sniff_format(const char* in, size_t inlen)
+{
+	sniff_counts counts;
+	size_t n;
+	size_t i = 0;
+
+	/* leading blanks and a UTF-8 BOM say nothing */
+	if (inlen >= 3 && memcmp(in, "\xEF\xBB\xBF", 3) == 0) {
+		in += 3;
+		inlen -= 3;
+	}
+	while (inlen && (*in == ' ' || *in == '\t' || *in == '\r' || *in == '\n')) {
+		in++;
+		inlen--;
+	}
+	if (inlen == 0) {
+		return SNIFF_UNKNOWN;
+	}
+	if (inlen > SNIFF_SAMPLE_SIZE) {
+		inlen = SNIFF_SAMPLE_SIZE;
+	}
+
+	/* line layouts first: their digits would pass for plain hex */
+	if (sniff_intel_hex(in, inlen)) {
+		return SNIFF_INTEL_HEX;
+	}
+	if (sniff_hexdump(in, inlen)) {
+		return SNIFF_HEXDUMP;
+	}
+	if (inlen >= 2 && in[0] == '<' && in[1] == '~') {
+		return SNIFF_ASCII85;
+	}
+	if (sniff_envelope(in, inlen)) {
+		return SNIFF_ENVELOPE;
+	}
+
+	memset(&counts, 0, sizeof(counts));
+#ifdef SNIFF_SSE2
+	i = sniff_count_sse2((const unsigned char*)in, inlen, &counts);
+#endif
+	sniff_count_scalar((const unsigned char*)in + i, inlen - i, &counts);
+
+	n = inlen - counts.c[SNIFF_C_BLANK];
+	if (counts.c[SNIFF_C_OTHER]) {
+		return SNIFF_UNKNOWN;
+	}
+
+	/* digits with separators, or with 0x / \x in front of each pair */
+	if (counts.c[SNIFF_C_LETTER] == 0 && counts.c[SNIFF_C_B64] == 0 &&
+		counts.c[SNIFF_C_LOW] == 0 && counts.c[SNIFF_C_PAD] == 0 &&
+		counts.c[SNIFF_C_PUNCT] == 0 && counts.c[SNIFF_C_HEX] >= n / 2) {
+		if (counts.c[SNIFF_C_X] == 0 && counts.c[SNIFF_C_LIST] == 0) {
+			return SNIFF_HEX;
+		}
+		if (counts.c[SNIFF_C_X] && counts.c[SNIFF_C_DASH] == 0 &&
+			counts.c[SNIFF_C_X] * 2 <= counts.c[SNIFF_C_HEX]) {
+			return SNIFF_HEX_PREFIXED;
+		}
+	}
+
+	/* the base64 alphabets, padding only at the end of lines or blocks */
+	if (counts.c[SNIFF_C_SEP] == 0 && counts.c[SNIFF_C_LIST] == 0 &&
+		counts.c[SNIFF_C_PUNCT] == 0 && counts.c[SNIFF_C_PAD] <= 2 * (1 + n / 64)) {
+		if (counts.c[SNIFF_C_DASH] == 0 && counts.c[SNIFF_C_LOW] == 0) {
+			return SNIFF_BASE64;
+		}
+		if (counts.c[SNIFF_C_B64] == 0) {
+			return SNIFF_BASE64URL;
+		}
+	}
+
+	/* '!'..'u' and 'z'; a quarter of the digits of random data are
+	   punctuation, prose has far less */
+	if (counts.beyond_u == 0 && counts.c[SNIFF_C_PUNCT] * 10 >= n) {
+		return SNIFF_ASCII85;
+	}
+	return SNIFF_UNKNOWN;
+}
+
+const char*
+sniff_name(int format)
+{
+	switch (format) {
+	case SNIFF_HEX:          return "hex";
+	case SNIFF_HEX_PREFIXED: return "prefixed hex";
+	case SNIFF_HEXDUMP:      return "hex dump";
+	case SNIFF_BASE64:       return "base64";
+	case SNIFF_BASE64URL:    return "base64url";
+	case SNIFF_ENVELOPE:     return "PEM / data: URI";
+	case SNIFF_ASCII85:      return "Ascii85";
+	case SNIFF_INTEL_HEX:    return "Intel HEX";
+	}
+	return "unknown";
+}
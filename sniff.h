@@ -0,0 +1,41 @@
+#pragma once
+
+#ifndef SNIFF_H
+#define SNIFF_H
+
+#include <stddef.h>
+
+/*
+ * Guesses how binary data was written out as text, from a sample at the
+ * start of the text, so the matching decoder can run without a failed
+ * attempt first. Line layouts (Intel HEX records, xxd / hexdump -C lines,
+ * PEM armor) are recognised by their first line; the rest from a count of
+ * character classes over the sample.
+ */
+
+#define SNIFF_UNKNOWN      0
+#define SNIFF_HEX          1   /* "DE AD BE EF", "de:ad:be:ef" */
+#define SNIFF_HEX_PREFIXED 2   /* "0xDE, 0xAD", "\xde\xad" */
+#define SNIFF_HEXDUMP      3   /* xxd or hexdump -C output */
+#define SNIFF_BASE64       4
+#define SNIFF_BASE64URL    5
+#define SNIFF_ENVELOPE     6   /* PEM blocks or data: URIs */
+#define SNIFF_ASCII85      7
+#define SNIFF_INTEL_HEX    8
+
+/* characters looked at, at most */
+#define SNIFF_SAMPLE_SIZE 4096
+
+/*
+ * return values is a SNIFF_* format
+ */
+int
+sniff_format(const char* in, size_t inlen);
+
+/*
+ * return values is a short name for a SNIFF_* format
+ */
+const char*
+sniff_name(int format);
+
+#endif /* SNIFF_H */
@@ -0,0 +1,78 @@
+// worker.cpp : background execution with progress reporting
+//
+
+#include "stdafx.h"
+
+#include "worker.h"
+
+static QWORD WorkerLoad(volatile LONG64* pValue)
+{
+	// Atomic 64-bit read, also on Win32
+	return InterlockedCompareExchange64(pValue, 0, 0);
+}
+
+void WorkerProgressInit(WORKER_PROGRESS* pProgress, QWORD qwTotal)
+{
+	InterlockedExchange64(&pProgress->qwTotal, qwTotal);
+	InterlockedExchange64(&pProgress->qwDone, 0);
+	InterlockedExchange(&pProgress->lCancel, 0);
+}
+
+void WorkerProgressSet(WORKER_PROGRESS* pProgress, QWORD qwDone)
+{
+	if (pProgress)
+		InterlockedExchange64(&pProgress->qwDone, qwDone);
+}
+
+BOOL WorkerCancelled(const WORKER_PROGRESS* pProgress)
+{
+	return pProgress && pProgress->lCancel != 0;
+}
+
+static int WorkerPercent(WORKER_PROGRESS* pProgress)
+{
+	QWORD qwTotal = WorkerLoad(&pProgress->qwTotal);
+	QWORD qwDone = WorkerLoad(&pProgress->qwDone);
+
+	if (qwTotal <= 0)
+		return 0;
+	if (qwDone >= qwTotal)
+		return 100;
+	return (int)(qwDone * 100 / qwTotal);
+}
+
+BOOL RunWorker(HWSESSION hSession,
+	LPCTSTR lpszStatus,
+	LPTHREAD_START_ROUTINE pfnWork,
+	LPVOID pParam,
+	WORKER_PROGRESS* pProgress)
+{
+	BOOL bCancelled = FALSE;
+	HANDLE hThread = CreateThread(NULL, 0, pfnWork, pParam, 0, NULL);
+
+	if (!hThread)
+	{
+		// No thread available; fall back to running on the execute thread
+		pfnWork(pParam);
+		return TRUE;
+	}
+
+	hwUpdateProgress(hSession, 0, lpszStatus);
+	while (WaitForSingleObject(hThread, WORKER_POLL_INTERVAL) == WAIT_TIMEOUT)
+	{
+		if (bCancelled)
+			continue;
+
+		if (hwUpdateProgress(hSession, WorkerPercent(pProgress), lpszStatus) == HWAPI_RESULT_USER_ABORT)
+		{
+			InterlockedExchange(&pProgress->lCancel, 1);
+			bCancelled = TRUE;
+		}
+	}
+	CloseHandle(hThread);
+
+	if (!bCancelled)
+		hwUpdateProgress(hSession, 100, lpszStatus);
+
+	return !bCancelled;
+}
@@ -0,0 +1,33 @@
+// worker.h : runs long plugin operations on a worker thread while the
+// execute thread reports progress to Hex Workshop
+//
+
+#pragma once
+
+#include "hwapi.h"
+
+// How often the execute thread samples the worker's progress (ms)
+#define WORKER_POLL_INTERVAL 100
+
+// Progress shared between the worker and the execute thread.  The worker
+// only ever writes qwDone; the execute thread only ever writes lCancel.
+typedef struct _WORKER_PROGRESS
+{
+	volatile LONG64 qwTotal;	// units of work (normally input bytes)
+	volatile LONG64 qwDone;		// units completed so far
+	volatile LONG   lCancel;	// non-zero once the user aborted
+} WORKER_PROGRESS;
+
+void WorkerProgressInit(WORKER_PROGRESS* pProgress, QWORD qwTotal);
+void WorkerProgressSet(WORKER_PROGRESS* pProgress, QWORD qwDone);
+BOOL WorkerCancelled(const WORKER_PROGRESS* pProgress);
+
+// Runs pfnWork(pParam) on a worker thread and keeps hwUpdateProgress fed
+// until it returns.  A user abort is forwarded through pProgress->lCancel;
+// the worker is expected to stop at its next chunk boundary.
+// Returns FALSE if the user cancelled, TRUE otherwise.
+BOOL RunWorker(HWSESSION hSession,
+	LPCTSTR lpszStatus,
+	LPTHREAD_START_ROUTINE pfnWork,
+	LPVOID pParam,
+	WORKER_PROGRESS* pProgress);
@@ -0,0 +1,195 @@
+/* xform.cpp : byte transforms for transform chains */
+
+#include "xform.h"
+
+#include <string.h>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define XFORM_SSE2
+#include <emmintrin.h>
+#endif
+
+int
+xform_init(xform_stage* stage, int kind, const unsigned char* key, size_t keylen)
+{
+	size_t i;
+
+	memset(stage, 0, sizeof(*stage));
+	if (keylen == 0 || keylen > XFORM_MAX_KEY) {
+		return 0;
+	}
+	if ((kind == XFORM_ROL || kind == XFORM_ROR) && (keylen != 1 || key[0] < 1 || key[0] > 7)) {
+		return 0;
+	}
+
+	stage->kind = kind;
+	stage->keylen = keylen;
+	for (i = 0; i < keylen + 16; i++) {
+		stage->key[i] = key[i % keylen];
+	}
+
+	if (kind == XFORM_XOR_ROLLING) {
+		/* a missing step counts as 1 */
+		stage->key[1] = (keylen > 1) ? key[1] : 1;
+	}
+	else if (kind == XFORM_RC4) {
+		unsigned char j = 0;
+		for (i = 0; i < 256; i++) {
+			stage->rc4_s[i] = (unsigned char)i;
+		}
+		for (i = 0; i < 256; i++) {
+			unsigned char t = stage->rc4_s[i];
+			j = (unsigned char)(j + t + key[i % keylen]);
+			stage->rc4_s[i] = stage->rc4_s[j];
+			stage->rc4_s[j] = t;
+		}
+	}
+
+	return 1;
+}
+
+/* XOR / ADD / SUB with a repeating key */
+static void
+xform_keyed(xform_stage* stage, unsigned char* buf, size_t len)
+{
+	size_t i = 0;
+	size_t phase = stage->phase;
+	size_t keylen = stage->keylen;
+	const unsigned char* key = stage->key;
+
+#ifdef XFORM_SSE2
+	/* key + phase holds the next 16 key bytes, whatever the key length */
+	for (; len - i >= 16; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(buf + i));
+		__m128i k = _mm_loadu_si128((const __m128i*)(key + phase));
+		if (stage->kind == XFORM_XOR) {
+			v = _mm_xor_si128(v, k);
+		}
+		else if (stage->kind == XFORM_ADD) {
+			v = _mm_add_epi8(v, k);
+		}
+		else {
+			v = _mm_sub_epi8(v, k);
+		}
+		_mm_storeu_si128((__m128i*)(buf + i), v);
+		phase = (phase + 16) % keylen;
+	}
+#endif
+	for (; i < len; i++) {
+		if (stage->kind == XFORM_XOR) {
+			buf[i] ^= key[phase];
+		}
+		else if (stage->kind == XFORM_ADD) {
+			buf[i] += key[phase];
+		}
+		else {
+			buf[i] -= key[phase];
+		}
+		if (++phase == keylen) {
+			phase = 0;
+		}
+	}
+
+	stage->phase = phase;
+}
+
+static void
+xform_rotate(xform_stage* stage, unsigned char* buf, size_t len)
+{
+	size_t i = 0;
+	int left = (stage->kind == XFORM_ROL) ? stage->key[0] : 8 - stage->key[0];
+
+#ifdef XFORM_SSE2
+	/* 16-bit shifts, with the bits that crossed a byte masked off */
+	const __m128i nl = _mm_cvtsi32_si128(left);
+	const __m128i nr = _mm_cvtsi32_si128(8 - left);
+	const __m128i ml = _mm_set1_epi8((char)(0xFF << left));
+	const __m128i mr = _mm_set1_epi8((char)(0xFF >> (8 - left)));
+
+	for (; len - i >= 16; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(buf + i));
+		v = _mm_or_si128(_mm_and_si128(_mm_sll_epi16(v, nl), ml),
+			_mm_and_si128(_mm_srl_epi16(v, nr), mr));
+		_mm_storeu_si128((__m128i*)(buf + i), v);
+	}
+#endif
+	for (; i < len; i++) {
+		buf[i] = (unsigned char)((buf[i] << left) | (buf[i] >> (8 - left)));
+	}
+}
+
+static void
+xform_rolling(xform_stage* stage, unsigned char* buf, size_t len)
+{
+	size_t i = 0;
+	unsigned char k = stage->key[0];
+	unsigned char step = stage->key[1];
+
+#ifdef XFORM_SSE2
+	if (len >= 16) {
+		unsigned char ramp[16];
+		for (int n = 0; n < 16; n++) {
+			ramp[n] = (unsigned char)(k + n * step);
+		}
+		__m128i kv = _mm_loadu_si128((const __m128i*)ramp);
+		const __m128i inc = _mm_set1_epi8((char)(step * 16));
+
+		for (; len - i >= 16; i += 16) {
+			__m128i v = _mm_loadu_si128((const __m128i*)(buf + i));
+			_mm_storeu_si128((__m128i*)(buf + i), _mm_xor_si128(v, kv));
+			kv = _mm_add_epi8(kv, inc);
+		}
+		k = (unsigned char)(k + i * step);
+	}
+#endif
+	for (; i < len; i++) {
+		buf[i] ^= k;
+		k = (unsigned char)(k + step);
+	}
+
+	stage->key[0] = k;
+}
+
+static void
+xform_rc4(xform_stage* stage, unsigned char* buf, size_t len)
+{
+	unsigned char* s = stage->rc4_s;
+	unsigned char i = stage->rc4_i;
+	unsigned char j = stage->rc4_j;
+	size_t n;
+
+	for (n = 0; n < len; n++) {
+		unsigned char t;
+		i++;
+		t = s[i];
+		j = (unsigned char)(j + t);
+		s[i] = s[j];
+		s[j] = t;
+		buf[n] ^= s[(unsigned char)(s[i] + t)];
+	}
+
+	stage->rc4_i = i;
+	stage->rc4_j = j;
+}
+
+void
+xform_apply(xform_stage* stage, unsigned char* buf, size_t len)
+{
+	switch (stage->kind) {
+	case XFORM_XOR:
+	case XFORM_ADD:
+	case XFORM_SUB:
+		xform_keyed(stage, buf, len);
+		break;
+	case XFORM_ROL:
+	case XFORM_ROR:
+		xform_rotate(stage, buf, len);
+		break;
+	case XFORM_XOR_ROLLING:
+		xform_rolling(stage, buf, len);
+		break;
+	case XFORM_RC4:
+		xform_rc4(stage, buf, len);
+		break;
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#ifndef XFORM_H
+#define XFORM_H
+
+#include <stddef.h>
+
+/*
+ * Byte transforms applied to decoded data in place, one chunk after
+ * another. Each stage keeps its position in the key stream, so splitting
+ * the data into chunks never changes the result.
+ *
+ * Builds without the plugin's precompiled header.
+ */
+
+#define XFORM_XOR         1   /* b ^ key[i % keylen] */
+#define XFORM_ADD         2   /* b + key[i % keylen] */
+#define XFORM_SUB         3   /* b - key[i % keylen] */
+#define XFORM_ROL         4   /* b rotated left by key[0] bits */
+#define XFORM_ROR         5   /* b rotated right by key[0] bits */
+#define XFORM_XOR_ROLLING 6   /* b ^ (key[0] + i * key[1]) */
+#define XFORM_RC4         7   /* RC4 key stream */
+
+#define XFORM_MAX_KEY 256
+
+typedef struct xform_stage {
+	int kind;
+	size_t keylen;
+	size_t phase;                               /* key index of the next byte */
+	unsigned char key[XFORM_MAX_KEY + 16];      /* key, then its start again for 16-byte loads */
+	unsigned char rc4_s[256];
+	unsigned char rc4_i;
+	unsigned char rc4_j;
+} xform_stage;
+
+/*
+ * return values is 0 if the key does not suit the kind: empty, longer
+ * than XFORM_MAX_KEY, or for rotations not 1 .. 7 bits
+ */
+int
+xform_init(xform_stage* stage, int kind, const unsigned char* key, size_t keylen);
+
+void
+xform_apply(xform_stage* stage, unsigned char* buf, size_t len);
+
+#endif /* XFORM_H */